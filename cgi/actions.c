@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2004-2008 Richard Kettlewell
+ * Copyright (C) 2004-2008, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -41,9 +41,10 @@ static void redirect(const char *url) {
     /* If back= is not set just go back to the front page */
     url = config->url;
   }
-  if(printf("Location: %s\n"
-            "%s\n"
-            "\n", url, dcgi_cookie_header()) < 0)
+  if(sink_printf(dcgi_output,
+                 "Location: %s\n"
+                 "%s\n"
+                 "\n", url, dcgi_cookie_header()) < 0)
     disorder_fatal(errno, "error writing to stdout");
 }
 
@@ -101,8 +102,8 @@ static void act_playing(void) {
     url = cgi_makeurl(config->url, "action", action, (char *)0);
   else
     url = config->url;
-  if(printf("Refresh: %ld;url=%s\n",
-            refresh, url) < 0)
+  if(sink_printf(dcgi_output, "Refresh: %ld;url=%s\n",
+                 refresh, url) < 0)
     disorder_fatal(errno, "error writing to stdout");
   dcgi_expand("playing", 1);
 }
@@ -305,8 +306,12 @@ static void login_error(const char *e) {
 static int login_as(const char *username, const char *password) {
   disorder_client *c;
 
-  if(dcgi_cookie && dcgi_client)
+  if(dcgi_cookie && dcgi_client) {
     disorder_revoke(dcgi_client);
+    /* The old connection is still logged in but its cookie is now dead, so
+     * it mustn't be reused for later requests. */
+    dcgi_forget_connection();
+  }
   /* We'll need a new connection as we are going to stop being guest.
    * Make sure it's unprivileged, so that the server actually bothers checking
    * the password we supply.
@@ -323,7 +328,7 @@ static int login_as(const char *username, const char *password) {
     return -1;
   }
   /* Use the new connection henceforth */
-  dcgi_client = c;
+  dcgi_use_connection(c);
   dcgi_lookup_reset();
   return 0;                             /* OK */
 }
@@ -383,7 +388,8 @@ static void act_logout(void) {
   }
   /* Attempt to reconnect without the cookie */
   dcgi_cookie = 0;
-  dcgi_login();
+  if(dcgi_login())
+    return;
   /* Back to login page, hopefuly forcing the browser to forget the cookie. */
   dcgi_expand("login", 1);
 }
@@ -738,13 +744,14 @@ void dcgi_expand(const char *name, int header) {
   if(!(found = mx_find(p, 0/*report*/)))
     disorder_fatal(errno, "cannot find %s", p);
   if(header) {
-    if(printf("Content-Type: text/html; charset=UTF-8\n"
-              "%s\n"
-              "\n", dcgi_cookie_header()) < 0)
+    if(sink_printf(dcgi_output,
+                   "Content-Type: text/html; charset=UTF-8\n"
+                   "%s\n"
+                   "\n", dcgi_cookie_header()) < 0)
       disorder_fatal(errno, "error writing to stdout");
   }
-  if(mx_expand_file(found, sink_stdio("stdout", stdout), 0) == -1
-     || fflush(stdout) < 0)
+  if(mx_expand_file(found, dcgi_output, 0) == -1
+     || sink_flush(dcgi_output) < 0)
     disorder_fatal(errno, "error writing to stdout");
 }
 
@@ -21,27 +21,58 @@
 
 #include "disorder-cgi.h"
 
-int main(int argc, char **argv) {
-  const char *conf;
+/** @brief Where the response is written */
+struct sink *dcgi_output;
 
-  if(argc > 0)
-    progname = argv[0];
+/** @brief Nonzero if the configuration specified the URL */
+static int url_configured;
+
+/** @brief Handle one request */
+static void dcgi_request(void) {
   /* RFC 3875 s8.2 recommends rejecting PATH_INFO if we don't make use of
    * it. */
-  if(!setlocale(LC_CTYPE, "")) disorder_error(errno, "error calling setlocale");
   /* TODO we could make disorder/ACTION equivalent to disorder?action=ACTION */
   if(getenv("PATH_INFO")) {
     /* TODO it might be nice to link back to the right place... */
-    printf("Content-Type: text/html; charset=UTF-8\n");
-    printf("Status: 404\n");
-    printf("\n");
-    printf("<p>Sorry, is PATH_INFO not supported."
-           "<a href=\"%s\">Try here instead.</a></p>\n",
-           cgi_sgmlquote(infer_url(0/*!include_path_info*/)));
-    exit(0);
+    sink_printf(dcgi_output, "Content-Type: text/html; charset=UTF-8\n");
+    sink_printf(dcgi_output, "Status: 404\n");
+    sink_printf(dcgi_output, "\n");
+    sink_printf(dcgi_output, "<p>Sorry, is PATH_INFO not supported."
+                "<a href=\"%s\">Try here instead.</a></p>\n",
+                cgi_sgmlquote(infer_url(0/*!include_path_info*/)));
+    return;
   }
   /* Parse CGI arguments */
   cgi_init();
+  /* Figure out our URL.  This can still be overridden from the config file if
+   * necessary but it shouldn't be necessary in ordinary installations. */
+  if(!url_configured)
+    config->url = infer_url(1/*include_path_info*/);
+  /* Forget anything left over from the previous request */
+  dcgi_cookie = 0;
+  dcgi_error_string = 0;
+  dcgi_status_string = 0;
+  /* Pick up the cookie, if there is one */
+  dcgi_get_cookie();
+  /* Never cache anythging */
+  if(sink_printf(dcgi_output, "Cache-Control: no-cache\n") < 0)
+    disorder_fatal(errno, "error writing to stdout");
+  /* Create the initial connection, trying the cookie if we found a suitable
+   * one. */
+  if(!dcgi_login())
+    /* Do whatever the user wanted */
+    dcgi_action(NULL);
+  /* Keep the connection for next time, if we're persistent */
+  dcgi_release();
+}
+
+int main(int argc, char **argv) {
+  const char *conf;
+
+  if(argc > 0)
+    progname = argv[0];
+  mem_init();
+  if(!setlocale(LC_CTYPE, "")) disorder_error(errno, "error calling setlocale");
   /* We allow various things to be overridden from the environment.  This is
    * intended for debugging and is not a documented feature. */
   if((conf = getenv("DISORDER_CONFIG")))
@@ -51,12 +82,7 @@ int main(int argc, char **argv) {
   /* Read configuration */
   if(config_read(0/*!server*/, NULL))
     exit(EXIT_FAILURE);
-  /* Figure out our URL.  This can still be overridden from the config file if
-   * necessary but it shouldn't be necessary in ordinary installations. */
-  if(!config->url)
-    config->url = infer_url(1/*include_path_info*/);
-  /* Pick up the cookie, if there is one */
-  dcgi_get_cookie();
+  url_configured = !!config->url;
   /* Register expansions */
   mx_register_builtin();
   dcgi_expansions();
@@ -64,14 +90,14 @@ int main(int argc, char **argv) {
    * directory second, so that the latter overrides the former. */
   mx_search_path(pkgconfdir);
   mx_search_path(pkgdatadir);
-  /* Never cache anythging */
-  if(printf("Cache-Control: no-cache\n") < 0)
-    disorder_fatal(errno, "error writing to stdout");
-  /* Create the initial connection, trying the cookie if we found a suitable
-   * one. */
-  dcgi_login();
-  /* Do whatever the user wanted */
-  dcgi_action(NULL);
+  /* If we were started by a FastCGI-capable web server then we handle many
+   * requests in this process; everything above is done only once. */
+  if(dcgi_fastcgi()) {
+    dcgi_persistent = 1;
+    dcgi_fastcgi_serve(dcgi_request);
+  }
+  dcgi_output = sink_stdio("stdout", stdout);
+  dcgi_request();
   /* In practice if a write fails that probably means the web server went away,
    * but we log it anyway. */
   if(fclose(stdout) < 0)
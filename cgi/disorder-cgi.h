@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2004-2008 Richard Kettlewell
+ * Copyright (C) 2004-2008, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -57,6 +57,8 @@
 
 extern disorder_client *dcgi_client;
 extern char *dcgi_cookie;
+extern int dcgi_persistent;
+extern struct sink *dcgi_output;
 extern const char *dcgi_error_string;
 extern const char *dcgi_status_string;
 
@@ -66,15 +68,20 @@ int dcgi_compare_entry(const void *a, const void *b);
 void dcgi_expand(const char *name, int header);
 void dcgi_action(const char *action);
 void dcgi_error(const char *key);
-void dcgi_login(void);
+int dcgi_login(void);
+void dcgi_forget_connection(void);
+void dcgi_use_connection(disorder_client *c);
+void dcgi_release(void);
 void dcgi_lookup(unsigned want);
 void dcgi_lookup_reset(void);
 void dcgi_expansions(void);
 char *dcgi_cookie_header(void);
-void dcgi_login(void);
 void dcgi_get_cookie(void);
 struct queue_entry *dcgi_findtrack(const char *id);
 
+int dcgi_fastcgi(void);
+void dcgi_fastcgi_serve(void (*handler)(void)) attribute((noreturn));
+
 void option_set(const char *name, const char *value);
 const char *option_label(const char *key);
 int option_label_exists(const char *key);
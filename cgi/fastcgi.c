@@ -0,0 +1,571 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file cgi/fastcgi.c
+ * @brief FastCGI support
+ *
+ * When the web server starts the CGI with a listening socket as its standard
+ * input, we speak the FastCGI protocol on it instead of handling a single
+ * request.  The process then persists across many requests, so configuration,
+ * registered expansions, parsed templates and server connections only need to
+ * be set up once.
+ *
+ * Only the responder role is implemented, and only one request is handled at
+ * a time on each connection.  The protocol is described at
+ * http://www.fastcgi.com/devkit/doc/fcgi-spec.html.
+ *
+ * Requests are presented to the rest of the CGI exactly as in ordinary CGI
+ * mode: the request parameters are placed in the environment, the request
+ * body is passed to cgi_set_body() and the response is collected from
+ * @ref dcgi_output.
+ */
+
+#include "disorder-cgi.h"
+
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#include "timeval.h"
+
+/** @brief FastCGI protocol version */
+#define FCGI_VERSION_1 1
+
+/** @brief Size of a FastCGI record header */
+#define FCGI_HEADER_LEN 8
+
+/** @brief Largest FastCGI record content */
+#define FCGI_MAX_CONTENT 65535
+
+/* Record types */
+#define FCGI_BEGIN_REQUEST 1
+#define FCGI_ABORT_REQUEST 2
+#define FCGI_END_REQUEST 3
+#define FCGI_PARAMS 4
+#define FCGI_STDIN 5
+#define FCGI_STDOUT 6
+#define FCGI_STDERR 7
+#define FCGI_DATA 8
+#define FCGI_GET_VALUES 9
+#define FCGI_GET_VALUES_RESULT 10
+#define FCGI_UNKNOWN_TYPE 11
+
+/** @brief Keep the connection open after the request (BEGIN_REQUEST flag) */
+#define FCGI_KEEP_CONN 1
+
+/** @brief Responder role */
+#define FCGI_RESPONDER 1
+
+/* Protocol status values for END_REQUEST */
+#define FCGI_REQUEST_COMPLETE 0
+#define FCGI_CANT_MPX_CONN 1
+#define FCGI_UNKNOWN_ROLE 3
+
+/** @brief A FastCGI record */
+struct fcgi_record {
+  /** @brief Record type */
+  int type;
+
+  /** @brief Request ID (0 for management records) */
+  unsigned id;
+
+  /** @brief Content length */
+  size_t length;
+
+  /** @brief Content */
+  unsigned char content[FCGI_MAX_CONTENT];
+};
+
+/** @brief State of the request currently being handled */
+struct fcgi_request {
+  /** @brief Connection file descriptor, or -1 */
+  int fd;
+
+  /** @brief Request ID, or 0 if no request is active */
+  unsigned id;
+
+  /** @brief True to keep the connection open after the request */
+  int keep_conn;
+
+  /** @brief True if the parameter stream is complete */
+  int params_done;
+
+  /** @brief True if the input stream is complete */
+  int stdin_done;
+
+  /** @brief Encoded parameters */
+  struct dynstr params;
+
+  /** @brief Request body */
+  struct dynstr body;
+
+  /** @brief Response, if the handler is running */
+  struct dynstr *output;
+};
+
+/** @brief The current request */
+static struct fcgi_request request = { .fd = -1 };
+
+/** @brief Environment variables set for the current request */
+static struct vector request_env;
+
+/** @brief Read exactly @p n bytes
+ * @param fd File descriptor
+ * @param buffer Where to put data
+ * @param n Number of bytes to read
+ * @return 0 on success, -1 on error or EOF
+ */
+static int fcgi_read(int fd, void *buffer, size_t n) {
+  char *ptr = buffer;
+  ssize_t r;
+
+  while(n > 0) {
+    r = read(fd, ptr, n);
+    if(r > 0) {
+      ptr += r;
+      n -= r;
+    } else if(r == 0)
+      return -1;
+    else if(errno != EINTR) {
+      disorder_error(errno, "error reading FastCGI connection");
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/** @brief Write exactly @p n bytes
+ * @param fd File descriptor
+ * @param buffer Data to write
+ * @param n Number of bytes to write
+ * @return 0 on success, -1 on error
+ */
+static int fcgi_write(int fd, const void *buffer, size_t n) {
+  const char *ptr = buffer;
+  ssize_t w;
+
+  while(n > 0) {
+    w = write(fd, ptr, n);
+    if(w >= 0) {
+      ptr += w;
+      n -= w;
+    } else if(errno != EINTR) {
+      disorder_error(errno, "error writing FastCGI connection");
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/** @brief Read one FastCGI record
+ * @param fd File descriptor
+ * @param r Where to store record
+ * @return 0 on success, -1 on error or EOF
+ */
+static int fcgi_read_record(int fd, struct fcgi_record *r) {
+  unsigned char header[FCGI_HEADER_LEN], padding[256];
+
+  if(fcgi_read(fd, header, sizeof header))
+    return -1;
+  if(header[0] != FCGI_VERSION_1) {
+    disorder_error(0, "unsupported FastCGI version %d", header[0]);
+    return -1;
+  }
+  r->type = header[1];
+  r->id = (header[2] << 8) + header[3];
+  r->length = (header[4] << 8) + header[5];
+  if(fcgi_read(fd, r->content, r->length)
+     || fcgi_read(fd, padding, header[6]))
+    return -1;
+  return 0;
+}
+
+/** @brief Write FastCGI records
+ * @param fd File descriptor
+ * @param type Record type
+ * @param id Request ID
+ * @param content Content
+ * @param n Length of content
+ * @return 0 on success, -1 on error
+ *
+ * Content longer than the maximum record size is split over several records.
+ * If @p n is 0 then a single empty record is written, which for stream
+ * records marks the end of the stream.
+ */
+static int fcgi_write_records(int fd, int type, unsigned id,
+                              const void *content, size_t n) {
+  unsigned char header[FCGI_HEADER_LEN];
+  static const unsigned char padding[8];
+  const char *ptr = content;
+  size_t chunk;
+
+  do {
+    chunk = n > FCGI_MAX_CONTENT ? FCGI_MAX_CONTENT : n;
+    header[0] = FCGI_VERSION_1;
+    header[1] = type;
+    header[2] = id >> 8;
+    header[3] = id;
+    header[4] = chunk >> 8;
+    header[5] = chunk;
+    header[6] = -chunk & 7;             /* pad to a multiple of 8 */
+    header[7] = 0;
+    if(fcgi_write(fd, header, sizeof header)
+       || fcgi_write(fd, ptr, chunk)
+       || fcgi_write(fd, padding, header[6]))
+      return -1;
+    ptr += chunk;
+    n -= chunk;
+  } while(n > 0);
+  return 0;
+}
+
+/** @brief Write an END_REQUEST record
+ * @param fd File descriptor
+ * @param id Request ID
+ * @param app_status Application exit status
+ * @param protocol_status Protocol status
+ * @return 0 on success, -1 on error
+ */
+static int fcgi_end_request(int fd, unsigned id, unsigned long app_status,
+                            int protocol_status) {
+  unsigned char body[8];
+
+  body[0] = app_status >> 24;
+  body[1] = app_status >> 16;
+  body[2] = app_status >> 8;
+  body[3] = app_status;
+  body[4] = protocol_status;
+  body[5] = body[6] = body[7] = 0;
+  return fcgi_write_records(fd, FCGI_END_REQUEST, id, body, sizeof body);
+}
+
+/** @brief Parse one FastCGI name-value length
+ * @param ptr Pointer to cursor
+ * @param end End of input
+ * @param lenp Where to store length
+ * @return 0 on success, -1 if the input is malformed
+ */
+static int fcgi_parse_length(const unsigned char **ptr,
+                             const unsigned char *end,
+                             size_t *lenp) {
+  const unsigned char *p = *ptr;
+
+  if(p >= end)
+    return -1;
+  if(*p < 0x80) {
+    *lenp = *p++;
+  } else {
+    if(end - p < 4)
+      return -1;
+    *lenp = ((size_t)(p[0] & 0x7F) << 24) + (p[1] << 16) + (p[2] << 8) + p[3];
+    p += 4;
+  }
+  *ptr = p;
+  return 0;
+}
+
+/** @brief Callback for each name-value pair
+ * @param name Name (0-terminated)
+ * @param value Value (0-terminated)
+ * @param u User data
+ */
+typedef void fcgi_pair_callback(const char *name, const char *value, void *u);
+
+/** @brief Parse a sequence of FastCGI name-value pairs
+ * @param ptr Start of encoded pairs
+ * @param n Length of encoded pairs
+ * @param callback Called for each pair
+ * @param u Passed to @p callback
+ * @return 0 on success, -1 if the input is malformed
+ */
+static int fcgi_parse_pairs(const void *ptr, size_t n,
+                            fcgi_pair_callback *callback, void *u) {
+  const unsigned char *p = ptr, *end = p + n;
+  size_t namelen, valuelen;
+  char *name, *value;
+
+  while(p < end) {
+    if(fcgi_parse_length(&p, end, &namelen)
+       || fcgi_parse_length(&p, end, &valuelen)
+       || (size_t)(end - p) < namelen
+       || (size_t)(end - p) - namelen < valuelen)
+      return -1;
+    name = xstrndup((const char *)p, namelen);
+    p += namelen;
+    value = xstrndup((const char *)p, valuelen);
+    p += valuelen;
+    callback(name, value, u);
+  }
+  return 0;
+}
+
+/** @brief Append a FastCGI name-value length
+ * @param d Where to append
+ * @param n Length to encode
+ */
+static void fcgi_append_length(struct dynstr *d, size_t n) {
+  if(n < 0x80)
+    dynstr_append(d, n);
+  else {
+    dynstr_append(d, (n >> 24) | 0x80);
+    dynstr_append(d, n >> 16);
+    dynstr_append(d, n >> 8);
+    dynstr_append(d, n);
+  }
+}
+
+/** @brief Answer one GET_VALUES query (callback for fcgi_parse_pairs()) */
+static void fcgi_get_value(const char *name,
+                           const char attribute((unused)) *value,
+                           void *u) {
+  struct dynstr *d = u;
+  const char *answer;
+
+  /* We handle one connection and one request at a time. */
+  if(!strcmp(name, "FCGI_MAX_CONNS") || !strcmp(name, "FCGI_MAX_REQS"))
+    answer = "1";
+  else if(!strcmp(name, "FCGI_MPXS_CONNS"))
+    answer = "0";
+  else
+    return;
+  fcgi_append_length(d, strlen(name));
+  fcgi_append_length(d, strlen(answer));
+  dynstr_append_string(d, name);
+  dynstr_append_string(d, answer);
+}
+
+/** @brief Put one request parameter in the environment
+ * (callback for fcgi_parse_pairs()) */
+static void fcgi_set_param(const char *name, const char *value,
+                           void attribute((unused)) *u) {
+  if(!*name || strchr(name, '='))
+    return;
+  if(setenv(name, value, 1) < 0)
+    disorder_fatal(errno, "error calling setenv");
+  vector_append(&request_env, (char *)name);
+}
+
+/** @brief Complete the current request
+ * @param app_status Application exit status
+ *
+ * Sends the response and the END_REQUEST record, and tidies up the
+ * environment.  If the connection should not be kept open it is closed.
+ */
+static void fcgi_finish_request(unsigned long app_status) {
+  struct dynstr *output = request.output;
+  int n;
+
+  request.output = NULL;
+  if(output) {
+    if(fcgi_write_records(request.fd, FCGI_STDOUT, request.id,
+                          output->vec, output->nvec)
+       || fcgi_write_records(request.fd, FCGI_STDOUT, request.id, "", 0)
+       || fcgi_end_request(request.fd, request.id, app_status,
+                           FCGI_REQUEST_COMPLETE))
+      request.keep_conn = 0;
+  }
+  for(n = 0; n < request_env.nvec; ++n)
+    unsetenv(request_env.vec[n]);
+  request_env.nvec = 0;
+  request.id = 0;
+  if(!request.keep_conn) {
+    xclose(request.fd);
+    request.fd = -1;
+  }
+}
+
+/** @brief Called at exit
+ *
+ * If a fatal error occurs during a request then the process will terminate
+ * (and the web server will start a new one).  The response so far is still
+ * delivered so that any error page that has been generated gets through.
+ */
+static void fcgi_atexit(void) {
+  if(request.output)
+    fcgi_finish_request(EXIT_FAILURE);
+}
+
+/** @brief Run the handler for the current request
+ * @param handler Request handler
+ */
+static void fcgi_run_request(void (*handler)(void)) {
+  struct dynstr output[1];
+  struct timeval started, finished;
+
+  xgettimeofday(&started, NULL);
+  if(fcgi_parse_pairs(request.params.vec, request.params.nvec,
+                      fcgi_set_param, NULL)) {
+    disorder_error(0, "malformed FastCGI parameters");
+    request.keep_conn = 0;
+  }
+  cgi_set_body(request.body.vec, request.body.nvec);
+  dynstr_init(output);
+  request.output = output;
+  dcgi_output = sink_dynstr(output);
+  handler();
+  dcgi_output = NULL;
+  cgi_set_body(NULL, 0);
+  fcgi_finish_request(0);
+  xgettimeofday(&finished, NULL);
+  D(("request took %"PRId64"us", tvsub_us(finished, started)));
+}
+
+/** @brief Handle one FastCGI connection
+ * @param fd Connection
+ * @param handler Request handler
+ */
+static void fcgi_connection(int fd, void (*handler)(void)) {
+  static struct fcgi_record r;
+  struct dynstr d[1];
+
+  request.fd = fd;
+  request.id = 0;
+  request.keep_conn = 1;
+  while(request.fd >= 0) {
+    if(fcgi_read_record(fd, &r)) {
+      xclose(fd);
+      request.fd = -1;
+      break;
+    }
+    if(r.id == 0) {
+      /* Management record */
+      switch(r.type) {
+      case FCGI_GET_VALUES:
+        dynstr_init(d);
+        if(fcgi_parse_pairs(r.content, r.length, fcgi_get_value, d))
+          disorder_error(0, "malformed FastCGI GET_VALUES record");
+        fcgi_write_records(fd, FCGI_GET_VALUES_RESULT, 0, d->vec, d->nvec);
+        break;
+      default: {
+        unsigned char body[8];
+
+        memset(body, 0, sizeof body);
+        body[0] = r.type;
+        fcgi_write_records(fd, FCGI_UNKNOWN_TYPE, 0, body, sizeof body);
+        break;
+      }
+      }
+      continue;
+    }
+    if(r.type == FCGI_BEGIN_REQUEST) {
+      int role;
+
+      if(r.length < 8) {
+        disorder_error(0, "malformed FastCGI BEGIN_REQUEST record");
+        continue;
+      }
+      role = (r.content[0] << 8) + r.content[1];
+      if(request.id) {
+        /* We don't multiplex requests */
+        fcgi_end_request(fd, r.id, 0, FCGI_CANT_MPX_CONN);
+      } else if(role != FCGI_RESPONDER) {
+        fcgi_end_request(fd, r.id, 0, FCGI_UNKNOWN_ROLE);
+      } else {
+        request.id = r.id;
+        request.keep_conn = !!(r.content[2] & FCGI_KEEP_CONN);
+        request.params_done = request.stdin_done = 0;
+        dynstr_init(&request.params);
+        dynstr_init(&request.body);
+      }
+      continue;
+    }
+    if(r.id != request.id)
+      /* Records for inactive requests are ignored */
+      continue;
+    switch(r.type) {
+    case FCGI_ABORT_REQUEST:
+      fcgi_end_request(fd, request.id, 0, FCGI_REQUEST_COMPLETE);
+      request.id = 0;
+      if(!request.keep_conn) {
+        xclose(fd);
+        request.fd = -1;
+      }
+      continue;
+    case FCGI_PARAMS:
+      if(r.length)
+        dynstr_append_bytes(&request.params, (char *)r.content, r.length);
+      else
+        request.params_done = 1;
+      break;
+    case FCGI_STDIN:
+      if(r.length)
+        dynstr_append_bytes(&request.body, (char *)r.content, r.length);
+      else
+        request.stdin_done = 1;
+      break;
+    case FCGI_DATA:
+      /* Only meaningful for the filter role */
+      break;
+    default:
+      disorder_error(0, "unexpected FastCGI record type %d", r.type);
+      break;
+    }
+    if(request.params_done && request.stdin_done)
+      fcgi_run_request(handler);
+  }
+}
+
+/** @brief Test whether we were started as a FastCGI application
+ * @return Nonzero if standard input is a listening socket
+ *
+ * This is the same test as used by the FastCGI development kit.
+ */
+int dcgi_fastcgi(void) {
+  struct sockaddr_storage sa;
+  socklen_t len = sizeof sa;
+
+  return getpeername(0, (struct sockaddr *)&sa, &len) < 0
+    && errno == ENOTCONN;
+}
+
+/** @brief Serve FastCGI requests
+ * @param handler Called to handle each request
+ *
+ * Never returns.  @p handler is called once per request, with the
+ * environment and request body set up, and should write its response to
+ * @ref dcgi_output.
+ */
+void dcgi_fastcgi_serve(void (*handler)(void)) {
+  struct sigaction sa;
+  int fd;
+
+  /* A web server that goes away mid-response should not kill us */
+  memset(&sa, 0, sizeof sa);
+  sa.sa_handler = SIG_IGN;
+  xsigaction(SIGPIPE, &sa, 0);
+  atexit(fcgi_atexit);
+  vector_init(&request_env);
+  for(;;) {
+    if((fd = accept(0, NULL, NULL)) < 0) {
+      if(errno == EINTR || errno == ECONNABORTED)
+        continue;
+      disorder_fatal(errno, "error calling accept");
+    }
+    cloexec(fd);
+    fcgi_connection(fd, handler);
+  }
+}
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2008 Richard Kettlewell
+ * Copyright (C) 2008, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -121,23 +121,170 @@ char *dcgi_cookie_header(void) {
   return s;
 }
 
-/** @brief Log in as the current user or guest if none */
-void dcgi_login(void) {
+/** @brief How long a cached connection may be reused for
+ *
+ * Cookies are only checked when a connection is made, so this bounds how
+ * long an expired or revoked cookie can continue to work in persistent mode.
+ */
+#define DCGI_CONNECTION_LIFETIME 60
+
+/** @brief Maximum number of cached connections */
+#define DCGI_MAX_CONNECTIONS 32
+
+/** @brief A cached connection */
+struct dcgi_connection {
+  /** @brief Client */
+  disorder_client *client;
+
+  /** @brief When the connection was made */
+  time_t created;
+};
+
+/** @brief Nonzero if we serve more than one request per process
+ *
+ * If this is set then server connections are kept open between requests,
+ * keyed by the login cookie.
+ */
+int dcgi_persistent;
+
+/** @brief Cached connections, keyed by cookie ("" for guest) */
+static hash *dcgi_connections;
+
+/** @brief When @ref dcgi_client was made */
+static time_t dcgi_client_created;
+
+/** @brief Set if @ref dcgi_client must not be cached */
+static int dcgi_client_forget;
+
+/** @brief Take a usable cached connection for @ref dcgi_cookie, if any
+ * @return Client or NULL
+ *
+ * The connection is removed from the cache while it is in use; see
+ * dcgi_release().
+ */
+static disorder_client *dcgi_reuse(void) {
+  const char *key = dcgi_cookie ? dcgi_cookie : "";
+  struct dcgi_connection *dc, c;
+  time_t now;
+
+  if(!dcgi_connections
+     || !(dc = hash_find(dcgi_connections, key)))
+    return NULL;
+  c = *dc;
+  hash_remove(dcgi_connections, key);
+  xtime(&now);
+  if(now - c.created < DCGI_CONNECTION_LIFETIME
+     && disorder_client_alive(c.client)) {
+    dcgi_client_created = c.created;
+    return c.client;
+  }
+  disorder_close(c.client);
+  return NULL;
+}
+
+/** @brief Discard the oldest cached connection */
+static void dcgi_evict(void) {
+  char **keys = hash_keys(dcgi_connections), *oldest = NULL;
+  time_t oldest_created = 0;
+  struct dcgi_connection *dc;
+
+  for(; *keys; ++keys) {
+    dc = hash_find(dcgi_connections, *keys);
+    if(!oldest || dc->created < oldest_created) {
+      oldest = *keys;
+      oldest_created = dc->created;
+    }
+  }
+  if(oldest) {
+    dc = hash_find(dcgi_connections, oldest);
+    disorder_close(dc->client);
+    hash_remove(dcgi_connections, oldest);
+  }
+}
+
+/** @brief Log in as the current user or guest if none
+ * @return 0 on success, non-0 if an error page was generated
+ *
+ * In persistent mode, a cached connection for the current cookie is used if
+ * one is available.
+ */
+int dcgi_login(void) {
   /* Junk old data */
   dcgi_lookup_reset();
   /* Junk the old connection if there is one */
   if(dcgi_client)
     disorder_close(dcgi_client);
+  dcgi_client = NULL;
+  dcgi_client_forget = 0;
+  if(dcgi_persistent && (dcgi_client = dcgi_reuse()))
+    return 0;
   /* Create a new connection */
   dcgi_client = disorder_new(0);
+  xtime(&dcgi_client_created);
   /* Reconnect */
   if(disorder_connect_cookie(dcgi_client, dcgi_cookie)) {
     dcgi_error("connect");
-    exit(0);
+    dcgi_client = NULL;
+    return -1;
   }
   /* If there was a cookie but it went bad, we forget it */
   if(dcgi_cookie && !strcmp(disorder_user(dcgi_client), "guest"))
     dcgi_cookie = 0;
+  return 0;
+}
+
+/** @brief Don't reuse the current connection for later requests
+ *
+ * Used when the connection's cookie has been revoked.
+ */
+void dcgi_forget_connection(void) {
+  dcgi_client_forget = 1;
+}
+
+/** @brief Switch to a new connection
+ * @param c New connection
+ *
+ * The old connection, if any, is closed.  The new one may be cached in the
+ * usual way when the request finishes.
+ */
+void dcgi_use_connection(disorder_client *c) {
+  if(dcgi_client)
+    disorder_close(dcgi_client);
+  dcgi_client = c;
+  dcgi_client_forget = 0;
+  xtime(&dcgi_client_created);
+}
+
+/** @brief Finished with the current connection
+ *
+ * Called at the end of each request.  In persistent mode the connection is
+ * cached for reuse by later requests bearing the same cookie; otherwise it is
+ * closed.
+ */
+void dcgi_release(void) {
+  const char *key = dcgi_cookie ? dcgi_cookie : "";
+  struct dcgi_connection dc[1], *old;
+
+  if(!dcgi_client)
+    return;
+  if(dcgi_persistent
+     && !dcgi_client_forget
+     && disorder_client_alive(dcgi_client)
+     /* Never cache a logged-in connection under the guest key */
+     && (dcgi_cookie || !strcmp(disorder_user(dcgi_client), "guest"))) {
+    if(!dcgi_connections)
+      dcgi_connections = hash_new(sizeof (struct dcgi_connection));
+    if((old = hash_find(dcgi_connections, key))) {
+      disorder_close(old->client);
+      hash_remove(dcgi_connections, key);
+    } else if(hash_count(dcgi_connections) >= DCGI_MAX_CONNECTIONS)
+      dcgi_evict();
+    dc->client = dcgi_client;
+    dc->created = dcgi_client_created;
+    hash_add(dcgi_connections, key, dc, HASH_INSERT);
+  } else
+    disorder_close(dcgi_client);
+  dcgi_client = NULL;
 }
 
 /*
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2004-2013 Richard Kettlewell
+ * Copyright (C) 2004-2013, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -68,6 +68,7 @@
 #include "inputline.h"
 
 static disorder_client *client;
+static int binary;
 
 static const struct option options[] = {
   { "help", no_argument, 0, 'h' },
@@ -75,6 +76,7 @@ static const struct option options[] = {
   { "config", required_argument, 0, 'c' },
   { "debug", no_argument, 0, 'd' },
   { "local", no_argument, 0, 'l' },
+  { "binary", no_argument, 0, 'b' },
   { "user-config", required_argument, 0, 'u' },
   { "no-per-user-config", no_argument, 0, 'N' },
   { "help-commands", no_argument, 0, 'H' },
@@ -94,6 +96,7 @@ static void attribute((noreturn)) help(void) {
 	  "  --config PATH, -c PATH  Set system configuration file\n"
 	  "  --user-config PATH, -u PATH  Set user configuration file\n"
 	  "  --local, -l             Force connection to local server\n"
+	  "  --binary, -b            Ask for binary framing of responses\n"
 	  "  --debug, -d             Turn on debugging\n");
   xfclose(stdout);
   exit(0);
@@ -102,6 +105,8 @@ static void attribute((noreturn)) help(void) {
 static disorder_client *getclient(void) {
   if(!client) {
     if(!(client = disorder_new(1))) exit(EXIT_FAILURE);
+    if(binary)
+      disorder_want_binary(client);
     if(disorder_connect(client)) exit(EXIT_FAILURE);
   }
   return client;
@@ -327,6 +332,17 @@ static void cf_random_enable(char attribute((unused)) **argv) {
   if(disorder_random_enable(getclient())) exit(EXIT_FAILURE);
 }
 
+static void cf_memstats(char attribute((unused)) **argv) {
+  char **vec;
+  int nvec;
+  int n;
+
+  if(disorder_memstats(getclient(), &vec, &nvec)) exit(EXIT_FAILURE);
+  for(n = 0; n < nvec; ++n)
+    xprintf("%s\n", nullcheck(utf82mb(vec[n])));
+  free_strings(nvec, vec);
+}
+
 static void cf_stats(char attribute((unused)) **argv) {
   char **vec;
   int nvec;
@@ -761,6 +777,8 @@ static const struct client_command {
                       "Get the length of TRACK in seconds" },
   { "log",            0, 0, cf_log, 0, "",
                       "Copy event log to stdout" },
+  { "memstats",       0, 0, cf_memstats, 0, "",
+                      "Display server memory usage" },
   { "move",           2, 2, cf_move, 0, "TRACK DELTA",
                       "Move a track in the queue" },
   { "new",            0, 1, cf_new, isarg_integer, "[MAX]",
@@ -885,7 +903,7 @@ int main(int argc, char **argv) {
   regexp_setup();
   if(!setlocale(LC_CTYPE, "")) disorder_fatal(errno, "error calling setlocale");
   if(!setlocale(LC_TIME, "")) disorder_fatal(errno, "error calling setlocale");
-  while((n = getopt_long(argc, argv, "+hVc:dHlu:", options, 0)) >= 0) {
+  while((n = getopt_long(argc, argv, "+hVc:dHlbu:", options, 0)) >= 0) {
     switch(n) {
     case 'h': help();
     case 'H': help_commands();
@@ -894,6 +912,7 @@ int main(int argc, char **argv) {
     case 'u': userconfigfile = optarg; break;
     case 'd': debugging = 1; break;
     case 'l': local = 1; break;
+    case 'b': binary = 1; break;
     case 'N': config_per_user = 0; break;
     case 'U': user = optarg; break;
     case 'P': password = optarg; break;
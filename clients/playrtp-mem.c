@@ -26,6 +26,7 @@
 #include "mem.h"
 #include "vector.h"
 #include "heap.h"
+#include "ring.h"
 #include "playrtp.h"
 
 /** @brief Linked list of free packets
@@ -27,12 +27,11 @@
  * The program runs (at least) three threads:
  *
  * listen_thread() is responsible for reading RTP packets off the wire and
- * adding them to the linked list @ref received_packets, assuming they are
- * basically sound.
+ * adding them to the ring @ref received_packets, assuming they are basically
+ * sound.
  *
- * queue_thread() takes packets off this linked list and adds them to @ref
- * packets (an operation which might be much slower due to contention for @ref
- * lock).
+ * queue_thread() takes packets off this ring and adds them to @ref packets (an
+ * operation which might be much slower due to contention for @ref lock).
  *
  * control_thread() accepts commands from Disobedience (or anything else).
  *
@@ -79,6 +78,8 @@
 #include "defs.h"
 #include "vector.h"
 #include "heap.h"
+#include "ring.h"
+#include "samples.h"
 #include "timeval.h"
 #include "client.h"
 #include "playrtp.h"
@@ -108,34 +109,40 @@ unsigned minbuffer;
  */
 static unsigned maxbuffer;
 
-/** @brief Received packets
- * Protected by @ref receive_lock
+/** @brief Number of packets @ref received_packets can hold
  *
- * Received packets are added to this list, and queue_thread() picks them off
- * it and adds them to @ref packets.  Whenever a packet is added to it, @ref
- * receive_cond is signalled.
+ * About 30s of audio at the usual packet size.  Must be a power of 2.
  */
-struct packet *received_packets;
+#define RECEIVE_RING_SIZE 4096
+
+/** @brief Maximum number of packets to read in one system call */
+#define RECEIVE_BATCH 16
 
-/** @brief Tail of @ref received_packets
- * Protected by @ref receive_lock
+/** @brief Received packets
+ *
+ * listen_thread() adds packets to this ring, and queue_thread() picks them off
+ * it and adds them to @ref packets.  Since there is exactly one producer and
+ * one consumer, no lock is needed to add or remove packets.
  */
-struct packet **received_tail = &received_packets;
+struct packet_ring received_packets;
 
-/** @brief Lock protecting @ref received_packets 
+/** @brief Lock used by queue_thread() to wait for packets
  *
- * Only listen_thread() and queue_thread() ever hold this lock.  It is vital
- * that queue_thread() not hold it any longer than it strictly has to. */
+ * Only listen_thread() and queue_thread() ever hold this lock, and only when
+ * queue_thread() has run out of packets. */
 pthread_mutex_t receive_lock = PTHREAD_MUTEX_INITIALIZER;
 
 /** @brief Condition variable signalled when @ref received_packets is updated
  *
- * Used by listen_thread() to notify queue_thread() that it has added another
- * packet to @ref received_packets. */
+ * Used by listen_thread() to wake up queue_thread() when it is waiting for
+ * packets, as indicated by @ref queue_waiting. */
 pthread_cond_t receive_cond = PTHREAD_COND_INITIALIZER;
 
-/** @brief Length of @ref received_packets */
-uint32_t nreceived;
+/** @brief Set while queue_thread() is waiting for packets
+ *
+ * Only accessed with atomic operations.  See ring_fence().
+ */
+static int queue_waiting;
 
 /** @brief Binary heap of received packets */
 struct pheap packets;
@@ -317,29 +324,31 @@ static void drop_first_packet(void) {
 /** @brief Background thread adding packets to heap
  *
  * This just transfers packets from @ref received_packets to @ref packets.  It
- * is important that it holds @ref receive_lock for as little time as possible,
- * in order to minimize the interval between calls to read() in
- * listen_thread().
+ * moves as many packets as are available each time it acquires @ref lock, and
+ * only sleeps (and only then involves @ref receive_lock) when there are none.
  */
 static void *queue_thread(void attribute((unused)) *arg) {
   struct packet *p;
 
   for(;;) {
     /* Get the next packet */
-    pthread_mutex_lock(&receive_lock);
-    while(!received_packets) {
-      pthread_cond_wait(&receive_cond, &receive_lock);
+    if(packet_ring_get(&received_packets, &p)) {
+      /* None available; sleep until listen_thread() adds some */
+      pthread_mutex_lock(&receive_lock);
+      __atomic_store_n(&queue_waiting, 1, __ATOMIC_RELAXED);
+      ring_fence();
+      while(!packet_ring_count(&received_packets))
+        pthread_cond_wait(&receive_cond, &receive_lock);
+      __atomic_store_n(&queue_waiting, 0, __ATOMIC_RELAXED);
+      pthread_mutex_unlock(&receive_lock);
+      continue;
     }
-    p = received_packets;
-    received_packets = p->next;
-    if(!received_packets)
-      received_tail = &received_packets;
-    --nreceived;
-    pthread_mutex_unlock(&receive_lock);
-    /* Add it to the heap */
+    /* Add it, and anything else that's arrived meanwhile, to the heap */
     pthread_mutex_lock(&lock);
-    pheap_insert(&packets, p);
-    nsamples += p->nsamples;
+    do {
+      pheap_insert(&packets, p);
+      nsamples += p->nsamples;
+    } while(!packet_ring_get(&received_packets, &p));
     pthread_cond_broadcast(&cond);
     pthread_mutex_unlock(&lock);
   }
@@ -348,43 +357,124 @@ static void *queue_thread(void attribute((unused)) *arg) {
 #endif
 }
 
+/** @brief Wake up queue_thread() if it is waiting for packets
+ *
+ * Called by listen_thread() after adding packets to @ref received_packets.
+ */
+static void wake_queue_thread(void) {
+  ring_fence();
+  if(__atomic_load_n(&queue_waiting, __ATOMIC_RELAXED)) {
+    pthread_mutex_lock(&receive_lock);
+    pthread_cond_signal(&receive_cond);
+    pthread_mutex_unlock(&receive_lock);
+  }
+}
+
+/** @brief Check and convert a received packet
+ * @param p Packet with samples already filled in
+ * @param header RTP header
+ * @param n Number of bytes received, including @p header
+ * @return 0 if the packet should be played, -1 if it should be ignored
+ */
+static int receive_packet(struct packet *p,
+                          const struct rtp_header *header,
+                          int n) {
+  uint16_t seq;
+  uint32_t timestamp;
+
+  /* Ignore too-short packets */
+  if((size_t)n <= sizeof (struct rtp_header)) {
+    disorder_info("ignored a short packet");
+    return -1;
+  }
+  timestamp = htonl(header->timestamp);
+  seq = htons(header->seq);
+  /* Ignore packets in the past */
+  if(active && lt(timestamp, next_timestamp)) {
+    disorder_info("dropping old packet, timestamp=%"PRIx32" < %"PRIx32,
+         timestamp, next_timestamp);
+    return -1;
+  }
+  /* Ignore packets with the extension bit set. */
+  if(header->vpxcc & 0x10)
+    return -1;
+  p->flags = 0;
+  p->timestamp = timestamp;
+  /* Convert to target format */
+  if(header->mpt & 0x80)
+    p->flags |= IDLE;
+  switch(header->mpt & 0x7F) {
+  case 10:                              /* L16 */
+    p->nsamples = (n - sizeof *header) / sizeof(uint16_t);
+    break;
+    /* TODO support other RFC3551 media types (when the speaker does) */
+  default:
+    disorder_fatal(0, "unsupported RTP payload type %d", header->mpt & 0x7F);
+  }
+  /* See if packet is silent */
+  if(samples_zero(p->samples_raw, p->nsamples * sizeof(uint16_t)))
+    p->flags |= SILENT;
+  if(logfp)
+    fprintf(logfp, "sequence %u timestamp %"PRIx32" length %"PRIx32" end %"PRIx32"\n",
+            seq, timestamp, p->nsamples, timestamp + p->nsamples);
+  return 0;
+}
+
 /** @brief Background thread collecting samples
  *
  * This function collects samples, perhaps converts them to the target format,
- * and adds them to the packet list.
+ * and adds them to the packet ring.
  *
- * It is crucial that the gap between successive calls to read() is as small as
- * possible: otherwise packets will be dropped.
+ * It is crucial that the gap between successive reads is as small as
+ * possible: otherwise packets will be dropped.  Where recvmmsg() is available
+ * we collect up to @ref RECEIVE_BATCH packets per system call, and in any case
+ * handing packets to queue_thread() only involves a lock if it has run out of
+ * work.
  *
  * We use a binary heap to ensure that the unavoidable effort is at worst
  * logarithmic in the total number of packets - in fact if packets are mostly
  * received in order then we will largely do constant work per packet since the
  * newest packet will always be last.
  *
- * Of more concern is that we must acquire the lock on the heap to add a packet
- * to it.  If this proves a problem in practice then the answer would be
- * (probably doubly) linked list with new packets added the end and a second
- * thread which reads packets off the list and adds them to the heap.
- *
  * We keep memory allocation (mostly) very fast by keeping pre-allocated
  * packets around; see @ref playrtp_new_packet().
  */
 static void *listen_thread(void attribute((unused)) *arg) {
-  struct packet *p = 0;
-  int n;
-  struct rtp_header header;
-  uint16_t seq;
-  uint32_t timestamp;
-  struct iovec iov[2];
+  struct packet *batch[RECEIVE_BATCH];
+  struct rtp_header headers[RECEIVE_BATCH];
+  struct iovec iov[RECEIVE_BATCH][2];
+  int lengths[RECEIVE_BATCH];
+#if HAVE_RECVMMSG
+  struct mmsghdr msgs[RECEIVE_BATCH];
+#endif
+  int n, i, queued;
 
+  memset(batch, 0, sizeof batch);
   for(;;) {
-    if(!p)
-      p = playrtp_new_packet();
-    iov[0].iov_base = &header;
-    iov[0].iov_len = sizeof header;
-    iov[1].iov_base = p->samples_raw;
-    iov[1].iov_len = sizeof p->samples_raw / sizeof *p->samples_raw;
-    n = readv(rtpfd, iov, 2);
+    for(i = 0; i < RECEIVE_BATCH; ++i) {
+      if(!batch[i])
+        batch[i] = playrtp_new_packet();
+      iov[i][0].iov_base = &headers[i];
+      iov[i][0].iov_len = sizeof headers[i];
+      iov[i][1].iov_base = batch[i]->samples_raw;
+      iov[i][1].iov_len = sizeof batch[i]->samples_raw;
+#if HAVE_RECVMMSG
+      memset(&msgs[i], 0, sizeof msgs[i]);
+      msgs[i].msg_hdr.msg_iov = iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 2;
+#endif
+    }
+#if HAVE_RECVMMSG
+    /* Block for the first packet, then take whatever else is waiting */
+    n = recvmmsg(rtpfd, msgs, RECEIVE_BATCH, MSG_WAITFORONE, NULL);
+    for(i = 0; i < n; ++i)
+      lengths[i] = msgs[i].msg_len;
+#else
+    if((lengths[0] = readv(rtpfd, iov[0], 2)) >= 0)
+      n = 1;
+    else
+      n = -1;
+#endif
     if(n < 0) {
       switch(errno) {
       case EINTR:
@@ -393,67 +483,38 @@ static void *listen_thread(void attribute((unused)) *arg) {
         disorder_fatal(errno, "error reading from socket");
       }
     }
-    /* Ignore too-short packets */
-    if((size_t)n <= sizeof (struct rtp_header)) {
-      disorder_info("ignored a short packet");
-      continue;
-    }
-    timestamp = htonl(header.timestamp);
-    seq = htons(header.seq);
-    /* Ignore packets in the past */
-    if(active && lt(timestamp, next_timestamp)) {
-      disorder_info("dropping old packet, timestamp=%"PRIx32" < %"PRIx32,
-           timestamp, next_timestamp);
-      continue;
-    }
-    /* Ignore packets with the extension bit set. */
-    if(header.vpxcc & 0x10)
-      continue;
-    p->next = 0;
-    p->flags = 0;
-    p->timestamp = timestamp;
-    /* Convert to target format */
-    if(header.mpt & 0x80)
-      p->flags |= IDLE;
-    switch(header.mpt & 0x7F) {
-    case 10:                            /* L16 */
-      p->nsamples = (n - sizeof header) / sizeof(uint16_t);
-      break;
-      /* TODO support other RFC3551 media types (when the speaker does) */
-    default:
-      disorder_fatal(0, "unsupported RTP payload type %d", header.mpt & 0x7F);
-    }
-    /* See if packet is silent */
-    const uint16_t *s = p->samples_raw;
-    n = p->nsamples;
-    for(; n > 0; --n)
-      if(*s++)
-        break;
-    if(!n)
-      p->flags |= SILENT;
-    if(logfp)
-      fprintf(logfp, "sequence %u timestamp %"PRIx32" length %"PRIx32" end %"PRIx32"\n",
-              seq, timestamp, p->nsamples, timestamp + p->nsamples);
-    /* Stop reading if we've reached the maximum.
-     *
-     * This is rather unsatisfactory: it means that if packets get heavily
-     * out of order then we guarantee dropouts.  But for now... */
-    if(nsamples >= maxbuffer) {
-      pthread_mutex_lock(&lock);
-      while(nsamples >= maxbuffer) {
-        pthread_cond_wait(&cond, &lock);
+    queued = 0;
+    for(i = 0; i < n; ++i) {
+      if(receive_packet(batch[i], &headers[i], lengths[i]))
+        continue;                       /* buffer will be reused */
+      /* Stop reading if we've reached the maximum.
+       *
+       * This is rather unsatisfactory: it means that if packets get heavily
+       * out of order then we guarantee dropouts.  But for now... */
+      if(nsamples >= maxbuffer) {
+        if(queued) {
+          wake_queue_thread();
+          queued = 0;
+        }
+        pthread_mutex_lock(&lock);
+        while(nsamples >= maxbuffer) {
+          pthread_cond_wait(&cond, &lock);
+        }
+        pthread_mutex_unlock(&lock);
       }
-      pthread_mutex_unlock(&lock);
+      /* Add the packet to the receive ring.  It only fills up if
+       * queue_thread() is stuck, in which case all we can do is wait. */
+      while(packet_ring_put(&received_packets, batch[i])) {
+        static const struct timespec delay = { 0, 1000000 };
+        wake_queue_thread();
+        nanosleep(&delay, NULL);
+      }
+      ++queued;
+      /* We'll need a new packet */
+      batch[i] = 0;
     }
-    /* Add the packet to the receive queue */
-    pthread_mutex_lock(&receive_lock);
-    *received_tail = p;
-    received_tail = &p->next;
-    ++nreceived;
-    pthread_cond_signal(&receive_cond);
-    pthread_mutex_unlock(&receive_lock);
-    /* We'll need a new packet */
-    p = 0;
+    if(queued)
+      wake_queue_thread();
   }
 }
 
@@ -564,12 +625,11 @@ static size_t playrtp_callback(void *buffer,
       samples = max_samples;
 
     /* Copy into buffer, converting to native endianness */
-    size_t i = samples;
-    int16_t *bufptr = buffer;
-    while(i > 0) {
-      *bufptr++ = (int16_t)ntohs(*ptr++);
-      --i;
-    }
+#if WORDS_BIGENDIAN
+    memcpy(buffer, ptr, samples * sizeof(uint16_t));
+#else
+    samples_swap16(buffer, ptr, samples);
+#endif
     silent = !!(p->flags & SILENT);
   } else {
     /* There is no suitable packet.  We introduce 0s up to the next packet, or
@@ -1003,6 +1063,7 @@ int main(int argc, char **argv) {
   backend->start(playrtp_callback, NULL);
   if(backend->open_mixer) backend->open_mixer();
   /* We receive and convert audio data in a background thread */
+  packet_ring_init(&received_packets, RECEIVE_RING_SIZE);
   if((err = pthread_create(&ltid, 0, listen_thread, 0)))
     disorder_fatal(err, "pthread_create listen_thread");
   /* We have a second thread to add received packets to the queue */
@@ -41,9 +41,6 @@
  * timestamp.
  */
 struct packet {
-  /** @brief Next packet in @ref next_free_packet or @ref received_packets */
-  struct packet *next;
-  
   /** @brief Number of samples in this packet */
   uint32_t nsamples;
 
@@ -127,16 +124,18 @@ static inline int contains(const struct packet *p, uint32_t timestamp) {
  * @brief Binary heap of packets ordered by timestamp */
 HEAP_TYPE(pheap, struct packet *, lt_packet);
 
+/** @struct packet_ring
+ * @brief Ring of packets passed from listen_thread() to queue_thread() */
+RING_TYPE(packet_ring, struct packet *);
+
 struct packet *playrtp_new_packet(void);
 void playrtp_free_packet(struct packet *p);
 void playrtp_fill_buffer(void);
 struct packet *playrtp_next_packet(void);
 
-extern struct packet *received_packets;
-extern struct packet **received_tail;
+extern struct packet_ring received_packets;
 extern pthread_mutex_t receive_lock;
 extern pthread_cond_t receive_cond;
-extern uint32_t nreceived;
 extern struct pheap packets;
 extern volatile uint32_t nsamples;
 extern uint32_t next_timestamp;
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2010 Richard Kettlewell
+ * Copyright (C) 2010, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -29,19 +29,65 @@
 
 static int hreader_fill(struct hreader *h, off_t offset);
 
+/** @brief Buffer size for new readers */
+static size_t hreader_bufsize = HREADER_DEFAULT_BUFSIZE;
+
+/** @brief Flags for new readers */
+static unsigned hreader_flags = HREADER_PREFETCH;
+
+void hreader_defaults(size_t bufsize, unsigned flags) {
+  hreader_bufsize = bufsize ? bufsize : HREADER_DEFAULT_BUFSIZE;
+  hreader_flags = flags;
+}
+
+/** @brief Open the file
+ * @param h Reader
+ * @return File descriptor or -1 on error
+ *
+ * In @ref HREADER_KEEP_OPEN mode the descriptor is remembered in @c h->fd.
+ */
+static int hreader_open(struct hreader *h) {
+  int fd = open(h->path, O_RDONLY);
+  if(fd < 0)
+    return -1;
+#if HAVE_POSIX_FADVISE
+  /* Only a descriptor that is kept open sees the reads in sequence; each
+   * reopen would discard the readahead state anyway */
+  if((h->flags & (HREADER_PREFETCH|HREADER_KEEP_OPEN))
+     == (HREADER_PREFETCH|HREADER_KEEP_OPEN))
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+  if(h->flags & HREADER_KEEP_OPEN)
+    h->fd = fd;
+  return fd;
+}
+
 int hreader_init(const char *path, struct hreader *h) {
   struct stat sb;
-  if(stat(path, &sb) < 0)
-    return -1;
+  int save_errno;
+
   memset(h, 0, sizeof *h);
   h->path = xstrdup(path);
+  h->flags = hreader_flags;
+  h->fd = -1;
+  if(h->flags & HREADER_KEEP_OPEN
+     ? hreader_open(h) < 0 || fstat(h->fd, &sb) < 0
+     : stat(path, &sb) < 0) {
+    save_errno = errno;
+    hreader_close(h);
+    errno = save_errno;
+    return -1;
+  }
   h->size = sb.st_size;
-  h->bufsize = 65536;
+  h->bufsize = hreader_bufsize;
   h->buffer = xmalloc_noptr(h->bufsize);
   return 0;
 }
 
 void hreader_close(struct hreader *h) {
+  if(h->fd >= 0)
+    close(h->fd);
+  h->fd = -1;
   xfree(h->path);
   xfree(h->buffer);
 }
@@ -80,13 +126,33 @@ int hreader_pread(struct hreader *h, void *buffer, size_t n, off_t offset) {
 }
 
 static int hreader_fill(struct hreader *h, off_t offset) {
-  int fd = open(h->path, O_RDONLY);
-  if(fd < 0)
-    return -1;
-  int n = pread(fd, h->buffer, h->bufsize, offset);
-  close(fd);
-  if(n < 0)
+  int fd, save_errno, retried = 0;
+  ssize_t n;
+
+  for(;;) {
+    if((fd = h->fd) < 0 && (fd = hreader_open(h)) < 0)
+      return -1;
+    n = pread(fd, h->buffer, h->bufsize, offset);
+    save_errno = errno;
+#if HAVE_POSIX_FADVISE
+    /* Start fetching the next buffer while the caller works on this one */
+    if(n > 0 && h->flags & HREADER_PREFETCH && offset + n < h->size)
+      posix_fadvise(fd, offset + n, h->bufsize, POSIX_FADV_WILLNEED);
+#endif
+    if(fd != h->fd || (n < 0 && save_errno == ESTALE)) {
+      close(fd);
+      h->fd = -1;
+    }
+    /* A stale handle (e.g. after the file was replaced on an NFS server) is
+     * worth one retry with a fresh lookup */
+    if(n < 0 && save_errno == ESTALE && !retried++)
+      continue;
+    break;
+  }
+  if(n < 0) {
+    errno = save_errno;
     return -1;
+  }
   h->buf_offset = offset;
   h->bytes = n;
   return n;
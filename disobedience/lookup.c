@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2008 Richard Kettlewell
+ * Copyright (C) 2008, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -21,8 +21,8 @@
 #include "disobedience.h"
 
 static int namepart_lookups_outstanding;
-static const struct cache_type cachetype_string = { 3600 };
-static const struct cache_type cachetype_integer = { 3600 };
+static const struct cache_type cachetype_string = { 3600, NULL };
+static const struct cache_type cachetype_integer = { 3600, NULL };
 
 /** @brief Called when a namepart lookup has completed or failed
  *
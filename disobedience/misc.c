@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2006-2008, 2010 Richard Kettlewell
+ * Copyright (C) 2006-2008, 2010, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -100,7 +100,7 @@ GtkWidget *frame_widget(GtkWidget *w, const char *label) {
  * Images are searched for in @c pkgdatadir/static.
  */
 GdkPixbuf *find_image(const char *name) {
-  static const struct cache_type image_cache_type = { INT_MAX };
+  static const struct cache_type image_cache_type = { INT_MAX, NULL };
 
   GdkPixbuf *pb;
   char *path;
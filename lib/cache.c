@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2006-2008 Richard Kettlewell
+ * Copyright (C) 2006-2008, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -30,6 +30,9 @@
 /** @brief The global cache */
 static hash *h;
 
+/** @brief Approximate memory used by the cache */
+static size_t total_bytes;
+
 /** @brief One cache entry */
 struct cache_entry {
   /** @brief What type of object this is */
@@ -40,6 +43,9 @@ struct cache_entry {
 
   /** @brief Time that object was inserted into cache */
   time_t birth;
+
+  /** @brief Approximate memory used by this entry */
+  size_t size;
 };
 
 /** @brief Return true if object @p c has expired */
@@ -47,6 +53,12 @@ static int expired(const struct cache_entry *c, time_t now) {
   return now - c->birth > c->type->lifetime;
 }
 
+/** @brief Remove an entry from the cache */
+static void remove_entry(const char *key, const struct cache_entry *c) {
+  total_bytes -= c->size;
+  hash_remove(h, key);
+}
+
 /** @brief Insert an object into the cache
  * @param type Pointer to object type
  * @param key Unique key
@@ -55,13 +67,20 @@ static int expired(const struct cache_entry *c, time_t now) {
 void cache_put(const struct cache_type *type,
                const char *key, const void *value) {
   struct cache_entry *c;
+  const struct cache_entry *old;
   
   if(!h)
     h = hash_new(sizeof (struct cache_entry));
+  if((old = hash_find(h, key)))
+    total_bytes -= old->size;
   c = xmalloc(sizeof *c);
   c->type = type;
   c->value = value;
   xtime(&c->birth);
+  c->size = sizeof *c + strlen(key) + 1;
+  if(type->size)
+    c->size += type->size(value);
+  total_bytes += c->size;
   hash_add(h, key, c,  HASH_INSERT_OR_REPLACE);
 }
 
@@ -88,7 +107,7 @@ static int expiry_callback(const char *key, void *value, void *u) {
   const time_t *now = u;
   
   if(expired(c, *now))
-    hash_remove(h, key);
+    remove_entry(key, c);
   return 0;
 }
 
@@ -110,7 +129,7 @@ static int clean_callback(const char *key, void *value, void *u) {
   const struct cache_type *type = u;
 
   if(!type || c->type == type)
-    hash_remove(h, key);
+    remove_entry(key, c);
   return 0;
 }
 
@@ -132,6 +151,16 @@ size_t cache_count(void) {
   return h ? hash_count(h) : 0;
 }
 
+/** @brief Report cache memory use
+ *
+ * Returns the approximate number of bytes used by the cache.  This includes
+ * keys and bookkeeping, but values only count if their type has a @c size
+ * callback.
+ */
+size_t cache_bytes(void) {
+  return total_bytes;
+}
+
 /*
 Local Variables:
 c-basic-offset:2
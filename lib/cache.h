@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2006-2008 Richard Kettlewell
+ * Copyright (C) 2006-2008, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -31,6 +31,9 @@
 struct cache_type {
   /** @brief Lifetime for objects of this type (seconds) */
   int lifetime;
+
+  /** @brief Report the size of a value in bytes, or NULL if not known */
+  size_t (*size)(const void *value);
 };
 
 void cache_put(const struct cache_type *type,
@@ -50,6 +53,9 @@ void cache_clean(const struct cache_type *type);
 size_t cache_count(void);
 /* Return the size of the cache */
 
+size_t cache_bytes(void);
+/* Return the approximate memory used by the cache */
+
 #endif /* CACHE_H */
 
 /*
@@ -37,6 +37,15 @@
 /** @brief Hash of arguments */
 static hash *cgi_args;
 
+/** @brief Request body, or NULL to read standard input
+ *
+ * See cgi_set_body().
+ */
+static const char *cgi_body;
+
+/** @brief Length of @ref cgi_body */
+static size_t cgi_body_length;
+
 /** @brief Get CGI arguments from a GET request's query string */
 static struct kvp *cgi__init_get(void) {
   const char *q;
@@ -62,6 +71,12 @@ static void cgi__input(char **ptrp, size_t *np) {
   if(!(n+1) || n > 16 * 1024 * 1024)
     disorder_fatal(0, "input is much too large");
   q = xmalloc_noptr(n + 1);
+  if(cgi_body) {
+    if(cgi_body_length < n)
+      disorder_fatal(0, "unexpected end of file reading request body");
+    memcpy(q, cgi_body, n);
+    m = n;
+  }
   while(m < n) {
     r = read(0, q + m, n - m);
     if(r > 0)
@@ -189,6 +204,19 @@ void cgi_init(void) {
   }
 }
 
+/** @brief Supply the request body
+ * @param body Request body, or NULL to read standard input
+ * @param n Length of @p body
+ *
+ * Persistent front ends (such as FastCGI) receive the request body over
+ * some channel other than standard input.  They should call this before each
+ * call to cgi_init().
+ */
+void cgi_set_body(const char *body, size_t n) {
+  cgi_body = body;
+  cgi_body_length = n;
+}
+
 /** @brief Get a CGI argument by name
  *
  * cgi_init() must be called first.  Names and values are all valid
@@ -25,6 +25,7 @@
 struct sink;
 
 void cgi_init(void);
+void cgi_set_body(const char *body, size_t n);
 const char *cgi_get(const char *name);
 void cgi_set(const char *name, const char *value);
 char *cgi_sgmlquote(const char *src);
@@ -162,6 +162,15 @@ int disorder_make_cookie(disorder_client *c, char **cookiep) {
   return 0;
 }
 
+int disorder_memstats(disorder_client *c, char ***statsp, int *nstatsp) {
+  int rc = disorder_simple(c, NULL, "memstats", (char *)NULL);
+  if(rc)
+    return rc;
+  if(readlist(c, statsp, nstatsp))
+    return -1;
+  return 0;
+}
+
 int disorder_move(disorder_client *c, const char *track, long delta) {
   return disorder_simple(c, NULL, "move", track, disorder__integer, delta, (char *)NULL);
 }
@@ -227,10 +236,32 @@ int disorder_playlist_get_share(disorder_client *c, const char *playlist, char *
   return disorder_simple(c, sharep, "playlist-get-share", playlist, (char *)NULL);
 }
 
+int disorder_playlist_insert(disorder_client *c, const char *playlist, long position, char **tracks, int ntracks) {
+  return disorder_simple(c, NULL, "playlist-insert", playlist, disorder__integer, position, disorder__body, tracks, ntracks, (char *)NULL);
+}
+
+int disorder_playlist_length(disorder_client *c, const char *playlist, long *lengthp) {
+  char **v;
+  int nv, rc = disorder_simple_split(c, &v, &nv, 1, "playlist-length", playlist, (char *)NULL);
+  if(rc)
+    return rc;
+  *lengthp = atol(v[0]);
+  free_strings(nv, v);
+  return 0;
+}
+
 int disorder_playlist_lock(disorder_client *c, const char *playlist) {
   return disorder_simple(c, NULL, "playlist-lock", playlist, (char *)NULL);
 }
 
+int disorder_playlist_move(disorder_client *c, const char *playlist, long from, long count, long to) {
+  return disorder_simple(c, NULL, "playlist-move", playlist, disorder__integer, from, disorder__integer, count, disorder__integer, to, (char *)NULL);
+}
+
+int disorder_playlist_remove(disorder_client *c, const char *playlist, long position, long count) {
+  return disorder_simple(c, NULL, "playlist-remove", playlist, disorder__integer, position, disorder__integer, count, (char *)NULL);
+}
+
 int disorder_playlist_set(disorder_client *c, const char *playlist, char **tracks, int ntracks) {
   return disorder_simple(c, NULL, "playlist-set", playlist, disorder__body, tracks, ntracks, (char *)NULL);
 }
@@ -214,6 +214,17 @@ int disorder_length(disorder_client *c, const char *track, long *lengthp);
  */
 int disorder_make_cookie(disorder_client *c, char **cookiep);
 
+/** @brief Get memory usage statistics
+ *
+ * Requires the 'admin' right.  The returned strings are intended to be printed out one to a line.
+ *
+ * @param c Client
+ * @param statsp List of memory usage strings.
+ * @param nstatsp Number of elements in statsp
+ * @return 0 on success, non-0 on error
+ */
+int disorder_memstats(disorder_client *c, char ***statsp, int *nstatsp);
+
 /** @brief Move a track
  *
  * Requires one of the 'move mine', 'move random' or 'move any' rights depending on how the track came to be added to the queue.
@@ -346,6 +357,30 @@ int disorder_playlist_get(disorder_client *c, const char *playlist, char ***trac
  */
 int disorder_playlist_get_share(disorder_client *c, const char *playlist, char **sharep);
 
+/** @brief Insert tracks into a playlist
+ *
+ * Requires the 'play' right and permission to modify the playlist, which must be locked.  The playlist is created if it does not exist.
+ *
+ * @param c Client
+ * @param playlist Playlist to modify
+ * @param position Index to insert before, or the playlist length to append
+ * @param tracks Tracks to insert
+ * @param ntracks Length of tracks
+ * @return 0 on success, non-0 on error
+ */
+int disorder_playlist_insert(disorder_client *c, const char *playlist, long position, char **tracks, int ntracks);
+
+/** @brief Get the length of a playlist
+ *
+ * Requires the 'read' right and permission to read the playlist.
+ *
+ * @param c Client
+ * @param playlist Playlist name
+ * @param lengthp Number of tracks in playlist
+ * @return 0 on success, non-0 on error
+ */
+int disorder_playlist_length(disorder_client *c, const char *playlist, long *lengthp);
+
 /** @brief Lock a playlist
  *
  * Requires the 'play' right and permission to modify the playlist.  A given connection may lock at most one playlist.
@@ -356,6 +391,31 @@ int disorder_playlist_get_share(disorder_client *c, const char *playlist, char *
  */
 int disorder_playlist_lock(disorder_client *c, const char *playlist);
 
+/** @brief Move tracks within a playlist
+ *
+ * Requires the 'play' right and permission to modify the playlist, which must be locked.  The destination is an index into the playlist after the moved tracks have been taken out.
+ *
+ * @param c Client
+ * @param playlist Playlist to modify
+ * @param from Index of first track to move
+ * @param count Number of tracks to move
+ * @param to New index of first moved track
+ * @return 0 on success, non-0 on error
+ */
+int disorder_playlist_move(disorder_client *c, const char *playlist, long from, long count, long to);
+
+/** @brief Remove tracks from a playlist
+ *
+ * Requires the 'play' right and permission to modify the playlist, which must be locked.
+ *
+ * @param c Client
+ * @param playlist Playlist to modify
+ * @param position Index of first track to remove
+ * @param count Number of tracks to remove
+ * @return 0 on success, non-0 on error
+ */
+int disorder_playlist_remove(disorder_client *c, const char *playlist, long position, long count);
+
 /** @brief Set the contents of a playlist
  *
  * Requires the 'play' right and permission to modify the playlist, which must be locked.
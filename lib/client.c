@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2004-13 Richard Kettlewell
+ * Copyright (C) 2004-13, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -41,6 +41,9 @@
 #if HAVE_NETDB_H
 # include <netdb.h>
 #endif
+#if !_WIN32
+# include <poll.h>
+#endif
 
 #include "log.h"
 #include "mem.h"
@@ -61,6 +64,7 @@
 #include "rights.h"
 #include "kvp.h"
 #include "socketio.h"
+#include "frame.h"
 
 /** @brief Client handle contents */
 struct disorder_client {
@@ -84,6 +88,10 @@ struct disorder_client {
   struct socketio sio;
   /** @brief Whether to try to open a privileged connection */
   int trypriv;
+  /** @brief Whether to ask for binary framing */
+  int want_binary;
+  /** @brief Whether response bodies use binary framing */
+  int binary;
 };
 
 /** @brief Create a new client
@@ -114,6 +122,18 @@ void disorder_force_unpriv(disorder_client *c) {
   c->trypriv = 0;
 }
 
+/** @brief Ask for binary framing of response bodies
+ * @param c Client
+ *
+ * You must call this before any of the connection functions, if at all.  If
+ * the server does not support binary framing then the connection uses text
+ * framing as usual.  Either way the client's interface is the same.
+ */
+void disorder_want_binary(disorder_client *c) {
+  assert(!c->open);
+  c->want_binary = 1;
+}
+
 /** @brief Determine the local socket address of this client */
 int disorder_client_sockname(disorder_client *c,
 			     struct sockaddr *sa, socklen_t *len_inout) {
@@ -462,6 +482,7 @@ int disorder_connect_generic(struct config *conf,
     return -1;
   c->input = 0;
   c->output = 0;
+  c->binary = 0;
   if((sd = socket(sa->sa_family, SOCK_STREAM, 0)) < 0) {
     byte_xasprintf((char **)&c->last, "socket: %s",
                    format_error(ec_socket, socket_error(), errbuf, sizeof errbuf));
@@ -499,6 +520,9 @@ int disorder_connect_generic(struct config *conf,
   challenge = rvec[2];
   if(!(nonce = unhex(challenge, &nl)))
     goto error;
+  /* Servers that don't know the command leave the connection in text mode */
+  if(c->want_binary && !disorder_simple(c, 0, "binary", (char *)0))
+    c->binary = 1;
   if(cookie) {
     if(!dequote(disorder_simple(c, &c->user, "cookie", cookie, (char *)0),
 		&c->user))
@@ -628,6 +652,39 @@ int disorder_close(disorder_client *c) {
   return ret;
 }
 
+/** @brief Check whether a client is still usable
+ * @param c Client
+ * @return 1 if the connection is usable, 0 if not
+ *
+ * A client that is between commands should never have any input pending.  If
+ * it does then the server has closed the connection (or sent something
+ * unexpected) and the client should be discarded.  This check does not
+ * involve a round trip to the server, so it is cheap enough to use before
+ * reusing a long-lived connection.
+ */
+int disorder_client_alive(disorder_client *c) {
+#if !_WIN32
+  struct pollfd pfd;
+  int n;
+#endif
+
+  if(!c->open
+     || socketio_error(&c->sio)
+     || socketio_eof(&c->sio)
+     || c->sio.inputptr < c->sio.inputlimit)
+    return 0;
+#if !_WIN32
+  pfd.fd = c->sio.sd;
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  while((n = poll(&pfd, 1, 0)) < 0 && errno == EINTR)
+    ;
+  if(n != 0)
+    return 0;
+#endif
+  return 1;
+}
+
 static void client_error(const char *msg,
 			 void attribute((unused)) *u) {
   disorder_error(0, "error parsing reply: %s", msg);
@@ -657,6 +714,65 @@ static int onequeue(disorder_client *c, const char *cmd,
   return 0;
 }
 
+/** @brief Read one item of a binary-framed body
+ * @param c Client
+ * @param itemp Where to store item (0-terminated)
+ * @return 1 for an item, 0 at the end of the body, -1 on error
+ */
+static int readframe(disorder_client *c, char **itemp) {
+  unsigned char h[FRAME_HEADER];
+  uint32_t len;
+  char *item;
+
+  if(socketio_read(&c->sio, h, FRAME_HEADER))
+    return -1;
+  if((len = frame_length(h)) == FRAME_END)
+    return 0;
+  item = xmalloc_noptr(len + 1);
+  if(socketio_read(&c->sio, item, len)) {
+    xfree(item);
+    return -1;
+  }
+  item[len] = 0;
+  *itemp = item;
+  return 1;
+}
+
+/** @brief Fetch the queue, recent list, etc, with binary framing
+ * @param c Client
+ * @param qt Where to store the first entry
+ * @return Where to store the entry after the last one, or NULL on error
+ *
+ * Each entry is a run of field names and values, ended by an empty name.
+ */
+static struct queue_entry **readqueue_binary(disorder_client *c,
+                                             struct queue_entry **qt) {
+  struct queue_entry *q;
+  struct vector v;
+  char *l;
+  int rc, n;
+
+  vector_init(&v);
+  while((rc = readframe(c, &l)) > 0) {
+    if(*l || v.nvec % 2) {
+      vector_append(&v, l);
+      continue;
+    }
+    xfree(l);
+    q = xmalloc(sizeof *q);
+    q->pid = -1;                        /* =none */
+    if(!queue_unmarshall_vec(q, v.nvec, v.vec, client_error, 0)) {
+      *qt = q;
+      qt = &q->next;
+    }
+    for(n = 0; n < v.nvec; ++n)
+      xfree(v.vec[n]);
+    v.nvec = 0;
+  }
+  xfree(v.vec);
+  return rc ? NULL : qt;
+}
+
 /** @brief Fetch the queue, recent list, etc */
 static int readqueue(disorder_client *c,
 		     struct queue_entry **qp) {
@@ -664,19 +780,22 @@ static int readqueue(disorder_client *c,
   char *l;
   char errbuf[1024];
 
-  while(inputlines(c->ident, c->input, &l, '\n') >= 0) {
-    if(!strcmp(l, ".")) {
-      *qt = 0;
-      *qp = qh;
+  if(c->binary) {
+    if((qt = readqueue_binary(c, qt)))
+      goto done;
+  } else {
+    while(inputlines(c->ident, c->input, &l, '\n') >= 0) {
+      if(!strcmp(l, ".")) {
+        xfree(l);
+        goto done;
+      }
+      q = xmalloc(sizeof *q);
+      if(!queue_unmarshall(q, l, client_error, 0)) {
+        *qt = q;
+        qt = &q->next;
+      }
       xfree(l);
-      return 0;
     }
-    q = xmalloc(sizeof *q);
-    if(!queue_unmarshall(q, l, client_error, 0)) {
-      *qt = q;
-      qt = &q->next;
-    }
-    xfree(l);
   }
   if(source_err(c->input)) {
     byte_xasprintf((char **)&c->last, "input error: %s",
@@ -686,9 +805,13 @@ static int readqueue(disorder_client *c,
   }
   disorder_error(0, "%s: %s", c->ident, c->last);
   return -1;
+done:
+  *qt = 0;
+  *qp = qh;
+  return 0;
 }
 
-/** @brief Read a dot-stuffed list
+/** @brief Read a dot-stuffed or binary-framed list
  * @param c Client
  * @param vecp Where to store list (UTF-8)
  * @param nvecp Where to store number of items, or NULL
@@ -700,19 +823,23 @@ static int readlist(disorder_client *c, char ***vecp, int *nvecp) {
   char *l;
   struct vector v;
   char errbuf[1024];
+  int rc;
 
   vector_init(&v);
-  while(inputlines(c->ident, c->input, &l, '\n') >= 0) {
-    if(!strcmp(l, ".")) {
-      vector_terminate(&v);
-      if(nvecp)
-	*nvecp = v.nvec;
-      *vecp = v.vec;
+  if(c->binary) {
+    while((rc = readframe(c, &l)) > 0)
+      vector_append(&v, l);
+    if(!rc)
+      goto done;
+  } else {
+    while(inputlines(c->ident, c->input, &l, '\n') >= 0) {
+      if(!strcmp(l, ".")) {
+        xfree(l);
+        goto done;
+      }
+      vector_append(&v, xstrdup(l + (*l == '.')));
       xfree(l);
-      return 0;
     }
-    vector_append(&v, xstrdup(l + (*l == '.')));
-    xfree(l);
   }
   if(source_err(c->input)) {
     byte_xasprintf((char **)&c->last, "input error: %s",
@@ -722,6 +849,12 @@ static int readlist(disorder_client *c, char ***vecp, int *nvecp) {
   }
   disorder_error(0, "%s: %s", c->ident, c->last);
   return -1;
+done:
+  vector_terminate(&v);
+  if(nvecp)
+    *nvecp = v.nvec;
+  *vecp = v.vec;
+  return 0;
 }
 
 /** @brief Return the user we logged in with
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2004-2008 Richard Kettlewell
+ * Copyright (C) 2004-2008, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -40,6 +40,7 @@ struct sink;
 
 disorder_client *disorder_new(int verbose);
 void disorder_force_unpriv(disorder_client *c);
+void disorder_want_binary(disorder_client *c);
 int disorder_client_sockname(disorder_client *c,
 			     struct sockaddr *sa, socklen_t *len_inout);
 int disorder_client_peername(disorder_client *c,
@@ -55,6 +56,7 @@ int disorder_connect_generic(struct config *conf,
                              const char *password,
                              const char *cookie);
 int disorder_close(disorder_client *c);
+int disorder_client_alive(disorder_client *c);
 char *disorder_user(disorder_client *c);
 int disorder_log(disorder_client *c, struct sink *s);
 const char *disorder_last(disorder_client *c);
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2004-2011, 2013 Richard Kettlewell
+ * Copyright (C) 2004-2011, 2013, 2026 Richard Kettlewell
  * Portions copyright (C) 2007 Mark Wooding
  *
  * This program is free software: you can redistribute it and/or modify
@@ -56,6 +56,7 @@
 #include "signame.h"
 #include "authhash.h"
 #include "vector.h"
+#include "trackname.h"
 #if !_WIN32
 #include "uaudio.h"
 #endif
@@ -430,6 +431,7 @@ static int set_namepart(const struct config_state *cs,
 		   cs->path, cs->line, vec[1], errstr, erroffset);
     return -1;
   }
+  regexp_jit(re);
   npl->s = xrealloc(npl->s, (npl->n + 1) * sizeof (struct namepart));
   npl->s[npl->n].part = xstrdup(vec[0]);
   npl->s[npl->n].re = re;
@@ -477,6 +479,7 @@ static int set_transform(const struct config_state *cs,
 		   cs->path, cs->line, vec[1], errstr, erroffset);
     return -1;
   }
+  regexp_jit(re);
   tl->t = xrealloc(tl->t, (tl->n + 1) * sizeof (struct namepart));
   tl->t[tl->n].type = xstrdup(vec[0]);
   tl->t[tl->n].context = xstrdup(vec[3] ? vec[3] : "*");
@@ -1088,6 +1091,7 @@ static const struct conf conf[] = {
 #endif
   { C(listen),           &type_netaddress,       validate_any },
   { C(mail_sender),      &type_string,           validate_any },
+  { C(memstats_interval), &type_integer,         validate_non_negative },
   { C(mixer),            &type_string,           validate_any },
   { C(mount_rescan),     &type_boolean,          validate_any },
   { C(multicast_loop),   &type_boolean,          validate_any },
@@ -1103,6 +1107,7 @@ static const struct conf conf[] = {
   { C(noticed_history),  &type_integer,          validate_positive },
   { C(password),         &type_string,           validate_any },
   { C(pause_mode),       &type_string,           validate_pausemode },
+  { C(pcm_cache_mbyte),  &type_integer,          validate_non_negative },
   { C(player),           &type_stringlist_accum, validate_player },
   { C(playlist_lock_timeout), &type_integer,     validate_positive },
   { C(playlist_max) ,    &type_integer,          validate_positive },
@@ -1131,12 +1136,15 @@ static const struct conf conf[] = {
 #endif
   { C(short_display),    &type_integer,          validate_positive },
   { C(signal),           &type_signal,           validate_any },
+  { C(slow_command_ms),  &type_integer,          validate_non_negative },
   { C(smtp_server),      &type_string,           validate_any },
   { C(sox_generation),   &type_integer,          validate_non_negative },
 #if !_WIN32
   { C2(speaker_backend, api),  &type_string,     validate_backend },
 #endif
+  { C(speaker_buffer_mbyte), &type_integer,      validate_positive },
   { C(speaker_command),  &type_string,           validate_any },
+  { C(speaker_low_water_ms), &type_integer,      validate_positive },
   { C(stopword),         &type_string_accum,     validate_any },
   { C(templates),        &type_string_accum,     validate_isdir },
   { C(tracklength),      &type_stringlist_accum, validate_tracklength },
@@ -1416,7 +1424,10 @@ static struct config *config_default(void) {
   c->sox_generation = DEFAULT_SOX_GENERATION;
   c->playlist_max = INT_MAX;            /* effectively no limit */
   c->playlist_lock_timeout = 10;        /* 10s */
+  c->speaker_buffer_mbyte = 32;
+  c->speaker_low_water_ms = 1000;       /* 1s */
   c->mount_rescan = 1;
+  c->memstats_interval = 3600;          /* 1h */
   /* Default stopwords */
   if(config_set(&cs, (int)NDEFAULT_STOPWORDS, (char **)default_stopwords))
     exit(1);
@@ -1487,6 +1498,7 @@ void config_free(struct config *c) {
     for(n = 0; n < c->nparts; ++n)
       xfree(c->parts[n]);
     xfree(c->parts);
+    trackname_rules_free(c->trackname_rules);
     xfree(c);
   }
 }
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2004-2011, 2013 Richard Kettlewell
+ * Copyright (C) 2004-2011, 2013, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -28,6 +28,7 @@
 #include "addr.h"
 
 struct uaudio;
+struct trackname_rules;
 
 /* Configuration is kept in a @struct config@; the live configuration
  * is always pointed to by @config@.  Values in @config@ are UTF-8 encoded.
@@ -162,6 +163,12 @@ struct config {
   /** @brief Command execute by speaker to play audio */
   const char *speaker_command;
 
+  /** @brief Total speaker buffer space in megabytes */
+  long speaker_buffer_mbyte;
+
+  /** @brief Milliseconds of audio a track needs before it can play */
+  long speaker_low_water_ms;
+
   /** @brief Pause mode for command backend */
   const char *pause_mode;
   
@@ -180,6 +187,9 @@ struct config {
   /** @brief Maximum lifetime of a playlist lock */
   long playlist_lock_timeout;
 
+  /** @brief Size of decoded track cache in megabytes, or 0 to disable */
+  long pcm_cache_mbyte;
+
 #if !_WIN32
   /** @brief Home directory for state files */
   const char *home;
@@ -317,12 +327,20 @@ struct config {
   /** @brief Rescan on (un)mount */
   int mount_rescan;
 
+  /** @brief Seconds between memory usage log lines, or 0 for none */
+  long memstats_interval;
+
+  /** @brief Commands taking at least this many milliseconds are logged, or 0
+   * for none */
+  long slow_command_ms;
+
   /** @brief RTP mode */
   const char *rtp_mode;
 
   /* derived values: */
   int nparts;				/* number of distinct name parts */
   char **parts;				/* name part list  */
+  struct trackname_rules *trackname_rules; /* indexed name rules and memo */
 
   /* undocumented, for testing only */
   long dbversion;
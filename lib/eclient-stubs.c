@@ -84,6 +84,10 @@ int disorder_eclient_make_cookie(disorder_eclient *c, disorder_eclient_string_re
   return simple(c, string_response_opcallback, (void (*)())completed, v, "make-cookie", (char *)0);
 }
 
+int disorder_eclient_memstats(disorder_eclient *c, disorder_eclient_list_response *completed, void *v) {
+  return simple(c, list_response_opcallback, (void (*)())completed, v, "memstats", (char *)0);
+}
+
 int disorder_eclient_move(disorder_eclient *c, disorder_eclient_no_response *completed, const char *track, long delta, void *v) {
   return simple(c, no_response_opcallback, (void (*)())completed, v, "move", track, disorder__integer, delta, (char *)0);
 }
@@ -132,10 +136,26 @@ int disorder_eclient_playlist_get_share(disorder_eclient *c, disorder_eclient_st
   return simple(c, string_response_opcallback, (void (*)())completed, v, "playlist-get-share", playlist, (char *)0);
 }
 
+int disorder_eclient_playlist_insert(disorder_eclient *c, disorder_eclient_no_response *completed, const char *playlist, long position, char **tracks, int ntracks, void *v) {
+  return simple(c, no_response_opcallback, (void (*)())completed, v, "playlist-insert", playlist, disorder__integer, position, disorder__body, tracks, ntracks, (char *)0);
+}
+
+int disorder_eclient_playlist_length(disorder_eclient *c, disorder_eclient_integer_response *completed, const char *playlist, void *v) {
+  return simple(c, integer_response_opcallback, (void (*)())completed, v, "playlist-length", playlist, (char *)0);
+}
+
 int disorder_eclient_playlist_lock(disorder_eclient *c, disorder_eclient_no_response *completed, const char *playlist, void *v) {
   return simple(c, no_response_opcallback, (void (*)())completed, v, "playlist-lock", playlist, (char *)0);
 }
 
+int disorder_eclient_playlist_move(disorder_eclient *c, disorder_eclient_no_response *completed, const char *playlist, long from, long count, long to, void *v) {
+  return simple(c, no_response_opcallback, (void (*)())completed, v, "playlist-move", playlist, disorder__integer, from, disorder__integer, count, disorder__integer, to, (char *)0);
+}
+
+int disorder_eclient_playlist_remove(disorder_eclient *c, disorder_eclient_no_response *completed, const char *playlist, long position, long count, void *v) {
+  return simple(c, no_response_opcallback, (void (*)())completed, v, "playlist-remove", playlist, disorder__integer, position, disorder__integer, count, (char *)0);
+}
+
 int disorder_eclient_playlist_set(disorder_eclient *c, disorder_eclient_no_response *completed, const char *playlist, char **tracks, int ntracks, void *v) {
   return simple(c, no_response_opcallback, (void (*)())completed, v, "playlist-set", playlist, disorder__body, tracks, ntracks, (char *)0);
 }
@@ -212,6 +212,17 @@ int disorder_eclient_length(disorder_eclient *c, disorder_eclient_integer_respon
  */
 int disorder_eclient_make_cookie(disorder_eclient *c, disorder_eclient_string_response *completed, void *v);
 
+/** @brief Get memory usage statistics
+ *
+ * Requires the 'admin' right.  The returned strings are intended to be printed out one to a line.
+ *
+ * @param c Client
+ * @param completed Called upon completion
+ * @param v Passed to @p completed
+ * @return 0 if the command was queued successfuly, non-0 on error
+ */
+int disorder_eclient_memstats(disorder_eclient *c, disorder_eclient_list_response *completed, void *v);
+
 /** @brief Move a track
  *
  * Requires one of the 'move mine', 'move random' or 'move any' rights depending on how the track came to be added to the queue.
@@ -360,6 +371,33 @@ int disorder_eclient_playlist_get(disorder_eclient *c, disorder_eclient_list_res
  */
 int disorder_eclient_playlist_get_share(disorder_eclient *c, disorder_eclient_string_response *completed, const char *playlist, void *v);
 
+/** @brief Insert tracks into a playlist
+ *
+ * Requires the 'play' right and permission to modify the playlist, which must be locked.  The playlist is created if it does not exist.
+ *
+ * @param c Client
+ * @param completed Called upon completion
+ * @param playlist Playlist to modify
+ * @param position Index to insert before, or the playlist length to append
+ * @param tracks Tracks to insert
+ * @param ntracks Length of tracks
+ * @param v Passed to @p completed
+ * @return 0 if the command was queued successfuly, non-0 on error
+ */
+int disorder_eclient_playlist_insert(disorder_eclient *c, disorder_eclient_no_response *completed, const char *playlist, long position, char **tracks, int ntracks, void *v);
+
+/** @brief Get the length of a playlist
+ *
+ * Requires the 'read' right and permission to read the playlist.
+ *
+ * @param c Client
+ * @param completed Called upon completion
+ * @param playlist Playlist name
+ * @param v Passed to @p completed
+ * @return 0 if the command was queued successfuly, non-0 on error
+ */
+int disorder_eclient_playlist_length(disorder_eclient *c, disorder_eclient_integer_response *completed, const char *playlist, void *v);
+
 /** @brief Lock a playlist
  *
  * Requires the 'play' right and permission to modify the playlist.  A given connection may lock at most one playlist.
@@ -372,6 +410,35 @@ int disorder_eclient_playlist_get_share(disorder_eclient *c, disorder_eclient_st
  */
 int disorder_eclient_playlist_lock(disorder_eclient *c, disorder_eclient_no_response *completed, const char *playlist, void *v);
 
+/** @brief Move tracks within a playlist
+ *
+ * Requires the 'play' right and permission to modify the playlist, which must be locked.  The destination is an index into the playlist after the moved tracks have been taken out.
+ *
+ * @param c Client
+ * @param completed Called upon completion
+ * @param playlist Playlist to modify
+ * @param from Index of first track to move
+ * @param count Number of tracks to move
+ * @param to New index of first moved track
+ * @param v Passed to @p completed
+ * @return 0 if the command was queued successfuly, non-0 on error
+ */
+int disorder_eclient_playlist_move(disorder_eclient *c, disorder_eclient_no_response *completed, const char *playlist, long from, long count, long to, void *v);
+
+/** @brief Remove tracks from a playlist
+ *
+ * Requires the 'play' right and permission to modify the playlist, which must be locked.
+ *
+ * @param c Client
+ * @param completed Called upon completion
+ * @param playlist Playlist to modify
+ * @param position Index of first track to remove
+ * @param count Number of tracks to remove
+ * @param v Passed to @p completed
+ * @return 0 if the command was queued successfuly, non-0 on error
+ */
+int disorder_eclient_playlist_remove(disorder_eclient *c, disorder_eclient_no_response *completed, const char *playlist, long position, long count, void *v);
+
 /** @brief Set the contents of a playlist
  *
  * Requires the 'play' right and permission to modify the playlist, which must be locked.
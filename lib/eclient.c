@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2006-2008 Richard Kettlewell
+ * Copyright (C) 2006-2008, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -48,6 +48,7 @@
 #include "addr.h"
 #include "authhash.h"
 #include "table.h"
+#include "frame.h"
 #include "client-common.h"
 
 /* TODO: more commands */
@@ -146,17 +147,26 @@ struct disorder_eclient {
 
   /** @brief True if enabled */
   int enabled;
+
+  /** @brief True to ask for binary framing */
+  int want_binary;
+
+  /** @brief True if response bodies use binary framing */
+  int binary;
 };
 
 /* Forward declarations ******************************************************/
 
 static int start_connect(disorder_eclient *c);
 static void process_line(disorder_eclient *c, char *line);
+static int process_frame(disorder_eclient *c);
 static void maybe_connected(disorder_eclient *c);
 static void authbanner_opcallback(disorder_eclient *c,
                                   struct operation *op);
 static void authuser_opcallback(disorder_eclient *c,
                                 struct operation *op);
+static void binary_opcallback(disorder_eclient *c,
+                              struct operation *op);
 static void complete(disorder_eclient *c);
 static void send_output(disorder_eclient *c);
 static void put(disorder_eclient *c, const char *s, size_t n);
@@ -234,6 +244,9 @@ static const struct logentry_handler logentry_handlers[] = {
   LE(volume, 2, 2)
 };
 
+/** @brief Perfect hash for looking up @ref logentry_handlers */
+static struct table_hash logentry_hash;
+
 /* Setup and teardown ********************************************************/
 
 /** @brief Create a new client
@@ -278,6 +291,7 @@ void disorder_eclient_close(disorder_eclient *c) {
   c->input.nvec = 0;
   c->eof = 0;
   c->authenticated = 0;
+  c->binary = 0;
   /* We'll need to resend all operations */
   for(op = c->ops; op; op = op->next)
     op->sent = 0;
@@ -296,6 +310,15 @@ void disorder_eclient_disable_connect(disorder_eclient *c) {
   c->enabled = 0;
 }
 
+/** @brief Ask for binary framing of response bodies
+ *
+ * Takes effect from the next connection.  Servers that don't support it
+ * carry on with text framing.
+ */
+void disorder_eclient_want_binary(disorder_eclient *c) {
+  c->want_binary = 1;
+}
+
 /** @brief Return current state */
 unsigned long disorder_eclient_state(const disorder_eclient *c) {
   return c->statebits | (c->state > state_connected ? DISORDER_CONNECTED : 0);
@@ -629,6 +652,19 @@ static void authbanner_opcallback(disorder_eclient *c,
                 -1/*nbody*/, 0/*body*/,
                 "user", quoteutf8(config->username), quoteutf8(res),
                 (char *)0);
+  /* Jumps ahead of the user command */
+  if(c->want_binary)
+    stash_command(c, 1/*queuejump*/, binary_opcallback, 0/*completed*/,
+                  0/*v*/, -1/*nbody*/, 0/*body*/, "binary", (char *)0);
+}
+
+/** @brief Called with the response to the @c binary command */
+static void binary_opcallback(disorder_eclient *c,
+                              struct operation attribute((unused)) *op) {
+  D(("binary_opcallback"));
+  /* Older servers reject the command, and we carry on in text mode */
+  if(c->rc / 100 == 2)
+    c->binary = 1;
 }
 
 /** @brief Called with the response to the @c user command */
@@ -719,13 +755,19 @@ static void read_input(disorder_eclient *c) {
     dynstr_append_bytes(&c->input, buffer, n);
   } else
     c->eof = 1;
-  /* might have more than one line to process */
-  while(c->state > state_connecting
-        && (nl = memchr(c->input.vec, '\n', c->input.nvec))) {
-    process_line(c, xstrndup(c->input.vec, nl - c->input.vec));
-    /* we might have disconnected along the way, which zogs the input buffer */
-    if(c->state > state_connecting)
-      consume(&c->input, (nl - c->input.vec) + 1);
+  /* might have more than one line or frame to process */
+  while(c->state > state_connecting) {
+    if(c->state == state_body && c->binary) {
+      if(!process_frame(c))
+        break;
+    } else if((nl = memchr(c->input.vec, '\n', c->input.nvec))) {
+      process_line(c, xstrndup(c->input.vec, nl - c->input.vec));
+      /* we might have disconnected along the way, which zogs the input
+       * buffer */
+      if(c->state > state_connecting)
+        consume(&c->input, (nl - c->input.vec) + 1);
+    } else
+      break;
   }
   if(c->eof) {
     comms_error(c, "reading from %s: server disconnected", c->ident);
@@ -787,6 +829,29 @@ static void process_line(disorder_eclient *c, char *line) {
   }
 }
 
+/* called in state_body with binary framing; returns 0 if there isn't a
+ * whole frame yet */
+static int process_frame(disorder_eclient *c) {
+  uint32_t len;
+
+  if(c->input.nvec < FRAME_HEADER)
+    return 0;
+  len = frame_length((const unsigned char *)c->input.vec);
+  if(len == FRAME_END) {
+    /* End of the body. */
+    consume(&c->input, FRAME_HEADER);
+    vector_terminate(&c->vec);
+    complete(c);
+    return 1;
+  }
+  if((size_t)c->input.nvec - FRAME_HEADER < len)
+    return 0;
+  D(("process_frame %d [%.*s]", c->fd, (int)len, c->input.vec + FRAME_HEADER));
+  vector_append(&c->vec, xstrndup(c->input.vec + FRAME_HEADER, len));
+  consume(&c->input, FRAME_HEADER + len);
+  return 1;
+}
+
 /* Called when an operation completes */
 static void complete(disorder_eclient *c) {
   struct operation *op;
@@ -1010,17 +1075,28 @@ static void queue_response_opcallback(disorder_eclient *c,
                                       struct operation *op) {
   disorder_eclient_queue_response *const completed
     = (disorder_eclient_queue_response *)op->completed;
-  int n;
+  int n, end, rc;
   int parse_failed = 0;
   struct queue_entry *q, *qh = 0, **qtail = &qh, *qlast = 0;
   
   D(("queue_response_callback"));
   if(c->rc / 100 == 2) {
     /* parse the queue */
-    for(n = 0; n < c->vec.nvec; ++n) {
+    for(n = 0; n < c->vec.nvec; n = end + 1) {
       q = xmalloc(sizeof *q);
-      D(("queue_unmarshall %s", c->vec.vec[n]));
-      if(!queue_unmarshall(q, c->vec.vec[n], NULL, op)) {
+      if(c->binary) {
+        /* A run of names and values, ended by an empty name */
+        for(end = n; end < c->vec.nvec && *c->vec.vec[end]; end += 2)
+          ;
+        q->pid = -1;                    /* =none */
+        rc = queue_unmarshall_vec(q, end - n, c->vec.vec + n,
+                                  eclient_queue_error, op);
+      } else {
+        end = n;
+        D(("queue_unmarshall %s", c->vec.vec[n]));
+        rc = queue_unmarshall(q, c->vec.vec[n], NULL, op);
+      }
+      if(!rc) {
         q->prev = qlast;
         *qtail = q;
         qtail = &q->next;
@@ -1217,7 +1293,7 @@ static void logline(disorder_eclient *c, const char *line) {
   }
   /* TODO: do something with the time */
   //fprintf(stderr, "log key: %s\n", vec[1]);
-  n = TABLE_FIND(logentry_handlers, name, vec[1]);
+  n = TABLE_HASH_FIND(logentry_hash, logentry_handlers, name, vec[1]);
   if(n < 0) {
     //fprintf(stderr, "...not found\n");
     return;                     /* probably a future command */
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2004, 2005, 2007, 2008 Richard Kettlewell
+ * Copyright (C) 2004, 2005, 2007, 2008, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -949,6 +949,15 @@ struct ev_writer {
 
   /** @brief Set when abandoned */
   int abandoned;
+
+  /** @brief Called when the buffer drains, or NULL */
+  ev_drained_callback *drained;
+
+  /** @brief Passed to @p drained */
+  void *drained_u;
+
+  /** @brief Buffered bytes at or below which @p drained is called */
+  size_t low_water;
 };
 
 /** @brief State structure for a buffered reader */
@@ -1038,6 +1047,29 @@ static void writer_set_timebound(ev_writer *w) {
   }
 }
 
+/** @brief Call a writer's drained callback if its buffer is low enough
+ * @return 0 on success, non-0 on error
+ *
+ * The callback is forgotten before it is called, so it may set itself up
+ * again.
+ */
+static int writer_check_drained(ev_source *ev, ev_writer *w) {
+  ev_drained_callback *callback = w->drained;
+
+  if(!callback || w->fd == -1
+     || (size_t)(w->b.end - w->b.start) > w->low_water)
+    return 0;
+  w->drained = 0;
+  return callback(ev, w, w->drained_u);
+}
+
+/** @brief Called from a time=0 timeout for ev_writer_drained() */
+static int writer_drained_now(ev_source *ev,
+			      const attribute((unused)) struct timeval *now,
+			      void *u) {
+  return writer_check_drained(ev, u);
+}
+
 /** @brief Called when a writer's file descriptor is writable */
 static int writer_callback(ev_source *ev, int fd, void *u) {
   ev_writer *const w = u;
@@ -1066,6 +1098,8 @@ static int writer_callback(ev_source *ev, int fd, void *u) {
       /* The buffer isn't empty, set a timeout so we give up if we don't manage
        * to write some more within a reasonable time */
       writer_set_timebound(w);
+    /* Maybe there's now room for whoever is waiting for it */
+    return writer_check_drained(ev, w);
   } else {
     switch(errno) {
     case EINTR:
@@ -1213,6 +1247,16 @@ struct sink *ev_writer_sink(ev_writer *w) {
   return &w->s;
 }
 
+/** @brief Report a writer's buffer usage
+ * @param w Writer
+ * @param buffered Where to store the number of bytes waiting to be written
+ * @param allocated Where to store the size of the buffer
+ */
+void ev_writer_usage(const ev_writer *w, size_t *buffered, size_t *allocated) {
+  *buffered = w->b.end - w->b.start;
+  *allocated = w->b.top - w->b.base;
+}
+
 /** @brief Close a writer
  * @param w Writer to close
  * @return 0 on success, non-0 on error
@@ -1229,6 +1273,7 @@ int ev_writer_close(ev_writer *w) {
   if(w->eof)
     return 0;				/* already closed */
   w->eof = 1;
+  w->drained = 0;			/* nothing more will be written */
   if(w->b.start == w->b.end) {
     /* We're already finished */
     w->error = 0;			/* no error */
@@ -1237,6 +1282,32 @@ int ev_writer_close(ev_writer *w) {
   return 0;
 }
 
+/** @brief Arrange a callback when a writer's buffer drains
+ * @param w Writer
+ * @param low_water Buffered bytes at or below which to call @p callback
+ * @param callback Called when the buffer drains
+ * @param u Passed to @p callback
+ * @return 0 on success, non-0 on error
+ *
+ * This lets a producer of a large amount of output write it a piece at a time
+ * as the peer consumes it, rather than buffering all of it.  @p callback is
+ * called once, from the event loop, when the buffer holds at most @p
+ * low_water bytes; if it already does, that is on the next iteration.  It
+ * replaces any earlier callback, and is never called after the writer has
+ * been closed or has shut down.
+ */
+int ev_writer_drained(ev_writer *w,
+		      size_t low_water,
+		      ev_drained_callback *callback,
+		      void *u) {
+  w->drained = callback;
+  w->drained_u = u;
+  w->low_water = low_water;
+  if((size_t)(w->b.end - w->b.start) <= low_water)
+    return ev_timeout(w->ev, 0, 0, writer_drained_now, w);
+  return 0;
+}
+
 /** @brief Attempt to flush a writer
  * @param w Writer to flush
  * @return 0 on success, non-0 on error
@@ -1465,6 +1536,16 @@ int ev_reader_enable(ev_reader *r) {
   return ev_timeout(r->ev, 0, 0, reader_enabled, r);
 }
 
+/** @brief Report a reader's buffer usage
+ * @param r Reader
+ * @param buffered Where to store the number of bytes not yet consumed
+ * @param allocated Where to store the size of the buffer
+ */
+void ev_reader_usage(const ev_reader *r, size_t *buffered, size_t *allocated) {
+  *buffered = r->b.end - r->b.start;
+  *allocated = r->b.top - r->b.base;
+}
+
 /** @brief Tie a reader and a writer together
  * @param r Reader
  * @param w Writer
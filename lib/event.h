@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2004, 2007 Richard Kettlewell
+ * Copyright (C) 2004, 2007, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -208,6 +208,26 @@ int ev_writer_flush(ev_writer *w);
 struct sink *ev_writer_sink(ev_writer *w) attribute((const));
 /* return a sink for the writer - use this to actually write to it */
 
+void ev_writer_usage(const ev_writer *w, size_t *buffered, size_t *allocated);
+/* report bytes waiting to be written and buffer space held */
+
+/** @brief Type of drained callback
+ * @param ev Event loop
+ * @param w Writer
+ * @param u As passed to ev_writer_drained()
+ * @return 0 on success, non-0 on error
+ */
+typedef int ev_drained_callback(ev_source *ev,
+				ev_writer *w,
+				void *u);
+
+int ev_writer_drained(ev_writer *w,
+		      size_t low_water,
+		      ev_drained_callback *callback,
+		      void *u);
+/* arrange for CALLBACK to be called once the writer has no more than
+ * LOW_WATER bytes buffered */
+
 /* buffered reader ************************************************************/
 
 typedef struct ev_reader ev_reader;
@@ -282,6 +302,9 @@ int ev_reader_enable(ev_reader *r);
  * has in fact already arrived.
  */
 
+void ev_reader_usage(const ev_reader *r, size_t *buffered, size_t *allocated);
+/* report bytes read but not yet consumed and buffer space held */
+
 int ev_tie(ev_reader *r, ev_writer *w);
 
 #endif /* EVENT_H */
@@ -0,0 +1,94 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file lib/frame.h
+ * @brief Binary framing of response bodies
+ *
+ * After a client issues the @c binary command, each item of a response body
+ * is sent as a 4-byte big-endian length followed by that many bytes, instead
+ * of as a dot-stuffed line.  The body ends with a length of @ref FRAME_END and
+ * no data.  Response lines, command bodies and the event log are unchanged.
+ */
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdint.h>
+
+#include "sink.h"
+
+/** @brief Size of a frame header */
+#define FRAME_HEADER 4
+
+/** @brief Length marking the end of a body */
+#define FRAME_END 0xFFFFFFFFu
+
+/** @brief Encode a frame header
+ * @param h Where to store @ref FRAME_HEADER bytes
+ * @param len Length of frame, or @ref FRAME_END
+ */
+static inline void frame_header(unsigned char *h, uint32_t len) {
+  h[0] = len >> 24;
+  h[1] = len >> 16;
+  h[2] = len >> 8;
+  h[3] = len;
+}
+
+/** @brief Decode a frame header
+ * @param h @ref FRAME_HEADER bytes
+ * @return Length of frame, or @ref FRAME_END
+ */
+static inline uint32_t frame_length(const unsigned char *h) {
+  return (uint32_t)h[0] << 24 | (uint32_t)h[1] << 16
+    | (uint32_t)h[2] << 8 | h[3];
+}
+
+/** @brief Write a frame
+ * @param s Sink to write to
+ * @param ptr Frame contents
+ * @param len Length of frame
+ * @return non-negative on success, -1 on error
+ */
+static inline int frame_write(struct sink *s, const void *ptr, size_t len) {
+  unsigned char h[FRAME_HEADER];
+
+  frame_header(h, len);
+  if(sink_write(s, h, FRAME_HEADER) < 0)
+    return -1;
+  return sink_write(s, ptr, len);
+}
+
+/** @brief Write the end of a body
+ * @param s Sink to write to
+ * @return non-negative on success, -1 on error
+ */
+static inline int frame_end(struct sink *s) {
+  unsigned char h[FRAME_HEADER];
+
+  frame_header(h, FRAME_END);
+  return sink_write(s, h, FRAME_HEADER);
+}
+
+#endif /* FRAME_H */
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
@@ -105,7 +105,7 @@ int hash_add(hash *h, const char *key, const void *value, int mode) {
   struct entry *e;
   
   for(e = h->slots[n & (h->nslots - 1)]; e; e = e->next)
-    if(e->h == n || !strcmp(e->key, key))
+    if(e->h == n && !strcmp(e->key, key))
       break;
   if(e) {
     /* This key is already present. */
@@ -139,7 +139,7 @@ int hash_remove(hash *h, const char *key) {
   struct entry *e, **ee;
   
   for(ee = &h->slots[n & (h->nslots - 1)]; (e = *ee); ee = &e->next)
-    if(e->h == n || !strcmp(e->key, key))
+    if(e->h == n && !strcmp(e->key, key))
       break;
   if(e) {
     *ee = e->next;
@@ -161,7 +161,7 @@ void *hash_find(hash *h, const char *key) {
   struct entry *e;
 
   for(e = h->slots[n & (h->nslots - 1)]; e; e = e->next)
-    if(e->h == n || !strcmp(e->key, key))
+    if(e->h == n && !strcmp(e->key, key))
       return e->value;
   return 0;
 }
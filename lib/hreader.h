@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2010 Richard Kettlewell
+ * Copyright (C) 2010, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -35,12 +35,45 @@ struct hreader {
   char *buffer;			/* input buffer */
   size_t bufsize;		/* buffer size */
   size_t bytes;			/* size of last read */
+  unsigned flags;               /* HREADER_... flags */
+  int fd;                       /* open file, or -1 */
 };
 
+/** @brief Default buffer size */
+#define HREADER_DEFAULT_BUFSIZE 65536
+
+/** @brief Keep the file open between reads
+ *
+ * This saves an @c open() call (and a path lookup) per buffer refill, at the
+ * cost of stopping the filesystem from being unmounted while the reader is in
+ * use.  If the file handle goes stale (which can happen over NFS) the file is
+ * reopened by name.
+ */
+#define HREADER_KEEP_OPEN 0x0001
+
+/** @brief Ask the kernel to read ahead
+ *
+ * After each buffer refill, the kernel is asked to start fetching the next
+ * buffer's worth of the file, so that it is (hopefully) already in memory by
+ * the time it is needed.
+ */
+#define HREADER_PREFETCH 0x0002
+
+/** @brief Set the defaults for new readers
+ * @param bufsize Buffer size, or 0 for @ref HREADER_DEFAULT_BUFSIZE
+ * @param flags Bitmap of @ref HREADER_KEEP_OPEN and @ref HREADER_PREFETCH
+ *
+ * The initial defaults are @ref HREADER_DEFAULT_BUFSIZE and @ref
+ * HREADER_PREFETCH.
+ */
+void hreader_defaults(size_t bufsize, unsigned flags);
+
 /** @brief Initialize a hands-off reader
  * @param path File to read
  * @param h Reader to initialize
  * @return 0 on success, -1 on error
+ *
+ * The reader uses the settings from the last call to hreader_defaults().
  */
 int hreader_init(const char *path, struct hreader *h);
 
@@ -85,20 +85,97 @@ struct expansion {
 /** @brief Expansion is a macro */
 #define EXP_MACRO 0x0002
 
+/** @brief Expansion is not registered (yet)
+ *
+ * Placeholder created by mx_parse() so that parse trees can refer to
+ * expansions before they are defined. */
+#define EXP_UNKNOWN 0x0003
+
 /** @brief Mask of types */
 #define EXP_TYPE_MASK 0x0003
 
 /** @brief Hash of all expansions
  *
- * Created by mx_register(), mx_register_macro() or mx_register_magic().
+ * Created by mx_register(), mx_register_macro() or mx_register_magic(), or
+ * by mx_parse() encountering a name for the first time.
+ *
+ * Parse trees point directly at the values in this hash (see @ref
+ * mx_node::expansion).  This is safe because values are never moved or
+ * removed; registration overwrites them in place.
  */
 static hash *expansions;
 
+/** @brief One instruction of a compiled template
+ *
+ * See @ref mx_program.
+ */
+struct mx_instruction {
+  /** @brief Expansion node, or NULL for literal text */
+  const struct mx_node *m;
+
+  /** @brief Literal text (if @p m is NULL) */
+  const char *text;
+
+  /** @brief Length of @p text */
+  size_t length;
+
+  /** @brief Nonzero if @p body is valid */
+  int cached;
+
+  /** @brief Macro definition @p body was generated from */
+  const struct mx_node *definition;
+
+  /** @brief Macro argument names @p body was generated from */
+  char **argnames;
+
+  /** @brief Macro definition with this call's arguments substituted */
+  const struct mx_node *body;
+};
+
+/** @brief A compiled template
+ *
+ * This is a flattened form of an @ref mx_node list, cached in the head node
+ * (see @ref mx_node::program).  Adjacent text nodes are merged and text
+ * lengths precomputed, and macro calls remember their rewritten definition.
+ */
+struct mx_program {
+  /** @brief Number of instructions */
+  int ninstructions;
+
+  /** @brief Instructions */
+  struct mx_instruction *instructions;
+
+  /** @brief Names of argument-less expansions anywhere in the template
+   *
+   * NULL-terminated, or NULL if not yet computed.  See mx__refs().
+   */
+  const char **refs;
+};
+
 static int mx__expand_macro(const struct expansion *e,
-                            const struct mx_node *m,
+                            struct mx_instruction *i,
                             struct sink *output,
                             void *u);
 
+/** @brief Find the definition of an expansion
+ * @param name Expansion name
+ * @return Pointer to definition (possibly of type @ref EXP_UNKNOWN)
+ *
+ * If @p name is not registered then a placeholder is created.
+ */
+static const struct expansion *mx__find(const char *name) {
+  static const struct expansion unknown = { .flags = EXP_UNKNOWN };
+  const struct expansion *e;
+
+  if(!expansions)
+    expansions = hash_new(sizeof(struct expansion));
+  if(!(e = hash_find(expansions, name))) {
+    hash_add(expansions, name, &unknown, HASH_INSERT);
+    e = hash_find(expansions, name);
+  }
+  return e;
+}
+
 /* Parsing ------------------------------------------------------------------ */
 
 static int next_non_whitespace(const char *input,
@@ -206,6 +283,7 @@ const struct mx_node *mx_parse(const char *filename,
       dynstr_append(d, *input++);
     dynstr_terminate(d);
     e->name = d->vec;
+    e->expansion = mx__find(e->name);
     /* See what the bracket character is */
     obracket = next_non_whitespace(input, end);
     switch(obracket) {
@@ -398,8 +476,191 @@ int mx_register_macro(const char *name,
   return 0;
 }
 
+/* Compilation -------------------------------------------------------------- */
+
+/** @brief Compile a template
+ * @param m Head of list to compile (not NULL)
+ * @return Compiled form of @p m
+ *
+ * The result is cached in @p m so each list is only compiled once.
+ */
+static struct mx_program *mx__compile(const struct mx_node *m) {
+  struct mx_program *p;
+  struct mx_instruction *i;
+  const struct mx_node *mm;
+  struct dynstr d[1];
+  int n = 0;
+
+  if(m->program)
+    return m->program;
+  for(mm = m; mm; mm = mm->next)
+    ++n;
+  p = xmalloc(sizeof *p);
+  p->instructions = xcalloc(n, sizeof *p->instructions);
+  mm = m;
+  while(mm) {
+    i = &p->instructions[p->ninstructions++];
+    switch(mm->type) {
+    case MX_TEXT:
+      if(mm->next && mm->next->type == MX_TEXT) {
+        /* Merge runs of text, e.g. either side of an '@@' */
+        dynstr_init(d);
+        while(mm && mm->type == MX_TEXT) {
+          dynstr_append_string(d, mm->text);
+          mm = mm->next;
+        }
+        dynstr_terminate(d);
+        i->text = d->vec;
+        i->length = d->nvec;
+      } else {
+        i->text = mm->text;
+        i->length = strlen(mm->text);
+        mm = mm->next;
+      }
+      break;
+    case MX_EXPANSION:
+      i->m = mm;
+      mm = mm->next;
+      break;
+    default:
+      assert(!"invalid m->type");
+    }
+  }
+  ((struct mx_node *)m)->program = p;
+  return p;
+}
+
+/** @brief Add a name to a set
+ * @param v Set of names
+ * @param name Name to add if not already present
+ */
+static void mx__addref(struct vector *v, const char *name) {
+  int n;
+
+  for(n = 0; n < v->nvec; ++n)
+    if(!strcmp(v->vec[n], name))
+      return;
+  vector_append(v, (char *)name);
+}
+
+/** @brief Find the names an mx_rewrite() might substitute
+ * @param m Head of list (not NULL)
+ * @return NULL-terminated list of argument-less expansion names in @p m
+ *
+ * Includes names found in the arguments to expansions, recursively.
+ */
+static const char **mx__refs(const struct mx_node *m) {
+  struct mx_program *p = mx__compile(m);
+  const struct mx_node *mm;
+  const char **r;
+  struct vector v[1];
+  int n;
+
+  if(!p->refs) {
+    vector_init(v);
+    for(mm = m; mm; mm = mm->next) {
+      if(mm->type != MX_EXPANSION)
+        continue;
+      if(mm->nargs == 0)
+        mx__addref(v, mm->name);
+      for(n = 0; n < mm->nargs; ++n)
+        if(mm->args[n])
+          for(r = mx__refs(mm->args[n]); *r; ++r)
+            mx__addref(v, *r);
+    }
+    vector_terminate(v);
+    p->refs = (const char **)v->vec;
+  }
+  return p->refs;
+}
+
 /* Expansion ---------------------------------------------------------------- */
 
+/** @brief Expand one expansion instruction
+ * @param i Instruction
+ * @param output Where to send output
+ * @param u User data
+ * @return 0 on success, non-0 on error
+ */
+static int mx__expand_one(struct mx_instruction *i,
+                          struct sink *output,
+                          void *u) {
+  const struct mx_node *m = i->m;
+  const struct expansion *e;
+  int rc = 0;
+
+  if(!(e = m->expansion))
+    e = ((struct mx_node *)m)->expansion = mx__find(m->name);
+  if((e->flags & EXP_TYPE_MASK) == EXP_UNKNOWN) {
+    disorder_error(0, "%s:%d: unknown expansion name '%s'",
+                   m->filename, m->line, m->name);
+    if(sink_printf(output, "[['%s' unknown]]", m->name) < 0)
+      return -1;
+  } else if(m->nargs < e->min) {
+    disorder_error(0, "%s:%d: expansion '%s' requires %d args, only %d given",
+                   m->filename, m->line, m->name, e->min, m->nargs);
+    if(sink_printf(output, "[['%s' too few args]]", m->name) < 0)
+      return -1;
+  } else if(m->nargs > e->max) {
+    disorder_error(0, "%s:%d: expansion '%s' takes at most %d args, but %d given",
+                   m->filename, m->line, m->name, e->max, m->nargs);
+    if(sink_printf(output, "[['%s' too many args]]", m->name) < 0)
+      return -1;
+  } else switch(e->flags & EXP_TYPE_MASK) {
+    case EXP_MAGIC: {
+      /* Magic callbacks we can call directly */
+      rc = ((mx_magic_callback *)e->callback)(m->nargs,
+                                              m->args,
+                                              output,
+                                              u);
+      break;
+    }
+    case EXP_SIMPLE: {
+      /* For simple callbacks we expand their arguments for them. */
+      char *small[8], **args;
+      int n;
+
+      if(m->nargs < (int)(sizeof small / sizeof *small))
+        args = small;
+      else
+        args = xcalloc(1 + m->nargs, sizeof (char *));
+      for(n = 0; n < m->nargs; ++n) {
+        /* Argument numbers are at least clear from looking at the text;
+         * adding names as well would be nice.  TODO */
+        if((rc = mx_expandstr(m->args[n], &args[n], u, NULL))) {
+          if(rc != -1)
+            disorder_error(0, "  ...in argument #%d at %s:%d",
+                           n, m->args[n]->filename, m->args[n]->line);
+          break;
+        }
+      }
+      if(!rc) {
+        args[n] = NULL;
+        rc = ((mx_simple_callback *)e->callback)(m->nargs,
+                                                 args,
+                                                 output,
+                                                 u);
+      }
+      break;
+    }
+    case EXP_MACRO: {
+      /* Macros we expand by rewriting their definition with argument values
+       * substituted and then expanding that. */
+      rc = mx__expand_macro(e, i, output, u);
+      break;
+    }
+    default:
+      assert(!"impossible EXP_TYPE_MASK value");
+    }
+  if(rc) {
+    /* For non-IO errors we generate some backtrace */
+    if(rc != -1)
+      disorder_error(0,  "  ...in @%s at %s:%d",
+                     m->name, m->filename, m->line);
+  }
+  return rc;
+}
+
 /** @brief Expand a template
  * @param m Where to start
  * @param output Where to send output
@@ -415,88 +676,28 @@ int mx_register_macro(const char *name,
  *
  * If any callback returns non-zero then that value is returned, abandoning
  * further expansion.
+ *
+ * The template is compiled on first use (see @ref mx_program) and the
+ * compiled form reused subsequently.
  */
 int mx_expand(const struct mx_node *m,
               struct sink *output,
               void *u) {
-  const struct expansion *e;
+  struct mx_program *p;
+  struct mx_instruction *i, *end;
   int rc;
 
   if(!m)
     return 0;
-  switch(m->type) {
-  case MX_TEXT:
-    if(sink_writes(output, m->text) < 0)
-      return -1;
-    break;
-  case MX_EXPANSION:
-    rc = 0;
-    if(!(e = hash_find(expansions, m->name))) {
-      disorder_error(0, "%s:%d: unknown expansion name '%s'",
-                     m->filename, m->line, m->name);
-      if(sink_printf(output, "[['%s' unknown]]", m->name) < 0)
-        return -1;
-    } else if(m->nargs < e->min) {
-      disorder_error(0, "%s:%d: expansion '%s' requires %d args, only %d given",
-                     m->filename, m->line, m->name, e->min, m->nargs);
-      if(sink_printf(output, "[['%s' too few args]]", m->name) < 0)
+  p = mx__compile(m);
+  for(i = p->instructions, end = i + p->ninstructions; i < end; ++i) {
+    if(!i->m) {
+      if(sink_write(output, i->text, i->length) < 0)
         return -1;
-    } else if(m->nargs > e->max) {
-      disorder_error(0, "%s:%d: expansion '%s' takes at most %d args, but %d given",
-            m->filename, m->line, m->name, e->max, m->nargs);
-      if(sink_printf(output, "[['%s' too many args]]", m->name) < 0)
-        return -1;
-    } else switch(e->flags & EXP_TYPE_MASK) {
-      case EXP_MAGIC: {
-        /* Magic callbacks we can call directly */
-        rc = ((mx_magic_callback *)e->callback)(m->nargs,
-                                                m->args,
-                                                output,
-                                                u);
-        break;
-      }
-      case EXP_SIMPLE: {
-        /* For simple callbacks we expand their arguments for them. */
-        char **args = xcalloc(1 + m->nargs, sizeof (char *)), *argname;
-        int n;
-        
-        for(n = 0; n < m->nargs; ++n) {
-          /* Argument numbers are at least clear from looking at the text;
-           * adding names as well would be nice.  TODO */
-          byte_xasprintf(&argname, "argument #%d", n);
-          if((rc = mx_expandstr(m->args[n], &args[n], u, argname)))
-            break;
-        }
-        if(!rc) {
-          args[n] = NULL;
-          rc = ((mx_simple_callback *)e->callback)(m->nargs,
-                                                   args,
-                                                   output,
-                                                   u);
-        }
-        break;
-      }
-      case EXP_MACRO: {
-        /* Macros we expand by rewriting their definition with argument values
-         * substituted and then expanding that. */
-        rc = mx__expand_macro(e, m, output, u);
-        break;
-      }
-      default:
-        assert(!"impossible EXP_TYPE_MASK value");
-    }
-    if(rc) {
-      /* For non-IO errors we generate some backtrace */
-      if(rc != -1)
-        disorder_error(0,  "  ...in @%s at %s:%d",
-                       m->name, m->filename, m->line);
+    } else if((rc = mx__expand_one(i, output, u)))
       return rc;
-    }
-    break;
-  default:
-    assert(!"invalid m->type");
   }
-  return mx_expand(m->next, output, u);
+  return 0;
 }
 
 /** @brief Expand a template storing the result in a string
@@ -513,9 +714,15 @@ int mx_expandstr(const struct mx_node *m,
                  char **sp,
                  void *u,
                  const char *what) {
+  const struct mx_program *p;
   struct dynstr d[1];
   int rc;
 
+  if(m && (p = mx__compile(m))->ninstructions == 1 && !p->instructions[0].m) {
+    /* Plain text needs no sink */
+    *sp = xstrndup(p->instructions[0].text, p->instructions[0].length);
+    return 0;
+  }
   dynstr_init(d);
   if(!(rc = mx_expand(m, sink_dynstr(d), u))) {
     dynstr_terminate(d);
@@ -527,29 +734,66 @@ int mx_expandstr(const struct mx_node *m,
   return rc;
 }
 
-/** @brief Expand a template file
+/** @brief A parsed template file
+ *
+ * See mx_expand_file().
+ */
+struct mx_file {
+  /** @brief Device number when parsed */
+  dev_t dev;
+
+  /** @brief Inode number when parsed */
+  ino_t ino;
+
+  /** @brief Size when parsed */
+  off_t size;
+
+  /** @brief Modification time when parsed */
+  time_t mtime;
+
+  /** @brief Parse tree */
+  const struct mx_node *m;
+};
+
+/** @brief Cache of parsed template files
+ *
+ * Maps filenames to @ref mx_file structures.  Long-lived callers (such as the
+ * CGI in FastCGI mode) expand the same templates over and over again, so it
+ * is worth remembering the parse trees.
+ */
+static hash *mx_files;
+
+/** @brief Parse a template file
  * @param path Filename
- * @param output Where to send output
- * @param u User data
- * @return 0 on success, non-0 on error
+ * @return Parse tree
  *
- * Same return conventions as mx_expand().
+ * If the file has already been parsed and has not changed since (judging by
+ * its inode, size and modification time) then the existing parse tree is
+ * returned.
  */
-int mx_expand_file(const char *path,
-                   struct sink *output,
-                   void *u) {
-  int fd, n, rc;
+static const struct mx_node *mx__parse_file(const char *path) {
+  int fd, n;
   struct stat sb;
   char *b;
   off_t sofar;
-  const struct mx_node *m;
+  struct mx_file *f, nf[1];
 
+  if(!mx_files)
+    mx_files = hash_new(sizeof (struct mx_file));
   if((fd = open(path, O_RDONLY)) < 0)
     disorder_fatal(errno, "error opening %s", path);
   if(fstat(fd, &sb) < 0)
     disorder_fatal(errno, "error statting %s", path);
   if(!S_ISREG(sb.st_mode))
     disorder_fatal(0, "%s: not a regular file", path);
+  if((f = hash_find(mx_files, path))
+     && f->dev == sb.st_dev
+     && f->ino == sb.st_ino
+     && f->size == sb.st_size
+     && f->mtime == sb.st_mtime) {
+    xclose(fd);
+    return f->m;
+  }
   sofar = 0;
   b = xmalloc_noptr(sb.st_size);
   while(sofar < sb.st_size) {
@@ -562,8 +806,34 @@ int mx_expand_file(const char *path,
       disorder_fatal(errno, "error reading %s", path);
   }
   xclose(fd);
-  m = mx_parse(path, 1, b, b + sb.st_size);
-  rc = mx_expand(m, output, u);
+  nf->dev = sb.st_dev;
+  nf->ino = sb.st_ino;
+  nf->size = sb.st_size;
+  nf->mtime = sb.st_mtime;
+  /* The parse tree refers to the filename, so it must outlive the caller's
+   * copy. */
+  nf->m = mx_parse(xstrdup(path), 1, b, b + sb.st_size);
+  hash_add(mx_files, path, nf, HASH_INSERT_OR_REPLACE);
+  return nf->m;
+}
+
+/** @brief Expand a template file
+ * @param path Filename
+ * @param output Where to send output
+ * @param u User data
+ * @return 0 on success, non-0 on error
+ *
+ * Same return conventions as mx_expand().
+ *
+ * Parse trees are cached, so expanding the same file repeatedly only parses
+ * it once (unless it changes).
+ */
+int mx_expand_file(const char *path,
+                   struct sink *output,
+                   void *u) {
+  int rc;
+
+  rc = mx_expand(mx__parse_file(path), output, u);
   if(rc && rc != -1)
     /* Mention inclusion in backtrace */
     disorder_error(0, "  ...in inclusion of file '%s'", path);
@@ -572,59 +842,75 @@ int mx_expand_file(const char *path,
 
 /* Macros ------------------------------------------------------------------- */
 
-/** @brief Rewrite a parse tree substituting sub-expansions
- * @param m Parse tree to rewrite (from macro definition)
- * @param ... Name/value pairs to rewrite
- * @return Rewritten parse tree
+/** @brief Values to substitute in mx__rewrite() */
+struct mx_bindings {
+  /** @brief Hash mapping names to values, or NULL to use @p names */
+  hash *h;
+
+  /** @brief Number of names (if @p h is NULL) */
+  int n;
+
+  /** @brief Names (if @p h is NULL) */
+  char **names;
+
+  /** @brief Values corresponding to @p names */
+  const struct mx_node **values;
+};
+
+/** @brief Look up a name in a @ref mx_bindings
+ * @param b Bindings
+ * @param name Name to look up
+ * @return Pointer to value, or NULL if @p name is not bound
  *
- * The name/value pair list consists of pairs of strings and is terminated by
- * (char *)0.  Names and values are both copied so need not survive the call.
+ * Callers with only a handful of names use arrays rather than a hash, which
+ * saves creating a hash table for every rewrite.
  */
-const struct mx_node *mx_rewritel(const struct mx_node *m,
-                                  ...) {
-  va_list ap;
-  hash *h = hash_new(sizeof (struct mx_node *));
-  const char *n, *v;
-  struct mx_node *e;
+static const struct mx_node **mx__lookup(const struct mx_bindings *b,
+                                         const char *name) {
+  int n;
 
-  va_start(ap, m);
-  while((n = va_arg(ap, const char *))) {
-    v = va_arg(ap, const char *);
-    e = xmalloc(sizeof *e);
-    e->next = 0;
-    e->filename = m->filename;
-    e->line = m->line;
-    e->type = MX_TEXT;
-    e->text = xstrdup(v);
-    hash_add(h, n, &e, HASH_INSERT);
-    /* hash_add() copies n */
-  }
-  return mx_rewrite(m, h);
+  if(b->h)
+    return hash_find(b->h, name);
+  for(n = 0; n < b->n; ++n)
+    if(!strcmp(b->names[n], name))
+      return &b->values[n];
+  return 0;
 }
 
 /** @brief Rewrite a parse tree substituting in macro arguments
  * @param definition Parse tree to rewrite (from macro definition)
- * @param h Hash mapping argument names to argument values
+ * @param b Argument names and values
  * @return Rewritten parse tree
+ *
+ * Parts of @p definition that contain nothing to substitute are not copied,
+ * so the result may share structure with (or be) @p definition.
  */
-const struct mx_node *mx_rewrite(const struct mx_node *definition,
-                                 hash *h) {
+static const struct mx_node *mx__rewrite(const struct mx_node *definition,
+                                         const struct mx_bindings *b) {
   const struct mx_node *head = 0, **tailp = &head, *argvalue, *m, *mm, **ap;
+  const char **r;
   struct mx_node *nm;
   int n;
-  
+
+  if(!definition)
+    return 0;
+  for(r = mx__refs(definition); *r && !mx__lookup(b, *r); ++r)
+    ;
+  if(!*r)
+    return definition;                  /* Nothing to substitute */
   for(m = definition; m; m = m->next) {
     switch(m->type) {
     case MX_TEXT:
       nm = xmalloc(sizeof *nm);
       *nm = *m;                          /* Dumb copy of text node fields */
       nm->next = 0;                      /* Maintain list structure */
+      nm->program = 0;
       *tailp = nm;
       tailp = (const struct mx_node **)&nm->next;
       break;
     case MX_EXPANSION:
       if(m->nargs == 0
-         && (ap = hash_find(h, m->name))) {
+         && (ap = mx__lookup(b, m->name))) {
         /* This expansion has no arguments and its name matches one of the
          * macro arguments.  (Even if it's a valid expansion name we override
          * it.)  We insert its value at this point.  We do NOT recursively
@@ -639,18 +925,20 @@ const struct mx_node *mx_rewrite(const struct mx_node *definition,
           nm = xmalloc(sizeof *nm);
           *nm = *mm;
           nm->next = 0;
+          nm->program = 0;
           *tailp = nm;
           tailp = (const struct mx_node **)&nm->next;
         }
       } else {
         /* This is some other expansion.  We recursively rewrite its argument
-         * values according to h. */
+         * values according to b. */
         nm = xmalloc(sizeof *nm);
         *nm = *m;
         nm->args = xcalloc(nm->nargs, sizeof (struct mx_node *));
         for(n = 0; n < nm->nargs; ++n)
-          nm->args[n] = mx_rewrite(m->args[n], h);
+          nm->args[n] = mx__rewrite(m->args[n], b);
         nm->next = 0;
+        nm->program = 0;
         *tailp = nm;
         tailp = (const struct mx_node **)&nm->next;
       }
@@ -663,29 +951,118 @@ const struct mx_node *mx_rewrite(const struct mx_node *definition,
   return head;
 }
 
+/** @brief Rewrite a parse tree substituting sub-expansions
+ * @param m Parse tree to rewrite (from macro definition)
+ * @param ... Name/value pairs to rewrite
+ * @return Rewritten parse tree
+ *
+ * The name/value pair list consists of pairs of strings and is terminated by
+ * (char *)0.  Values are copied and names are not retained, so neither need
+ * survive the call.
+ */
+const struct mx_node *mx_rewritel(const struct mx_node *m,
+                                  ...) {
+  va_list ap;
+  struct vector names[1];
+  struct mx_node_vector values[1];
+  struct mx_bindings b[1];
+  const char *n, *v;
+  struct mx_node *e;
+
+  if(!m)
+    return 0;
+  vector_init(names);
+  mx_node_vector_init(values);
+  va_start(ap, m);
+  while((n = va_arg(ap, const char *))) {
+    v = va_arg(ap, const char *);
+    e = xmalloc(sizeof *e);
+    e->next = 0;
+    e->filename = m->filename;
+    e->line = m->line;
+    e->type = MX_TEXT;
+    e->text = xstrdup(v);
+    vector_append(names, (char *)n);
+    mx_node_vector_append(values, e);
+  }
+  va_end(ap);
+  b->h = 0;
+  b->n = names->nvec;
+  b->names = names->vec;
+  b->values = values->vec;
+  return mx__rewrite(m, b);
+}
+
+/** @brief Rewrite a parse tree substituting in macro arguments
+ * @param definition Parse tree to rewrite (from macro definition)
+ * @param h Hash mapping argument names to argument values
+ * @return Rewritten parse tree
+ */
+const struct mx_node *mx_rewrite(const struct mx_node *definition,
+                                 hash *h) {
+  struct mx_bindings b[1];
+
+  b->h = h;
+  b->n = 0;
+  b->names = 0;
+  b->values = 0;
+  return mx__rewrite(definition, b);
+}
+
+/** @brief Test whether a cached macro body is still valid
+ * @param e Macro definition
+ * @param i Instruction holding the cached body
+ * @return Nonzero if @p i->body can be used
+ *
+ * Macros can be redefined at any time, so the cache is checked against the
+ * current definition on every use.
+ */
+static int mx__macro_cached(const struct expansion *e,
+                            const struct mx_instruction *i) {
+  int n;
+
+  if(!i->cached || i->definition != e->definition)
+    return 0;
+  if(i->argnames != e->args)
+    for(n = 0; n < i->m->nargs; ++n)
+      if(strcmp(i->argnames[n], e->args[n]))
+        return 0;
+  return 1;
+}
+
 /** @brief Expand a macro
  * @param e Macro definition
- * @param m Macro expansion
+ * @param i Macro expansion instruction
  * @param output Where to send output
  * @param u User data
  * @return 0 on success, non-0 on error
+ *
+ * The rewritten definition is remembered in @p i, so repeated expansions of
+ * the same call only rewrite it once.
  */
 static int mx__expand_macro(const struct expansion *e,
-                            const struct mx_node *m,
+                            struct mx_instruction *i,
                             struct sink *output,
                             void *u) {
-  hash *h = hash_new(sizeof (struct mx_node *));
-  int n;
+  const struct mx_node *m = i->m;
+  struct mx_bindings b[1];
 
-  /* We store the macro arguments in a hash.  Currently there is no check for
-   * duplicate argument names (and this would be the wrong place for it
-   * anyway); if you do that you just lose in some undefined way. */
-  for(n = 0; n < m->nargs; ++n)
-    hash_add(h, e->args[n], &m->args[n], HASH_INSERT);
-  /* Generate a rewritten parse tree */
-  m = mx_rewrite(e->definition, h);
+  if(!mx__macro_cached(e, i)) {
+    /* Currently there is no check for duplicate argument names (and this
+     * would be the wrong place for it anyway); if you do that you just lose in
+     * some undefined way. */
+    b->h = 0;
+    b->n = m->nargs;
+    b->names = e->args;
+    b->values = m->args;
+    /* Generate a rewritten parse tree */
+    i->body = mx__rewrite(e->definition, b);
+    i->definition = e->definition;
+    i->argnames = e->args;
+    i->cached = 1;
+  }
   /* Expand the result */
-  return mx_expand(m, output, u);
+  return mx_expand(i->body, output, u);
   /* mx_expand() will update the backtrace */
 }
 
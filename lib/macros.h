@@ -24,6 +24,8 @@
 #define MACROS_H
 
 struct sink;
+struct expansion;
+struct mx_program;
 
 /** @brief One node in a macro expansion parse tree */
 struct mx_node {
@@ -50,6 +52,18 @@ struct mx_node {
 
   /** @brief Argument values, parsed recursively (or NULL if @p nargs is 0) */
   const struct mx_node **args;
+
+  /** @brief Definition of expansion (if @p type is @ref MX_EXPANSION)
+   *
+   * Resolved at parse time, so expansion never has to look up @p name.  The
+   * definition may change (or be registered for the first time) after
+   * parsing. */
+  const struct expansion *expansion;
+
+  /** @brief Compiled form of the list starting here, or NULL
+   *
+   * Filled in the first time the list is expanded. */
+  struct mx_program *program;
 };
 
 /** @brief Text node */
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2004, 2005, 2006, 2007, 2009 Richard Kettlewell
+ * Copyright (C) 2004, 2005, 2006, 2007, 2009, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -17,6 +17,19 @@
  */
 /** @file lib/mem.c
  * @brief Memory management
+ *
+ * As well as the general-purpose allocation functions, this file provides
+ * arenas.  An arena is a region from which allocations are carved
+ * sequentially and then all freed at once by mem_arena_reset(), which suits
+ * the many short-lived strings and vectors created while handling a single
+ * command or request.
+ *
+ * Arena allocations are always explicit, with mem_arena_alloc() and
+ * friends; xmalloc() and the rest never return arena memory, and arena
+ * memory must not be passed to xrealloc() or xfree().  So only the code that
+ * allocates from an arena needs to know when it will be reset.
+ *
+ * Arenas are not thread-safe; only single-threaded programs may use them.
  */
 
 #include "common.h"
@@ -25,6 +38,9 @@
 #include <gc.h>
 #endif
 #include <errno.h>
+#if HAVE_MALLINFO2
+#include <malloc.h>
+#endif
 
 #include "mem.h"
 #include "log.h"
@@ -48,13 +64,60 @@ static void *(*do_malloc)(size_t) = GC_malloc;
 static void *(*do_realloc)(void *, size_t) = GC_realloc;
 static void *(*do_malloc_atomic)(size_t) = GC_malloc_atomic;
 static void (*do_free)(void *) = GC_free;
+static void *(*do_malloc_uncollectable)(size_t) = GC_malloc_uncollectable;
 #else
 static void *(*do_malloc)(size_t) = malloc_and_zero;
 static void *(*do_realloc)(void *, size_t) = realloc;
 static void *(*do_malloc_atomic)(size_t) = malloc;
 static void (*do_free)(void *) = free;
+static void *(*do_malloc_uncollectable)(size_t) = malloc;
 #endif
 
+/** @brief Alignment of arena allocations */
+#define ARENA_ALIGN (2 * sizeof (void *))
+
+/** @brief Size of an arena's first chunk */
+#define ARENA_CHUNK 65536
+
+/** @brief Largest chunk size reached by doubling
+ *
+ * Bigger allocations still get a chunk of their own.
+ */
+#define ARENA_CHUNK_MAX (16 * 1048576)
+
+/** @brief A block of memory that arena allocations are carved from */
+struct mem_chunk {
+  /** @brief Next (older) chunk */
+  struct mem_chunk *next;
+
+  /** @brief Start of allocatable space */
+  char *base;
+
+  /** @brief Next free byte */
+  char *top;
+
+  /** @brief End of allocatable space */
+  char *limit;
+};
+
+/** @brief An arena */
+struct mem_arena {
+  /** @brief Next arena in @ref arenas */
+  struct mem_arena *next;
+
+  /** @brief Chunks, newest first
+   *
+   * The last (oldest) chunk is kept by mem_arena_reset().
+   */
+  struct mem_chunk *chunks;
+
+  /** @brief Total size of @ref chunks in bytes */
+  size_t size;
+};
+
+/** @brief All arenas */
+static struct mem_arena *arenas;
+
 /** @brief Initialize memory management
  *
  * Must be called by all programs that use garbage collection.  Define
@@ -70,6 +133,7 @@ void mem_init(void) {
     do_malloc_atomic = malloc;
     do_realloc = realloc;
     do_free = free;
+    do_malloc_uncollectable = malloc;
   } else {
     GC_init();
 #ifdef HAVE_GC_GET_ALL_INTERIOR_POINTERS
@@ -81,6 +145,197 @@ void mem_init(void) {
 #endif
 }
 
+/** @brief Round up an arena allocation size
+ * @param n Bytes requested
+ * @return Bytes actually used
+ *
+ * Every allocation gets a distinct address, even if @p n is 0.
+ */
+static inline size_t arena_round(size_t n) {
+  return (n + ARENA_ALIGN) & ~(ARENA_ALIGN - 1);
+}
+
+/** @brief Allocate from an arena
+ * @param a Arena
+ * @param n Bytes to allocate
+ * @return Pointer to allocated memory (not 0-filled)
+ */
+static void *arena_alloc(struct mem_arena *a, size_t n) {
+  struct mem_chunk *c = a->chunks;
+  size_t size;
+  char *ptr;
+
+  if(n > SIZE_MAX / 2)
+    disorder_fatal(0, "excessively large allocation");
+  n = arena_round(n);
+  if(!c || (size_t)(c->limit - c->top) < n) {
+    size = c ? (size_t)(c->limit - c->base) * 2 : ARENA_CHUNK;
+    if(size > ARENA_CHUNK_MAX)
+      size = ARENA_CHUNK_MAX;
+    if(size < n)
+      size = n;
+    if(!(c = do_malloc_uncollectable(sizeof *c + ARENA_ALIGN + size)))
+      disorder_fatal(errno, "error allocating memory");
+    c->base = (char *)(((uintptr_t)(c + 1) + ARENA_ALIGN - 1)
+                       & ~(uintptr_t)(ARENA_ALIGN - 1));
+    c->top = c->base;
+    c->limit = c->base + size;
+    c->next = a->chunks;
+    a->chunks = c;
+    a->size += size;
+  }
+  ptr = c->top;
+  c->top += n;
+  return ptr;
+}
+
+/** @brief Create an arena
+ * @return New arena
+ *
+ * No memory is allocated for the arena's contents until it is first used.
+ */
+struct mem_arena *mem_arena_new(void) {
+  struct mem_arena *a;
+
+  if(!(a = malloc_and_zero(sizeof *a)))
+    disorder_fatal(errno, "error allocating memory");
+  a->next = arenas;
+  arenas = a;
+  return a;
+}
+
+/** @brief Allocate from an arena
+ * @param a Arena
+ * @param n Bytes to allocate
+ * @return Pointer to allocated memory
+ *
+ * The allocated memory is always 0-filled.  It lasts until @p a is reset or
+ * freed.
+ */
+void *mem_arena_alloc(struct mem_arena *a, size_t n) {
+  return memset(arena_alloc(a, n), 0, n);
+}
+
+/** @brief Reallocate within an arena
+ * @param a Arena
+ * @param ptr Block to reallocate, or NULL
+ * @param oldn Current size of @p ptr
+ * @param n Bytes to allocate
+ * @return Pointer to allocated memory
+ *
+ * @p ptr must have come from @p a.  The most recent allocation is resized in
+ * place if there is room.  Otherwise a new block is allocated and the old one
+ * copied into it; the old block's space is not reclaimed until the arena is
+ * reset.  It is NOT guaranteed that any additional memory allocated is
+ * 0-filled.
+ */
+void *mem_arena_realloc(struct mem_arena *a, void *ptr, size_t oldn,
+                        size_t n) {
+  struct mem_chunk *const c = a->chunks;
+  char *newptr;
+
+  if(!ptr)
+    return arena_alloc(a, n);
+  if(c && (char *)ptr + arena_round(oldn) == c->top
+     && n < (size_t)(c->limit - (char *)ptr)
+     && arena_round(n) <= (size_t)(c->limit - (char *)ptr)) {
+    c->top = (char *)ptr + arena_round(n);
+    return ptr;
+  }
+  newptr = arena_alloc(a, n);
+  memcpy(newptr, ptr, oldn < n ? oldn : n);
+  return newptr;
+}
+
+/** @brief Duplicate a prefix of a string into an arena
+ * @param a Arena
+ * @param s String to copy
+ * @param n Prefix of string to copy
+ * @return New copy of string
+ *
+ * @p n must not exceed the length of the string.
+ */
+char *mem_arena_strndup(struct mem_arena *a, const char *s, size_t n) {
+  char *t = arena_alloc(a, n + 1);
+
+  memcpy(t, s, n);
+  t[n] = 0;
+  return t;
+}
+
+/** @brief Free everything allocated from an arena
+ * @param a Arena
+ *
+ * The arena's first chunk is kept for reuse.
+ */
+void mem_arena_reset(struct mem_arena *a) {
+  struct mem_chunk *c;
+
+  if(!a->chunks)
+    return;
+  while(a->chunks->next) {
+    c = a->chunks;
+    a->chunks = c->next;
+    a->size -= c->limit - c->base;
+    do_free(c);
+  }
+  c = a->chunks;
+  /* Stale pointers would keep garbage alive, if there's a collector */
+  memset(c->base, 0, c->top - c->base);
+  c->top = c->base;
+}
+
+/** @brief Destroy an arena
+ * @param a Arena
+ *
+ * Everything allocated from @p a is freed.
+ */
+void mem_arena_free(struct mem_arena *a) {
+  struct mem_arena **aa;
+  struct mem_chunk *c;
+
+  for(aa = &arenas; *aa != a; aa = &(*aa)->next)
+    ;
+  *aa = a->next;
+  while((c = a->chunks)) {
+    a->chunks = c->next;
+    do_free(c);
+  }
+  free(a);
+}
+
+/** @brief Get memory usage statistics
+ * @param ms Where to store statistics
+ *
+ * Without a garbage collector, the heap size is what malloc() has obtained
+ * from the operating system and the free space is what it has not handed
+ * out, if those can be determined.  The total allocated is only known with
+ * the garbage collector.
+ */
+void mem_get_stats(struct mem_stats *ms) {
+  const struct mem_arena *a;
+
+  memset(ms, 0, sizeof *ms);
+#if GC
+  if(do_malloc == GC_malloc) {
+    ms->heap_size = GC_get_heap_size();
+    ms->free_bytes = GC_get_free_bytes();
+    ms->allocated = GC_get_total_bytes();
+    ms->collections = GC_get_gc_no();
+  }
+#endif
+#if HAVE_MALLINFO2
+  if(!ms->heap_size) {
+    const struct mallinfo2 mi = mallinfo2();
+
+    ms->heap_size = mi.arena + mi.hblkhd;
+    ms->free_bytes = mi.fordblks;
+  }
+#endif
+  for(a = arenas; a; a = a->next)
+    ms->arena_size += a->size;
+}
+
 /** @brief Allocate memory
  * @param n Bytes to allocate
  * @return Pointer to allocated memory
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2004-2009 Richard Kettlewell
+ * Copyright (C) 2004-2009, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -56,6 +56,48 @@ char *xstrndup(const char *, size_t);
 void xfree(void *ptr);
 /* As free, but calls GC_free instead if gc is enabled */
 
+struct mem_arena;
+
+struct mem_arena *mem_arena_new(void);
+/* Create a new, empty arena */
+
+void *mem_arena_alloc(struct mem_arena *a, size_t n);
+/* As xmalloc, but from A */
+
+void *mem_arena_realloc(struct mem_arena *a, void *ptr, size_t oldn,
+                        size_t n);
+/* As xrealloc, but within A.  OLDN is PTR's current size. */
+
+char *mem_arena_strndup(struct mem_arena *a, const char *s, size_t n);
+/* As xstrndup, but from A */
+
+void mem_arena_reset(struct mem_arena *a);
+/* Free everything allocated from A, which remains usable */
+
+void mem_arena_free(struct mem_arena *a);
+/* Free everything allocated from A, and A itself */
+
+/** @brief Memory usage statistics */
+struct mem_stats {
+  /** @brief Size of the heap in bytes */
+  size_t heap_size;
+
+  /** @brief Free space in the heap in bytes */
+  size_t free_bytes;
+
+  /** @brief Total bytes allocated so far, or 0 if not known */
+  size_t allocated;
+
+  /** @brief Number of garbage collections so far */
+  size_t collections;
+
+  /** @brief Bytes held by arenas */
+  size_t arena_size;
+};
+
+void mem_get_stats(struct mem_stats *ms);
+/* Fill in MS.  Fields that can't be determined are set to 0. */
+
 #endif /* MEM_H */
 
 /*
@@ -0,0 +1,285 @@
+/*
+ * This file is part of DisOrder
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file lib/pcm-cache.c
+ * @brief Cache of decoded tracks
+ *
+ * Each entry is the complete output of a decoder for one track, stored in a
+ * file named after the entry's key.  The key is a hash of the track's path,
+ * size and modification time, and the decoder command, so an entry goes stale
+ * by itself if the track is replaced.
+ *
+ * Reading an entry updates its modification time, which is what eviction uses
+ * to find the least recently used entries.  New entries are written to a
+ * temporary file whose name starts @c tmp. and renamed into place once
+ * complete, so a reader never sees a partial entry.
+ */
+#include "common.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <gcrypt.h>
+
+#include "mem.h"
+#include "log.h"
+#include "hex.h"
+#include "printf.h"
+#include "vector.h"
+#include "syscalls.h"
+#include "pcm-cache.h"
+
+/** @brief An entry being written */
+struct pcm_cache_writer {
+  /** @brief File descriptor, or -1 once abandoned */
+  int fd;
+
+  /** @brief Temporary path */
+  char *tmp;
+
+  /** @brief Final path */
+  char *path;
+
+  /** @brief Bytes written so far */
+  off_t written;
+
+  /** @brief Maximum size */
+  off_t limit;
+};
+
+/** @brief An entry found by pcm_cache_evict() */
+struct pcm_cache_entry {
+  /** @brief Path to entry */
+  char *path;
+
+  /** @brief Size of entry */
+  off_t size;
+
+  /** @brief Last use */
+  time_t used;
+};
+
+char *pcm_cache_key(const char *path, int argc, const char *const *argv) {
+  struct stat sb;
+  struct dynstr d[1];
+  uint8_t digest[20];
+  char buffer[64];
+  int n;
+
+  if(stat(path, &sb) < 0 || !S_ISREG(sb.st_mode))
+    return NULL;
+  dynstr_init(d);
+  dynstr_append_string(d, path);
+  dynstr_append(d, 0);
+  snprintf(buffer, sizeof buffer, "%jd %jd",
+           (intmax_t)sb.st_size, (intmax_t)sb.st_mtime);
+  dynstr_append_string(d, buffer);
+  for(n = 0; n < argc; ++n) {
+    dynstr_append(d, 0);
+    dynstr_append_string(d, argv[n]);
+  }
+  gcry_md_hash_buffer(GCRY_MD_SHA1, digest, d->vec, d->nvec);
+  return hex(digest, sizeof digest);
+}
+
+int pcm_cache_open(const char *dir, const char *key) {
+  char *path;
+  int fd;
+
+  byte_xasprintf(&path, "%s/%s", dir, key);
+  if((fd = open(path, O_RDONLY)) >= 0)
+    utimes(path, NULL);
+  else if(errno != ENOENT)
+    disorder_error(errno, "error opening %s", path);
+  xfree(path);
+  return fd;
+}
+
+struct pcm_cache_writer *pcm_cache_create(const char *dir, const char *key,
+                                          off_t limit) {
+  struct pcm_cache_writer *w = xmalloc(sizeof *w);
+
+  if(mkdir(dir, 0755) < 0 && errno != EEXIST) {
+    disorder_error(errno, "error creating %s", dir);
+    xfree(w);
+    return NULL;
+  }
+  byte_xasprintf(&w->tmp, "%s/tmp.%s.%lu", dir, key, (unsigned long)getpid());
+  byte_xasprintf(&w->path, "%s/%s", dir, key);
+  if((w->fd = open(w->tmp, O_WRONLY|O_CREAT|O_TRUNC, 0644)) < 0) {
+    disorder_error(errno, "error creating %s", w->tmp);
+    xfree(w->tmp);
+    xfree(w->path);
+    xfree(w);
+    return NULL;
+  }
+  w->written = 0;
+  w->limit = limit;
+  return w;
+}
+
+/** @brief Stop writing an entry, leaving @p w allocated */
+static void pcm_cache_stop(struct pcm_cache_writer *w) {
+  if(w->fd >= 0) {
+    xclose(w->fd);
+    w->fd = -1;
+    unlink(w->tmp);
+  }
+}
+
+/** @brief Write all of a buffer
+ * @return 0 on success or an errno value
+ */
+static int pcm_cache_write(int fd, const char *ptr, size_t n) {
+  ssize_t written;
+
+  while(n > 0) {
+    if((written = write(fd, ptr, n)) < 0) {
+      if(errno == EINTR)
+        continue;
+      return errno;
+    }
+    ptr += written;
+    n -= written;
+  }
+  return 0;
+}
+
+int pcm_cache_tee(int from, int to, struct pcm_cache_writer *w) {
+  char buffer[65536];
+  ssize_t n;
+  int err;
+
+  for(;;) {
+    if((n = read(from, buffer, sizeof buffer)) < 0) {
+      if(errno == EINTR)
+        continue;
+      return errno;
+    }
+    if(n == 0)
+      return 0;
+    if((err = pcm_cache_write(to, buffer, n)))
+      return err;
+    if(w && w->fd >= 0) {
+      if(w->written + n > w->limit)
+        pcm_cache_stop(w);
+      else if((err = pcm_cache_write(w->fd, buffer, n))) {
+        disorder_error(err, "error writing %s", w->tmp);
+        pcm_cache_stop(w);
+      } else
+        w->written += n;
+    }
+  }
+}
+
+int pcm_cache_commit(struct pcm_cache_writer *w) {
+  int rc = -1;
+
+  if(w->fd >= 0) {
+    if(close(w->fd) < 0)
+      disorder_error(errno, "error closing %s", w->tmp);
+    else if(rename(w->tmp, w->path) < 0)
+      disorder_error(errno, "error renaming %s", w->tmp);
+    else
+      rc = 0;
+    w->fd = -1;
+    if(rc)
+      unlink(w->tmp);
+  }
+  pcm_cache_abandon(w);
+  return rc;
+}
+
+void pcm_cache_abandon(struct pcm_cache_writer *w) {
+  pcm_cache_stop(w);
+  xfree(w->tmp);
+  xfree(w->path);
+  xfree(w);
+}
+
+/** @brief Comparison function for pcm_cache_evict() */
+static int pcm_cache_compare(const void *av, const void *bv) {
+  const struct pcm_cache_entry *a = av, *b = bv;
+
+  return a->used < b->used ? -1 : a->used > b->used;
+}
+
+void pcm_cache_evict(const char *dir, off_t limit) {
+  DIR *dp;
+  struct dirent *de;
+  struct stat sb;
+  struct pcm_cache_entry *entries = NULL;
+  size_t nentries = 0, nslots = 0, n;
+  off_t total = 0;
+  time_t now = xtime(NULL);
+  char *path;
+
+  if(!(dp = opendir(dir))) {
+    if(errno != ENOENT)
+      disorder_error(errno, "error opening %s", dir);
+    return;
+  }
+  while((de = readdir(dp))) {
+    if(de->d_name[0] == '.')
+      continue;
+    byte_xasprintf(&path, "%s/%s", dir, de->d_name);
+    if(stat(path, &sb) < 0 || !S_ISREG(sb.st_mode)) {
+      xfree(path);
+      continue;
+    }
+    if(!strncmp(de->d_name, "tmp.", 4)) {
+      if(now - sb.st_mtime > PCM_CACHE_STALE)
+        unlink(path);
+      xfree(path);
+      continue;
+    }
+    if(nentries >= nslots) {
+      nslots = nslots ? 2 * nslots : 64;
+      entries = xrealloc(entries, nslots * sizeof *entries);
+    }
+    entries[nentries].path = path;
+    entries[nentries].size = sb.st_size;
+    entries[nentries].used = sb.st_mtime;
+    ++nentries;
+    total += sb.st_size;
+  }
+  closedir(dp);
+  if(total > limit) {
+    qsort(entries, nentries, sizeof *entries, pcm_cache_compare);
+    for(n = 0; n < nentries && total > limit; ++n) {
+      if(unlink(entries[n].path) < 0)
+        disorder_error(errno, "error removing %s", entries[n].path);
+      else
+        total -= entries[n].size;
+    }
+  }
+  for(n = 0; n < nentries; ++n)
+    xfree(entries[n].path);
+  xfree(entries);
+}
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
@@ -0,0 +1,76 @@
+/*
+ * This file is part of DisOrder
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file lib/pcm-cache.h
+ * @brief Cache of decoded tracks
+ */
+#ifndef PCM_CACHE_H
+#define PCM_CACHE_H
+
+/** @brief Fraction of the cache that one entry may use
+ *
+ * An entry bigger than the cache size divided by this is abandoned.
+ */
+#define PCM_CACHE_ENTRY_FRACTION 4
+
+/** @brief Age in seconds after which a partial entry is assumed abandoned */
+#define PCM_CACHE_STALE 86400
+
+struct pcm_cache_writer;
+
+char *pcm_cache_key(const char *path, int argc, const char *const *argv);
+/* Return the cache key for decoding @path@ with the command @argv@.  The key
+ * depends on the path, size and modification time of the file.  Returns a null
+ * pointer if the file cannot be found. */
+
+int pcm_cache_open(const char *dir, const char *key);
+/* Open the entry for @key@ in @dir@ and mark it as recently used.  Returns a
+ * file descriptor or -1 if there is no such entry. */
+
+struct pcm_cache_writer *pcm_cache_create(const char *dir, const char *key,
+                                          off_t limit);
+/* Start writing a new entry for @key@ in @dir@, which is created if necessary.
+ * The entry is abandoned if it reaches @limit@ bytes.  Returns a null pointer
+ * on error. */
+
+int pcm_cache_tee(int from, int to, struct pcm_cache_writer *w);
+/* Copy everything from @from@ to @to@, and also to @w@ if it is not a null
+ * pointer.  Returns 0 on success, or an errno value if reading @from@ or
+ * writing @to@ fails.  Errors writing to @w@ just abandon the entry. */
+
+int pcm_cache_commit(struct pcm_cache_writer *w);
+/* Install the entry written to @w@ and free @w@.  Returns 0 on success or -1
+ * if the entry was abandoned or could not be installed. */
+
+void pcm_cache_abandon(struct pcm_cache_writer *w);
+/* Discard the entry written to @w@ and free @w@. */
+
+void pcm_cache_evict(const char *dir, off_t limit);
+/* Remove least recently used entries from @dir@ until they total no more than
+ * @limit@ bytes.  Also removes partial entries older than @ref
+ * PCM_CACHE_STALE. */
+
+#endif /* PCM_CACHE_H */
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
@@ -0,0 +1,594 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file lib/queue-journal.c
+ * @brief Journalled queue persistence
+ *
+ * A queue (or recently played list) is stored as a snapshot file, in the
+ * format that queue_marshall() produces, plus a journal of changes made since
+ * the snapshot was written.  The journal is named after the snapshot with @c
+ * .journal appended.
+ *
+ * Both files start with a line of the form <tt>#1 GENERATION</tt>.  Older
+ * versions of the server only look at the @c 1.  The journal only applies to a
+ * snapshot with the same generation; each compaction increments it, writing
+ * the snapshot first and the (empty) journal second, so a crash in between
+ * leaves a snapshot that already contains everything together with a journal
+ * that will be ignored.
+ *
+ * Journal records are:
+ * - <tt>- ID</tt>, meaning remove the entry with that ID
+ * - <tt>+ AFTER FIELDS...</tt>, meaning remove any entry with the ID in @c
+ *   FIELDS and then insert the new entry after the one with ID @c AFTER, or at
+ *   the start if @c AFTER is @c -
+ *
+ * A record is only complete once its newline has been written.  Any partial
+ * record at the end of the journal is ignored.  So is everything from the
+ * first malformed record onwards, for instance where a crash left the end of
+ * the file filled with zeros.
+ *
+ * The journal remembers what it last wrote as an image of each entry, so it
+ * can work out what has changed without being told.  Entries that have been
+ * added or modified are written out, as are the smallest set of entries that
+ * must be moved to get from the old order to the new one (i.e. the complement
+ * of a longest increasing subsequence).
+ *
+ * Appending does not wait for the data to reach the disk; the caller decides
+ * how often to do that with queue_journal_sync().
+ */
+#include "common.h"
+
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "mem.h"
+#include "queue.h"
+#include "queue-journal.h"
+#include "log.h"
+#include "hash.h"
+#include "vector.h"
+#include "printf.h"
+#include "inputline.h"
+#include "syscalls.h"
+
+/** @brief Minimum journal size before compaction */
+#define QUEUE_JOURNAL_MIN 65536
+
+/** @brief How many times to reread if a compaction races with a read */
+#define QUEUE_JOURNAL_RETRIES 4
+
+/** @brief What the journal last recorded about an entry */
+struct queue_image {
+  /** @brief Copy of entry (@c next and @c prev are not meaningful) */
+  struct queue_entry q;
+
+  /** @brief Position in last recorded order */
+  int pos;
+
+  /** @brief Generation in which this entry was last seen */
+  unsigned long seen;
+};
+
+/** @brief A journalled queue file */
+struct queue_journal {
+  /** @brief Path to snapshot */
+  const char *path;
+
+  /** @brief Path to journal */
+  const char *jpath;
+
+  /** @brief Journal file descriptor or -1 */
+  int fd;
+
+  /** @brief Current generation */
+  unsigned long gen;
+
+  /** @brief Size of snapshot */
+  off_t snapshot_bytes;
+
+  /** @brief Size of journal */
+  off_t journal_bytes;
+
+  /** @brief Nonzero if records have been appended but not synced */
+  int dirty;
+
+  /** @brief Map of IDs to @ref queue_image pointers */
+  hash *images;
+
+  /** @brief Images in last recorded order */
+  struct queue_image **order;
+
+  /** @brief Number of entries in @ref order */
+  int norder;
+
+  /** @brief Size of @ref order and of the scratch arrays below */
+  int nslots;
+
+  /** @brief New order, under construction */
+  struct queue_image **next_order;
+
+  /** @brief Entries in new order */
+  const struct queue_entry **entries;
+
+  /** @brief Old positions of surviving entries, in new order */
+  int *pos;
+
+  /** @brief Scratch space for queue_journal_lis() */
+  int *tails;
+
+  /** @brief Scratch space for queue_journal_lis() */
+  int *prev;
+
+  /** @brief Which surviving entries need not be written */
+  char *keep;
+
+  /** @brief Counter for @ref queue_image::seen */
+  unsigned long pass;
+};
+
+static void queue_journal_error(const char *msg,
+                                void *u) {
+  disorder_fatal(0, "error parsing queue %s: %s", (const char *)u, msg);
+}
+
+/** @brief Make room for at least @p n entries */
+static void queue_journal_reserve(struct queue_journal *j, int n) {
+  if(n <= j->nslots)
+    return;
+  j->nslots = n > 2 * j->nslots ? n : 2 * j->nslots;
+  j->order = xrealloc(j->order, j->nslots * sizeof *j->order);
+  j->next_order = xrealloc(j->next_order, j->nslots * sizeof *j->next_order);
+  j->entries = xrealloc(j->entries, j->nslots * sizeof *j->entries);
+  j->pos = xrealloc_noptr(j->pos, j->nslots * sizeof *j->pos);
+  j->tails = xrealloc_noptr(j->tails, j->nslots * sizeof *j->tails);
+  j->prev = xrealloc_noptr(j->prev, j->nslots * sizeof *j->prev);
+  j->keep = xrealloc_noptr(j->keep, j->nslots);
+}
+
+struct queue_journal *queue_journal_new(const char *path) {
+  struct queue_journal *j = xmalloc(sizeof *j);
+
+  j->path = xstrdup(path);
+  byte_xasprintf((char **)&j->jpath, "%s.journal", path);
+  j->fd = -1;
+  j->images = hash_new(sizeof (struct queue_image *));
+  queue_journal_reserve(j, 16);
+  return j;
+}
+
+/** @brief Forget all images and record the current state of @p head */
+static void queue_journal_reset_images(struct queue_journal *j,
+                                       const struct queue_entry *head) {
+  const struct queue_entry *q;
+  struct queue_image *im;
+  int n = 0;
+
+  j->images = hash_new(sizeof (struct queue_image *));
+  for(q = head->next; q != head; q = q->next)
+    ++n;
+  queue_journal_reserve(j, n);
+  j->norder = n;
+  n = 0;
+  for(q = head->next; q != head; q = q->next) {
+    im = xmalloc(sizeof *im);
+    im->q = *q;
+    im->pos = n;
+    j->order[n++] = im;
+    hash_add(j->images, q->id, &im, HASH_INSERT_OR_REPLACE);
+  }
+}
+
+/** @brief Read a snapshot into @p head
+ * @return Generation of snapshot, or 0 if there isn't one
+ */
+static unsigned long queue_journal_read_snapshot(struct queue_journal *j,
+                                                 struct queue_entry *head) {
+  char *buffer;
+  FILE *fp;
+  struct queue_entry *q;
+  int ver = 0;
+  unsigned long gen = 0;
+
+  head->next = head->prev = head;
+  j->snapshot_bytes = 0;
+  if(!(fp = fopen(j->path, "r"))) {
+    if(errno == ENOENT)
+      return 0;			/* no queue */
+    disorder_fatal(errno, "error opening %s", j->path);
+  }
+  while(!inputline(j->path, fp, &buffer, '\n')) {
+    j->snapshot_bytes += strlen(buffer) + 1;
+    if(buffer[0] == '#') {
+      /* Version indicator and generation */
+      ver = atoi(buffer + 1);
+      if(sscanf(buffer + 1, "%*d %lu", &gen) != 1)
+        gen = 0;
+      continue;
+    }
+    q = xmalloc(sizeof *q);
+    queue_unmarshall(q, buffer, queue_journal_error, (void *)j->path);
+    if(ver < 1) {
+      /* Fix up origin field as best we can; will be wrong in some cases but
+       * hopefully not too horribly so. */
+      q->origin = q->submitter ? origin_picked : origin_random;
+      /* Eliminated obsolete states, since they are assumed elsewhere not to be
+       * set. */
+      switch(q->state) {
+      case playing_isscratch:
+        q->origin = origin_scratch;
+        q->state = playing_unplayed;
+        break;
+      case playing_random:
+        q->state = playing_unplayed;
+        break;
+      default:
+        break;
+      }
+    }
+    queue_insert_entry(head->prev, q);
+  }
+  if(ferror(fp))
+    disorder_fatal(errno, "error reading %s", j->path);
+  fclose(fp);
+  return gen;
+}
+
+/** @brief Read the whole journal
+ * @param j Journal
+ * @param d Where to store contents
+ * @return 0 on success, -1 if there is no journal
+ */
+static int queue_journal_slurp(struct queue_journal *j, struct dynstr *d) {
+  char buffer[65536];
+  ssize_t n;
+  int fd;
+
+  dynstr_init(d);
+  if((fd = open(j->jpath, O_RDONLY)) < 0) {
+    if(errno == ENOENT)
+      return -1;
+    disorder_fatal(errno, "error opening %s", j->jpath);
+  }
+  while((n = read(fd, buffer, sizeof buffer)) != 0) {
+    if(n < 0) {
+      if(errno == EINTR)
+        continue;
+      disorder_fatal(errno, "error reading %s", j->jpath);
+    }
+    dynstr_append_bytes(d, buffer, n);
+  }
+  xclose(fd);
+  return 0;
+}
+
+/** @brief Report a malformed journal record
+ * @param msg Error message
+ * @param u Journal path
+ */
+static void queue_journal_record_error(const char *msg,
+                                       void *u) {
+  disorder_error(0, "error parsing queue %s: %s", (const char *)u, msg);
+}
+
+/** @brief Apply one journal record
+ * @param j Journal
+ * @param head List to modify
+ * @param ids Map of IDs to entries in @p head
+ * @param line Record (without newline)
+ * @return 0 on success, -1 if the record is malformed
+ *
+ * A malformed record is reported and leaves @p head unchanged.
+ */
+static int queue_journal_apply(struct queue_journal *j,
+                               struct queue_entry *head,
+                               hash *ids,
+                               char *line) {
+  struct queue_entry *q, **qq, *after = head;
+  char *s;
+
+  if(line[0] == '-' && line[1] == ' ') {
+    if((qq = hash_find(ids, line + 2))) {
+      queue_delete_entry(*qq);
+      hash_remove(ids, line + 2);
+    }
+    return 0;
+  }
+  if(line[0] != '+' || line[1] != ' ' || !(s = strchr(line + 2, ' '))) {
+    queue_journal_record_error("invalid record", (void *)j->jpath);
+    return -1;
+  }
+  *s++ = 0;
+  q = xmalloc(sizeof *q);
+  if(queue_unmarshall(q, s, queue_journal_record_error, (void *)j->jpath))
+    return -1;
+  if(!q->id) {
+    queue_journal_record_error("record has no ID", (void *)j->jpath);
+    return -1;
+  }
+  if(strcmp(line + 2, "-")) {
+    if(!(qq = hash_find(ids, line + 2))) {
+      disorder_error(0, "error parsing queue %s: unknown ID %s",
+                     j->jpath, line + 2);
+      return -1;
+    }
+    after = *qq;
+  }
+  if((qq = hash_find(ids, q->id))) {
+    if(*qq == after)
+      after = after->prev;
+    queue_delete_entry(*qq);
+  }
+  queue_insert_entry(after, q);
+  hash_add(ids, q->id, &q, HASH_INSERT_OR_REPLACE);
+  return 0;
+}
+
+/** @brief Replay journal contents into @p head
+ * @param j Journal
+ * @param head List to modify
+ * @param d Journal contents, including header
+ *
+ * Replay stops at the first malformed record, as might be left by a crash
+ * part way through writing.  Whatever follows it is discarded when the next
+ * snapshot is written.
+ */
+static void queue_journal_replay(struct queue_journal *j,
+                                 struct queue_entry *head,
+                                 struct dynstr *d) {
+  hash *ids = hash_new(sizeof (struct queue_entry *));
+  struct queue_entry *q;
+  char *line = d->vec, *nl, *end = d->vec + d->nvec;
+
+  for(q = head->next; q != head; q = q->next)
+    hash_add(ids, q->id, &q, HASH_INSERT_OR_REPLACE);
+  /* Skip header */
+  line = (char *)memchr(line, '\n', end - line) + 1;
+  while(line < end && (nl = memchr(line, '\n', end - line))) {
+    *nl = 0;
+    if(queue_journal_apply(j, head, ids, line)) {
+      disorder_error(0, "%s: ignoring records from offset %ld",
+                     j->jpath, (long)(line - d->vec));
+      end = line;
+      break;
+    }
+    line = nl + 1;
+  }
+  if(line < end)
+    disorder_error(0, "%s: ignoring incomplete final record", j->jpath);
+  j->journal_bytes = line - d->vec;
+}
+
+void queue_journal_read(struct queue_journal *j, struct queue_entry *head) {
+  struct dynstr d[1];
+  unsigned long jgen;
+  int tries = 0;
+  const int indexed = head->index != NULL;
+
+  for(;;) {
+    head->index = NULL;
+    j->gen = queue_journal_read_snapshot(j, head);
+    j->journal_bytes = 0;
+    if(queue_journal_slurp(j, d)
+       || !memchr(d->vec, '\n', d->nvec)
+       || sscanf(d->vec, "#%*d %lu", &jgen) != 1)
+      break;                            /* no usable journal */
+    if(jgen == j->gen) {
+      queue_journal_replay(j, head, d);
+      break;
+    }
+    /* A journal newer than the snapshot means we raced with a compaction and
+     * should try again.  Anything else is left over from a compaction that
+     * was interrupted and is redundant. */
+    if(jgen < j->gen || ++tries > QUEUE_JOURNAL_RETRIES)
+      break;
+  }
+  if(indexed)
+    queue_index_list(head);
+  queue_journal_reset_images(j, head);
+}
+
+/** @brief Write all of @p n bytes at @p ptr to @p fd */
+static void queue_journal_writeall(const char *path, int fd,
+                                   const char *ptr, size_t n) {
+  ssize_t written;
+
+  while(n > 0) {
+    if((written = write(fd, ptr, n)) < 0) {
+      if(errno == EINTR)
+        continue;
+      disorder_fatal(errno, "error writing %s", path);
+    }
+    ptr += written;
+    n -= written;
+  }
+}
+
+void queue_journal_compact(struct queue_journal *j,
+                           const struct queue_entry *head) {
+  char *tmp;
+  FILE *fp;
+  const struct queue_entry *q;
+  int fd;
+  struct timespec started, finished;
+
+  xgettime(CLOCK_MONOTONIC, &started);
+  /* Write the new snapshot */
+  byte_xasprintf(&tmp, "%s.new", j->path);
+  if(!(fp = fopen(tmp, "w"))) disorder_fatal(errno, "error opening %s", tmp);
+  if(fprintf(fp, "#1 %lu\n", j->gen + 1) < 0)
+    disorder_fatal(errno, "error writing %s", tmp);
+  for(q = head->next; q != head; q = q->next)
+    if(fprintf(fp, "%s\n", queue_marshall(q)) < 0)
+      disorder_fatal(errno, "error writing %s", tmp);
+  if(fflush(fp) < 0) disorder_fatal(errno, "error writing %s", tmp);
+  if(fsync(fileno(fp)) < 0) disorder_fatal(errno, "error syncing %s", tmp);
+  j->snapshot_bytes = ftell(fp);
+  if(fclose(fp) < 0) disorder_fatal(errno, "error closing %s", tmp);
+  if(rename(tmp, j->path) < 0)
+    disorder_fatal(errno, "error replacing %s", j->path);
+  ++j->gen;
+  /* Start a new journal to go with it */
+  byte_xasprintf(&tmp, "%s.new", j->jpath);
+  if((fd = open(tmp, O_WRONLY|O_CREAT|O_TRUNC|O_APPEND, 0666)) < 0)
+    disorder_fatal(errno, "error opening %s", tmp);
+  cloexec(fd);
+  byte_xasprintf(&tmp, "#1 %lu\n", j->gen);
+  queue_journal_writeall(j->jpath, fd, tmp, strlen(tmp));
+  if(fsync(fd) < 0) disorder_fatal(errno, "error syncing %s", j->jpath);
+  byte_xasprintf(&tmp, "%s.new", j->jpath);
+  if(rename(tmp, j->jpath) < 0)
+    disorder_fatal(errno, "error replacing %s", j->jpath);
+  if(j->fd >= 0)
+    xclose(j->fd);
+  j->fd = fd;
+  j->journal_bytes = 0;
+  j->dirty = 0;
+  queue_journal_reset_images(j, head);
+  xgettime(CLOCK_MONOTONIC, &finished);
+  D(("compacted %s (%ld bytes) in %ldus", j->path, (long)j->snapshot_bytes,
+     (long)((finished.tv_sec - started.tv_sec) * 1000000
+            + (finished.tv_nsec - started.tv_nsec) / 1000)));
+}
+
+/** @brief Find entries that need not move
+ * @param j Journal (for scratch space)
+ * @param n Number of entries in @c j->pos
+ *
+ * Sets @c j->keep[i] nonzero for entries that are part of a longest
+ * increasing subsequence of @c j->pos.
+ */
+static void queue_journal_lis(struct queue_journal *j, int n) {
+  const int *pos = j->pos;
+  int *tails = j->tails, *prev = j->prev;
+  int len = 0, lo, hi, mid, i, k;
+
+  for(i = 0; i < n; ++i) {
+    /* Find the first tail with position >= pos[i] */
+    lo = 0;
+    hi = len;
+    while(lo < hi) {
+      mid = (lo + hi) / 2;
+      if(pos[tails[mid]] < pos[i])
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    prev[i] = lo ? tails[lo - 1] : -1;
+    tails[lo] = i;
+    if(lo == len)
+      ++len;
+  }
+  memset(j->keep, 0, n);
+  for(k = len ? tails[len - 1] : -1; k >= 0; k = prev[k])
+    j->keep[k] = 1;
+}
+
+void queue_journal_write(struct queue_journal *j,
+                         const struct queue_entry *head) {
+  const struct queue_entry *q;
+  struct queue_image **imp, *im, **order;
+  struct dynstr d[1];
+  int n = 0, nsurvivors = 0, i;
+  char *s;
+  struct timespec started, finished;
+
+  if(j->fd < 0) {
+    /* Nothing open yet, so start from a fresh snapshot */
+    queue_journal_compact(j, head);
+    return;
+  }
+  xgettime(CLOCK_MONOTONIC, &started);
+  ++j->pass;
+  /* Match up entries with their images and find the old positions of those
+   * that were already present */
+  for(q = head->next; q != head; q = q->next) {
+    if(n >= j->nslots)
+      queue_journal_reserve(j, n + 1);
+    j->entries[n] = q;
+    if((imp = hash_find(j->images, q->id))) {
+      im = *imp;
+      im->seen = j->pass;
+      j->pos[nsurvivors++] = im->pos;
+    } else
+      im = NULL;
+    j->next_order[n++] = im;
+  }
+  queue_journal_lis(j, nsurvivors);
+  dynstr_init(d);
+  /* Anything not seen has been removed */
+  for(i = 0; i < j->norder; ++i)
+    if(j->order[i]->seen != j->pass) {
+      dynstr_append_string(d, "- ");
+      dynstr_append_string(d, j->order[i]->q.id);
+      dynstr_append(d, '\n');
+      hash_remove(j->images, j->order[i]->q.id);
+    }
+  /* Anything new, changed or out of order must be (re-)written */
+  nsurvivors = 0;
+  for(i = 0; i < n; ++i) {
+    q = j->entries[i];
+    if((im = j->next_order[i])) {
+      if(j->keep[nsurvivors++] && !queue_compare(&im->q, q)) {
+        im->pos = i;
+        continue;
+      }
+    } else {
+      im = j->next_order[i] = xmalloc(sizeof *im);
+      hash_add(j->images, q->id, &im, HASH_INSERT);
+    }
+    im->q = *q;
+    im->pos = i;
+    dynstr_append_string(d, "+ ");
+    dynstr_append_string(d, q->prev == head ? "-" : q->prev->id);
+    s = queue_marshall(q);
+    dynstr_append_bytes(d, s, strlen(s));
+    dynstr_append(d, '\n');
+  }
+  order = j->order;
+  j->order = j->next_order;
+  j->next_order = order;
+  j->norder = n;
+  if(d->nvec) {
+    queue_journal_writeall(j->jpath, j->fd, d->vec, d->nvec);
+    j->journal_bytes += d->nvec;
+    j->dirty = 1;
+  }
+  xgettime(CLOCK_MONOTONIC, &finished);
+  D(("journalled %d bytes to %s in %ldus", d->nvec, j->jpath,
+     (long)((finished.tv_sec - started.tv_sec) * 1000000
+            + (finished.tv_nsec - started.tv_nsec) / 1000)));
+  if(j->journal_bytes > QUEUE_JOURNAL_MIN
+     && j->journal_bytes > j->snapshot_bytes)
+    queue_journal_compact(j, head);
+}
+
+void queue_journal_sync(struct queue_journal *j) {
+  if(j->fd >= 0 && j->dirty) {
+    if(fsync(j->fd) < 0) disorder_fatal(errno, "error syncing %s", j->jpath);
+    j->dirty = 0;
+  }
+}
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
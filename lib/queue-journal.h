@@ -0,0 +1,54 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file lib/queue-journal.h
+ * @brief Journalled queue persistence
+ */
+#ifndef QUEUE_JOURNAL_H
+#define QUEUE_JOURNAL_H
+
+#include "queue.h"
+
+struct queue_journal;
+
+struct queue_journal *queue_journal_new(const char *path);
+/* Create a journal for the queue file @path@.  Nothing is opened yet. */
+
+void queue_journal_read(struct queue_journal *j, struct queue_entry *head);
+/* Read the snapshot and replay the journal into the list at @head@. */
+
+void queue_journal_write(struct queue_journal *j,
+                         const struct queue_entry *head);
+/* Append whatever has changed in @head@ since the last read or write. */
+
+void queue_journal_compact(struct queue_journal *j,
+                           const struct queue_entry *head);
+/* Write a new snapshot of @head@ and start an empty journal. */
+
+void queue_journal_sync(struct queue_journal *j);
+/* Flush any unsynced journal records to disk. */
+
+#endif /* QUEUE_JOURNAL_H */
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2004-2009, 2011, 2013 Richard Kettlewell
+ * Copyright (C) 2004-2009, 2011, 2013, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -31,6 +31,7 @@
 #include "table.h"
 #include "printf.h"
 #include "vector.h"
+#include "hash.h"
 
 const char *const playing_states[] = {
   "failed",
@@ -56,6 +57,52 @@ const char *const track_origins[] = {
 
 #define VALUE(q, offset, type) *(type *)((char *)q + offset)
 
+/** @brief Index of a list of queue entries
+ *
+ * See queue_index_list().
+ */
+struct queue_index {
+  /** @brief Map of IDs to entries */
+  hash *ids;
+
+  /** @brief Map of tracks to number of entries */
+  hash *tracks;
+
+  /** @brief Number of entries */
+  long length;
+};
+
+/** @brief Add @p q to @p index */
+static void queue_index_add(struct queue_index *index,
+                            struct queue_entry *q) {
+  long *countp, one = 1;
+
+  if(q->id)
+    hash_add(index->ids, q->id, &q, HASH_INSERT_OR_REPLACE);
+  if(q->track) {
+    if((countp = hash_find(index->tracks, q->track)))
+      ++*countp;
+    else
+      hash_add(index->tracks, q->track, &one, HASH_INSERT);
+  }
+  ++index->length;
+  q->index = index;
+}
+
+/** @brief Remove @p q from @p index */
+static void queue_index_remove(struct queue_index *index,
+                               struct queue_entry *q) {
+  long *countp;
+
+  if(q->id)
+    hash_remove(index->ids, q->id);
+  if(q->track && (countp = hash_find(index->tracks, q->track))
+     && !--*countp)
+    hash_remove(index->tracks, q->track);
+  --index->length;
+  q->index = NULL;
+}
+
 /** @brief Insert queue entry @p n just after @p b
  * @param b Insert after this entry
  * @param n New entry to insert
@@ -65,12 +112,75 @@ void queue_insert_entry(struct queue_entry *b, struct queue_entry *n) {
   n->next = b->next;
   n->next->prev = n;
   n->prev->next = n;
+  if(b->index)
+    queue_index_add(b->index, n);
+  else
+    n->index = NULL;
 }
 
 /* remove an entry from a doubly-linked list */
 void queue_delete_entry(struct queue_entry *node) {
   node->next->prev = node->prev;
   node->prev->next = node->next;
+  if(node->index)
+    queue_index_remove(node->index, node);
+}
+
+/** @brief Index a list of queue entries
+ * @param head Head of list
+ *
+ * After this call, the list can be searched by ID with queue_index_find() and
+ * by track with queue_index_track().  The index is kept up to date by
+ * queue_insert_entry() and queue_delete_entry(), so all changes to which
+ * entries are in the list must go through those functions (reordering it
+ * directly is fine).  The @c id and @c track fields of an entry must not be
+ * changed while it is in the list.
+ *
+ * Calling this function again discards the old index and builds a new one.
+ */
+void queue_index_list(struct queue_entry *head) {
+  struct queue_index *index = xmalloc(sizeof *index);
+  struct queue_entry *q;
+
+  index->ids = hash_new(sizeof (struct queue_entry *));
+  index->tracks = hash_new(sizeof (long));
+  for(q = head->next; q != head; q = q->next)
+    queue_index_add(index, q);
+  head->index = index;
+}
+
+/** @brief Find an entry by ID
+ * @param head Head of indexed list
+ * @param id ID to find
+ * @return Entry with ID @p id, or NULL
+ */
+struct queue_entry *queue_index_find(const struct queue_entry *head,
+                                     const char *id) {
+  struct queue_entry **qq;
+
+  assert(head->index != NULL);
+  return (qq = hash_find(head->index->ids, id)) ? *qq : NULL;
+}
+
+/** @brief Count entries for a track
+ * @param head Head of indexed list
+ * @param track Track to look for
+ * @return Number of entries for @p track
+ */
+long queue_index_track(const struct queue_entry *head, const char *track) {
+  long *countp;
+
+  assert(head->index != NULL);
+  return (countp = hash_find(head->index->tracks, track)) ? *countp : 0;
+}
+
+/** @brief Return the length of a list
+ * @param head Head of indexed list
+ * @return Number of entries in the list
+ */
+long queue_index_length(const struct queue_entry *head) {
+  assert(head->index != NULL);
+  return head->index->length;
 }
 
 static int unmarshall_long(char *data, struct queue_entry *q,
@@ -194,7 +304,7 @@ static const char *marshall_origin(const struct queue_entry *q, size_t offset) {
 #define free_state free_none
 #define free_origin free_none
 
-#define F(n, h) { #n, offsetof(struct queue_entry, n), marshall_##h, unmarshall_##h, free_##h }
+#define F(n, h) { #n, offsetof(struct queue_entry, n), sizeof ((struct queue_entry *)0)->n, marshall_##h, unmarshall_##h, free_##h }
 
 /** @brief A field in a @ref queue_entry */
 static const struct queue_field {
@@ -204,6 +314,9 @@ static const struct queue_field {
   /** @brief Offset of value in @ref queue_entry structure */
   size_t offset;
 
+  /** @brief Size of value in @ref queue_entry structure */
+  size_t size;
+
   /** @brief Marshaling function */
   const char *(*marshall)(const struct queue_entry *q, size_t offset);
 
@@ -253,7 +366,7 @@ int queue_unmarshall_vec(struct queue_entry *q, int nvec, char **vec,
     error_handler("invalid marshalled queue format", u);
     return -1;
   }
-  while(*vec) {
+  for(; nvec > 0; nvec -= 2, vec += 2) {
     D(("key %s value %s", vec[0], vec[1]));
     if((n = TABLE_FIND(fields, name, *vec)) < 0) {
       error_handler("unknown key in queue data", u);
@@ -262,7 +375,6 @@ int queue_unmarshall_vec(struct queue_entry *q, int nvec, char **vec,
       if(fields[n].unmarshall(vec[1], q, fields[n].offset, error_handler, u))
 	return -1;
     }
-    vec += 2;
   }
   return 0;
 }
@@ -290,6 +402,55 @@ char *queue_marshall(const struct queue_entry *q) {
   return r;
 }
 
+/** @brief Visit the marshalled fields of a queue entry
+ * @param q Queue entry
+ * @param callback Called with the name and value of each field
+ * @param u Passed to @p callback
+ *
+ * The fields are the ones queue_marshall() would include, in the same order,
+ * but unquoted.
+ */
+void queue_marshall_fields(const struct queue_entry *q,
+                           void (*callback)(const char *name,
+                                            const char *value,
+                                            void *u),
+                           void *u) {
+  unsigned n;
+  const char *v;
+
+  for(n = 0; n < NFIELDS; ++n)
+    if((v = fields[n].marshall(q, fields[n].offset)))
+      callback(fields[n].name, v, u);
+}
+
+/** @brief Compare the marshalled fields of two queue entries
+ * @param a First entry
+ * @param b Second entry
+ * @return 0 if they would marshall identically, nonzero otherwise
+ *
+ * @c expected is ignored, since it is a transient estimate recomputed every
+ * time the queue is listed.
+ */
+int queue_compare(const struct queue_entry *a, const struct queue_entry *b) {
+  unsigned n;
+  const char *sa, *sb;
+
+  for(n = 0; n < NFIELDS; ++n) {
+    if(fields[n].offset == offsetof(struct queue_entry, expected))
+      continue;
+    if(fields[n].marshall == marshall_string) {
+      sa = VALUE(a, fields[n].offset, const char *);
+      sb = VALUE(b, fields[n].offset, const char *);
+      if(sa != sb && (!sa || !sb || strcmp(sa, sb)))
+        return 1;
+    } else if(memcmp((const char *)a + fields[n].offset,
+                     (const char *)b + fields[n].offset,
+                     fields[n].size))
+      return 1;
+  }
+  return 0;
+}
+
 void queue_free(struct queue_entry *q, int rest) {
   unsigned n;
   if(!q)
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2004-2009 Richard Kettlewell
+ * Copyright (C) 2004-2009, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -217,6 +217,12 @@ struct queue_entry {
 
   /** @brief Owning queue (for Disobedience only) */
   struct queuelike *ql;
+
+  /** @brief Index of the list containing this entry, or NULL
+   *
+   * Maintained by queue_insert_entry() and queue_delete_entry() for lists
+   * that have been passed to queue_index_list(). */
+  struct queue_index *index;
   
   /** @brief Decoder (or player) process ID */
   pid_t pid;
@@ -231,6 +237,19 @@ struct queue_entry {
 void queue_insert_entry(struct queue_entry *b, struct queue_entry *n);
 void queue_delete_entry(struct queue_entry *node);
 
+void queue_index_list(struct queue_entry *head);
+/* index the list at @head@ by ID and track */
+
+struct queue_entry *queue_index_find(const struct queue_entry *head,
+                                     const char *id);
+/* return the entry in indexed list @head@ with ID @id@, or NULL */
+
+long queue_index_track(const struct queue_entry *head, const char *track);
+/* return how many entries in indexed list @head@ are for @track@ */
+
+long queue_index_length(const struct queue_entry *head);
+/* return the length of indexed list @head@ */
+
 int queue_unmarshall(struct queue_entry *q, const char *s,
 		     void (*error_handler)(const char *, void *),
 		     void *u);
@@ -244,6 +263,16 @@ int queue_unmarshall_vec(struct queue_entry *q, int nvec, char **vec,
 char *queue_marshall(const struct queue_entry *q);
 /* marshall @q@ into a UTF-8 string */
 
+void queue_marshall_fields(const struct queue_entry *q,
+                           void (*callback)(const char *name,
+                                            const char *value,
+                                            void *u),
+                           void *u);
+/* call @callback@ with each field name and unquoted value of @q@ */
+
+int queue_compare(const struct queue_entry *a, const struct queue_entry *b);
+/* compare the marshalled fields of @a@ and @b@, ignoring @expected@ */
+
 void queue_free(struct queue_entry *q, int rest);
 
 #endif /* QUEUE_H */
@@ -1,6 +1,7 @@
 /*
  * This file is part of DisOrder
  * Copyright (C) 2017 Mark Wooding
+ * Copyright (C) 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -25,6 +26,8 @@
 
 #ifdef HAVE_LIBPCRE2
 
+#include "log.h"
+
 static pcre2_general_context *genctx = 0;
 static pcre2_compile_context *compctx = 0;
 
@@ -59,19 +62,32 @@ regexp *regexp_compile(const char *pat, unsigned f,
   return re;
 }
 
+void regexp_jit(regexp *re)
+{
+  /* Failure (e.g. no JIT support) just means matching is interpreted */
+  pcre2_jit_compile(re, PCRE2_JIT_COMPLETE);
+}
+
 int regexp_match(const regexp *re, const char *s, size_t n, unsigned f,
 		 size_t *ov, size_t on)
 {
+  /* Kept between calls, since callers use the same size every time.  It
+   * belongs to the calling thread, since some programs use regexps from more
+   * than one.  It comes from malloc() rather than the garbage-collected heap,
+   * which the collector need not scan thread-local storage for. */
+  static __thread pcre2_match_data *m;
   int rc;
-  pcre2_match_data *m;
   PCRE2_SIZE *ovp;
   size_t i;
 
-  m = pcre2_match_data_create(on, genctx);
+  if(!m || pcre2_get_ovector_count(m) != on) {
+    if(m) pcre2_match_data_free(m);
+    if(!(m = pcre2_match_data_create(on, 0)))
+      disorder_fatal(0, "pcre2_match_data_create failed");
+  }
   rc = pcre2_match(re, (PCRE2_SPTR)s, n, 0, f, m, 0);
   ovp = pcre2_get_ovector_pointer(m);
   for(i = 0; i < on; i++) ov[i] = ovp[i];
-  pcre2_match_data_free(m);
   return rc;
 }
 
@@ -104,6 +120,11 @@ regexp *regexp_compile(const char *pat, unsigned f,
   return re;
 }
 
+void regexp_jit(regexp attribute((unused)) *re)
+{
+  /* pcre_exec() is called without study data, so there's nothing to do */
+}
+
 int regexp_match(const regexp *re, const char *s, size_t n, unsigned f,
 		 size_t *ov, size_t on)
 {
@@ -44,6 +44,8 @@ void regexp_setup(void);
 regexp *regexp_compile(const char *pat, unsigned f,
 		       char *errbuf, size_t errlen, size_t *erroff_out);
 
+void regexp_jit(regexp *re);
+
 int regexp_match(const regexp *re, const char *s, size_t n, unsigned f,
 		 size_t *ov, size_t on);
 
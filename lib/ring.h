@@ -0,0 +1,139 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file lib/ring.h @brief Single-producer single-consumer ring template */
+
+#ifndef RING_H
+#define RING_H
+
+#include "mem.h"
+
+/** @brief Single-producer single-consumer ring template
+ * @param NAME name of type to define
+ * @param ETYPE element type
+ *
+ * Defines a bounded FIFO called @c struct @p NAME with element type @p ETYPE.
+ * Exactly one thread may add elements and exactly one (possibly different)
+ * thread may remove them.  Neither needs a lock: the two indexes are each
+ * written by only one side and are published with release/acquire ordering.
+ *
+ * The functions defined are:
+ * - NAME_init(r, size) which initializes an empty ring with room for @p size
+ *   elements, which must be a power of 2
+ * - NAME_count(r) which returns the number of elements in the ring
+ * - NAME_put(r, e) which adds @p e to the ring, returning 0 on success or -1
+ *   if it is full (producer only)
+ * - NAME_get(r, ep) which removes the oldest element into @p *ep, returning 0
+ *   on success or -1 if the ring is empty (consumer only)
+ * - NAME_peek(r) which returns a pointer to the oldest element without
+ *   removing it, or NULL if the ring is empty (consumer only)
+ * - NAME_drop(r) which removes the oldest element, which must exist
+ *   (consumer only)
+ *
+ * NAME_peek() and NAME_drop() allow the consumer to go on using an element
+ * in place, with the producer being unable to reuse its slot until it has
+ * been dropped.
+ *
+ * The indexes increase without bound (modulo wraparound) and are reduced to
+ * array positions by masking, so a full ring is distinguishable from an empty
+ * one without wasting a slot.
+ *
+ * Waiting for the ring to become non-empty or non-full is left to the caller,
+ * which can use ring_fence() to avoid lost wakeups; see clients/playrtp.c for
+ * an example.
+ */
+#define RING_TYPE(NAME, ETYPE)                                          \
+  typedef ETYPE NAME##_element;                                         \
+                                                                        \
+  struct NAME {                                                         \
+    /** @brief Elements */                                              \
+    NAME##_element *vec;                                                \
+    /** @brief Size of @p vec minus 1 */                                \
+    size_t mask;                                                        \
+    /** @brief Index of next element to remove */                       \
+    size_t head;                                                        \
+    /** @brief Keep @p head and @p tail on separate cache lines */      \
+    char pad[64];                                                       \
+    /** @brief Index of next element to add */                          \
+    size_t tail;                                                        \
+  };                                                                    \
+                                                                        \
+  static inline void NAME##_init(struct NAME *r, size_t size) {         \
+    assert(size && !(size & (size - 1)) && "_init");                    \
+    r->vec = xcalloc(size, sizeof *r->vec);                             \
+    r->mask = size - 1;                                                 \
+    r->head = r->tail = 0;                                              \
+  }                                                                     \
+                                                                        \
+  static inline size_t NAME##_count(struct NAME *r) {                   \
+    return __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE)                  \
+      - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);                    \
+  }                                                                     \
+                                                                        \
+  static inline int NAME##_put(struct NAME *r, NAME##_element e) {      \
+    const size_t t = __atomic_load_n(&r->tail, __ATOMIC_RELAXED);       \
+    if(t - __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) > r->mask)       \
+      return -1;                                                        \
+    r->vec[t & r->mask] = e;                                            \
+    __atomic_store_n(&r->tail, t + 1, __ATOMIC_RELEASE);                \
+    return 0;                                                           \
+  }                                                                     \
+                                                                        \
+  static inline int NAME##_get(struct NAME *r, NAME##_element *ep) {    \
+    const size_t h = __atomic_load_n(&r->head, __ATOMIC_RELAXED);       \
+    if(h == __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE))                \
+      return -1;                                                        \
+    *ep = r->vec[h & r->mask];                                          \
+    __atomic_store_n(&r->head, h + 1, __ATOMIC_RELEASE);                \
+    return 0;                                                           \
+  }                                                                     \
+                                                                        \
+  static inline NAME##_element *NAME##_peek(struct NAME *r) {           \
+    const size_t h = __atomic_load_n(&r->head, __ATOMIC_RELAXED);       \
+    if(h == __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE))                \
+      return NULL;                                                      \
+    return &r->vec[h & r->mask];                                        \
+  }                                                                     \
+                                                                        \
+  static inline void NAME##_drop(struct NAME *r) {                      \
+    const size_t h = __atomic_load_n(&r->head, __ATOMIC_RELAXED);       \
+    __atomic_store_n(&r->head, h + 1, __ATOMIC_RELEASE);                \
+  }                                                                     \
+                                                                        \
+  struct ring_swallow_semicolon
+
+/** @brief Full memory barrier
+ *
+ * A thread about to sleep waiting for a ring must set a flag saying so, call
+ * this, and then check the ring again.  The thread updating the ring must
+ * update it, call this, and then check the flag.  At least one of them will
+ * then see the other's change.
+ */
+static inline void ring_fence(void) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+#endif /* RING_H */
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
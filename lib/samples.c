@@ -0,0 +1,234 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file lib/samples.c
+ * @brief Bulk operations on sample buffers
+ *
+ * These are the per-sample loops that run for every packet on the RTP paths:
+ * byte-swapping 16-bit samples between host and network order, and spotting
+ * packets that are entirely silent.
+ *
+ * Where the compiler supports it (see @c HAVE_X86_SIMD) there are SSE2 and
+ * AVX2 versions alongside the portable ones.  The best one the CPU supports is
+ * picked the first time any of them is called.  Buffers need not be aligned.
+ */
+
+#include "common.h"
+
+#include "samples.h"
+
+#if HAVE_X86_SIMD
+# include <immintrin.h>
+#endif
+
+/** @brief Implementation in use, or -1 if not yet chosen */
+static int samples_isa = -1;
+
+/** @brief Return the implementation to use */
+static inline enum samples_isa samples__isa(void) {
+  const int isa = __atomic_load_n(&samples_isa, __ATOMIC_RELAXED);
+
+  return isa >= 0 ? (enum samples_isa)isa : samples_get_isa();
+}
+
+/* Portable versions -------------------------------------------------------- */
+
+static void samples_swap16_scalar(uint8_t *dst, const uint8_t *src, size_t n) {
+  while(n > 0) {
+    const uint8_t t = src[0];
+    dst[0] = src[1];
+    dst[1] = t;
+    dst += 2;
+    src += 2;
+    --n;
+  }
+}
+
+static int samples_zero_scalar(const uint8_t *ptr, size_t nbytes) {
+  uint64_t w;
+
+  for(; nbytes >= sizeof w; nbytes -= sizeof w, ptr += sizeof w) {
+    memcpy(&w, ptr, sizeof w);
+    if(w)
+      return 0;
+  }
+  while(nbytes > 0) {
+    if(*ptr++)
+      return 0;
+    --nbytes;
+  }
+  return 1;
+}
+
+#if HAVE_X86_SIMD
+/* SSE2 versions ------------------------------------------------------------ */
+
+__attribute__((target("sse2")))
+static void samples_swap16_sse2(uint8_t *dst, const uint8_t *src, size_t n) {
+  /* SSE2 has no byte shuffle, so swap with a pair of 16-bit shifts */
+  for(; n >= 8; n -= 8, src += 16, dst += 16) {
+    const __m128i v = _mm_loadu_si128((const __m128i *)src);
+    _mm_storeu_si128((__m128i *)dst,
+                     _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8)));
+  }
+  samples_swap16_scalar(dst, src, n);
+}
+
+__attribute__((target("sse2")))
+static int samples_zero_sse2(const uint8_t *ptr, size_t nbytes) {
+  const __m128i zero = _mm_setzero_si128();
+
+  /* Most packets aren't silent and give up in the first block */
+  for(; nbytes >= 64; nbytes -= 64, ptr += 64) {
+    __m128i v = _mm_or_si128(_mm_loadu_si128((const __m128i *)ptr),
+                             _mm_loadu_si128((const __m128i *)(ptr + 16)));
+    v = _mm_or_si128(v, _mm_loadu_si128((const __m128i *)(ptr + 32)));
+    v = _mm_or_si128(v, _mm_loadu_si128((const __m128i *)(ptr + 48)));
+    if(_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) != 0xFFFF)
+      return 0;
+  }
+  for(; nbytes >= 16; nbytes -= 16, ptr += 16)
+    if(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)ptr),
+                                        zero)) != 0xFFFF)
+      return 0;
+  return samples_zero_scalar(ptr, nbytes);
+}
+
+/* AVX2 versions ------------------------------------------------------------ */
+
+__attribute__((target("avx2")))
+static void samples_swap16_avx2(uint8_t *dst, const uint8_t *src, size_t n) {
+  const __m256i order = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+                                         9, 8, 11, 10, 13, 12, 15, 14,
+                                         1, 0, 3, 2, 5, 4, 7, 6,
+                                         9, 8, 11, 10, 13, 12, 15, 14);
+
+  for(; n >= 16; n -= 16, src += 32, dst += 32) {
+    const __m256i v = _mm256_loadu_si256((const __m256i *)src);
+    _mm256_storeu_si256((__m256i *)dst, _mm256_shuffle_epi8(v, order));
+  }
+  /* GCC doesn't always clear the upper halves before a tail call, and mixing
+   * dirty AVX state with SSE instructions is very slow */
+  _mm256_zeroupper();
+  samples_swap16_sse2(dst, src, n);
+}
+
+__attribute__((target("avx2")))
+static int samples_zero_avx2(const uint8_t *ptr, size_t nbytes) {
+  for(; nbytes >= 128; nbytes -= 128, ptr += 128) {
+    __m256i v = _mm256_or_si256(_mm256_loadu_si256((const __m256i *)ptr),
+                                _mm256_loadu_si256((const __m256i *)(ptr + 32)));
+    v = _mm256_or_si256(v, _mm256_loadu_si256((const __m256i *)(ptr + 64)));
+    v = _mm256_or_si256(v, _mm256_loadu_si256((const __m256i *)(ptr + 96)));
+    if(!_mm256_testz_si256(v, v))
+      return 0;
+  }
+  _mm256_zeroupper();
+  return samples_zero_sse2(ptr, nbytes);
+}
+#endif
+
+/* Interface ---------------------------------------------------------------- */
+
+/** @brief Byte-swap 16-bit samples
+ * @param dst Where to put swapped samples
+ * @param src Samples to swap
+ * @param nsamples Number of samples
+ *
+ * @p dst may be equal to @p src but must not otherwise overlap it.  This is
+ * how to convert between host and network byte order on little-endian
+ * hosts.
+ */
+void samples_swap16(void *dst, const void *src, size_t nsamples) {
+  switch(samples__isa()) {
+#if HAVE_X86_SIMD
+  case SAMPLES_AVX2: samples_swap16_avx2(dst, src, nsamples); return;
+  case SAMPLES_SSE2: samples_swap16_sse2(dst, src, nsamples); return;
+#endif
+  default: samples_swap16_scalar(dst, src, nsamples); return;
+  }
+}
+
+/** @brief Test whether a buffer is all 0s
+ * @param ptr Start of buffer
+ * @param nbytes Size of buffer in bytes
+ * @return Nonzero if every byte is 0 (including if @p nbytes is 0), else 0
+ */
+int samples_zero(const void *ptr, size_t nbytes) {
+  switch(samples__isa()) {
+#if HAVE_X86_SIMD
+  case SAMPLES_AVX2: return samples_zero_avx2(ptr, nbytes);
+  case SAMPLES_SSE2: return samples_zero_sse2(ptr, nbytes);
+#endif
+  default: return samples_zero_scalar(ptr, nbytes);
+  }
+}
+
+/** @brief Return the best implementation the CPU supports
+ *
+ * Also makes it the one in use, if none has been chosen yet.
+ */
+enum samples_isa samples_get_isa(void) {
+  int isa = __atomic_load_n(&samples_isa, __ATOMIC_RELAXED);
+
+  if(isa < 0) {
+    isa = SAMPLES_SCALAR;
+#if HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))
+      isa = SAMPLES_AVX2;
+    else if(__builtin_cpu_supports("sse2"))
+      isa = SAMPLES_SSE2;
+#endif
+    __atomic_store_n(&samples_isa, isa, __ATOMIC_RELAXED);
+  }
+  return (enum samples_isa)isa;
+}
+
+/** @brief Choose an implementation
+ * @param isa Desired implementation
+ * @return Implementation now in use
+ *
+ * If @p isa isn't supported then the best one that is will be used instead.
+ * This is intended for testing and benchmarking.
+ */
+enum samples_isa samples_set_isa(enum samples_isa isa) {
+  __atomic_store_n(&samples_isa, -1, __ATOMIC_RELAXED);
+  if(isa > samples_get_isa())
+    return samples_get_isa();
+  __atomic_store_n(&samples_isa, isa, __ATOMIC_RELAXED);
+  return isa;
+}
+
+/** @brief Return the name of an implementation */
+const char *samples_isa_name(enum samples_isa isa) {
+  switch(isa) {
+  case SAMPLES_SCALAR: return "scalar";
+  case SAMPLES_SSE2: return "sse2";
+  case SAMPLES_AVX2: return "avx2";
+  }
+  return "unknown";
+}
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
@@ -0,0 +1,56 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file lib/samples.h
+ * @brief Bulk operations on sample buffers
+ */
+
+#ifndef SAMPLES_H
+#define SAMPLES_H
+
+/** @brief Implementations available to the sample kernels
+ *
+ * Later values are faster but need more from the CPU.
+ */
+enum samples_isa {
+  /** @brief Portable C */
+  SAMPLES_SCALAR,
+
+  /** @brief x86 SSE2 */
+  SAMPLES_SSE2,
+
+  /** @brief x86 AVX2 */
+  SAMPLES_AVX2,
+};
+
+void samples_swap16(void *dst, const void *src, size_t nsamples);
+int samples_zero(const void *ptr, size_t nbytes);
+
+enum samples_isa samples_get_isa(void);
+enum samples_isa samples_set_isa(enum samples_isa isa);
+const char *samples_isa_name(enum samples_isa isa);
+
+#endif /* SAMPLES_H */
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2013 Richard Kettlewell
+ * Copyright (C) 2013, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -74,6 +74,30 @@ int socketio_getc(struct socketio *sio) {
   return *sio->inputptr++;
 }
 
+/** @brief Read exactly @p n bytes
+ * @param sio Socket
+ * @param buffer Where to store bytes
+ * @param n Number of bytes to read
+ * @return 0 on success, -1 on error or EOF
+ */
+int socketio_read(struct socketio *sio, void *buffer, size_t n) {
+  size_t chunk;
+
+  while(n > 0) {
+    if(sio->inputptr >= sio->inputlimit)
+      if(socketio_fill(sio))
+        return -1;
+    chunk = sio->inputlimit - sio->inputptr;
+    if(chunk > n)
+      chunk = n;
+    memcpy(buffer, sio->inputptr, chunk);
+    sio->inputptr += chunk;
+    buffer = (char *)buffer + chunk;
+    n -= chunk;
+  }
+  return 0;
+}
+
 int socketio_flush(struct socketio *sio) {
   size_t written = 0;
   while(written < sio->outputused) {
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2013 Richard Kettlewell
+ * Copyright (C) 2013, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -35,6 +35,7 @@ struct socketio {
 void socketio_init(struct socketio *sio, SOCKET sd);
 int socketio_write(struct socketio *sio, const void *buffer, size_t n);
 int socketio_getc(struct socketio *sio);
+int socketio_read(struct socketio *sio, void *buffer, size_t n);
 int socketio_flush(struct socketio *sio);
 void socketio_close(struct socketio *sio);
 
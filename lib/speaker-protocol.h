@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2005, 2007, 2008, 2013 Richard Kettlewell
+ * Copyright (C) 2005, 2007, 2008, 2013, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -26,11 +26,58 @@
 #define SPEAKER_PROTOCOL_H
 
 #include "byte-order.h"
+#include "uaudio.h"
 #if HAVE_NETINET_IN_H
 # include <netinet/in.h>
 #endif
 
 /** @brief A message from the main server to the speaker, or vica versa */
+/** @brief Speaker statistics
+ *
+ * Sent in @ref SM_STATS messages.  Counters are totals since the speaker
+ * started.
+ */
+struct speaker_stats {
+  /** @brief Number of tracks with connections */
+  uint32_t tracks;
+
+  /** @brief Milliseconds of audio buffered for the playing track */
+  uint32_t buffered_ms;
+
+  /** @brief Current buffer target for the playing track in milliseconds */
+  uint32_t target_ms;
+
+  /** @brief Kilobytes of audio buffered for all tracks */
+  uint32_t buffered_kbytes;
+
+  /** @brief Kilobytes of buffer space allocated */
+  uint32_t pool_kbytes;
+
+  /** @brief Peak of @ref pool_kbytes */
+  uint32_t pool_peak_kbytes;
+
+  /** @brief Number of times the playing track ran out of data */
+  uint32_t underruns;
+
+  /** @brief Milliseconds of silence played because of underruns */
+  uint32_t underrun_ms;
+
+  /** @brief Number of times one track followed on from another */
+  uint32_t handovers;
+
+  /** @brief Number of handovers with no silence between the tracks */
+  uint32_t gapless_handovers;
+
+  /** @brief Samples of silence before the most recent handover
+   *
+   * Measured per channel, i.e. in frames.
+   */
+  uint32_t last_gap_samples;
+
+  /** @brief Statistics from the uaudio backend, if it keeps any */
+  struct uaudio_stats backend;
+};
+
 struct speaker_message {
   /** @brief Message type
    *
@@ -49,6 +96,7 @@ struct speaker_message {
    * - @ref SM_PLAYING
    * - @ref SM_UNKNOWN
    * - @ref SM_ARRIVED
+   * - @ref SM_STATS
    */
   int type;
 
@@ -61,6 +109,9 @@ struct speaker_message {
 
     /** @brief An IP address (for @ref SM_RTP_REQUEST and @ref SM_RTP_CANCEL) */
     struct sockaddr_storage address;
+
+    /** @brief Statistics (for @ref SM_STATS) */
+    struct speaker_stats stats;
   } u;
 };
 
@@ -122,6 +173,12 @@ struct speaker_message {
 /** @brief A connection for track @c id arrived */
 #define SM_ARRIVED 134
 
+/** @brief Statistics in @c stats
+ *
+ * This is sent from time to time.
+ */
+#define SM_STATS 135
+
 void speaker_send(int fd, const struct speaker_message *sm);
 /* Send a message. */
 
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2004, 2007, 2008 Richard Kettlewell
+ * Copyright (C) 2004, 2007, 2008, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -16,11 +16,13 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 /** @file lib/table.c
- * @brief Generic binary search
+ * @brief Generic binary search and perfect hashing
  */
 #include "common.h"
 
 #include "table.h"
+#include "mem.h"
+#include "log.h"
 
 int table_find(const void *table, size_t offset, size_t eltsize, size_t nelts,
 	       const char *name) {
@@ -39,6 +41,200 @@ int table_find(const void *table, size_t offset, size_t eltsize, size_t nelts,
   return -1;
 }
 
+/** @brief Maximum number of seeds to try for one bucket */
+#define TABLE_HASH_TRIES 4096
+
+/** @brief Return the name of a table entry */
+static inline const char *table_key(const void *table, size_t offset,
+                                    size_t eltsize, size_t n) {
+  return *(const char **)((const char *)table + offset + eltsize * n);
+}
+
+/** @brief Hash a name
+ * @param name Name to hash
+ * @return 64-bit FNV-1a hash
+ *
+ * The top half picks the bucket and the bottom half, mixed with the bucket's
+ * seed, picks the slot, so a lookup only has to read the name once.
+ */
+static inline uint64_t table_hash_name(const char *name) {
+  const unsigned char *s = (const unsigned char *)name;
+  uint64_t h = 14695981039346656037u;
+
+  while(*s)
+    h = (h ^ *s++) * 1099511628211u;
+  return h;
+}
+
+/** @brief Pick a bucket
+ * @param th Perfect hash
+ * @param h Hash of name
+ * @return Bucket number
+ */
+static inline size_t table_hash_bucket(const struct table_hash *th,
+                                       uint64_t h) {
+  return (size_t)(h >> 32) & (th->nbuckets - 1);
+}
+
+/** @brief Pick a slot
+ * @param th Perfect hash
+ * @param h Hash of name
+ * @param seed Seed for the name's bucket
+ * @return Slot number
+ */
+static inline size_t table_hash_slot(const struct table_hash *th,
+                                     uint64_t h, uint32_t seed) {
+  uint32_t x = (uint32_t)h ^ (seed * 2654435761u);
+
+  /* Finalizer from MurmurHash3 */
+  x ^= x >> 16;
+  x *= 0x85ebca6bu;
+  x ^= x >> 13;
+  x *= 0xc2b2ae35u;
+  x ^= x >> 16;
+  return x & (th->nslots - 1);
+}
+
+/** @brief A bucket while a perfect hash is being built */
+struct table_bucket {
+  /** @brief Bucket number */
+  size_t bucket;
+
+  /** @brief Number of names in the bucket */
+  size_t count;
+};
+
+/** @brief qsort() callback putting the fullest buckets first */
+static int compare_buckets(const void *av, const void *bv) {
+  const struct table_bucket *a = av, *b = bv;
+
+  if(a->count != b->count)
+    return a->count > b->count ? -1 : 1;
+  return a->bucket < b->bucket ? -1 : a->bucket > b->bucket;
+}
+
+/** @brief Try to build a perfect hash
+ * @param th Hash to fill in, with sizes set and arrays allocated
+ * @param nelts Number of names
+ * @param hashes Hash of each name
+ * @param buckets Workspace for @c th->nbuckets buckets
+ * @param members Workspace for @p nelts table indexes
+ * @return 0 on success, -1 if some bucket could not be placed
+ *
+ * The fullest buckets are placed first, while there is most room.  For each
+ * one, seeds are tried until all its names hash to distinct free slots.
+ */
+static int table_hash_try(struct table_hash *th, size_t nelts,
+                          const uint64_t *hashes,
+                          struct table_bucket *buckets, size_t *members) {
+  size_t b, n, m, count, slot;
+  uint32_t seed;
+
+  for(b = 0; b < th->nbuckets; ++b) {
+    buckets[b].bucket = b;
+    buckets[b].count = 0;
+    th->seeds[b] = 0;
+  }
+  for(n = 0; n < th->nslots; ++n)
+    th->slots[n] = -1;
+  for(n = 0; n < nelts; ++n)
+    ++buckets[table_hash_bucket(th, hashes[n])].count;
+  qsort(buckets, th->nbuckets, sizeof *buckets, compare_buckets);
+  for(b = 0; b < th->nbuckets && buckets[b].count; ++b) {
+    count = 0;
+    for(n = 0; n < nelts; ++n)
+      if(table_hash_bucket(th, hashes[n]) == buckets[b].bucket)
+        members[count++] = n;
+    for(seed = 1; seed <= TABLE_HASH_TRIES; ++seed) {
+      for(m = 0; m < count; ++m) {
+        slot = table_hash_slot(th, hashes[members[m]], seed);
+        if(th->slots[slot] >= 0)
+          break;
+        th->slots[slot] = (int)members[m];
+      }
+      if(m == count)
+        break;
+      /* Undo a partial placement */
+      while(m-- > 0)
+        th->slots[table_hash_slot(th, hashes[members[m]], seed)] = -1;
+    }
+    if(seed > TABLE_HASH_TRIES)
+      return -1;
+    th->seeds[buckets[b].bucket] = seed;
+  }
+  return 0;
+}
+
+/** @brief Build a perfect hash
+ * @param th Hash to build
+ * @param table Table
+ * @param offset Offset of name in each element
+ * @param eltsize Size of each element
+ * @param nelts Number of elements
+ *
+ * Starts with twice as many slots as names and four times as many slots as
+ * buckets, and doubles the slots if that fails.  Only names whose 64-bit
+ * hashes are identical can defeat every attempt.
+ */
+static void table_hash_build(struct table_hash *th,
+                             const void *table, size_t offset, size_t eltsize,
+                             size_t nelts) {
+  struct table_bucket *buckets;
+  uint64_t *hashes;
+  size_t *members;
+  size_t n, nslots, nbuckets;
+
+  for(nslots = 4; nslots < 2 * nelts; nslots *= 2)
+    ;
+  hashes = xcalloc_noptr(nelts ? nelts : 1, sizeof *hashes);
+  members = xcalloc_noptr(nelts ? nelts : 1, sizeof *members);
+  for(n = 0; n < nelts; ++n)
+    hashes[n] = table_hash_name(table_key(table, offset, eltsize, n));
+  for(nbuckets = nslots / 4;; nslots *= 2) {
+    if(nslots > 1024 * (nelts + 1))
+      disorder_fatal(0, "cannot build perfect hash for %zu names", nelts);
+    th->nslots = nslots;
+    th->nbuckets = nbuckets;
+    th->seeds = xcalloc_noptr(nbuckets, sizeof *th->seeds);
+    th->slots = xcalloc_noptr(nslots, sizeof *th->slots);
+    buckets = xcalloc_noptr(nbuckets, sizeof *buckets);
+    if(!table_hash_try(th, nelts, hashes, buckets, members))
+      break;
+    xfree(th->seeds);
+    xfree(th->slots);
+    xfree(buckets);
+  }
+  xfree(buckets);
+  xfree(hashes);
+  xfree(members);
+}
+
+/** @brief Look up a name using a perfect hash
+ * @param th Perfect hash for @p table
+ * @param table Table
+ * @param offset Offset of name in each element
+ * @param eltsize Size of each element
+ * @param nelts Number of elements
+ * @param name Name to find
+ * @return Index of @p name in @p table, or -1
+ *
+ * Normally called via TABLE_HASH_FIND().  The first call builds @p th.
+ */
+int table_hash_find(struct table_hash *th,
+                    const void *table, size_t offset, size_t eltsize,
+                    size_t nelts, const char *name) {
+  uint64_t h;
+  int n;
+
+  if(!th->nbuckets)
+    table_hash_build(th, table, offset, eltsize, nelts);
+  h = table_hash_name(name);
+  n = th->slots[table_hash_slot(th, h, th->seeds[table_hash_bucket(th, h)])];
+  if(n >= 0 && !strcmp(name, table_key(table, offset, eltsize, n)))
+    return n;
+  return -1;
+}
+
 /*
 Local Variables:
 c-basic-offset:2
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2004, 2005, 2007, 2008, 2013 Richard Kettlewell
+ * Copyright (C) 2004, 2005, 2007, 2008, 2013, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -16,12 +16,13 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 /** @file lib/table.h
- * @brief Generic binary search
+ * @brief Generic binary search and perfect hashing
  */
 #ifndef TABLE_H
 #define TABLE_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 #if _WIN32
 #define OFFSETOF_IN_OBJECT(OBJECT,FIELD) ((char *)&(OBJECT).FIELD - (char *)&(OBJECT))
@@ -43,6 +44,44 @@
 int table_find(const void *table, size_t offset, size_t eltsize, size_t nelts,
 	       const char *name);
 
+/** @brief Perfect hash index for a table
+ *
+ * Built from the table the first time it is used, so it must start out
+ * 0-filled (e.g. by being static).  Part of a name's hash picks a bucket,
+ * and the rest, mixed with that bucket's seed, picks a slot, which holds the
+ * only table index the name could match.
+ */
+struct table_hash {
+  /** @brief Number of buckets (a power of 2), or 0 if not built yet */
+  size_t nbuckets;
+
+  /** @brief Number of slots (a power of 2) */
+  size_t nslots;
+
+  /** @brief Seed for each bucket */
+  uint32_t *seeds;
+
+  /** @brief Table index for each slot, or -1 */
+  int *slots;
+};
+
+#define TABLE_HASH_FIND(HASH, TABLE, FIELD, NAME)	\
+  table_hash_find(&(HASH),				\
+                  (void *)TABLE,			\
+                  OFFSETOF_IN_OBJECT(TABLE[0], FIELD),	\
+                  sizeof ((TABLE)[0]),			\
+                  sizeof TABLE / sizeof ((TABLE)[0]),	\
+                  NAME)
+/* Search TABLE[] for an element where TABLE[N].FIELD matches NAME, using the
+ * perfect hash HASH, which must only ever be used with TABLE
+ * Returns the index N on success or -1 if not found
+ * The names in the table must be distinct but need not be sorted
+ */
+
+int table_hash_find(struct table_hash *th,
+                    const void *table, size_t offset, size_t eltsize,
+                    size_t nelts, const char *name);
+
 #endif /* TABLE_H */
 
 /*
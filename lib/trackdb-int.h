@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2005, 2007 Richard Kettlewell
+ * Copyright (C) 2005, 2007, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -61,6 +61,10 @@ void trackdb_abort_transaction(DB_TXN *tid);
 void trackdb_commit_transaction(DB_TXN *tid);
 /* begin, abort or commit a transaction */
 
+void trackdb_abort_to_retry(DB_TXN *tid);
+/* abort a transaction that is about to be tried again, counting it in
+ * trackdb_retries */
+
 /** @brief Evaluate @p expr in a transaction, looping on deadlock
  *
  * @c tid will be the transaction handle.  @p e will be the error code.
@@ -70,7 +74,7 @@ void trackdb_commit_transaction(DB_TXN *tid);
                                                 \
   tid = trackdb_begin_transaction();            \
   while((e = (expr)) == DB_LOCK_DEADLOCK) {     \
-    trackdb_abort_transaction(tid);             \
+    trackdb_abort_to_retry(tid);                \
     tid = trackdb_begin_transaction();          \
   }                                             \
   if(e)                                         \
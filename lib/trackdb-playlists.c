@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2008 Richard Kettlewell
+ * Copyright (C) 2008, 2026 Richard Kettlewell
  *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -22,6 +22,25 @@
  *
  * This file implements reading and modification of playlists, including access
  * control, but not locking or event logging (at least yet).
+ *
+ * A playlist is stored as a header record, keyed by the playlist name, and a
+ * sequence of chunk records each holding up to @ref PLAYLIST_CHUNK tracks.
+ * The header has the following keys:
+ * - @c sharing: the sharing status
+ * - @c count: the total number of tracks
+ * - @c chunks: space-separated @c ID:COUNT pairs, in playlist order
+ *
+ * Chunk @c ID of playlist @c NAME is stored under the key @c NAME/ID, which
+ * can't collide with a playlist name, with its tracks under the keys @c 0,
+ * @c 1, etc.
+ *
+ * The header alone is enough to find which chunks an edit affects, so
+ * inserting, removing or moving tracks only reads and rewrites those chunks
+ * (and the header) however long the playlist is.
+ *
+ * Older versions stored the tracks in the header record itself, under the keys
+ * @c 0 to @c count-1, and had no @c chunks key.  These are still read, and are
+ * converted to chunks the first time they are modified.
  */
 #include "common.h"
 
@@ -34,6 +53,79 @@
 #include "vector.h"
 #include "eventlog.h"
 #include "validity.h"
+#include "printf.h"
+
+/** @brief Most tracks in one playlist chunk */
+#define PLAYLIST_CHUNK 256
+
+/** @brief One chunk of a playlist */
+struct playlist_chunk {
+  /** @brief Chunk ID */
+  int id;
+
+  /** @brief Number of tracks */
+  int ntracks;
+
+  /** @brief Tracks, or NULL if not loaded yet */
+  char **tracks;
+
+  /** @brief Nonzero if the chunk must be written back */
+  int modified;
+};
+
+/** @brief A dynamic array of playlist chunks */
+VECTOR_TYPE(chunkvector, struct playlist_chunk, xrealloc);
+
+/** @brief A playlist being read or modified */
+struct playlist {
+  /** @brief Playlist name */
+  const char *name;
+
+  /** @brief Sharing status */
+  const char *share;
+
+  /** @brief Total number of tracks */
+  int ntracks;
+
+  /** @brief Chunks in playlist order */
+  struct chunkvector chunks;
+
+  /** @brief Keys of chunks to delete when storing */
+  struct vector deleted;
+
+  /** @brief Next free chunk ID */
+  int nextid;
+};
+
+/** @brief A change to a playlist
+ *
+ * See trackdb_playlist_set_tid().
+ */
+struct playlist_edit {
+  /** @brief New sharing status, or NULL to leave alone */
+  const char *share;
+
+  /** @brief Nonzero to replace the whole contents with @c tracks */
+  int replace;
+
+  /** @brief Index of first track to remove, or to insert before */
+  int position;
+
+  /** @brief Number of tracks to remove */
+  int nremove;
+
+  /** @brief Tracks to insert */
+  char **tracks;
+
+  /** @brief Number of tracks to insert */
+  int ntracks;
+
+  /** @brief Where to reinsert removed tracks, or -1 to discard them */
+  int move_to;
+
+  /** @brief Nonzero if the edit may create the playlist */
+  int create;
+};
 
 static int trackdb_playlist_get_tid(const char *name,
                                     const char *who,
@@ -43,9 +135,7 @@ static int trackdb_playlist_get_tid(const char *name,
                                     DB_TXN *tid);
 static int trackdb_playlist_set_tid(const char *name,
                                     const char *who,
-                                    char **tracks,
-                                    int ntracks,
-                                    const char *share,
+                                    const struct playlist_edit *edit,
                                     DB_TXN *tid);
 static int trackdb_playlist_list_tid(const char *who,
                                      char ***playlistsp,
@@ -102,6 +192,469 @@ static int playlist_may_write(const char *name,
   return 0;
 }
 
+/** @brief Return the key for a playlist chunk */
+static char *playlist_chunk_key(const char *name, int id) {
+  char *key;
+
+  byte_xasprintf(&key, "%s/%d", name, id);
+  return key;
+}
+
+/** @brief Extract tracks from a record
+ * @param k Record
+ * @param tracks Where to put tracks
+ * @param ntracks Number of tracks expected
+ * @return Number of tracks missing from @p k
+ *
+ * The tracks are under the keys @c 0 to @c ntracks-1.  Each key is visited
+ * just once, rather than searching for each track in turn.  Missing tracks
+ * are replaced with "unknown".
+ */
+static int playlist_decode_tracks(const struct kvp *k,
+                                  char **tracks,
+                                  int ntracks) {
+  int n, missing = 0;
+
+  memset(tracks, 0, ntracks * sizeof *tracks);
+  for(; k; k = k->next) {
+    char *end;
+    long l;
+
+    if(k->name[0] < '0' || k->name[0] > '9')
+      continue;
+    errno = 0;
+    l = strtol(k->name, &end, 10);
+    if(errno || *end || l >= ntracks)
+      continue;
+    tracks[l] = (char *)k->value;
+  }
+  for(n = 0; n < ntracks; ++n)
+    if(!tracks[n]) {
+      tracks[n] = (char *)"unknown";
+      ++missing;
+    }
+  return missing;
+}
+
+/** @brief Encode tracks as a record
+ * @param tracks Tracks
+ * @param ntracks Number of tracks
+ * @return Record with tracks under the keys @c 0 to @c ntracks-1
+ */
+static struct kvp *playlist_encode_tracks(char **tracks, int ntracks) {
+  struct kvp *k, **kk = &k;
+  char b[16];
+
+  for(int n = 0; n < ntracks; ++n) {
+    *kk = xmalloc(sizeof **kk);
+    snprintf(b, sizeof b, "%d", n);
+    (*kk)->name = xstrdup(b);
+    (*kk)->value = tracks[n];
+    kk = &(*kk)->next;
+  }
+  *kk = 0;
+  return k;
+}
+
+/** @brief Add new chunks to a playlist
+ * @param pl Playlist
+ * @param index Where to put the new chunks
+ * @param tracks Tracks for the new chunks
+ * @param ntracks Number of tracks
+ *
+ * The tracks are spread evenly over as few chunks as possible.  @p tracks is
+ * not copied.  @c pl->ntracks is not updated.
+ */
+static void playlist_add_chunks(struct playlist *pl,
+                                int index,
+                                char **tracks,
+                                int ntracks) {
+  const int nchunks = (ntracks + PLAYLIST_CHUNK - 1) / PLAYLIST_CHUNK;
+  const int oldn = pl->chunks.nvec;
+  struct playlist_chunk c, *v;
+
+  for(int n = 0; n < nchunks; ++n) {
+    const int start = (int64_t)ntracks * n / nchunks;
+    const int end = (int64_t)ntracks * (n + 1) / nchunks;
+
+    c.id = pl->nextid++;
+    c.ntracks = end - start;
+    c.tracks = tracks + start;
+    c.modified = 1;
+    chunkvector_append(&pl->chunks, c);
+  }
+  if(index < oldn) {
+    /* Rotate the new chunks into place */
+    v = xmalloc(nchunks * sizeof *v);
+    memcpy(v, pl->chunks.vec + oldn, nchunks * sizeof *v);
+    memmove(pl->chunks.vec + index + nchunks, pl->chunks.vec + index,
+            (oldn - index) * sizeof *v);
+    memcpy(pl->chunks.vec + index, v, nchunks * sizeof *v);
+  }
+}
+
+/** @brief Remove a chunk from a playlist
+ * @param pl Playlist
+ * @param index Chunk to remove
+ *
+ * The chunk will be deleted from the database when the playlist is stored.
+ * @c pl->ntracks is not updated.
+ */
+static void playlist_drop_chunk(struct playlist *pl, int index) {
+  vector_append(&pl->deleted,
+                playlist_chunk_key(pl->name, pl->chunks.vec[index].id));
+  memmove(pl->chunks.vec + index, pl->chunks.vec + index + 1,
+          (pl->chunks.nvec - index - 1) * sizeof *pl->chunks.vec);
+  --pl->chunks.nvec;
+}
+
+/** @brief Parse a playlist's chunk list
+ * @param pl Playlist
+ * @param s Value of @c chunks key
+ */
+static void playlist_parse_chunks(struct playlist *pl, const char *s) {
+  struct playlist_chunk c;
+  int total = 0;
+  char *end;
+  long id, n;
+
+  memset(&c, 0, sizeof c);
+  while(*s) {
+    if(*s == ' ') {
+      ++s;
+      continue;
+    }
+    errno = 0;
+    id = strtol(s, &end, 10);
+    if(errno || *end != ':' || id < 0 || id >= INT_MAX)
+      break;
+    n = strtol(end + 1, &end, 10);
+    if(errno || (*end && *end != ' ') || n <= 0 || n > INT_MAX - total)
+      break;
+    c.id = id;
+    c.ntracks = n;
+    chunkvector_append(&pl->chunks, c);
+    total += n;
+    if(id >= pl->nextid)
+      pl->nextid = id + 1;
+    s = end;
+  }
+  if(*s)
+    disorder_error(0, "playlist '%s' has malformed chunk list", pl->name);
+  if(total != pl->ntracks) {
+    disorder_error(0, "playlist '%s' has inconsistent count", pl->name);
+    pl->ntracks = total;
+  }
+}
+
+/** @brief Read a playlist's header
+ * @param name Playlist name
+ * @param pl Where to put playlist
+ * @param tid Owning transaction
+ * @return 0, @c DB_NOTFOUND or @c DB_LOCK_DEADLOCK
+ *
+ * Chunks are not read until they are needed; see playlist_load().  A playlist
+ * in the old format is converted to chunks in memory.
+ *
+ * @p pl is initialized even if an error is returned.
+ */
+static int playlist_read(const char *name,
+                         struct playlist *pl,
+                         DB_TXN *tid) {
+  struct kvp *k;
+  const char *s;
+  int e;
+
+  memset(pl, 0, sizeof *pl);
+  pl->name = name;
+  chunkvector_init(&pl->chunks);
+  vector_init(&pl->deleted);
+  if((e = trackdb_getdata(trackdb_playlistsdb, name, &k, tid)))
+    return e;
+  /* Get sharability */
+  if(!(s = kvp_get(k, "sharing"))) {
+    disorder_error(0, "playlist '%s' has no 'sharing' key", name);
+    s = "private";
+  }
+  pl->share = s;
+  /* Get track count */
+  if(!(s = kvp_get(k, "count"))) {
+    disorder_error(0, "playlist '%s' has no 'count' key", name);
+    s = "0";
+  }
+  pl->ntracks = atoi(s);
+  if(pl->ntracks < 0) {
+    disorder_error(0, "playlist '%s' has negative count", name);
+    pl->ntracks = 0;
+  }
+  if((s = kvp_get(k, "chunks")))
+    playlist_parse_chunks(pl, s);
+  else if(pl->ntracks) {
+    /* Old format, with the tracks in the header */
+    char **tracks = xcalloc(pl->ntracks, sizeof *tracks);
+    const int missing = playlist_decode_tracks(k, tracks, pl->ntracks);
+
+    if(missing)
+      disorder_error(0, "playlist '%s' lacks %d tracks", name, missing);
+    playlist_add_chunks(pl, 0, tracks, pl->ntracks);
+  }
+  return 0;
+}
+
+/** @brief Make sure a chunk's tracks are in memory
+ * @param pl Playlist
+ * @param index Chunk to load
+ * @param tid Owning transaction
+ * @return 0 or @c DB_LOCK_DEADLOCK
+ */
+static int playlist_load(struct playlist *pl, int index, DB_TXN *tid) {
+  struct playlist_chunk *const c = &pl->chunks.vec[index];
+  struct kvp *k;
+  int e, missing;
+
+  if(c->tracks)
+    return 0;
+  e = trackdb_getdata(trackdb_playlistsdb, playlist_chunk_key(pl->name, c->id),
+                      &k, tid);
+  if(e && e != DB_NOTFOUND)
+    return e;
+  c->tracks = xcalloc(c->ntracks, sizeof *c->tracks);
+  missing = playlist_decode_tracks(k, c->tracks, c->ntracks);
+  if(missing)
+    disorder_error(0, "playlist '%s' chunk %d lacks %d tracks",
+                   pl->name, c->id, missing);
+  return 0;
+}
+
+/** @brief Find the chunk containing a track
+ * @param pl Playlist
+ * @param position Track index, from 0 to @c pl->ntracks inclusive
+ * @param offsetp Where to store index of @p position within chunk
+ * @return Chunk index
+ *
+ * If @p position is @c pl->ntracks then the last chunk is returned, with
+ * @p *offsetp set to its length.  If there are no chunks then 0 is returned.
+ */
+static int playlist_locate(const struct playlist *pl,
+                           int position,
+                           int *offsetp) {
+  int index;
+
+  for(index = 0; index < pl->chunks.nvec; ++index) {
+    const int n = pl->chunks.vec[index].ntracks;
+
+    if(position < n || index + 1 == pl->chunks.nvec)
+      break;
+    position -= n;
+  }
+  *offsetp = position;
+  return index;
+}
+
+/** @brief Copy tracks out of a playlist
+ * @param pl Playlist
+ * @param position Index of first track
+ * @param count Number of tracks
+ * @param tracks Where to store tracks
+ * @param tid Owning transaction
+ * @return 0 or @c DB_LOCK_DEADLOCK
+ */
+static int playlist_range(struct playlist *pl,
+                          int position,
+                          int count,
+                          char **tracks,
+                          DB_TXN *tid) {
+  int offset, index, e;
+
+  index = playlist_locate(pl, position, &offset);
+  while(count > 0) {
+    const struct playlist_chunk *c = &pl->chunks.vec[index];
+    const int n = c->ntracks - offset < count ? c->ntracks - offset : count;
+
+    if((e = playlist_load(pl, index, tid)))
+      return e;
+    memcpy(tracks, c->tracks + offset, n * sizeof *tracks);
+    tracks += n;
+    count -= n;
+    offset = 0;
+    ++index;
+  }
+  return 0;
+}
+
+/** @brief Merge a pair of chunks if they are small enough
+ * @param pl Playlist
+ * @param index Index of first chunk of pair
+ * @param mergedp Set to 1 if the chunks were merged, else 0
+ * @param tid Owning transaction
+ * @return 0 or @c DB_LOCK_DEADLOCK
+ *
+ * This stops repeated removals leaving a trail of tiny chunks.
+ */
+static int playlist_merge(struct playlist *pl,
+                          int index,
+                          int *mergedp,
+                          DB_TXN *tid) {
+  struct playlist_chunk *a = &pl->chunks.vec[index], *b = a + 1;
+  char **tracks;
+  int e;
+
+  *mergedp = 0;
+  if(a->ntracks + b->ntracks > PLAYLIST_CHUNK
+     || (a->ntracks >= PLAYLIST_CHUNK / 4 && b->ntracks >= PLAYLIST_CHUNK / 4))
+    return 0;
+  if((e = playlist_load(pl, index, tid))
+     || (e = playlist_load(pl, index + 1, tid)))
+    return e;
+  tracks = xcalloc(a->ntracks + b->ntracks, sizeof *tracks);
+  memcpy(tracks, a->tracks, a->ntracks * sizeof *tracks);
+  memcpy(tracks + a->ntracks, b->tracks, b->ntracks * sizeof *tracks);
+  a->tracks = tracks;
+  a->ntracks += b->ntracks;
+  a->modified = 1;
+  playlist_drop_chunk(pl, index + 1);
+  *mergedp = 1;
+  return 0;
+}
+
+/** @brief Remove tracks from a playlist
+ * @param pl Playlist
+ * @param position Index of first track to remove
+ * @param count Number of tracks to remove
+ * @param tid Owning transaction
+ * @return 0 or @c DB_LOCK_DEADLOCK
+ *
+ * Chunks that are removed completely are not read.
+ */
+static int playlist_remove(struct playlist *pl,
+                           int position,
+                           int count,
+                           DB_TXN *tid) {
+  int offset, index, first, last, merged, e;
+
+  if(!count)
+    return 0;
+  first = index = playlist_locate(pl, position, &offset);
+  pl->ntracks -= count;
+  while(count > 0) {
+    struct playlist_chunk *c = &pl->chunks.vec[index];
+    const int n = c->ntracks - offset < count ? c->ntracks - offset : count;
+
+    if(n == c->ntracks)
+      playlist_drop_chunk(pl, index);
+    else {
+      if((e = playlist_load(pl, index, tid)))
+        return e;
+      memmove(c->tracks + offset, c->tracks + offset + n,
+              (c->ntracks - offset - n) * sizeof *c->tracks);
+      c->ntracks -= n;
+      c->modified = 1;
+      ++index;
+    }
+    count -= n;
+    offset = 0;
+  }
+  /* Tidy up around the edit */
+  index = first > 0 ? first - 1 : 0;
+  last = first + 1;
+  while(index < last && index + 1 < pl->chunks.nvec) {
+    if((e = playlist_merge(pl, index, &merged, tid)))
+      return e;
+    if(merged)
+      --last;
+    else
+      ++index;
+  }
+  return 0;
+}
+
+/** @brief Insert tracks into a playlist
+ * @param pl Playlist
+ * @param position Index to insert before, or @c pl->ntracks to append
+ * @param tracks Tracks to insert
+ * @param ntracks Number of tracks to insert
+ * @param tid Owning transaction
+ * @return 0 or @c DB_LOCK_DEADLOCK
+ *
+ * Only the chunk containing @p position is read.  If it gets too big it is
+ * split.
+ */
+static int playlist_insert(struct playlist *pl,
+                           int position,
+                           char **tracks,
+                           int ntracks,
+                           DB_TXN *tid) {
+  struct playlist_chunk *c;
+  int offset, index, total, e;
+  char **newtracks;
+
+  if(!ntracks)
+    return 0;
+  index = playlist_locate(pl, position, &offset);
+  pl->ntracks += ntracks;
+  if(!pl->chunks.nvec) {
+    playlist_add_chunks(pl, 0, tracks, ntracks);
+    return 0;
+  }
+  if((e = playlist_load(pl, index, tid)))
+    return e;
+  c = &pl->chunks.vec[index];
+  total = c->ntracks + ntracks;
+  newtracks = xcalloc(total, sizeof *newtracks);
+  memcpy(newtracks, c->tracks, offset * sizeof *newtracks);
+  memcpy(newtracks + offset, tracks, ntracks * sizeof *newtracks);
+  memcpy(newtracks + offset + ntracks, c->tracks + offset,
+         (c->ntracks - offset) * sizeof *newtracks);
+  if(total <= PLAYLIST_CHUNK) {
+    c->tracks = newtracks;
+    c->ntracks = total;
+    c->modified = 1;
+  } else {
+    playlist_drop_chunk(pl, index);
+    playlist_add_chunks(pl, index, newtracks, total);
+  }
+  return 0;
+}
+
+/** @brief Write back a modified playlist
+ * @param pl Playlist
+ * @param tid Owning transaction
+ * @return 0 or @c DB_LOCK_DEADLOCK
+ */
+static int playlist_store(struct playlist *pl, DB_TXN *tid) {
+  struct dynstr chunks[1];
+  struct kvp *k = 0;
+  char b[16];
+  int e;
+
+  for(int n = 0; n < pl->deleted.nvec; ++n)
+    if((e = trackdb_delkey(trackdb_playlistsdb, pl->deleted.vec[n], tid)))
+      return e;
+  dynstr_init(chunks);
+  for(int n = 0; n < pl->chunks.nvec; ++n) {
+    const struct playlist_chunk *c = &pl->chunks.vec[n];
+
+    if(c->modified
+       && (e = trackdb_putdata(trackdb_playlistsdb,
+                               playlist_chunk_key(pl->name, c->id),
+                               playlist_encode_tracks(c->tracks, c->ntracks),
+                               tid, 0)))
+      return e;
+    if(n)
+      dynstr_append(chunks, ' ');
+    snprintf(b, sizeof b, "%d:", c->id);
+    dynstr_append_string(chunks, b);
+    snprintf(b, sizeof b, "%d", c->ntracks);
+    dynstr_append_string(chunks, b);
+  }
+  dynstr_terminate(chunks);
+  kvp_set(&k, "sharing", pl->share);
+  snprintf(b, sizeof b, "%d", pl->ntracks);
+  kvp_set(&k, "count", b);
+  kvp_set(&k, "chunks", chunks->vec);
+  return trackdb_putdata(trackdb_playlistsdb, pl->name, k, tid, 0);
+}
+
 /** @brief Get playlist data
  * @param name Name of playlist
  * @param who Who wants to know
@@ -142,56 +695,54 @@ static int trackdb_playlist_get_tid(const char *name,
                                     int *ntracksp,
                                     char **sharep,
                                     DB_TXN *tid) {
-  struct kvp *k;
-  int e, ntracks;
-  const char *s;
+  struct playlist pl;
+  int e;
 
-  if((e = trackdb_getdata(trackdb_playlistsdb, name, &k, tid)))
+  if((e = playlist_read(name, &pl, tid)))
     return e;
-  /* Get sharability */
-  if(!(s = kvp_get(k, "sharing"))) {
-    disorder_error(0, "playlist '%s' has no 'sharing' key", name);
-    s = "private";
-  }
   /* Check the read is allowed */
-  if(!playlist_may_read(name, who, s))
+  if(!playlist_may_read(name, who, pl.share))
     return EACCES;
   /* Return sharability */
   if(sharep)
-    *sharep = xstrdup(s);
-  /* Get track count */
-  if(!(s = kvp_get(k, "count"))) {
-    disorder_error(0, "playlist '%s' has no 'count' key", name);
-    s = "0";
-  }
-  ntracks = atoi(s);
-  if(ntracks < 0) {
-    disorder_error(0, "playlist '%s' has negative count", name);
-    ntracks = 0;
-  }
+    *sharep = xstrdup(pl.share);
   /* Return track count */
   if(ntracksp)
-    *ntracksp = ntracks;
+    *ntracksp = pl.ntracks;
   if(tracksp) {
     /* Get track list */
-    char **tracks = xcalloc(ntracks + 1, sizeof (char *));
-    char b[16];
-
-    for(int n = 0; n < ntracks; ++n) {
-      snprintf(b, sizeof b, "%d", n);
-      if(!(s = kvp_get(k, b))) {
-        disorder_error(0, "playlist '%s' lacks track %d", name, n);
-        s = "unknown";
-      }
-      tracks[n] = xstrdup(s);
-    }
-    tracks[ntracks] = 0;
+    char **tracks = xcalloc(pl.ntracks + 1, sizeof (char *));
+
+    if((e = playlist_range(&pl, 0, pl.ntracks, tracks, tid)))
+      return e;
+    tracks[pl.ntracks] = 0;
     /* Return track list */
     *tracksp = tracks;
   }
   return 0;
 }
 
+/** @brief Apply a change to a playlist
+ * @param name Playlist name
+ * @param who User modifying playlist
+ * @param edit Change to make
+ * @return 0 on success, non-0 on error
+ *
+ * See trackdb_playlist_set() for possible return values.  In addition @c
+ * ENOENT is returned if the playlist doesn't exist and @c edit->create is
+ * 0, and @c ERANGE if a position is out of range.
+ */
+static int trackdb_playlist_edit(const char *name,
+                                 const char *who,
+                                 const struct playlist_edit *edit) {
+  int e;
+
+  WITH_TRANSACTION(trackdb_playlist_set_tid(name, who, edit, tid));
+  if(e == DB_NOTFOUND)
+    e = ENOENT;
+  return e;
+}
+
 /** @brief Modify or create a playlist
  * @param name Playlist name
  * @param who User modifying playlist
@@ -220,7 +771,7 @@ int trackdb_playlist_set(const char *name,
                          char **tracks,
                          int ntracks,
                          const char *share) {
-  int e;
+  struct playlist_edit edit;
   char *owner;
   
   if(playlist_parse_name(name, &owner, 0)) {
@@ -245,29 +796,131 @@ int trackdb_playlist_set(const char *name,
     }        
   }
   /* We've checked as much as we can for now, now go and attempt the change */
-  WITH_TRANSACTION(trackdb_playlist_set_tid(name, who, tracks, ntracks, share,
-                                            tid));
-  return e;
+  memset(&edit, 0, sizeof edit);
+  edit.share = share;
+  if(tracks) {
+    edit.replace = 1;
+    edit.tracks = tracks;
+    edit.ntracks = ntracks;
+  }
+  edit.move_to = -1;
+  edit.create = 1;
+  return trackdb_playlist_edit(name, who, &edit);
+}
+
+/** @brief Insert tracks into a playlist
+ * @param name Playlist name
+ * @param who User modifying playlist
+ * @param position Index to insert before, or the playlist length to append
+ * @param tracks Tracks to insert
+ * @param ntracks Number of tracks to insert
+ * @return 0 on success, non-0 on error
+ *
+ * If the playlist does not exist it is created, as for
+ * trackdb_playlist_set().
+ *
+ * Possible return values are as for trackdb_playlist_set(), plus @c ERANGE if
+ * @p position is out of range.
+ */
+int trackdb_playlist_insert(const char *name,
+                            const char *who,
+                            int position,
+                            char **tracks,
+                            int ntracks) {
+  struct playlist_edit edit;
+
+  if(playlist_parse_name(name, 0, 0)) {
+    disorder_error(0, "invalid playlist name '%s'", name);
+    return EINVAL;
+  }
+  memset(&edit, 0, sizeof edit);
+  edit.position = position;
+  edit.tracks = tracks;
+  edit.ntracks = ntracks;
+  edit.move_to = -1;
+  edit.create = 1;
+  return trackdb_playlist_edit(name, who, &edit);
+}
+
+/** @brief Remove tracks from a playlist
+ * @param name Playlist name
+ * @param who User modifying playlist
+ * @param position Index of first track to remove
+ * @param count Number of tracks to remove
+ * @return 0 on success, non-0 on error
+ *
+ * Possible return values are as for trackdb_playlist_set(), plus @c ENOENT if
+ * the playlist doesn't exist and @c ERANGE if @p position or @p count is out
+ * of range.
+ */
+int trackdb_playlist_remove(const char *name,
+                            const char *who,
+                            int position,
+                            int count) {
+  struct playlist_edit edit;
+
+  if(playlist_parse_name(name, 0, 0)) {
+    disorder_error(0, "invalid playlist name '%s'", name);
+    return EINVAL;
+  }
+  memset(&edit, 0, sizeof edit);
+  edit.position = position;
+  edit.nremove = count;
+  edit.move_to = -1;
+  return trackdb_playlist_edit(name, who, &edit);
+}
+
+/** @brief Move tracks within a playlist
+ * @param name Playlist name
+ * @param who User modifying playlist
+ * @param from Index of first track to move
+ * @param count Number of tracks to move
+ * @param to New index of first moved track
+ * @return 0 on success, non-0 on error
+ *
+ * @p to is an index into the playlist as it is after the moved tracks are
+ * taken out, so it must be at most the playlist length less @p count.
+ *
+ * Possible return values are as for trackdb_playlist_remove().
+ */
+int trackdb_playlist_move(const char *name,
+                          const char *who,
+                          int from,
+                          int count,
+                          int to) {
+  struct playlist_edit edit;
+
+  if(playlist_parse_name(name, 0, 0)) {
+    disorder_error(0, "invalid playlist name '%s'", name);
+    return EINVAL;
+  }
+  if(to < 0)
+    return ERANGE;
+  memset(&edit, 0, sizeof edit);
+  edit.position = from;
+  edit.nremove = count;
+  edit.move_to = to;
+  return trackdb_playlist_edit(name, who, &edit);
 }
 
 static int trackdb_playlist_set_tid(const char *name,
                                     const char *who,
-                                    char **tracks,
-                                    int ntracks,
-                                    const char *share,
+                                    const struct playlist_edit *edit,
                                     DB_TXN *tid) {
-  struct kvp *k;
-  int e;
-  const char *s;
+  struct playlist pl;
+  int e, position, nremove, remaining;
   const char *event = "playlist_modified";
+  char **moved = 0;
 
-  if((e = trackdb_getdata(trackdb_playlistsdb, name, &k, tid))
+  if((e = playlist_read(name, &pl, tid))
      && e != DB_NOTFOUND)
     return e;
   /* If the playlist doesn't exist set some defaults */
   if(e == DB_NOTFOUND) {
     char *defshare, *owner;
 
+    if(!edit->create)
+      return e;
     if(playlist_parse_name(name, &owner, &defshare))
       return EINVAL;
     /* Can't create a non-shared playlist belonging to someone else.  In fact
@@ -275,57 +928,55 @@ static int trackdb_playlist_set_tid(const char *name,
      * to do it here. */
     if(owner && strcmp(owner, who))
       return EACCES;
-    k = 0;
-    kvp_set(&k, "count", 0);
-    kvp_set(&k, "sharing", defshare);
+    pl.share = defshare;
     event = "playlist_created";
   }
   /* Check that the modification is allowed */
-  if(!(s = kvp_get(k, "sharing"))) {
-    disorder_error(0, "playlist '%s' has no 'sharing' key", name);
-    s = "private";
-  }
-  if(!playlist_may_write(name, who, s))
+  if(!playlist_may_write(name, who, pl.share))
     return EACCES;
   /* If no change was requested then don't even create */
-  if(!share && !tracks)
+  if(!edit->share && !edit->replace && !edit->nremove && !edit->ntracks)
     return 0;
   /* Set the new values */
-  if(share)
-    kvp_set(&k, "sharing", share);
-  if(tracks) {
-    char b[16];
-    int oldcount, n;
-
-    /* Sanity check track count */
-    if(ntracks < 0 || ntracks > config->playlist_max) {
-      disorder_error(0, "invalid track count %d", ntracks);
-      return EINVAL;
-    }
-    /* Set the tracks */
-    for(n = 0; n < ntracks; ++n) {
-      snprintf(b, sizeof b, "%d", n);
-      kvp_set(&k, b, tracks[n]);
-    }
-    /* Get the old track count */
-    if((s = kvp_get(k, "count")))
-      oldcount = atoi(s);
-    else
-      oldcount = 0;
-    /* Delete old slots */
-    for(; n < oldcount; ++n) {
-      snprintf(b, sizeof b, "%d", n);
-      kvp_set(&k, b, NULL);
-    }
-    /* Set the new count */
-    snprintf(b, sizeof b, "%d", ntracks);
-    kvp_set(&k, "count", b);
+  if(edit->share)
+    pl.share = edit->share;
+  if(edit->replace) {
+    position = 0;
+    nremove = pl.ntracks;
+  } else {
+    position = edit->position;
+    nremove = edit->nremove;
+    if(position < 0 || position > pl.ntracks
+       || nremove < 0 || nremove > pl.ntracks - position
+       || (edit->move_to >= 0 && edit->move_to > pl.ntracks - nremove))
+      return ERANGE;
+  }
+  /* Sanity check track count.  Only an edit that makes the playlist longer
+   * is refused for exceeding playlist_max, so that one which is already too
+   * long can still be cut down or rearranged. */
+  remaining = pl.ntracks - (edit->move_to >= 0 ? 0 : nremove);
+  if(edit->ntracks < 0
+     || (edit->ntracks > pl.ntracks - remaining
+         && edit->ntracks > config->playlist_max - remaining)) {
+    disorder_error(0, "invalid track count %d", edit->ntracks + remaining);
+    return EINVAL;
+  }
+  if(edit->move_to >= 0) {
+    moved = xcalloc(nremove, sizeof *moved);
+    if((e = playlist_range(&pl, position, nremove, moved, tid)))
+      return e;
   }
+  if((e = playlist_remove(&pl, position, nremove, tid)))
+    return e;
+  if(moved && (e = playlist_insert(&pl, edit->move_to, moved, nremove, tid)))
+    return e;
+  if((e = playlist_insert(&pl, position, edit->tracks, edit->ntracks, tid)))
+    return e;
   /* Store the resulting record */
-  e = trackdb_putdata(trackdb_playlistsdb, name, k, tid, 0);
+  e = playlist_store(&pl, tid);
   /* Log the event */
   if(!e)
-    eventlog(event, name, kvp_get(k, "sharing"), (char *)0);
+    eventlog(event, name, pl.share, (char *)0);
   return e;
 }
 
@@ -356,6 +1007,9 @@ static int trackdb_playlist_list_tid(const char *who,
   c = trackdb_opencursor(trackdb_playlistsdb, tid);
   memset(k, 0, sizeof k);
   while(!(e = c->c_get(c, k, prepare_data(d), DB_NEXT))) {
+    /* Skip playlist chunks */
+    if(memchr(k->data, '/', k->size))
+      continue;
     char *name = xstrndup(k->data, k->size), *owner;
     const char *share = kvp_get(kvp_urldecode(d->data, d->size),
                                 "sharing");
@@ -426,20 +1080,20 @@ int trackdb_playlist_delete(const char *name,
 static int trackdb_playlist_delete_tid(const char *name,
                                        const char *who,
                                        DB_TXN *tid) {
-  struct kvp *k;
+  struct playlist pl;
   int e;
-  const char *s;
 
-  if((e = trackdb_getdata(trackdb_playlistsdb, name, &k, tid)))
+  if((e = playlist_read(name, &pl, tid)))
     return e;
   /* Check that modification is allowed */
-  if(!(s = kvp_get(k, "sharing"))) {
-    disorder_error(0, "playlist '%s' has no 'sharing' key", name);
-    s = "private";
-  }
-  if(!playlist_may_write(name, who, s))
+  if(!playlist_may_write(name, who, pl.share))
     return EACCES;
-  /* Delete the playlist */
+  /* Delete the chunks and then the playlist */
+  for(int n = 0; n < pl.chunks.nvec; ++n)
+    if((e = trackdb_delkey(trackdb_playlistsdb,
+                           playlist_chunk_key(name, pl.chunks.vec[n].id),
+                           tid)))
+      return e;
   e = trackdb_delkey(trackdb_playlistsdb, name, tid);
   if(!e)
     eventlog("playlist_deleted", name, 0);
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2005-2008 Richard Kettlewell
+ * Copyright (C) 2005-2008, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -71,13 +71,22 @@ static const char *getpart(const char *track,
                            int *used_db);
 static char **trackdb_new_tid(int *ntracksp,
                               int maxtracks,
+                              struct mem_arena *arena,
                               DB_TXN *tid);
 static int trackdb_expire_noticed_tid(time_t earliest, DB_TXN *tid);
 static char *normalize_tag(const char *s, size_t ns);
 
-const struct cache_type cache_files_type = { 86400 };
+static size_t cache_files_size(const void *value);
+
+const struct cache_type cache_files_type = { 86400, cache_files_size };
 unsigned long cache_files_hits, cache_files_misses;
 
+/** @brief Number of transactions retried
+ *
+ * Incremented by trackdb_abort_to_retry().
+ */
+unsigned long trackdb_retries;
+
 /** @brief Set by trackdb_open() */
 int trackdb_existing_database;
 
@@ -165,9 +174,12 @@ DB *trackdb_scheduledb;
 DB *trackdb_usersdb;
 
 /** @brief The playlists database
- * - Keys are playlist names
- * - Values are encoded key-value pairs
+ * - Keys are playlist names, or @c NAME/ID for the chunks of a playlist
+ * - Values are encoded key-value pairs: a header for a playlist, or the
+ *   tracks of a chunk
  * - Data is user data and cannot be reconstructed
+ *
+ * See lib/trackdb-playlists.c for the details.
  */
 DB *trackdb_playlistsdb;
 
@@ -804,6 +816,16 @@ void trackdb_abort_transaction(DB_TXN *tid) {
       disorder_fatal(0, "tid->abort: %s", db_strerror(err));
 }
 
+/** @brief Abort a transaction that will be retried
+ * @param tid Transaction (or NULL)
+ *
+ * Used by loops that start again after deadlock.
+ */
+void trackdb_abort_to_retry(DB_TXN *tid) {
+  ++trackdb_retries;
+  trackdb_abort_transaction(tid);
+}
+
 /** @brief Commit transaction
  * @param tid Transaction (must not be NULL)
  */
@@ -943,7 +965,15 @@ static void word_split(struct vector *v,
                        unicode_property_tailor *pt) {
   size_t nw, nt32, i;
   uint32_t *t32, **w32;
+  char **w;
 
+  /* Most names are ASCII, which can be split without converting to UTF-32 */
+  if((w = utf8_casefold_word_split_ascii(s, strlen(s), &nw, pt))) {
+    for(i = 0; i < nw; ++i)
+      vector_append(v, w[i]);
+    xfree(w);
+    return;
+  }
   /* Convert to UTF-32 */
   if(!(t32 = utf8_to_utf32(s, strlen(s), &nt32)))
     return;
@@ -974,7 +1004,18 @@ static char *normalize_tag(const char *s, size_t ns) {
   uint32_t *s32, **w32;
   size_t ns32, nw32, i;
   struct dynstr d[1];
+  char **w;
 
+  dynstr_init(d);
+  if((w = utf8_casefold_word_split_ascii(s, ns, &nw32, 0))) {
+    for(i = 0; i < nw32; ++i) {
+      if(i)
+        dynstr_append(d, ' ');
+      dynstr_append_string(d, w[i]);
+    }
+    dynstr_terminate(d);
+    return d->vec;
+  }
   if(!(s32 = utf8_to_utf32(s, ns, &ns32)))
     return 0;
   if(!(s32 = utf32_casefold_compat(s32, ns32, &ns32))) /* ->NFKD */
@@ -983,7 +1024,6 @@ static char *normalize_tag(const char *s, size_t ns) {
   /* Split into words, no Word_Break tailoring */
   w32 = utf32_word_split(s32, ns32, &nw32, 0);
   /* Compose back into a string */
-  dynstr_init(d);
   for(i = 0; i < nw32; ++i) {
     if(i)
       dynstr_append(d, ' ');
@@ -1257,7 +1297,7 @@ int trackdb_notice(const char *track,
     if(err == DB_LOCK_DEADLOCK) goto fail;
     break;
   fail:
-    trackdb_abort_transaction(tid);
+    trackdb_abort_to_retry(tid);
   }
   trackdb_commit_transaction(tid);
   return err;
@@ -1587,7 +1627,7 @@ char **trackdb_stats(int *nstatsp) {
     vector_terminate(&v);
     break;
 fail:
-    trackdb_abort_transaction(tid);
+    trackdb_abort_to_retry(tid);
   }
   trackdb_commit_transaction(tid);
   if(nstatsp) *nstatsp = v.nvec;
@@ -1876,7 +1916,7 @@ int trackdb_set(const char *track,
     err = 0;
     break;
 fail:
-    trackdb_abort_transaction(tid);
+    trackdb_abort_to_retry(tid);
   }
   trackdb_commit_transaction(tid);
   return err == 0 ? 0 : -1;
@@ -1906,7 +1946,7 @@ struct kvp *trackdb_get_all(const char *track) {
       goto fail;
     break;
 fail:
-    trackdb_abort_transaction(tid);
+    trackdb_abort_to_retry(tid);
   }
   trackdb_commit_transaction(tid);
   for(pp = &p; *pp; pp = &(*pp)->next)
@@ -1929,7 +1969,7 @@ const char *trackdb_resolve(const char *track) {
       goto fail;
     break;
 fail:
-    trackdb_abort_transaction(tid);
+    trackdb_abort_to_retry(tid);
   }
   trackdb_commit_transaction(tid);
   return actual;
@@ -1960,7 +2000,7 @@ int trackdb_exists(const char *track) {
       goto fail;
     break;
 fail:
-    trackdb_abort_transaction(tid);
+    trackdb_abort_to_retry(tid);
   }
   trackdb_commit_transaction(tid);
   return (err == 0);
@@ -2188,7 +2228,7 @@ const char *trackdb_getpart(const char *track,
       goto fail;
     break;
 fail:
-    trackdb_abort_transaction(tid);
+    trackdb_abort_to_retry(tid);
   }
   trackdb_commit_transaction(tid);
   return getpart(actual, context, part, p, &used_db);
@@ -2211,7 +2251,7 @@ const char *trackdb_rawpath(const char *track) {
       goto fail;
     break;
 fail:
-    trackdb_abort_transaction(tid);
+    trackdb_abort_to_retry(tid);
   }
   trackdb_commit_transaction(tid);
   if(!(path = kvp_get(t, "_path"))) path = track;
@@ -2220,6 +2260,16 @@ fail:
 
 /* trackdb_list **************************************************************/
 
+/** @brief Report the size of a cached trackdb_list() result */
+static size_t cache_files_size(const void *value) {
+  char *const *vec = value;
+  size_t n = sizeof *vec;
+
+  for(; *vec; ++vec)
+    n += sizeof *vec + strlen(*vec) + 1;
+  return n;
+}
+
 /* this is incredibly ugly, sorry, perhaps it will be rewritten to be actually
  * readable at some point */
 
@@ -2258,47 +2308,87 @@ static int track_matches(size_t dl, const char *track, size_t tl,
   }
 }
 
-/** @brief Generate a list of tracks and/or directories in @p dir
+/** @brief State of a listing produced a step at a time */
+struct trackdb_listing {
+  /** @brief Directories to list */
+  char **dirs;
+
+  /** @brief Number of directories to list */
+  int ndirs;
+
+  /** @brief Index into @ref dirs of the directory being listed */
+  int n;
+
+  /** @brief Bitmap of objects to return */
+  enum trackdb_listable what;
+
+  /** @brief Regexp to filter matches, or NULL */
+  const regexp *re;
+
+  /** @brief Key to resume from, or NULL to start at the directory */
+  char *resume;
+
+  /** @brief Last subdirectory reported in this directory, or NULL */
+  char *last_dir;
+
+  /** @brief Length of @ref last_dir */
+  size_t last_dir_len;
+};
+
+/** @brief Generate a list of tracks and/or directories in the current directory
  * @param v Where to put results
- * @param dir Directory to list
- * @param what Bitmap of objects to return
- * @param re Regexp to filter matches (or NULL to accept all)
+ * @param ls Listing state
+ * @param limit Maximum number of keys to examine, or 0 for no limit
+ * @param examined Number of keys examined so far in this step
  * @param tid Owning transaction
  * @return 0 or DB_LOCK_DEADLOCK
- */
-static int do_list(struct vector *v, const char *dir,
-                   enum trackdb_listable what, const regexp *re, DB_TXN *tid) {
+ *
+ * On return @p ls->resume is NULL if the directory is finished and otherwise
+ * the first key that wasn't examined.
+ */
+static int do_list(struct vector *v, struct trackdb_listing *ls,
+                   size_t limit, size_t *examined, DB_TXN *tid) {
+  const char *const dir = ls->dirs[ls->n];
+  const enum trackdb_listable what = ls->what;
+  const regexp *const re = ls->re;
   DBC *cursor;
   DBT k, d;
   size_t dl;
   char *ptr;
   int err;
-  size_t l, last_dir_len = 0;
-  char *last_dir = 0, *track;
+  size_t l;
+  char *track;
   struct kvp *p;
 
   dl = strlen(dir);
   cursor = trackdb_opencursor(trackdb_tracksdb, tid);
-  make_key(&k, dir);
+  make_key(&k, ls->resume ? ls->resume : dir);
   prepare_data(&d);
-  /* find the first key >= dir */
+  /* find the first key >= dir, or where the last step left off */
   err = cursor->c_get(cursor, &k, &d, DB_SET_RANGE);
+  ls->resume = 0;
   /* keep going while we're dealing with <dir/anything> */
   while(err == 0
 	&& k.size > dl
 	&& ((char *)k.data)[dl] == '/'
 	&& !memcmp(k.data, dir, dl)) {
+    if(limit && *examined >= limit) {
+      /* Out of time for this step, pick up here next time */
+      ls->resume = xstrndup(k.data, k.size);
+      break;
+    }
+    ++*examined;
     ptr = memchr((char *)k.data + dl + 1, '/', k.size - (dl + 1));
     if(ptr) {
       /* we have <dir/component/anything>, so <dir/component> is a directory */
       l = ptr - (char *)k.data;
       if(what & trackdb_directories)
-	if(!(last_dir
-	     && l == last_dir_len
-	     && !memcmp(last_dir, k.data, l))) {
-	  last_dir = xstrndup(k.data, last_dir_len = l);
+	if(!(ls->last_dir
+	     && l == ls->last_dir_len
+	     && !memcmp(ls->last_dir, k.data, l))) {
+	  ls->last_dir = xstrndup(k.data, ls->last_dir_len = l);
 	  if(track_matches(dl, k.data, l, re))
-	    vector_append(v, last_dir);
+	    vector_append(v, ls->last_dir);
 	}
     } else {
       /* found a plain file */
@@ -2357,36 +2447,84 @@ deadlocked:
   return err;
 }
 
-/** @brief Get the directories or files below @p dir
- * @param dir Directory to list
- * @param np Where to put number of results (or NULL)
+/** @brief Start listing the directories or files below @p dir
+ * @param dir Directory to list, or NULL for all collections
  * @param what Bitmap of objects to return
  * @param re Regexp to filter matches (or NULL to accept all)
- * @return List of tracks
+ * @return Listing state for trackdb_listing_next()
  */
-char **trackdb_list(const char *dir, int *np, enum trackdb_listable what,
-                    const regexp *re) {
-  DB_TXN *tid;
+struct trackdb_listing *trackdb_listing_open(const char *dir,
+                                             enum trackdb_listable what,
+                                             const regexp *re) {
+  struct trackdb_listing *ls = xmalloc(sizeof *ls);
   int n;
-  struct vector v;
 
-  vector_init(&v);
+  if(dir) {
+    ls->dirs = xmalloc(sizeof *ls->dirs);
+    ls->dirs[0] = xstrdup(dir);
+    ls->ndirs = 1;
+  } else {
+    ls->dirs = xcalloc(config->collection.n, sizeof *ls->dirs);
+    for(n = 0; n < config->collection.n; ++n)
+      ls->dirs[n] = xstrdup(config->collection.s[n].root);
+    ls->ndirs = config->collection.n;
+  }
+  ls->what = what;
+  ls->re = re;
+  return ls;
+}
+
+/** @brief Get the next part of a listing
+ * @param ls Listing state from trackdb_listing_open()
+ * @param v Where to append results
+ * @param limit Maximum number of keys to examine, or 0 for no limit
+ * @return Nonzero if there may be more results, 0 if the listing is finished
+ *
+ * Each call is a separate transaction, so a listing made in several steps
+ * reflects any changes to the database made between them.  Since keys are
+ * visited in order, no track is reported twice.
+ */
+int trackdb_listing_next(struct trackdb_listing *ls, struct vector *v,
+                         size_t limit) {
+  const struct trackdb_listing saved = *ls;
+  const int nvec = v->nvec;
+  DB_TXN *tid;
+  size_t examined;
+
   for(;;) {
     tid = trackdb_begin_transaction();
-    v.nvec = 0;
-    if(dir) {
-      if(do_list(&v, dir, what, re, tid))
+    examined = 0;
+    while(ls->n < ls->ndirs) {
+      if(do_list(v, ls, limit, &examined, tid))
         goto fail;
-    } else {
-      for(n = 0; n < config->collection.n; ++n)
-        if(do_list(&v, config->collection.s[n].root, what, re, tid))
-          goto fail;
+      if(ls->resume)
+        break;
+      ++ls->n;
+      ls->last_dir = 0;
     }
     break;
 fail:
-    trackdb_abort_transaction(tid);
+    trackdb_abort_to_retry(tid);
+    *ls = saved;
+    v->nvec = nvec;
   }
   trackdb_commit_transaction(tid);
+  return ls->n < ls->ndirs;
+}
+
+/** @brief Get the directories or files below @p dir
+ * @param dir Directory to list
+ * @param np Where to put number of results (or NULL)
+ * @param what Bitmap of objects to return
+ * @param re Regexp to filter matches (or NULL to accept all)
+ * @return List of tracks
+ */
+char **trackdb_list(const char *dir, int *np, enum trackdb_listable what,
+                    const regexp *re) {
+  struct vector v;
+
+  vector_init(&v);
+  trackdb_listing_next(trackdb_listing_open(dir, what, re), &v, 0);
   vector_terminate(&v);
   if(np)
     *np = v.nvec;
@@ -2406,9 +2544,49 @@ static const char *checktag(const char *s) {
     return 0;
 }
 
+/** @brief Copy a track name into a result
+ * @param arena Arena to allocate from, or NULL for the heap
+ * @param s Track name (not 0-terminated)
+ * @param n Length of track name
+ * @return Copy of track name
+ */
+static char *result_strndup(struct mem_arena *arena, const char *s, size_t n) {
+  return arena ? mem_arena_strndup(arena, s, n) : xstrndup(s, n);
+}
+
+/** @brief Append to a result vector
+ * @param arena Arena to allocate from, or NULL for the heap
+ * @param v Vector, which must only ever have been grown this way
+ * @param s String to append, or NULL to terminate @p v
+ *
+ * Terminating @p v doesn't change its length.
+ */
+static void result_append(struct mem_arena *arena, struct vector *v, char *s) {
+  int old;
+
+  if(!arena) {
+    if(s)
+      vector_append(v, s);
+    else
+      vector_terminate(v);
+    return;
+  }
+  if(v->nvec >= v->nslots) {
+    old = v->nslots;
+    v->nslots = old ? 2 * old : 16;
+    v->vec = mem_arena_realloc(arena, v->vec, old * sizeof (char *),
+                               v->nslots * sizeof (char *));
+  }
+  v->vec[v->nvec] = s;
+  if(s)
+    ++v->nvec;
+}
+
 /* return a list of tracks containing all of the words given.  If you
- * ask for only stopwords you get no tracks. */
-char **trackdb_search(char **wordlist, int nwordlist, int *ntracks) {
+ * ask for only stopwords you get no tracks.  If ARENA is not NULL then the
+ * result comes from it. */
+char **trackdb_search(char **wordlist, int nwordlist, int *ntracks,
+                      struct mem_arena *arena) {
   const char **w, *best = 0, *tag;
   char **twords, **tags;
   char *istag;
@@ -2479,7 +2657,7 @@ char **trackdb_search(char **wordlist, int nwordlist, int *ntracks) {
     v.nvec = 0;
     cursor = trackdb_opencursor(db, tid);
     while(!(err = cursor->c_get(cursor, &k, &d, what))) {
-      vector_append(&v, xstrndup(d.data, d.size));
+      result_append(arena, &v, result_strndup(arena, d.data, d.size));
       what = DB_NEXT_DUP;
     }
     switch(err) {
@@ -2526,17 +2704,17 @@ char **trackdb_search(char **wordlist, int nwordlist, int *ntracks) {
         }
       }
       if(i >= nwordlist)                /* all words found */
-        vector_append(&u, v.vec[n]);
+        result_append(arena, &u, v.vec[n]);
     }
     break;
   fail:
     trackdb_closecursor(cursor);
     cursor = 0;
-    trackdb_abort_transaction(tid);
+    trackdb_abort_to_retry(tid);
     disorder_info("retrying search");
   }
   trackdb_commit_transaction(tid);
-  vector_terminate(&u);
+  result_append(arena, &u, NULL);
   if(ntracks)
     *ntracks = u.nvec;
   return u.vec;
@@ -2752,7 +2930,7 @@ int trackdb_set_global(const char *name,
     err = trackdb_set_global_tid(name, value, tid);
     if(err != DB_LOCK_DEADLOCK)
       break;
-    trackdb_abort_transaction(tid);
+    trackdb_abort_to_retry(tid);
   }
   trackdb_commit_transaction(tid);
   /* log important state changes */
@@ -2815,7 +2993,7 @@ const char *trackdb_get_global(const char *name) {
     tid = trackdb_begin_transaction();
     if(!trackdb_get_global_tid(name, tid, &r))
       break;
-    trackdb_abort_transaction(tid);
+    trackdb_abort_to_retry(tid);
   }
   trackdb_commit_transaction(tid);
   return r;
@@ -2854,21 +3032,23 @@ int trackdb_get_global_tid(const char *name,
 /** @brief Retrieve the most recently added tracks
  * @param ntracksp Where to put count, or 0
  * @param maxtracks Maximum number of tracks to retrieve
+ * @param arena Arena for the result, or NULL for the heap
  * @return null-terminated array of track names
  *
  * The most recently added track is first in the array.
  */
 char **trackdb_new(int *ntracksp,
-                   int maxtracks) {
+                   int maxtracks,
+                   struct mem_arena *arena) {
   DB_TXN *tid;
   char **tracks;
 
   for(;;) {
     tid = trackdb_begin_transaction();
-    tracks = trackdb_new_tid(ntracksp, maxtracks, tid);
+    tracks = trackdb_new_tid(ntracksp, maxtracks, arena, tid);
     if(tracks)
       break;
-    trackdb_abort_transaction(tid);
+    trackdb_abort_to_retry(tid);
   }
   trackdb_commit_transaction(tid);
   return tracks;
@@ -2877,6 +3057,7 @@ char **trackdb_new(int *ntracksp,
 /** @brief Retrieve the most recently added tracks
  * @param ntracksp Where to put count, or 0
  * @param maxtracks Maximum number of tracks to retrieve, or 0 for all
+ * @param arena Arena for the result, or NULL for the heap
  * @param tid Transaction ID
  * @return null-terminated array of track names, or NULL on deadlock
  *
@@ -2884,6 +3065,7 @@ char **trackdb_new(int *ntracksp,
  */
 static char **trackdb_new_tid(int *ntracksp,
                               int maxtracks,
+                              struct mem_arena *arena,
                               DB_TXN *tid) {
   DBC *c;
   DBT k, d;
@@ -2895,7 +3077,7 @@ static char **trackdb_new_tid(int *ntracksp,
   c = trackdb_opencursor(trackdb_noticeddb, tid);
   while((maxtracks <= 0 || tracks->nvec < maxtracks)
         && !(err = c->c_get(c, prepare_data(&k), prepare_data(&d), DB_PREV))) {
-    char *const track = xstrndup(d.data, d.size);
+    char *const track = result_strndup(arena, d.data, d.size);
     /* Don't add any track more than once */
     if(hash_add(h, track, "", HASH_INSERT))
       continue;
@@ -2905,7 +3087,7 @@ static char **trackdb_new_tid(int *ntracksp,
       continue;                         /* It doesn't, skip it */
     if(err == DB_LOCK_DEADLOCK)
       break;                            /* Doh */
-    vector_append(tracks, track);
+    result_append(arena, tracks, track);
   }
   switch(err) {
   case 0:                               /* hit maxtracks */
@@ -2919,7 +3101,7 @@ static char **trackdb_new_tid(int *ntracksp,
   }
   if(trackdb_closecursor(c))
     return 0;                           /* deadlock */
-  vector_terminate(tracks);
+  result_append(arena, tracks, NULL);
   if(ntracksp)
     *ntracksp = tracks->nvec;
   return tracks->vec;
@@ -2935,7 +3117,7 @@ void trackdb_expire_noticed(time_t earliest) {
     tid = trackdb_begin_transaction();
     if(!trackdb_expire_noticed_tid(earliest, tid))
       break;
-    trackdb_abort_transaction(tid);
+    trackdb_abort_to_retry(tid);
   }
   trackdb_commit_transaction(tid);
 }
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2005-2008 Richard Kettlewell
+ * Copyright (C) 2005-2008, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -25,10 +25,17 @@
 #include "regexp.h"
 #include "rights.h"
 
+struct vector;
+struct trackdb_listing;
+struct mem_arena;
+
 extern const struct cache_type cache_files_type;
 extern unsigned long cache_files_hits, cache_files_misses;
 /* Cache entry type and tracking for regexp-based lookups */
 
+extern unsigned long trackdb_retries;
+/* Number of transactions retried, usually because of deadlock */
+
 /** @brief Do not attempt database recovery (trackdb_init()) */
 #define TRACKDB_NO_RECOVER 0x0000
 
@@ -132,9 +139,23 @@ char **trackdb_list(const char *dir, int *np, enum trackdb_listable what,
  * regexp are returned.
  */
 
-char **trackdb_search(char **wordlist, int nwordlist, int *ntracks);
+struct trackdb_listing *trackdb_listing_open(const char *dir,
+                                             enum trackdb_listable what,
+                                             const regexp *rec);
+/* Start a listing of the directories and/or files below DIR, as for
+ * trackdb_list(), to be produced a step at a time. */
+
+int trackdb_listing_next(struct trackdb_listing *ls, struct vector *v,
+                         size_t limit);
+/* Append the next part of listing LS to V, examining at most LIMIT database
+ * keys (0 for no limit).  Returns nonzero if there may be more to come.
+ * Each step is a separate transaction. */
+
+char **trackdb_search(char **wordlist, int nwordlist, int *ntracks,
+                      struct mem_arena *arena);
 /* return a list of tracks containing all of the words given.  If you
- * ask for only stopwords you get no tracks. */
+ * ask for only stopwords you get no tracks.  If ARENA is not NULL then the
+ * result comes from it. */
 
 void trackdb_rescan(struct ev_source *ev, int recheck,
                     void (*rescanned)(void *ru),
@@ -155,7 +176,7 @@ int trackdb_set_global(const char *name,
 const char *trackdb_get_global(const char *name);
 /* get a global pref */
 
-char **trackdb_new(int *ntracksp, int maxtracks);
+char **trackdb_new(int *ntracksp, int maxtracks, struct mem_arena *arena);
 
 void trackdb_expire_noticed(time_t when);
 void trackdb_create_root(void);
@@ -192,6 +213,20 @@ int trackdb_playlist_set(const char *name,
                          char **tracks,
                          int ntracks,
                          const char *share);
+int trackdb_playlist_insert(const char *name,
+                            const char *who,
+                            int position,
+                            char **tracks,
+                            int ntracks);
+int trackdb_playlist_remove(const char *name,
+                            const char *who,
+                            int position,
+                            int count);
+int trackdb_playlist_move(const char *name,
+                          const char *who,
+                          int from,
+                          int count,
+                          int to);
 void trackdb_playlist_list(const char *who,
                            char ***playlistsp,
                            int *nplaylistsp);
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2005, 2006, 2007 Richard Kettlewell
+ * Copyright (C) 2005, 2006, 2007, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -27,6 +27,70 @@
 #include "log.h"
 #include "filepart.h"
 #include "unicode.h"
+#include "mem.h"
+
+/** @brief The rules that apply to one part or type in one context
+ *
+ * The namepart (or transform) rules whose part (or type) matches and whose
+ * context glob matches, in configuration order.
+ */
+struct trackname_ruleset {
+  /** @brief Next ruleset */
+  struct trackname_ruleset *next;
+
+  /** @brief Nonzero for transform rules, 0 for namepart rules */
+  int transform;
+
+  /** @brief Part name or transform type */
+  char *name;
+
+  /** @brief Context */
+  char *context;
+
+  /** @brief Number of rules */
+  int nrules;
+
+  /** @brief Indexes into @c config->namepart.s or @c config->transform.t */
+  int *rules;
+};
+
+/** @brief A remembered result */
+struct trackname_memo {
+  /** @brief Ruleset that produced the result, or NULL if unused */
+  const struct trackname_ruleset *rs;
+
+  /** @brief Hash of @ref rs and @ref subject */
+  uint32_t hash;
+
+  /** @brief Track name or subject */
+  char *subject;
+
+  /** @brief Result, or NULL if it was the subject unchanged */
+  const char *result;
+};
+
+/** @brief Number of results in each set of the memo */
+#define TRACKNAME_MEMO_WAYS 4
+
+/** @brief Number of sets in the memo */
+#define TRACKNAME_MEMO_SETS (TRACKNAME_MEMO_SIZE / TRACKNAME_MEMO_WAYS)
+
+/** @brief Name rules and results for one configuration
+ *
+ * Hung off @ref config::trackname_rules, so that a new configuration starts
+ * afresh.  Rulesets are built the first time each (part, context) pair is
+ * asked for, since contexts are globs and can't be enumerated in advance.
+ * The memo is a set-associative cache holding at most @ref
+ * TRACKNAME_MEMO_SIZE results.  Each set is kept in order of use, most
+ * recent first.
+ */
+struct trackname_rules {
+  /** @brief Rulesets built so far */
+  struct trackname_ruleset *rulesets;
+
+  /** @brief Remembered results */
+  struct trackname_memo memo[TRACKNAME_MEMO_SETS][TRACKNAME_MEMO_WAYS];
+};
 
 const struct collection *find_track_collection(const char *track) {
   int n;
@@ -64,48 +128,200 @@ const char *track_rootless(const char *track) {
   return track + strlen(root);
 }
 
+/** @brief Find the rules for a part or type in a context
+ * @param transform Nonzero for transform rules, 0 for namepart rules
+ * @param name Part name or transform type
+ * @param context Context
+ * @return Ruleset
+ */
+static const struct trackname_ruleset *find_ruleset(int transform,
+                                                    const char *name,
+                                                    const char *context) {
+  struct trackname_rules *tr = config->trackname_rules;
+  struct trackname_ruleset *rs;
+  int n;
+
+  if(!tr)
+    tr = config->trackname_rules = xcalloc(1, sizeof *tr);
+  for(rs = tr->rulesets; rs; rs = rs->next)
+    if(rs->transform == transform
+       && !strcmp(rs->name, name)
+       && !strcmp(rs->context, context))
+      return rs;
+  rs = xmalloc(sizeof *rs);
+  rs->transform = transform;
+  rs->name = xstrdup(name);
+  rs->context = xstrdup(context);
+  rs->nrules = 0;
+  if(transform) {
+    rs->rules = xcalloc(config->transform.n + 1, sizeof *rs->rules);
+    for(n = 0; n < config->transform.n; ++n)
+      if(!strcmp(config->transform.t[n].type, name)
+         && fnmatch(config->transform.t[n].context, context, 0) == 0)
+        rs->rules[rs->nrules++] = n;
+  } else {
+    rs->rules = xcalloc(config->namepart.n + 1, sizeof *rs->rules);
+    for(n = 0; n < config->namepart.n; ++n)
+      if(!strcmp(config->namepart.s[n].part, name)
+         && fnmatch(config->namepart.s[n].context, context, 0) == 0)
+        rs->rules[rs->nrules++] = n;
+  }
+  rs->next = tr->rulesets;
+  tr->rulesets = rs;
+  return rs;
+}
+
+/** @brief Look up a remembered result
+ * @param rs Ruleset
+ * @param subject Track name or subject
+ * @param hashp Where to store the hash, for remember()
+ * @return Remembered result or NULL
+ */
+static const struct trackname_memo *recall(const struct trackname_ruleset *rs,
+                                           const char *subject,
+                                           uint32_t *hashp) {
+  const unsigned char *s = (const unsigned char *)subject;
+  uint32_t h = 2166136261u;             /* FNV-1a */
+  struct trackname_memo *set, m;
+  int n;
+
+  while(*s)
+    h = (h ^ *s++) * 16777619u;
+  h ^= (uint32_t)((uintptr_t)rs >> 4) * 2654435761u;
+  *hashp = h;
+  set = config->trackname_rules->memo[h % TRACKNAME_MEMO_SETS];
+  for(n = 0; n < TRACKNAME_MEMO_WAYS; ++n)
+    if(set[n].rs == rs && set[n].hash == h && !strcmp(set[n].subject, subject))
+      break;
+  if(n >= TRACKNAME_MEMO_WAYS)
+    return NULL;
+  /* Move to the front */
+  m = set[n];
+  memmove(set + 1, set, n * sizeof *set);
+  set[0] = m;
+  return &set[0];
+}
+
+/** @brief Remember a result
+ * @param rs Ruleset
+ * @param subject Track name or subject
+ * @param hash Hash from recall()
+ * @param result Result, or NULL if it was @p subject unchanged
+ *
+ * The least recently used result in the set is evicted.  It is not freed,
+ * since callers may still have it.
+ */
+static void remember(const struct trackname_ruleset *rs,
+                     const char *subject,
+                     uint32_t hash,
+                     const char *result) {
+  struct trackname_memo *set
+    = config->trackname_rules->memo[hash % TRACKNAME_MEMO_SETS];
+
+  xfree(set[TRACKNAME_MEMO_WAYS - 1].subject);
+  memmove(set + 1, set, (TRACKNAME_MEMO_WAYS - 1) * sizeof *set);
+  set[0].rs = rs;
+  set[0].hash = hash;
+  set[0].subject = xstrdup(subject);
+  set[0].result = result;
+}
+
 const char *trackname_part(const char *track,
 			   const char *context,
 			   const char *part) {
   int n;
-  const char *replaced, *rootless;
+  const char *replaced, *rootless, *subject;
+  const struct trackname_ruleset *rs;
+  const struct namepart *np;
+  const struct trackname_memo *m;
+  uint32_t hash;
 
   assert(track != 0);
   if(!strcmp(part, "path")) return track;
   if(!strcmp(part, "ext")) return extension(track);
-  if((rootless = track_rootless(track))) track = rootless;
-  for(n = 0; n < config->namepart.n; ++n) {
-    if(!strcmp(config->namepart.s[n].part, part)
-       && fnmatch(config->namepart.s[n].context, context, 0) == 0) {
-      if((replaced = regsub(config->namepart.s[n].re,
-			    track,
-			    config->namepart.s[n].replace,
-			    config->namepart.s[n].reflags
-			    |REGSUB_MUST_MATCH
-			    |REGSUB_REPLACE)))
-	return replaced;
-    }
+  rs = find_ruleset(0, part, context);
+  if((m = recall(rs, track, &hash)))
+    return m->result;
+  subject = track;
+  if((rootless = track_rootless(track))) subject = rootless;
+  replaced = "";
+  for(n = 0; n < rs->nrules; ++n) {
+    np = &config->namepart.s[rs->rules[n]];
+    if((replaced = regsub(np->re, subject, np->replace,
+                          np->reflags|REGSUB_MUST_MATCH|REGSUB_REPLACE)))
+      break;
+    replaced = "";
   }
-  return "";
+  remember(rs, track, hash, replaced);
+  return replaced;
 }
 
 const char *trackname_transform(const char *type,
 				const char *subject,
 				const char *context) {
-  const char *replaced;
+  const char *replaced, *result = subject;
   int n;
   const struct transform *k;
+  const struct trackname_ruleset *rs;
+  const struct trackname_memo *m;
+  uint32_t hash;
+
+  rs = find_ruleset(1, type, context);
+  if((m = recall(rs, subject, &hash)))
+    return m->result ? m->result : subject;
+  for(n = 0; n < rs->nrules; ++n) {
+    k = &config->transform.t[rs->rules[n]];
+    if((replaced = regsub(k->re, result, k->replace, k->flags)))
+      result = replaced;
+  }
+  /* An unchanged subject belongs to the caller, so hand back theirs on a hit */
+  remember(rs, subject, hash, result == subject ? NULL : result);
+  return result;
+}
+
+/** @brief Report memo usage
+ * @param entries Where to store the number of remembered results
+ * @param bytes Where to store the approximate memory used by the memo
+ */
+void trackname_memo_usage(size_t *entries, size_t *bytes) {
+  const struct trackname_rules *const tr = config->trackname_rules;
+  const struct trackname_memo *m;
+
+  *entries = *bytes = 0;
+  if(!tr)
+    return;
+  *bytes = sizeof *tr;
+  for(int n = 0; n < TRACKNAME_MEMO_SETS; ++n)
+    for(int w = 0; w < TRACKNAME_MEMO_WAYS; ++w) {
+      m = &tr->memo[n][w];
+      if(!m->rs)
+        continue;
+      ++*entries;
+      *bytes += strlen(m->subject) + 1;
+      if(m->result)
+        *bytes += strlen(m->result) + 1;
+    }
+}
+
+/** @brief Free a configuration's name rules and memo
+ * @param tr Rules to free, or NULL
+ */
+void trackname_rules_free(struct trackname_rules *tr) {
+  struct trackname_ruleset *rs;
 
-  for(n = 0; n < config->transform.n; ++n) {
-    k = &config->transform.t[n];
-    if(strcmp(k->type, type))
-      continue;
-    if(fnmatch(k->context, context, 0) != 0)
-      continue;
-    if((replaced = regsub(k->re, subject, k->replace, k->flags)))
-      subject = replaced;
+  if(!tr)
+    return;
+  while((rs = tr->rulesets)) {
+    tr->rulesets = rs->next;
+    xfree(rs->name);
+    xfree(rs->context);
+    xfree(rs->rules);
+    xfree(rs);
   }
-  return subject;
+  for(int n = 0; n < TRACKNAME_MEMO_SETS; ++n)
+    for(int w = 0; w < TRACKNAME_MEMO_WAYS; ++w)
+      xfree(tr->memo[n][w].subject);
+  xfree(tr);
 }
 
 /*
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2005-2008 Richard Kettlewell
+ * Copyright (C) 2005-2008, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -21,6 +21,8 @@
 #ifndef TRACKNAME_H
 #define TRACKNAME_H
 
+struct trackname_rules;
+
 const struct collection *find_track_collection(const char *track);
 /* find the collection for @track@ */
 
@@ -41,11 +43,45 @@ const char *trackname_transform(const char *type,
 /* convert SUBJECT (usually 'track' or 'dir' according to TYPE) for CONTEXT
  * (display/sort) */
 
+/** @brief Number of results remembered by trackname_part() and
+ * trackname_transform() (a power of 2) */
+#define TRACKNAME_MEMO_SIZE 16384
+
+void trackname_rules_free(struct trackname_rules *tr);
+/* free the rule index and memo built for a configuration */
+
+void trackname_memo_usage(size_t *entries, size_t *bytes);
+/* report how many results are remembered for the current configuration and
+ * the approximate memory they use */
+
 int compare_tracks(const char *sa, const char *sb,
 		   const char *da, const char *db,
 		   const char *ta, const char *tb);
 /* Compare tracks A and B, with sort/display/track names S?, D? and T? */
 
+char *track_collation_key(const char *sort, const char *display,
+                          const char *track, size_t *nkeyp);
+/* Compute a binary key for a track such that comparing two keys with
+ * compare_collation_keys() gives the same answer as compare_tracks() */
+
+/** @brief Compare two collation keys
+ * @param a First key
+ * @param na Length of @p a
+ * @param b Second key
+ * @param nb Length of @p b
+ * @return -ve, 0 or +ve for a <, = or > b
+ *
+ * The keys must come from track_collation_key().
+ */
+static inline int compare_collation_keys(const char *a, size_t na,
+                                         const char *b, size_t nb) {
+  int c = memcmp(a, b, na < nb ? na : nb);
+
+  if(c)
+    return c;
+  return na < nb ? -1 : na > nb;
+}
+
 int compare_path_raw(const unsigned char *ap, size_t an,
 		     const unsigned char *bp, size_t bn);
 /* Comparison function for path names that groups all entries in a directory
@@ -72,12 +108,19 @@ struct tracksort_data {
   const char *sort;
   /** @brief Display key */
   const char *display;
+  /** @brief Collation key (see track_collation_key()) */
+  const char *key;
+  /** @brief Length of @ref key */
+  size_t nkey;
 };
 
 struct tracksort_data *tracksort_init(int nvec,
                                       char **vec,
                                       const char *type);
 
+void tracksort_sort(int ntracks, struct tracksort_data *td);
+/* Sort TD, filling in the collation keys from the other fields */
+
 #endif /* TRACKNAME_H */
 
 /*
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2008 Richard Kettlewell
+ * Copyright (C) 2008, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -23,13 +23,26 @@
 #include "trackname.h"
 #include "mem.h"
 
-/** @brief Compare two @ref entry objects */
+/** @brief Compare two @ref tracksort_data objects by collation key */
 static int tracksort_compare(const void *a, const void *b) {
   const struct tracksort_data *ea = a, *eb = b;
 
-  return compare_tracks(ea->sort, eb->sort,
-			ea->display, eb->display,
-			ea->track, eb->track);
+  return compare_collation_keys(ea->key, ea->nkey, eb->key, eb->nkey);
+}
+
+/** @brief Sort track data
+ * @param ntracks Number of tracks to sort
+ * @param td Track data
+ *
+ * The track, sort and display fields must already be filled in.  The key
+ * fields are filled in here, and the resulting order is the same as sorting
+ * with compare_tracks().
+ */
+void tracksort_sort(int ntracks, struct tracksort_data *td) {
+  for(int n = 0; n < ntracks; ++n)
+    td[n].key = track_collation_key(td[n].sort, td[n].display, td[n].track,
+                                    &td[n].nkey);
+  qsort(td, ntracks, sizeof *td, tracksort_compare);
 }
 
 /** @brief Sort tracks
@@ -38,7 +51,7 @@ static int tracksort_compare(const void *a, const void *b) {
  * @param type Comparison type
  * @return Sorted track data
  *
- * Tracks are compared using compare_tracks(), with the sort key and display
+ * Tracks are ordered as by compare_tracks(), with the sort key and display
  * string set according to @p type, which should be "track" if the tracks are
  * really tracks and "dir" if they are directories.
  */
@@ -51,7 +64,7 @@ struct tracksort_data *tracksort_init(int ntracks,
     td[n].sort = trackname_transform(type, tracks[n], "sort");
     td[n].display = trackname_transform(type, tracks[n], "display");
   }
-  qsort(td, ntracks, sizeof *td, tracksort_compare);
+  tracksort_sort(ntracks, td);
   return td;
 }
 
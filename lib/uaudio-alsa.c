@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2009, 2013 Richard Kettlewell
+ * Copyright (C) 2009, 2013, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -284,6 +284,7 @@ const struct uaudio uaudio_alsa = {
   .stop = alsa_stop,
   .activate = uaudio_thread_activate,
   .deactivate = uaudio_thread_deactivate,
+  .stats = uaudio_thread_stats,
   .open_mixer = alsa_open_mixer,
   .close_mixer = alsa_close_mixer,
   .get_volume = alsa_get_volume,
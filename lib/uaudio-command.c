@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2005, 2006, 2007, 2009 Richard Kettlewell
+ * Copyright (C) 2005, 2006, 2007, 2009, 2026 Richard Kettlewell
  * Portions (C) 2007 Mark Wooding
  *
  * This program is free software: you can redistribute it and/or modify
@@ -162,6 +162,7 @@ const struct uaudio uaudio_command = {
   .stop = command_stop,
   .activate = uaudio_thread_activate,
   .deactivate = uaudio_thread_deactivate,
+  .stats = uaudio_thread_stats,
   .configure = command_configure,
   .flags = UAUDIO_API_CLIENT | UAUDIO_API_SERVER,
 };
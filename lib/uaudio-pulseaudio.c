@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2013 Richard Kettlewell, 2018 Mark Wooding
+ * Copyright (C) 2013, 2026 Richard Kettlewell, 2018 Mark Wooding
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -289,6 +289,7 @@ const struct uaudio uaudio_pulseaudio = {
   .stop = pulseaudio_stop,
   .activate = uaudio_thread_activate,
   .deactivate = uaudio_thread_deactivate,
+  .stats = uaudio_thread_stats,
   .open_mixer = pulseaudio_open_mixer,
   .close_mixer = pulseaudio_close_mixer,
   .get_volume = pulseaudio_get_volume,
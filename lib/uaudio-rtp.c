@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2009, 2013 Richard Kettlewell
+ * Copyright (C) 2009, 2013, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -40,6 +40,7 @@
 #include "ifreq.h"
 #include "timeval.h"
 #include "configuration.h"
+#include "samples.h"
 
 /** @brief Bytes to send per network packet */
 static int rtp_max_payload;
@@ -82,12 +83,79 @@ static int rtp_mode;
 
 /** @brief A unicast client */
 struct rtp_recipient {
-  struct rtp_recipient *next;
+  /** @brief Recipient address */
   struct sockaddr_storage sa;
+
+  /** @brief Number of @ref rtp_recipients snapshots containing this one
+   *
+   * Protected by @ref rtp_lock. */
+  int refs;
+
+  /** @brief Packets sent successfully
+   *
+   * Updated by the play thread and read by others, so accessed atomically. */
+  unsigned long sent;
+
+  /** @brief Packets that could not be sent
+   *
+   * Accessed atomically, as @p sent. */
+  unsigned long errors;
+
+  /** @brief Number of consecutive failed packets
+   *
+   * Only used by the play thread. */
+  unsigned long failing;
 };
 
-/** @brief List of unicast clients */
-static struct rtp_recipient *rtp_recipient_list;
+/** @brief A snapshot of the unicast clients
+ *
+ * rtp_play() works from a snapshot so that it never needs @ref rtp_lock.
+ * rtp_add_recipient() and rtp_remove_recipient() never modify a snapshot;
+ * they build a new one and swap it in.  The old one is retired, and freed
+ * once the play thread is no longer using it (see @ref rtp_in_use).
+ */
+struct rtp_recipients {
+  /** @brief Next retired snapshot */
+  struct rtp_recipients *next;
+
+  /** @brief Number of recipients */
+  int n;
+
+  /** @brief Number of IPv4 recipients
+   *
+   * These come first in @p r, so that each address family can be sent with
+   * a single system call. */
+  int n4;
+
+  /** @brief Recipients */
+  struct rtp_recipient **r;
+
+  /** @brief Message headers, one per recipient
+   *
+   * Only rtp_play() uses these, so it can fill in the payload without
+   * locking. */
+#if HAVE_SENDMMSG
+  struct mmsghdr *msgs;
+#else
+  struct msghdr *msgs;
+#endif
+};
+
+/** @brief Current set of unicast clients, or NULL
+ *
+ * Only changed with @ref rtp_lock held, but read by the play thread without
+ * it, so accessed atomically.
+ */
+static struct rtp_recipients *rtp_current;
+
+/** @brief Snapshot the play thread is using, or NULL
+ *
+ * Set by the play thread and read by rtp_reclaim(), so accessed
+ * atomically. */
+static struct rtp_recipients *rtp_in_use;
+
+/** @brief Snapshots no longer current but maybe not yet freed */
+static struct rtp_recipients *rtp_retired;
 
 /** @brief Mutex protecting data structures */
 static pthread_mutex_t rtp_lock = PTHREAD_MUTEX_INITIALIZER;
@@ -149,6 +217,166 @@ static void rtp_set_netconfig(const char *af,
   }
 }
 
+/** @brief Free a recipient snapshot
+ * @param rs Snapshot
+ *
+ * Must be called with @ref rtp_lock held.
+ */
+static void rtp_free(struct rtp_recipients *rs) {
+  int n;
+
+  for(n = 0; n < rs->n; ++n)
+    if(!--rs->r[n]->refs)
+      xfree(rs->r[n]);
+  xfree(rs->r);
+  xfree(rs->msgs);
+  xfree(rs);
+}
+
+/** @brief Free retired snapshots that the play thread isn't using
+ *
+ * Must be called with @ref rtp_lock held.
+ */
+static void rtp_reclaim(void) {
+  struct rtp_recipients **rr = &rtp_retired, *rs;
+  struct rtp_recipients *const in_use = __atomic_load_n(&rtp_in_use,
+                                                        __ATOMIC_SEQ_CST);
+
+  while((rs = *rr)) {
+    if(rs == in_use)
+      rr = &rs->next;
+    else {
+      *rr = rs->next;
+      rtp_free(rs);
+    }
+  }
+}
+
+/** @brief Pick up the current recipient snapshot
+ * @return Snapshot or NULL
+ *
+ * Only called from the play thread.  The result stays valid until
+ * rtp_unuse() is called, even if it stops being current.
+ */
+static struct rtp_recipients *rtp_use(void) {
+  struct rtp_recipients *rs, *check;
+
+  rs = __atomic_load_n(&rtp_current, __ATOMIC_SEQ_CST);
+  /* Announce which snapshot we want and then check it is still current.  If
+   * it is, then rtp_reclaim() will see the announcement before it could
+   * consider freeing it. */
+  for(;;) {
+    __atomic_store_n(&rtp_in_use, rs, __ATOMIC_SEQ_CST);
+    check = __atomic_load_n(&rtp_current, __ATOMIC_SEQ_CST);
+    if(check == rs)
+      return rs;
+    rs = check;
+  }
+}
+
+/** @brief Finish with the snapshot from rtp_use() */
+static void rtp_unuse(void) {
+  __atomic_store_n(&rtp_in_use, NULL, __ATOMIC_RELEASE);
+}
+
+/** @brief Replace the current recipient snapshot
+ * @param r Recipients in any order
+ * @param n Number of recipients
+ *
+ * Must be called with @ref rtp_lock held.
+ */
+static void rtp_publish(struct rtp_recipient **r, int n) {
+  struct rtp_recipients *rs = xmalloc(sizeof *rs), *old;
+  struct msghdr *m;
+  int i, j;
+
+  rs->next = NULL;
+  rs->n = n;
+  rs->n4 = 0;
+  rs->r = xcalloc(n, sizeof *rs->r);
+  rs->msgs = xcalloc(n, sizeof *rs->msgs);
+  /* IPv4 first, then everything else */
+  for(i = 0; i < n; ++i)
+    if(r[i]->sa.ss_family == AF_INET)
+      rs->r[rs->n4++] = r[i];
+  for(i = 0, j = rs->n4; i < n; ++i)
+    if(r[i]->sa.ss_family != AF_INET)
+      rs->r[j++] = r[i];
+  for(i = 0; i < n; ++i) {
+    ++rs->r[i]->refs;
+#if HAVE_SENDMMSG
+    m = &rs->msgs[i].msg_hdr;
+#else
+    m = &rs->msgs[i];
+#endif
+    m->msg_name = &rs->r[i]->sa;
+    m->msg_namelen = rs->r[i]->sa.ss_family == AF_INET ?
+      sizeof(struct sockaddr_in) : sizeof (struct sockaddr_in6);
+  }
+  old = __atomic_exchange_n(&rtp_current, rs, __ATOMIC_SEQ_CST);
+  if(old) {
+    old->next = rtp_retired;
+    rtp_retired = old;
+  }
+  rtp_reclaim();
+}
+
+/** @brief Record the outcome of sending to a recipient
+ * @param r Recipient
+ * @param err 0 on success, else errno value
+ */
+static void rtp_sent(struct rtp_recipient *r, int err) {
+  if(!err) {
+    __atomic_add_fetch(&r->sent, 1, __ATOMIC_RELAXED);
+    if(r->failing) {
+      disorder_info("RTP: resumed transmission to %s after %lu errors",
+                    format_sockaddr((struct sockaddr *)&r->sa), r->failing);
+      r->failing = 0;
+    }
+  } else {
+    __atomic_add_fetch(&r->errors, 1, __ATOMIC_RELAXED);
+    /* ~120 packets/second so this is about once a minute per recipient */
+    if(!(r->failing++ & 8191))
+      disorder_error(err, "error transmitting audio data to %s",
+                     format_sockaddr((struct sockaddr *)&r->sa));
+  }
+}
+
+/** @brief Send a packet to some unicast clients
+ * @param fd Socket to send with
+ * @param rs Recipient snapshot
+ * @param start Index of first recipient
+ * @param end Index after last recipient
+ */
+static void rtp_send_unicast(int fd, struct rtp_recipients *rs,
+                             int start, int end) {
+#if HAVE_SENDMMSG
+  int n, sent;
+
+  while(start < end) {
+    sent = sendmmsg(fd, rs->msgs + start, end - start,
+                    MSG_DONTWAIT|MSG_NOSIGNAL);
+    if(sent < 0) {
+      if(errno == EINTR)
+        continue;
+      /* The first message failed; carry on with the rest */
+      rtp_sent(rs->r[start++], errno);
+    } else if(sent == 0)
+      break;
+    else {
+      for(n = start; n < start + sent; ++n)
+        rtp_sent(rs->r[n], 0);
+      start += sent;
+    }
+  }
+#else
+  for(; start < end; ++start)
+    rtp_sent(rs->r[start],
+             sendmsg(fd, &rs->msgs[start], MSG_DONTWAIT|MSG_NOSIGNAL) < 0
+               ? errno : 0);
+#endif
+}
+
 static size_t rtp_play(void *buffer, size_t nsamples, unsigned flags) {
   struct rtp_header header;
   struct iovec vec[2];
@@ -173,11 +401,7 @@ static size_t rtp_play(void *buffer, size_t nsamples, unsigned flags) {
     header.mpt |= 0x80;
 #if !WORDS_BIGENDIAN
   /* Convert samples to network byte order */
-  uint16_t *u = buffer, *const limit = u + nsamples;
-  while(u < limit) {
-    *u = htons(*u);
-    ++u;
-  }
+  samples_swap16(buffer, buffer, nsamples);
 #endif
   vec[0].iov_base = (void *)&header;
   vec[0].iov_len = sizeof header;
@@ -186,11 +410,15 @@ static size_t rtp_play(void *buffer, size_t nsamples, unsigned flags) {
   const uint32_t timestamp = uaudio_schedule_sync();
   header.timestamp = htonl(rtp_base + (uint32_t)timestamp);
 
+  /* Pick up the current set of unicast clients */
+  struct rtp_recipients *const rs = rtp_use();
+  int n;
+
   /* We send ~120 packets a second with current arrangements.  So if we log
    * once every 8192 packets we log about once a minute. */
 
   if(!(ntohs(header.seq) & 8191)
-     && config->rtp_verbose)
+     && config->rtp_verbose) {
     disorder_info("RTP: seq %04"PRIx16" %08"PRIx32"+%08"PRIx32"=%08"PRIx32" ns %zu%s",
                   ntohs(header.seq),
                   rtp_base,
@@ -198,28 +426,36 @@ static size_t rtp_play(void *buffer, size_t nsamples, unsigned flags) {
                   header.timestamp,
                   nsamples,
                   flags & UAUDIO_PAUSED ? " [paused]" : "");
+    for(n = 0; rs && n < rs->n; ++n)
+      disorder_info("RTP: %s: %lu packets sent, %lu errors",
+                    format_sockaddr((struct sockaddr *)&rs->r[n]->sa),
+                    __atomic_load_n(&rs->r[n]->sent, __ATOMIC_RELAXED),
+                    __atomic_load_n(&rs->r[n]->errors, __ATOMIC_RELAXED));
+  }
 
   /* If we're paused don't actually end a packet, we just pretend */
   if(flags & UAUDIO_PAUSED) {
+    rtp_unuse();
     uaudio_schedule_sent(nsamples);
     return nsamples;
   }
-  /* Send stuff to explicitly registerd unicast addresses unconditionally */
-  struct rtp_recipient *r;
-  struct msghdr m;
-  memset(&m, 0, sizeof m);
-  m.msg_iov = vec;
-  m.msg_iovlen = 2;
-  pthread_mutex_lock(&rtp_lock);
-  for(r = rtp_recipient_list; r; r = r->next) {
-    m.msg_name = &r->sa;
-    m.msg_namelen = r->sa.ss_family == AF_INET ? 
-      sizeof(struct sockaddr_in) : sizeof (struct sockaddr_in6);
-    sendmsg(r->sa.ss_family == AF_INET ? rtp_fd4 : rtp_fd6,
-            &m, MSG_DONTWAIT|MSG_NOSIGNAL);
-    // TODO similar error handling to other case?
+  /* Send stuff to explicitly registerd unicast addresses unconditionally.
+   * Errors are accounted per recipient; one bad client shouldn't stop the
+   * others. */
+  if(rs) {
+    for(n = 0; n < rs->n; ++n) {
+#if HAVE_SENDMMSG
+      rs->msgs[n].msg_hdr.msg_iov = vec;
+      rs->msgs[n].msg_hdr.msg_iovlen = 2;
+#else
+      rs->msgs[n].msg_iov = vec;
+      rs->msgs[n].msg_iovlen = 2;
+#endif
+    }
+    rtp_send_unicast(rtp_fd4, rs, 0, rs->n4);
+    rtp_send_unicast(rtp_fd6, rs, rs->n4, rs->n);
   }
-  pthread_mutex_unlock(&rtp_lock);
+  rtp_unuse();
   if(rtp_mode != RTP_REQUEST) {
     int written_bytes;
     do {
@@ -462,6 +698,9 @@ static void rtp_start(uaudio_callback *callback,
 
 static void rtp_stop(void) {
   uaudio_thread_stop();
+  pthread_mutex_lock(&rtp_lock);
+  rtp_reclaim();
+  pthread_mutex_unlock(&rtp_lock);
   if(rtp_fd >= 0) { close(rtp_fd); rtp_fd = -1; }
   if(rtp_fd4 >= 0) { close(rtp_fd4); rtp_fd4 = -1; }
   if(rtp_fd6 >= 0) { close(rtp_fd6); rtp_fd6 = -1; }
@@ -487,26 +726,42 @@ static void rtp_configure(void) {
     disorder_info("RTP: configured");
 }
 
+/** @brief Find an RTP recipient
+ * @param sa Pointer to recipient address
+ * @return Index in @ref rtp_current or -1
+ *
+ * Must be called with @ref rtp_lock held.
+ */
+static int rtp_find_recipient(const struct sockaddr_storage *sa) {
+  int n;
+
+  for(n = 0; rtp_current && n < rtp_current->n; ++n)
+    if(!sockaddrcmp((struct sockaddr *)sa,
+                    (struct sockaddr *)&rtp_current->r[n]->sa))
+      return n;
+  return -1;
+}
+
 /** @brief Add an RTP recipient address
  * @param sa Pointer to recipient address
  * @return 0 on success, -1 on error
  */
 int rtp_add_recipient(const struct sockaddr_storage *sa) {
-  struct rtp_recipient *r;
-  int rc;
+  struct rtp_recipient *r, **rv;
+  int rc, n;
   pthread_mutex_lock(&rtp_lock);
-  for(r = rtp_recipient_list;
-      r && sockaddrcmp((struct sockaddr *)sa,
-                       (struct sockaddr *)&r->sa);
-      r = r->next)
-    ;
-  if(r)
+  n = rtp_current ? rtp_current->n : 0;
+  if(rtp_find_recipient(sa) >= 0)
     rc = -1;
   else {
     r = xmalloc(sizeof *r);
     memcpy(&r->sa, sa, sizeof *sa);
-    r->next = rtp_recipient_list;
-    rtp_recipient_list = r;
+    rv = xcalloc(n + 1, sizeof *rv);
+    if(n)
+      memcpy(rv, rtp_current->r, n * sizeof *rv);
+    rv[n] = r;
+    rtp_publish(rv, n + 1);
+    xfree(rv);
     rc = 0;
   }
   pthread_mutex_unlock(&rtp_lock);
@@ -518,17 +773,22 @@ int rtp_add_recipient(const struct sockaddr_storage *sa) {
  * @return 0 on success, -1 on error
  */
 int rtp_remove_recipient(const struct sockaddr_storage *sa) {
-  struct rtp_recipient *r, **rr;
-  int rc;
+  struct rtp_recipient *r, **rv;
+  int rc, n, i;
   pthread_mutex_lock(&rtp_lock);
-  for(rr = &rtp_recipient_list;
-      (r = *rr) && sockaddrcmp((struct sockaddr *)sa,
-                               (struct sockaddr *)&r->sa);
-      rr = &r->next)
-    ;
-  if(r) {
-    *rr = r->next;
-    xfree(r);
+  if((i = rtp_find_recipient(sa)) >= 0) {
+    n = rtp_current->n;
+    r = rtp_current->r[i];
+    if(config->rtp_verbose)
+      disorder_info("RTP: removing %s: %lu packets sent, %lu errors",
+                    format_sockaddr((struct sockaddr *)&r->sa),
+                    __atomic_load_n(&r->sent, __ATOMIC_RELAXED),
+                    __atomic_load_n(&r->errors, __ATOMIC_RELAXED));
+    rv = xcalloc(n, sizeof *rv);
+    memcpy(rv, rtp_current->r, n * sizeof *rv);
+    rv[i] = rv[n - 1];
+    rtp_publish(rv, n - 1);
+    xfree(rv);
     rc = 0;
   } else {
     disorder_error(0, "bogus rtp_remove_recipient");
@@ -545,6 +805,7 @@ const struct uaudio uaudio_rtp = {
   .stop = rtp_stop,
   .activate = uaudio_thread_activate,
   .deactivate = uaudio_thread_deactivate,
+  .stats = uaudio_thread_stats,
   .configure = rtp_configure,
   .flags = UAUDIO_API_SERVER,
 };
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2009 Richard Kettlewell
+ * Copyright (C) 2009, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -128,6 +128,11 @@ uint32_t uaudio_schedule_sync(void) {
 #endif
     while(nanosleep(ts, ts) < 0 && errno == EINTR)
       ;
+    /* Record how late we woke, relative to when the timestamp'th sample was
+     * due */
+    xgettimeofday(&now, NULL);
+    uaudio_thread_record_sleep(tvsub_us(now, base)
+                               - (double)timestamp * 1000000 / rate);
   } else {
 #if 0
     fprintf(stderr, "samples=%8"PRIu64" timestamp=%8"PRIu64"\n",
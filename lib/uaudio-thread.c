@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2009, 2013 Richard Kettlewell
+ * Copyright (C) 2009, 2013, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -16,7 +16,14 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 /** @file lib/uaudio-thread.c
- * @brief Background thread for audio processing */
+ * @brief Background thread for audio processing
+ *
+ * A collection thread fills buffers from the uaudio callback and a play
+ * thread passes them to the backend.  Playing starts, and restarts after
+ * running out, once @ref UAUDIO_THREAD_WATERMARK_MS of audio is buffered or
+ * no more buffers can be filled.  Buffer depth, underruns and how late the
+ * play thread wakes from its pacing sleeps are recorded; see
+ * uaudio_thread_stats(). */
 #include "common.h"
 
 #include <pthread.h>
@@ -36,6 +43,9 @@
  */
 #define UAUDIO_THREAD_BUFFERS 4
 
+/** @brief Audio to buffer before playing, in milliseconds */
+#define UAUDIO_THREAD_WATERMARK_MS 40
+
 /** @brief Buffer data structure */
 struct uaudio_buffer {
   /** @brief Pointer to sample data */
@@ -90,11 +100,65 @@ static size_t uaudio_thread_max;
 /** @brief Set when activated, clear when paused */
 static int uaudio_thread_activated;
 
+/** @brief Number of samples in filled buffers */
+static size_t uaudio_thread_buffered;
+
+/** @brief Statistics
+ *
+ * Protected by @ref uaudio_thread_lock.  The @c late_mean_us field is
+ * computed by uaudio_thread_stats().
+ */
+static struct uaudio_stats uaudio_thread_counters;
+
+/** @brief Total lateness in microseconds */
+static uint64_t uaudio_thread_late_total_us;
+
+/** @brief Start time for pacing output */
+static struct timespec uaudio_thread_base;
+
+/** @brief Frames supplied to the backend since @ref uaudio_thread_base */
+static int64_t uaudio_thread_frames_supplied;
+
+static void uaudio_thread_gettime(struct timespec *ts) {
+  xgettime(CLOCK_MONOTONIC, ts);
+}
+
+static void uaudio_thread_sleep(const struct timespec *ts) {
+  xnanosleep(ts, NULL);
+}
+
+/** @brief Clock for pacing output */
+static void (*uaudio_thread_now)(struct timespec *ts) = uaudio_thread_gettime;
+
+/** @brief Sleep for pacing output */
+static void (*uaudio_thread_wait)(const struct timespec *ts)
+  = uaudio_thread_sleep;
+
 /** @brief Return number of buffers currently in use */
 static int uaudio_buffers_used(void) {
   return (uaudio_collect_buffer - uaudio_play_buffer) % UAUDIO_THREAD_BUFFERS;
 }
 
+/** @brief Convert a sample count to milliseconds */
+static uint32_t uaudio_thread_ms(size_t samples) {
+  return (uint64_t)samples * 1000 / ((uint64_t)uaudio_rate * uaudio_channels);
+}
+
+/** @brief Record the buffer depth as a buffer starts playing
+ *
+ * Called with @ref uaudio_thread_lock held.
+ */
+static void uaudio_thread_record_depth(void) {
+  uint32_t ms = uaudio_thread_ms(uaudio_thread_buffered);
+  int bucket = 0;
+
+  while(ms >= 4 && bucket < UAUDIO_DEPTH_BUCKETS - 1) {
+    ms /= 2;
+    ++bucket;
+  }
+  ++uaudio_thread_counters.depth[bucket];
+}
+
 /** @brief Background thread for audio collection
  *
  * Collects data while activated and communicates its status via @ref
@@ -133,6 +197,7 @@ static void *uaudio_collect_thread_fn(void attribute((unused)) *arg) {
         }
         pthread_mutex_lock(&uaudio_thread_lock);
         /* Advance to next buffer */
+        uaudio_thread_buffered += b->nsamples;
         uaudio_collect_buffer = (1 + uaudio_collect_buffer) % UAUDIO_THREAD_BUFFERS;
         /* Awaken player */
         pthread_cond_broadcast(&uaudio_thread_cond);
@@ -147,41 +212,65 @@ static void *uaudio_collect_thread_fn(void attribute((unused)) *arg) {
   return NULL;
 }
 
+/** @brief Record a pacing sleep
+ * @param late_us How long after the intended time the sleep ended, in
+ * microseconds
+ *
+ * Called from the play thread, either here or from a backend that does its
+ * own pacing (see uaudio_schedule_sync()).  Only the play thread updates
+ * the counters, so it may read them without the lock.
+ */
+void uaudio_thread_record_sleep(double late_us) {
+  if(late_us < 0)
+    late_us = 0;
+  pthread_mutex_lock(&uaudio_thread_lock);
+  ++uaudio_thread_counters.sleeps;
+  uaudio_thread_late_total_us += late_us;
+  if(late_us > uaudio_thread_counters.late_max_us)
+    uaudio_thread_counters.late_max_us = late_us;
+  pthread_mutex_unlock(&uaudio_thread_lock);
+}
+
+/** @brief Play samples, keeping to the sample rate
+ * @param buffer Sample data
+ * @param samples Number of samples
+ * @param flags Flags for the play callback
+ * @return Number of samples played
+ *
+ * Sleeps until the approximate point at which the backend will have run out
+ * of buffered audio, and records how late it woke up unless the backend
+ * already recorded its own pacing sleep while playing these samples.
+ */
 static size_t uaudio_play_samples(void *buffer, size_t samples, unsigned flags) {
-  static struct timespec base;
-  static int64_t frames_supplied;
   struct timespec now;
   struct timespec delay_ts;
   double target, delay;
+  int slept = 0;
+  const uint32_t sleeps = uaudio_thread_counters.sleeps;
 
-  if(!base.tv_sec)
-    xgettime(CLOCK_MONOTONIC, &base);
+  if(!uaudio_thread_base.tv_sec)
+    uaudio_thread_now(&uaudio_thread_base);
   samples = uaudio_thread_play_callback(buffer, samples, flags);
-  frames_supplied += samples / uaudio_channels;
+  uaudio_thread_frames_supplied += samples / uaudio_channels;
   /* Set target to the approximate point at which we run out of buffered audio.
    * If no buffer size has been specified, use 1/16th of a second. */
-  target = (frames_supplied - (uaudio_buffer ? uaudio_buffer : uaudio_rate / 16))
-    / (double)uaudio_rate + ts_to_double(base);
+  target = (uaudio_thread_frames_supplied
+            - (uaudio_buffer ? uaudio_buffer : uaudio_rate / 16))
+    / (double)uaudio_rate + ts_to_double(uaudio_thread_base);
   for(;;) {
-    xgettime(CLOCK_MONOTONIC, &now);
+    uaudio_thread_now(&now);
     delay = target - ts_to_double(now);
-    if(delay <= 0) {
-      //putc('.', stderr);
+    if(delay <= 0)
       break;
-    }
-    //putc('!', stderr);
-    /*
-    fprintf(stderr, "frames supplied %ld (%lds) base %f target %f now %f want delay %g\n", 
-            frames_supplied,
-            frames_supplied / uaudio_rate,
-            ts_to_double(base),
-            target, 
-            ts_to_double(now),
-            delay);
-    */
     delay_ts = double_to_ts(delay);
-    xnanosleep(&delay_ts, NULL);
+    uaudio_thread_wait(&delay_ts);
+    slept = 1;
   }
+  /* Only time spent sleeping counts; if we were behind anyway, it was the
+   * backend that held us up.  A backend that paces itself has already
+   * recorded the sleep that matters, so don't count a second one. */
+  if(slept && uaudio_thread_counters.sleeps == sleeps)
+    uaudio_thread_record_sleep(-delay * 1000000);
   return samples;
 }
 
@@ -196,6 +285,7 @@ static void *uaudio_play_thread_fn(void attribute((unused)) *arg) {
   unsigned char zero[uaudio_thread_max * uaudio_sample_size];
   memset(zero, 0, sizeof zero);
 
+  pthread_mutex_lock(&uaudio_thread_lock);
   while(uaudio_thread_started) {
     // If we're paused then just play silence
     if(!uaudio_thread_activated) {
@@ -212,13 +302,17 @@ static void *uaudio_play_thread_fn(void attribute((unused)) *arg) {
     int go;
 
     if(resync)
-      go = (used == UAUDIO_THREAD_BUFFERS - 1);
+      go = (used == UAUDIO_THREAD_BUFFERS - 1
+            || (used > 0
+                && uaudio_thread_ms(uaudio_thread_buffered)
+                     >= UAUDIO_THREAD_WATERMARK_MS));
     else
       go = (used > 0);
     if(go) {
       /* At least one buffer is filled.  We release the lock while playing so
        * that more collection can go on. */
       struct uaudio_buffer *const b = &uaudio_buffers[uaudio_play_buffer];
+      uaudio_thread_record_depth();
       pthread_mutex_unlock(&uaudio_thread_lock);
       //fprintf(stderr, "P%d.", uaudio_play_buffer);
       size_t played = 0;
@@ -233,12 +327,15 @@ static void *uaudio_play_thread_fn(void attribute((unused)) *arg) {
       }
       pthread_mutex_lock(&uaudio_thread_lock);
       /* Move to next buffer */
+      uaudio_thread_buffered -= b->nsamples;
       uaudio_play_buffer = (1 + uaudio_play_buffer) % UAUDIO_THREAD_BUFFERS;
       /* Awaken collector */
       pthread_cond_broadcast(&uaudio_thread_cond);
       resync = 0;
     } else {
       /* Insufficient data to play, wait for collector */
+      if(!resync && !used)
+        ++uaudio_thread_counters.underruns;
       pthread_cond_wait(&uaudio_thread_cond, &uaudio_thread_lock);
       /* (Still) re-synchronizing */
       resync = 1;
@@ -280,6 +377,9 @@ void uaudio_thread_start(uaudio_callback *callback,
     uaudio_buffers[n].samples = xcalloc_noptr(uaudio_thread_max,
                                               uaudio_sample_size);
   uaudio_collect_buffer = uaudio_play_buffer = 0;
+  uaudio_thread_buffered = 0;
+  uaudio_thread_base.tv_sec = uaudio_thread_base.tv_nsec = 0;
+  uaudio_thread_frames_supplied = 0;
   if((e = pthread_create(&uaudio_collect_thread,
                          NULL,
                          uaudio_collect_thread_fn,
@@ -323,6 +423,30 @@ void uaudio_thread_deactivate(void) {
   pthread_mutex_unlock(&uaudio_thread_lock);
 }
 
+/** @brief Get output statistics
+ * @param s Where to store statistics
+ */
+void uaudio_thread_stats(struct uaudio_stats *s) {
+  pthread_mutex_lock(&uaudio_thread_lock);
+  *s = uaudio_thread_counters;
+  if(s->sleeps)
+    s->late_mean_us = uaudio_thread_late_total_us / s->sleeps;
+  pthread_mutex_unlock(&uaudio_thread_lock);
+}
+
+/** @brief Replace the clock used to pace output
+ * @param now Called to get the time, or NULL for the monotonic clock
+ * @param sleep Called to sleep, or NULL for xnanosleep()
+ *
+ * Must be called before uaudio_thread_start().  This exists so that tests can
+ * run the background threads against a simulated clock.
+ */
+void uaudio_thread_clock(void (*now)(struct timespec *ts),
+                         void (*sleep)(const struct timespec *ts)) {
+  uaudio_thread_now = now ? now : uaudio_thread_gettime;
+  uaudio_thread_wait = sleep ? sleep : uaudio_thread_sleep;
+}
+
 /*
 Local Variables:
 c-basic-offset:2
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2009, 2013 Richard Kettlewell
+ * Copyright (C) 2009, 2013, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -82,6 +82,35 @@ typedef size_t uaudio_playcallback(void *buffer, size_t samples,
 /** @brief Currently paused */
 #define UAUDIO_PAUSED 0x0008
 
+/** @brief Number of buckets in @ref uaudio_stats::depth */
+#define UAUDIO_DEPTH_BUCKETS 8
+
+/** @brief Output statistics
+ *
+ * Counters are totals since the backend started.
+ */
+struct uaudio_stats {
+  /** @brief Histogram of buffered audio
+   *
+   * Sampled each time a buffer starts playing.  Bucket 0 counts less than 4ms,
+   * bucket @c n counts from 2^(n+1)ms up to 2^(n+2)ms and the last bucket
+   * counts everything above that.
+   */
+  uint32_t depth[UAUDIO_DEPTH_BUCKETS];
+
+  /** @brief Number of times output ran out of buffered audio */
+  uint32_t underruns;
+
+  /** @brief Number of times output slept to keep to the sample rate */
+  uint32_t sleeps;
+
+  /** @brief Mean time woken after the intended time, in microseconds */
+  uint32_t late_mean_us;
+
+  /** @brief Longest time woken after the intended time, in microseconds */
+  uint32_t late_max_us;
+};
+
 /** @brief Audio API definition */
 struct uaudio {
   /** @brief Name of this API */
@@ -152,6 +181,13 @@ struct uaudio {
   /** @brief Set configuration */
   void (*configure)(void);
 
+  /** @brief Get output statistics
+   * @param s Where to store statistics
+   *
+   * May be a null pointer if the backend doesn't collect any.
+   */
+  void (*stats)(struct uaudio_stats *s);
+
   /** @brief Descriptive flags */
   unsigned flags;
 };
@@ -175,6 +211,10 @@ void uaudio_thread_start(uaudio_callback *callback,
 void uaudio_thread_stop(void);
 void uaudio_thread_activate(void);
 void uaudio_thread_deactivate(void);
+void uaudio_thread_stats(struct uaudio_stats *s);
+void uaudio_thread_record_sleep(double late_us);
+void uaudio_thread_clock(void (*now)(struct timespec *ts),
+                         void (*sleep)(const struct timespec *ts));
 uint32_t uaudio_schedule_sync(void);
 void uaudio_schedule_sent(size_t nsamples_sent);
 void uaudio_schedule_init(void);
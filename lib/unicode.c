@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2007, 2009, 2013 Richard Kettlewell
+ * Copyright (C) 2007, 2009, 2013, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -39,6 +39,10 @@
 
 #include "common.h"
 
+#if __SSE2__
+# include <emmintrin.h>
+#endif
+
 #include "mem.h"
 #include "vector.h"
 #include "unicode.h"
@@ -477,6 +481,119 @@ int utf8_valid(const char *s, size_t ns) {
   return 1;
 }
 
+/** @brief Return the length of the ASCII prefix of [s,s+ns)
+ * @param s Start of string
+ * @param ns Length of string
+ * @return Number of bytes before the first non-ASCII one, or @p ns
+ */
+size_t utf8_ascii_prefix(const char *s, size_t ns) {
+  const char *const start = s;
+  uint64_t w;
+
+#if __SSE2__
+  for(; ns >= 16; ns -= 16, s += 16) {
+    const int m = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)s));
+    if(m)
+      return s - start + __builtin_ctz(m);
+  }
+#endif
+  for(; ns >= sizeof w; ns -= sizeof w, s += sizeof w) {
+    memcpy(&w, s, sizeof w);
+    if(w & 0x8080808080808080ULL)
+      break;
+  }
+  while(ns > 0 && !(*s & 0x80)) {
+    ++s;
+    --ns;
+  }
+  return s - start;
+}
+
+/** @brief Test whether a code point is certainly unchanged by NFC in any
+ * context
+ * @param c Code point
+ * @return Non-0 if a string made only of such code points is in NFC
+ *
+ * This is a conservative version of NFC_QC=Yes: it also excludes anything
+ * that might compose with the code point before it.  Those are combining
+ * marks (including the handful of composable ones with combining class 0,
+ * which are all spacing or nonspacing marks) and Hangul vowel and trailing
+ * consonant jamo.
+ *
+ * Of the code points with a canonical decomposition, only those that
+ * decompose to one stable code point and one undecomposable one, and that
+ * composition turns back into the original, are accepted.  That covers the
+ * precomposed letters of the Latin, Greek and Cyrillic scripts.
+ */
+static int utf32__nfc_stable(uint32_t c) {
+  const struct unidata *const data = utf32__unidata(c);
+  const uint32_t *compositions;
+
+  if(data->ccc)
+    return 0;
+  if(data->decomp && !(data->flags & unicode_compatibility_decomposition)) {
+    if(!data->decomp[1] || data->decomp[2]
+       || utf32__decomposition_canon(data->decomp[1])
+       || !utf32__nfc_stable(data->decomp[0])
+       || !(compositions = utf32__unidata(data->decomp[0])->composed))
+      return 0;
+    while(*compositions && *compositions != c)
+      ++compositions;
+    if(!*compositions)
+      return 0;
+  }
+  switch(data->general_category) {
+  case unicode_General_Category_Mn:
+  case unicode_General_Category_Mc:
+  case unicode_General_Category_Me:
+    return 0;
+  }
+  switch(data->grapheme_break) {
+  case unicode_Grapheme_Break_V:
+  case unicode_Grapheme_Break_T:
+    return 0;
+  }
+  return 1;
+}
+
+/** @brief Quick check for NFC
+ * @param s Start of string
+ * @param ns Length of string
+ * @return Non-0 if [s,s+ns) is valid UTF-8 and in NFC, otherwise 0
+ *
+ * If this returns non-0 then utf8_compose_canon() would return a copy of
+ * [s,s+ns), so callers can skip it.  A 0 return doesn't mean the string is
+ * not in NFC, just that utf8_compose_canon() must be called to find out (or
+ * to detect invalid UTF-8).  ASCII is always in NFC, and is checked without
+ * decoding.
+ */
+int utf8_quick_check_nfc(const char *s, size_t ns) {
+  const size_t ascii = utf8_ascii_prefix(s, ns);
+  const uint8_t *ss = (const uint8_t *)s + ascii;
+  uint32_t c32;
+  int n;
+
+  ns -= ascii;
+  while(ns > 0) {
+    const struct unicode_utf8_row *const r = &unicode_utf8_valid[*ss];
+    if(r->count > ns || r->count == 0)
+      return 0;
+    if(r->count > 1 && (ss[1] < r->min2 || ss[1] > r->max2))
+      return 0;
+    c32 = r->count == 1 ? *ss : *ss & (0x7F >> r->count);
+    for(n = 1; n < r->count; ++n) {
+      if(ss[n] < 0x80 || ss[n] > 0xBF)
+        return 0;
+      c32 = (c32 << 6) | (ss[n] & 0x3F);
+    }
+    if(!utf32__nfc_stable(c32))
+      return 0;
+    ss += r->count;
+    ns -= r->count;
+  }
+  return 1;
+}
+
 /*@}*/
 /** @defgroup utf32iterator UTF-32 string iterators */
 /*@{*/
@@ -741,66 +858,20 @@ int utf32_iterator_grapheme_boundary(utf32_iterator it) {
 
 }
 
-/** @brief Test for a word boundary
- * @param it Iterator
- * @return Non-0 if pointing just after a word boundary, otherwise 0
+/** @brief Apply rules WB5 to WB14
+ * @param wbtwobefore Word_Break of the code point before @p wbbefore
+ * @param wbbefore Word_Break of the code point before the proposed boundary
+ * @param wbafter Word_Break of the code point after the proposed boundary
+ * @param wbtwoafter Word_Break of the code point after @p wbafter
+ * @return Non-0 if there is a boundary, otherwise 0
  *
- * This function identifies default word boundaries as described in UAX #29 s4.
- * It returns non-0 if @p it points at the code point just after a word
- * boundary (including the hypothetical code point just after the end of the
- * string) and 0 otherwise.
+ * Extend and Format code points must already have been skipped.  Used by
+ * utf32_iterator_word_boundary() and utf8_casefold_word_split_ascii().
  */
-int utf32_iterator_word_boundary(utf32_iterator it) {
-  uint32_t before, after;
-  enum unicode_Word_Break wbtwobefore, wbbefore, wbafter, wbtwoafter;
-  size_t nn;
-
-  /* WB1 and WB2 */
-  if(it->n == 0 || it->n == it->ns)
-    return 1;
-  before = it->s[it->n-1];
-  after = it->s[it->n];
-  /* WB3 */
-  if(before == 0x000D && after == 0x000A)
-    return 0;
-  /* WB3a */
-  if(utf32__iterator_word_break(it, before) == unicode_Word_Break_Newline
-     || before == 0x000D
-     || before == 0x000A)
-    return 1;
-  /* WB3b */
-  if(utf32__iterator_word_break(it, after) == unicode_Word_Break_Newline
-     || after == 0x000D
-     || after == 0x000A)
-    return 1;
-  /* WB4 */
-  /* (!Sep) x (Extend|Format) as in UAX #29 s6.2 */
-  if(utf32__sentence_break(before) != unicode_Sentence_Break_Sep
-     && utf32__boundary_ignorable(utf32__iterator_word_break(it, after)))
-    return 0;
-  /* Gather the property values we'll need for the rest of the test taking the
-   * s6.2 changes into account */
-  /* First we look at the code points after the proposed boundary */
-  nn = it->n;                           /* <it->ns */
-  wbafter = utf32__iterator_word_break(it, it->s[nn++]);
-  if(!utf32__boundary_ignorable(wbafter)) {
-    /* X (Extend|Format)* -> X */
-    while(nn < it->ns
-          && utf32__boundary_ignorable(utf32__iterator_word_break(it,
-                                                                  it->s[nn])))
-      ++nn;
-  }
-  /* It's possible now that nn=ns */
-  if(nn < it->ns)
-    wbtwoafter = utf32__iterator_word_break(it, it->s[nn]);
-  else
-    wbtwoafter = unicode_Word_Break_Other;
-
-  /* We've already recorded the non-ignorable code points before the proposed
-   * boundary */
-  wbbefore = utf32__iterator_word_break(it, it->last[1]);
-  wbtwobefore = utf32__iterator_word_break(it, it->last[0]);
-
+static inline int utf32__word_rules(enum unicode_Word_Break wbtwobefore,
+                                    enum unicode_Word_Break wbbefore,
+                                    enum unicode_Word_Break wbafter,
+                                    enum unicode_Word_Break wbtwoafter) {
   /* WB5 */
   if(wbbefore == unicode_Word_Break_ALetter
      && wbafter == unicode_Word_Break_ALetter)
@@ -862,6 +933,69 @@ int utf32_iterator_word_boundary(utf32_iterator it) {
   return 1;
 }
 
+/** @brief Test for a word boundary
+ * @param it Iterator
+ * @return Non-0 if pointing just after a word boundary, otherwise 0
+ *
+ * This function identifies default word boundaries as described in UAX #29 s4.
+ * It returns non-0 if @p it points at the code point just after a word
+ * boundary (including the hypothetical code point just after the end of the
+ * string) and 0 otherwise.
+ */
+int utf32_iterator_word_boundary(utf32_iterator it) {
+  uint32_t before, after;
+  enum unicode_Word_Break wbtwobefore, wbbefore, wbafter, wbtwoafter;
+  size_t nn;
+
+  /* WB1 and WB2 */
+  if(it->n == 0 || it->n == it->ns)
+    return 1;
+  before = it->s[it->n-1];
+  after = it->s[it->n];
+  /* WB3 */
+  if(before == 0x000D && after == 0x000A)
+    return 0;
+  /* WB3a */
+  if(utf32__iterator_word_break(it, before) == unicode_Word_Break_Newline
+     || before == 0x000D
+     || before == 0x000A)
+    return 1;
+  /* WB3b */
+  if(utf32__iterator_word_break(it, after) == unicode_Word_Break_Newline
+     || after == 0x000D
+     || after == 0x000A)
+    return 1;
+  /* WB4 */
+  /* (!Sep) x (Extend|Format) as in UAX #29 s6.2 */
+  if(utf32__sentence_break(before) != unicode_Sentence_Break_Sep
+     && utf32__boundary_ignorable(utf32__iterator_word_break(it, after)))
+    return 0;
+  /* Gather the property values we'll need for the rest of the test taking the
+   * s6.2 changes into account */
+  /* First we look at the code points after the proposed boundary */
+  nn = it->n;                           /* <it->ns */
+  wbafter = utf32__iterator_word_break(it, it->s[nn++]);
+  if(!utf32__boundary_ignorable(wbafter)) {
+    /* X (Extend|Format)* -> X */
+    while(nn < it->ns
+          && utf32__boundary_ignorable(utf32__iterator_word_break(it,
+                                                                  it->s[nn])))
+      ++nn;
+  }
+  /* It's possible now that nn=ns */
+  if(nn < it->ns)
+    wbtwoafter = utf32__iterator_word_break(it, it->s[nn]);
+  else
+    wbtwoafter = unicode_Word_Break_Other;
+
+  /* We've already recorded the non-ignorable code points before the proposed
+   * boundary */
+  wbbefore = utf32__iterator_word_break(it, it->last[1]);
+  wbtwobefore = utf32__iterator_word_break(it, it->last[0]);
+
+  return utf32__word_rules(wbtwobefore, wbbefore, wbafter, wbtwoafter);
+}
+
 /*@}*/
 /** @defgroup utf32 Functions that operate on UTF-32 strings */
 /*@{*/
@@ -1703,6 +1837,101 @@ error:
 }
 
 
+/** @brief Casefold and split an ASCII string into words
+ * @param s Pointer to start of string
+ * @param ns Length of string
+ * @param nwp Where to store word count, or NULL
+ * @param wbreak Word_Break property tailor, or NULL
+ * @return Pointer to array of pointers to words, or NULL
+ *
+ * If [s,s+ns) is ASCII, returns the words found by casefolding it with
+ * utf8_casefold_compat(), removing combining characters and splitting the
+ * result with utf8_word_split(), but without converting to UTF-32.  ASCII has
+ * no combining characters and no Extend or Format characters to skip, so
+ * casefolding is just lower-casing and each boundary depends only on the two
+ * bytes either side of it.
+ *
+ * Returns NULL if the string is not ASCII, or if @p wbreak makes any of it
+ * Extend or Format, and the caller must take the slow path.
+ *
+ * The returned array is terminated by a NULL pointer and individual
+ * strings are 0-terminated.
+ */
+char **utf8_casefold_word_split_ascii(const char *s, size_t ns, size_t *nwp,
+                                      unicode_property_tailor *wbreak) {
+  unsigned char buffer[256], *wb = buffer;
+  char *f, **ret = NULL;
+  size_t n, start;
+  int isword;
+  struct vector v[1];
+  enum unicode_Word_Break none, wbtwobefore, wbtwoafter;
+
+  if(utf8_ascii_prefix(s, ns) != ns)
+    return NULL;
+  if(ns > sizeof buffer)
+    wb = xmalloc_noptr(ns);
+  /* Word_Break values of the casefolded string, as the iterator sees them */
+  f = xmalloc_noptr(ns + 1);
+  for(n = 0; n < ns; ++n) {
+    f[n] = (s[n] >= 'A' && s[n] <= 'Z') ? s[n] + ('a' - 'A') : s[n];
+    if(wbreak && wbreak((unsigned char)f[n]) >= 0)
+      wb[n] = wbreak((unsigned char)f[n]);
+    else
+      wb[n] = utf32__word_break((unsigned char)f[n]);
+    if(utf32__boundary_ignorable(wb[n]))
+      goto done;
+  }
+  f[ns] = 0;
+  /* The iterator's placeholder for the code point before the first */
+  if(wbreak && wbreak((uint32_t)-1) >= 0)
+    none = wbreak((uint32_t)-1);
+  else
+    none = utf32__word_break((uint32_t)-1);
+  vector_init(v);
+  start = 0;
+  isword = 0;
+  for(n = 1; n <= ns; ++n) {
+    switch(wb[n - 1]) {
+    case unicode_Word_Break_ALetter:
+    case unicode_Word_Break_Numeric:
+    case unicode_Word_Break_Katakana:
+      isword = 1;
+      break;
+    default:
+      break;
+    }
+    if(n < ns) {
+      /* WB3 */
+      if(f[n - 1] == 0x0D && f[n] == 0x0A)
+        continue;
+      /* WB3a and WB3b force a boundary; otherwise apply WB5 onwards */
+      if(!(wb[n - 1] == unicode_Word_Break_Newline
+           || f[n - 1] == 0x0D || f[n - 1] == 0x0A
+           || wb[n] == unicode_Word_Break_Newline
+           || f[n] == 0x0D || f[n] == 0x0A)) {
+        wbtwobefore = n >= 2 ? wb[n - 2] : none;
+        wbtwoafter = n + 1 < ns ? wb[n + 1] : unicode_Word_Break_Other;
+        if(!utf32__word_rules(wbtwobefore, wb[n - 1], wb[n], wbtwoafter))
+          continue;
+      }
+    }
+    /* [start,n) lies between two boundaries */
+    if(isword)
+      vector_append(v, xstrndup(f + start, n - start));
+    start = n;
+    isword = 0;
+  }
+  vector_terminate(v);
+  if(nwp)
+    *nwp = v->nvec;
+  ret = v->vec;
+done:
+  if(wb != buffer)
+    xfree(wb);
+  xfree(f);
+  return ret;
+}
+
 /*@}*/
 
 /** @brief Return the length of a 0-terminated UTF-16 string
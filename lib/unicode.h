@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrde
- * Copyright (C) 2007, 2008, 2013 Richard Kettlewell
+ * Copyright (C) 2007, 2008, 2013, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -47,6 +47,8 @@ uint32_t *utf8_to_utf32(const char *s, size_t ns, size_t *nd);
 char *utf16_to_utf8(const uint16_t *s, size_t ns, size_t *nd);
 uint16_t *utf8_to_utf16(const char *s, size_t ns, size_t *nd);
 int utf8_valid(const char *s, size_t ns);
+size_t utf8_ascii_prefix(const char *s, size_t ns);
+int utf8_quick_check_nfc(const char *s, size_t ns);
 
 int utf32_combining_class(uint32_t c);
 
@@ -91,6 +93,8 @@ uint32_t **utf32_word_split(const uint32_t *s, size_t ns, size_t *nwp,
                             unicode_property_tailor *wbreak);
 char **utf8_word_split(const char *s, size_t ns, size_t *nwp,
                             unicode_property_tailor *wbreak);
+char **utf8_casefold_word_split_ascii(const char *s, size_t ns, size_t *nwp,
+                                      unicode_property_tailor *wbreak);
 
 /** @brief Convert 0-terminated UTF-32 to UTF-8
  * @param s 0-terminated UTF-32 string
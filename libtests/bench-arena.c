@@ -0,0 +1,120 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file libtests/bench-arena.c
+ * @brief Benchmark for arena allocation
+ *
+ * Builds the kind of result the server builds to answer a search or a new
+ * command: a vector of a few hundred track names.  This is done first with
+ * each result allocated from an arena that is reset afterwards, and then
+ * with everything allocated from the heap.  The heap size and number of
+ * garbage collections are reported before and after each pass.
+ *
+ * Usage: bench-arena [COMMANDS]
+ */
+#include "common.h"
+
+#include <time.h>
+
+#include "mem.h"
+#include "log.h"
+#include "printf.h"
+#include "vector.h"
+#include "timeval.h"
+#include "syscalls.h"
+
+/** @brief Number of track names in each result */
+#define RESULTS 500
+
+/** @brief Something to stop the compiler discarding results */
+static volatile size_t sink;
+
+/* One command's worth of results, from A or from the heap if A is NULL */
+static void work(struct mem_arena *a) {
+  char name[128];
+  struct vector v[1];
+  int n, len, old;
+
+  vector_init(v);
+  for(n = 0; n < RESULTS; ++n) {
+    len = snprintf(name, sizeof name,
+                   "/music/Bj\xc3\xb6rk/Post/%02d:Army of Me.ogg", n);
+    if(!a) {
+      vector_append(v, xstrndup(name, len));
+      continue;
+    }
+    if(v->nvec >= v->nslots) {
+      old = v->nslots;
+      v->nslots = old ? 2 * old : 16;
+      v->vec = mem_arena_realloc(a, v->vec, old * sizeof (char *),
+                                 v->nslots * sizeof (char *));
+    }
+    v->vec[v->nvec++] = mem_arena_strndup(a, name, len);
+  }
+  sink += v->nvec;
+}
+
+static void report(const char *what, long commands,
+                   const struct timeval *started,
+                   const struct timeval *finished,
+                   const struct mem_stats *before,
+                   const struct mem_stats *after) {
+  printf("%-6s %8.2fus per command; heap %zu -> %zu bytes;"
+         " %zu collections; arenas %zu bytes\n",
+         what, (double)tvsub_us(*finished, *started) / commands,
+         before->heap_size, after->heap_size,
+         after->collections - before->collections,
+         after->arena_size);
+}
+
+int main(int argc, char **argv) {
+  long commands = 10000, n;
+  struct timeval started, finished;
+  struct mem_stats before, after;
+  struct mem_arena *a;
+
+  mem_init();
+  if(argc > 1) commands = atol(argv[1]);
+  a = mem_arena_new();
+  mem_get_stats(&before);
+  xgettimeofday(&started, NULL);
+  for(n = 0; n < commands; ++n) {
+    work(a);
+    mem_arena_reset(a);
+  }
+  xgettimeofday(&finished, NULL);
+  mem_get_stats(&after);
+  report("arena", commands, &started, &finished, &before, &after);
+  /* The heap pass goes second, so that its growth doesn't hide the arena's */
+  mem_get_stats(&before);
+  xgettimeofday(&started, NULL);
+  for(n = 0; n < commands; ++n)
+    work(NULL);
+  xgettimeofday(&finished, NULL);
+  mem_get_stats(&after);
+  report("heap", commands, &started, &finished, &before, &after);
+  return 0;
+}
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
@@ -0,0 +1,272 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file libtests/bench-framing.c
+ * @brief Benchmark for text and binary framing of response bodies
+ *
+ * Encodes a large track listing and a queue the way the server does, sends
+ * them over a socket pair and decodes them the way lib/client.c does, once
+ * with dot-stuffed text framing and once with binary framing.  Reports the
+ * body size and the time to encode and to receive and decode it.
+ *
+ * Usage: bench-framing [TRACKS [QUEUE]]
+ */
+#include "common.h"
+
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "mem.h"
+#include "log.h"
+#include "printf.h"
+#include "vector.h"
+#include "sink.h"
+#include "socketio.h"
+#include "inputline.h"
+#include "queue.h"
+#include "frame.h"
+#include "timeval.h"
+#include "syscalls.h"
+
+/** @brief Something to stop the compiler discarding results */
+static volatile size_t sink;
+
+static void encode_list_text(struct sink *s, char **names, long n) {
+  long i;
+
+  for(i = 0; i < n; ++i) {
+    if(*names[i] == '.')
+      sink_writec(s, '.');
+    sink_writes(s, names[i]);
+    sink_writec(s, '\n');
+  }
+  sink_writes(s, ".\n");
+}
+
+static void encode_list_binary(struct sink *s, char **names, long n) {
+  long i;
+
+  for(i = 0; i < n; ++i)
+    frame_write(s, names[i], strlen(names[i]));
+  frame_end(s);
+}
+
+static void encode_queue_text(struct sink *s, struct queue_entry *q, long n) {
+  long i;
+
+  for(i = 0; i < n; ++i)
+    sink_printf(s, " %s\n", queue_marshall(&q[i]));
+  sink_writes(s, ".\n");
+}
+
+static void encode_field(const char *name, const char *value, void *u) {
+  struct sink *s = u;
+
+  frame_write(s, name, strlen(name));
+  frame_write(s, value, strlen(value));
+}
+
+static void encode_queue_binary(struct sink *s, struct queue_entry *q,
+                                long n) {
+  long i;
+
+  for(i = 0; i < n; ++i) {
+    queue_marshall_fields(&q[i], encode_field, s);
+    frame_write(s, "", 0);
+  }
+  frame_end(s);
+}
+
+/* As readframe() in lib/client.c */
+static int read_frame(struct socketio *sio, char **itemp) {
+  unsigned char h[FRAME_HEADER];
+  uint32_t len;
+  char *item;
+
+  if(socketio_read(sio, h, FRAME_HEADER))
+    disorder_fatal(0, "unexpected EOF");
+  if((len = frame_length(h)) == FRAME_END)
+    return 0;
+  item = xmalloc_noptr(len + 1);
+  if(socketio_read(sio, item, len))
+    disorder_fatal(0, "unexpected EOF");
+  item[len] = 0;
+  *itemp = item;
+  return 1;
+}
+
+/* As readlist() in lib/client.c */
+static size_t decode_list_text(struct socketio *sio) {
+  struct source *s = source_socketio(sio);
+  struct vector v;
+  char *l;
+
+  vector_init(&v);
+  while(!inputlines("bench", s, &l, '\n') && strcmp(l, ".")) {
+    vector_append(&v, xstrdup(l + (*l == '.')));
+    xfree(l);
+  }
+  return v.nvec;
+}
+
+static size_t decode_list_binary(struct socketio *sio) {
+  struct vector v;
+  char *l;
+
+  vector_init(&v);
+  while(read_frame(sio, &l))
+    vector_append(&v, l);
+  return v.nvec;
+}
+
+static void decode_error(const char *msg, void attribute((unused)) *u) {
+  disorder_fatal(0, "decoding queue: %s", msg);
+}
+
+/* As readqueue() in lib/client.c */
+static size_t decode_queue_text(struct socketio *sio) {
+  struct source *s = source_socketio(sio);
+  struct queue_entry *q;
+  size_t n = 0;
+  char *l;
+
+  while(!inputlines("bench", s, &l, '\n') && strcmp(l, ".")) {
+    q = xmalloc(sizeof *q);
+    queue_unmarshall(q, l, decode_error, 0);
+    xfree(l);
+    ++n;
+  }
+  return n;
+}
+
+static size_t decode_queue_binary(struct socketio *sio) {
+  struct queue_entry *q;
+  struct vector v;
+  size_t n = 0;
+  char *l;
+
+  vector_init(&v);
+  while(read_frame(sio, &l)) {
+    if(*l || v.nvec % 2) {
+      vector_append(&v, l);
+      continue;
+    }
+    q = xmalloc(sizeof *q);
+    q->pid = -1;
+    queue_unmarshall_vec(q, v.nvec, v.vec, decode_error, 0);
+    v.nvec = 0;
+    ++n;
+  }
+  return n;
+}
+
+/** @brief Send a body over a socket pair and time decoding it */
+static void transfer(const char *what,
+                     const struct timeval *encode_started,
+                     const struct timeval *encode_finished,
+                     const struct dynstr *body,
+                     size_t (*decode)(struct socketio *sio)) {
+  int sv[2], w;
+  pid_t pid;
+  struct socketio sio;
+  struct timeval started, finished;
+
+  if(socketpair(PF_UNIX, SOCK_STREAM, 0, sv) < 0)
+    disorder_fatal(errno, "socketpair");
+  if(!(pid = xfork())) {
+    xclose(sv[0]);
+    if(write(sv[1], body->vec, body->nvec) != body->nvec)
+      _exit(1);
+    _exit(0);
+  }
+  xclose(sv[1]);
+  socketio_init(&sio, sv[0]);
+  xgettimeofday(&started, NULL);
+  sink += decode(&sio);
+  xgettimeofday(&finished, NULL);
+  xclose(sv[0]);
+  while(waitpid(pid, &w, 0) < 0 && errno == EINTR)
+    ;
+  printf("%-12s %10d bytes; encode %8.2fms; decode %8.2fms\n",
+         what, body->nvec,
+         tvsub_us(*encode_finished, *encode_started) / 1000.0,
+         tvsub_us(finished, started) / 1000.0);
+}
+
+int main(int argc, char **argv) {
+  long ntracks = 400000, nqueue = 20000, n;
+  char **names;
+  struct queue_entry *q;
+  struct dynstr body;
+  struct timeval started, finished;
+
+  mem_init();
+  if(argc > 1) ntracks = atol(argv[1]);
+  if(argc > 2) nqueue = atol(argv[2]);
+  names = xcalloc(ntracks, sizeof *names);
+  for(n = 0; n < ntracks; ++n)
+    byte_xasprintf(&names[n],
+                   "/export/music/Artist %ld/Album Title %ld/%02ld:Track %ld.ogg",
+                   n / 200, n / 12, n % 12 + 1, n);
+  q = xcalloc(nqueue, sizeof *q);
+  for(n = 0; n < nqueue; ++n) {
+    q[n].track = names[n % ntracks];
+    q[n].submitter = "fred";
+    q[n].when = 1700000000 + n;
+    q[n].expected = 1700000300 + n;
+    q[n].state = playing_unplayed;
+    q[n].origin = origin_picked;
+    byte_xasprintf((char **)&q[n].id, "%08lx", n);
+  }
+
+  dynstr_init(&body);
+  xgettimeofday(&started, NULL);
+  encode_list_text(sink_dynstr(&body), names, ntracks);
+  xgettimeofday(&finished, NULL);
+  transfer("list text", &started, &finished, &body, decode_list_text);
+
+  dynstr_init(&body);
+  xgettimeofday(&started, NULL);
+  encode_list_binary(sink_dynstr(&body), names, ntracks);
+  xgettimeofday(&finished, NULL);
+  transfer("list binary", &started, &finished, &body, decode_list_binary);
+
+  dynstr_init(&body);
+  xgettimeofday(&started, NULL);
+  encode_queue_text(sink_dynstr(&body), q, nqueue);
+  xgettimeofday(&finished, NULL);
+  transfer("queue text", &started, &finished, &body, decode_queue_text);
+
+  dynstr_init(&body);
+  xgettimeofday(&started, NULL);
+  encode_queue_binary(sink_dynstr(&body), q, nqueue);
+  xgettimeofday(&finished, NULL);
+  transfer("queue binary", &started, &finished, &body, decode_queue_binary);
+  return 0;
+}
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
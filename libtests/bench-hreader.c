@@ -0,0 +1,176 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file libtests/bench-hreader.c
+ * @brief Benchmark for hands-off reader settings
+ *
+ * Decodes a corpus of WAV files the way disorder-decode does, with each
+ * combination of buffer size, @ref HREADER_KEEP_OPEN and @ref
+ * HREADER_PREFETCH.  The corpus is created in DIRECTORY, which should be on
+ * the filesystem of interest (e.g. an NFS mount).  Where possible the corpus
+ * is dropped from the page cache before each pass, so that prefetching has
+ * something to do.
+ *
+ * Usage: bench-hreader [DIRECTORY [FILES [MEGABYTES]]]
+ */
+#include "common.h"
+
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mem.h"
+#include "log.h"
+#include "hreader.h"
+#include "wav.h"
+#include "printf.h"
+#include "timeval.h"
+#include "syscalls.h"
+
+static const size_t bufsizes[] = { 65536, 262144, 1048576 };
+
+static const struct {
+  const char *name;
+  unsigned flags;
+} modes[] = {
+  { "hands-off", 0 },
+  { "hands-off+prefetch", HREADER_PREFETCH },
+  { "keep-open", HREADER_KEEP_OPEN },
+  { "keep-open+prefetch", HREADER_KEEP_OPEN|HREADER_PREFETCH },
+};
+
+/** @brief Something to stop the compiler discarding results */
+static volatile uint32_t sink;
+
+static void put16(char *p, unsigned n) {
+  p[0] = n;
+  p[1] = n >> 8;
+}
+
+static void put32(char *p, uint32_t n) {
+  put16(p, n);
+  put16(p + 2, n >> 16);
+}
+
+/* Create a 44.1KHz 16-bit stereo WAV file of the given size */
+static void make_wav(const char *path, size_t bytes) {
+  char header[44], *data = xmalloc_noptr(bytes);
+  size_t n;
+  int fd;
+
+  memcpy(header, "RIFF....WAVEfmt ", 16);
+  put32(header + 4, 36 + bytes);
+  put32(header + 16, 16);
+  put16(header + 20, 1);                /* PCM */
+  put16(header + 22, 2);
+  put32(header + 24, 44100);
+  put32(header + 28, 44100 * 4);
+  put16(header + 32, 4);
+  put16(header + 34, 16);
+  memcpy(header + 36, "data", 4);
+  put32(header + 40, bytes);
+  for(n = 0; n < bytes; ++n)
+    data[n] = random();
+  if((fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0666)) < 0)
+    disorder_fatal(errno, "creating %s", path);
+  if(write(fd, header, sizeof header) != sizeof header
+     || write(fd, data, bytes) != (ssize_t)bytes)
+    disorder_fatal(errno, "writing %s", path);
+  xclose(fd);
+  xfree(data);
+}
+
+static void uncache(const char *path) {
+#if HAVE_POSIX_FADVISE
+  int fd;
+
+  if((fd = open(path, O_RDONLY)) >= 0) {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    xclose(fd);
+  }
+#else
+  (void)path;
+#endif
+}
+
+/* Stand-in for writing decoded samples to the speaker */
+static int consume(struct wavfile attribute((unused)) *f,
+                   const char *data,
+                   size_t nbytes,
+                   void attribute((unused)) *u) {
+  uint32_t h = 0;
+  size_t n;
+
+  for(n = 0; n < nbytes; n += 64)
+    h += (unsigned char)data[n];
+  sink += h;
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  const char *dir = ".";
+  int files = 8, megabytes = 32, n, err;
+  char **paths;
+  size_t b, m;
+  struct wavfile f[1];
+  struct timeval started, finished;
+  double secs;
+
+  mem_init();
+  if(argc > 1) dir = argv[1];
+  if(argc > 2) files = atoi(argv[2]);
+  if(argc > 3) megabytes = atoi(argv[3]);
+  paths = xcalloc(files, sizeof *paths);
+  for(n = 0; n < files; ++n) {
+    byte_xasprintf(&paths[n], "%s/bench-hreader-%d.wav", dir, n);
+    make_wav(paths[n], (size_t)megabytes << 20);
+  }
+  for(b = 0; b < sizeof bufsizes / sizeof *bufsizes; ++b)
+    for(m = 0; m < sizeof modes / sizeof *modes; ++m) {
+      hreader_defaults(bufsizes[b], modes[m].flags);
+      for(n = 0; n < files; ++n)
+        uncache(paths[n]);
+      xgettimeofday(&started, NULL);
+      for(n = 0; n < files; ++n) {
+        if((err = wav_init(f, paths[n])))
+          disorder_fatal(err, "opening %s", paths[n]);
+        if((err = wav_data(f, consume, NULL)))
+          disorder_fatal(err, "reading %s", paths[n]);
+        wav_destroy(f);
+      }
+      xgettimeofday(&finished, NULL);
+      secs = tvsub_us(finished, started) / 1e6;
+      printf("bufsize=%-7zu %-19s %7.1fMB/s %7.0f opens\n",
+             bufsizes[b], modes[m].name, files * megabytes / secs,
+             modes[m].flags & HREADER_KEEP_OPEN
+               ? (double)files
+               : (double)files * ((size_t)megabytes << 20) / bufsizes[b]);
+    }
+  for(n = 0; n < files; ++n)
+    unlink(paths[n]);
+  return 0;
+}
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
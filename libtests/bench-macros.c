@@ -0,0 +1,182 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2008 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file libtests/bench-macros.c
+ * @brief Benchmark for template expansion
+ *
+ * Renders templates/choose.tmpl against a large synthetic directory, using
+ * stand-ins for the CGI's expansions that don't need a server.
+ *
+ * Usage: bench-macros [DIRS [TRACKS [ROUNDS]]]
+ */
+#include "common.h"
+
+#include <time.h>
+
+#include "mem.h"
+#include "log.h"
+#include "hash.h"
+#include "macros.h"
+#include "sink.h"
+#include "vector.h"
+#include "timeval.h"
+#include "printf.h"
+#include "syscalls.h"
+
+static int ndirs = 1000, ntracks = 10000, rounds = 5;
+
+/* Expansions that just echo (part of) their first argument */
+static int exp_echo(int attribute((unused)) nargs,
+                    char **args,
+                    struct sink *output,
+                    void attribute((unused)) *u) {
+  return sink_writes(output, nargs ? args[0] : "x") < 0 ? -1 : 0;
+}
+
+static int exp_arg(int attribute((unused)) nargs,
+                   char **args,
+                   struct sink *output,
+                   void attribute((unused)) *u) {
+  if(!strcmp(args[0], "dir"))
+    return sink_writes(output, "/music/Some Artist") < 0 ? -1 : 0;
+  return 0;
+}
+
+static int exp_empty(int attribute((unused)) nargs,
+                     char attribute((unused)) **args,
+                     struct sink attribute((unused)) *output,
+                     void attribute((unused)) *u) {
+  return 0;
+}
+
+static int exp_right(int nargs,
+                     const struct mx_node **args,
+                     struct sink *output,
+                     void *u) {
+  return nargs > 1 ? mx_expand(args[1], output, u) : 0;
+}
+
+static int exp_breadcrumbs(int attribute((unused)) nargs,
+                           const struct mx_node **args,
+                           struct sink *output,
+                           void *u) {
+  return mx_expand(mx_rewritel(args[1], "dir", "/music", (char *)0),
+                   output, u);
+}
+
+/* Same shape as exp__files_dirs() in cgi/macros-disorder.c */
+static int exp__files_dirs(int nargs,
+                           const struct mx_node **args,
+                           struct sink *output,
+                           void *u,
+                           int count,
+                           const char *what) {
+  const struct mx_node *m = args[nargs - 1];
+  char *name, *display;
+  int n, rc;
+
+  for(n = 0; n < count; ++n) {
+    byte_xasprintf(&name, "/music/Some Artist/%s %05d", what, n);
+    byte_xasprintf(&display, "%s %05d", what, n);
+    if((rc = mx_expand(mx_rewritel(m,
+                                   "index", "1",
+                                   "parity", n % 2 ? "odd" : "even",
+                                   "track", name,
+                                   "first", n == 0 ? "true" : "false",
+                                   "last", n + 1 == count ? "false" : "true",
+                                   "sort", display,
+                                   "display", display,
+                                   (char *)0),
+                       output, u)))
+      return rc;
+  }
+  return 0;
+}
+
+static int exp_dirs(int nargs,
+                    const struct mx_node **args,
+                    struct sink *output,
+                    void *u) {
+  return exp__files_dirs(nargs, args, output, u, ndirs, "Album");
+}
+
+static int exp_tracks(int nargs,
+                      const struct mx_node **args,
+                      struct sink *output,
+                      void *u) {
+  return exp__files_dirs(nargs, args, output, u, ntracks, "Track");
+}
+
+static const char *const echoes[] = {
+  "argq", "image", "label", "length", "part", "pref", "quote", "resolve",
+  "state", "thisurl", "trackstate", "url", "version", "when", "who",
+  "movable", "removable", "user", "transform",
+};
+
+int main(int argc, char **argv) {
+  struct dynstr d[1];
+  struct timeval started, finished;
+  int n, rc;
+  uint32_t h;
+  size_t i;
+
+  mem_init();
+  if(argc > 1) ndirs = atoi(argv[1]);
+  if(argc > 2) ntracks = atoi(argv[2]);
+  if(argc > 3) rounds = atoi(argv[3]);
+  mx_register_builtin();
+  for(i = 0; i < sizeof echoes / sizeof *echoes; ++i)
+    mx_register(echoes[i], 0, 3, exp_echo);
+  mx_register("arg", 1, 1, exp_arg);
+  mx_register("enabled", 0, 0, exp_empty);
+  mx_register("random-enabled", 0, 0, exp_empty);
+  mx_register("error", 0, 0, exp_empty);
+  mx_register("status", 0, 0, exp_empty);
+  mx_register("server-version", 0, 0, exp_empty);
+  mx_register_magic("right", 1, 3, exp_right);
+  mx_register_magic("breadcrumbs", 2, 2, exp_breadcrumbs);
+  mx_register_magic("dirs", 2, 3, exp_dirs);
+  mx_register_magic("tracks", 2, 3, exp_tracks);
+  mx_search_path(SRCDIR "/../templates");
+  if(mx_expand_file(mx_find("macros.tmpl", 1), sink_discard(), 0))
+    disorder_fatal(0, "expanding macros.tmpl failed");
+  for(n = 0; n < rounds; ++n) {
+    dynstr_init(d);
+    xgettimeofday(&started, NULL);
+    rc = mx_expand_file(mx_find("choose.tmpl", 1), sink_dynstr(d), 0);
+    xgettimeofday(&finished, NULL);
+    if(rc)
+      disorder_fatal(0, "expanding choose.tmpl failed");
+    /* Checksum the output so that changes in behaviour are visible */
+    h = 0;
+    for(i = 0; i < (size_t)d->nvec; ++i)
+      h = 31 * h + (unsigned char)d->vec[i];
+    printf("choose.tmpl dirs=%d tracks=%d: %zu bytes (%08"PRIx32") in %"PRId64"us\n",
+           ndirs, ntracks, (size_t)d->nvec, h,
+           tvsub_us(finished, started));
+  }
+  return 0;
+}
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
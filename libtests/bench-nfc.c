@@ -0,0 +1,95 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file libtests/bench-nfc.c
+ * @brief Benchmark for normalizing protocol commands
+ *
+ * Times what the server does to each command line before parsing it: always
+ * calling utf8_compose_canon(), as it used to, and calling it only when
+ * utf8_quick_check_nfc() fails.
+ *
+ * Usage: bench-nfc [ITERATIONS]
+ */
+#include "common.h"
+
+#include <time.h>
+
+#include "mem.h"
+#include "log.h"
+#include "unicode.h"
+#include "timeval.h"
+#include "syscalls.h"
+
+/* Typical command lines */
+static const char *const lines[] = {
+  "playing",
+  "queue",
+  "volume",
+  "recent",
+  "play /music/Artist/Album/01:Title.ogg",
+  "get /music/Artist/Album/01:Title.ogg trackname_display_title",
+  "part /music/Artist/Album/01:Title.ogg display artist",
+  "length /music/The Artist/Some Album Name/07:A Rather Long Title.flac",
+  "play /music/Bj\xC3\xB6rk/Post/01:Army of Me.ogg",
+  "play /music/Bjo\xCC\x88rk/Post/01:Army of Me.ogg",
+};
+
+#define NLINES (sizeof lines / sizeof *lines)
+
+/** @brief Something to stop the compiler discarding results */
+static volatile size_t sink;
+
+int main(int argc, char **argv) {
+  long iterations = 200000, n;
+  struct timeval started, finished;
+  size_t l;
+  const char *line;
+  double before, after;
+
+  mem_init();
+  if(argc > 1) iterations = atol(argv[1]);
+  for(l = 0; l < NLINES; ++l) {
+    const size_t len = strlen(lines[l]);
+
+    xgettimeofday(&started, NULL);
+    for(n = 0; n < iterations; ++n)
+      sink += strlen(utf8_compose_canon(lines[l], len, 0));
+    xgettimeofday(&finished, NULL);
+    before = 1000.0 * tvsub_us(finished, started) / iterations;
+    xgettimeofday(&started, NULL);
+    for(n = 0; n < iterations; ++n) {
+      line = lines[l];
+      if(!utf8_quick_check_nfc(line, len))
+        line = utf8_compose_canon(line, len, 0);
+      sink += strlen(line);
+    }
+    xgettimeofday(&finished, NULL);
+    after = 1000.0 * tvsub_us(finished, started) / iterations;
+    printf("%-24.24s %3zu bytes: %7.1fns -> %7.1fns per command\n",
+           lines[l], len, before, after);
+  }
+  return 0;
+}
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
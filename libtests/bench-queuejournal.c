@@ -0,0 +1,153 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file libtests/bench-queuejournal.c
+ * @brief Benchmark for queue persistence
+ *
+ * Compares rewriting the whole queue file after each change, as the server
+ * used to, with appending to the queue journal.  Each round makes the same
+ * sort of change as a user: a track finishes, another is added at the end and
+ * one is moved.  Neither path waits for the disk, except for the journal's
+ * occasional compactions, so this measures the cost to the server's event
+ * loop.  A single compaction and reading the result back are timed
+ * separately.
+ *
+ * Usage: bench-queuejournal [ENTRIES [ROUNDS]]
+ */
+#include "common.h"
+
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "mem.h"
+#include "log.h"
+#include "queue.h"
+#include "queue-journal.h"
+#include "printf.h"
+#include "timeval.h"
+#include "syscalls.h"
+
+#define QPATH "bench-queuejournal.queue"
+
+static unsigned nextid;
+
+static struct queue_entry *new_entry(void) {
+  struct queue_entry *q = xmalloc(sizeof *q);
+  char *s;
+
+  byte_xasprintf(&s, "%08x", nextid++);
+  q->id = s;
+  byte_xasprintf(&s, "/export/music/Some Artist/Some Album/%02u:Track %u.ogg",
+                 nextid % 20, nextid);
+  q->track = s;
+  q->submitter = "someone";
+  q->when = 1400000000 + nextid;
+  q->origin = origin_picked;
+  q->state = playing_unplayed;
+  return q;
+}
+
+/* What server/server-queue.c used to do */
+static void rewrite(const struct queue_entry *head, const char *path) {
+  char *tmp;
+  FILE *fp;
+  struct queue_entry *q;
+
+  byte_xasprintf(&tmp, "%s.new", path);
+  if(!(fp = fopen(tmp, "w"))) disorder_fatal(errno, "error opening %s", tmp);
+  if(fprintf(fp, "#1\n") < 0)
+    disorder_fatal(errno, "error writing %s", tmp);
+  for(q = head->next; q != head; q = q->next)
+    if(fprintf(fp, "%s\n", queue_marshall(q)) < 0)
+      disorder_fatal(errno, "error writing %s", tmp);
+  if(fclose(fp) < 0) disorder_fatal(errno, "error closing %s", tmp);
+  if(rename(tmp, path) < 0) disorder_fatal(errno, "error replacing %s", path);
+}
+
+/* One round of typical changes */
+static void change(struct queue_entry *head) {
+  struct queue_entry *q;
+  int n;
+
+  queue_delete_entry(head->next);
+  queue_insert_entry(head->prev, new_entry());
+  for(q = head->next, n = 0; n < 100; ++n)
+    q = q->next;
+  queue_delete_entry(q);
+  queue_insert_entry(head->next, q);
+}
+
+int main(int argc, char **argv) {
+  struct queue_entry head[1];
+  struct queue_journal *j;
+  struct timeval started, finished;
+  int entries = 2000, rounds = 1000, n;
+
+  mem_init();
+  if(argc > 1) entries = atoi(argv[1]);
+  if(argc > 2) rounds = atoi(argv[2]);
+  memset(head, 0, sizeof *head);
+  head->next = head->prev = head;
+  for(n = 0; n < entries; ++n)
+    queue_insert_entry(head->prev, new_entry());
+  /* Full rewrite */
+  xgettimeofday(&started, NULL);
+  for(n = 0; n < rounds; ++n) {
+    change(head);
+    rewrite(head, QPATH);
+  }
+  xgettimeofday(&finished, NULL);
+  printf("rewrite entries=%d: %.1fus/change\n", entries,
+         (double)tvsub_us(finished, started) / rounds);
+  /* Journal */
+  unlink(QPATH ".journal");
+  j = queue_journal_new(QPATH);
+  queue_journal_compact(j, head);
+  xgettimeofday(&started, NULL);
+  for(n = 0; n < rounds; ++n) {
+    change(head);
+    queue_journal_write(j, head);
+  }
+  xgettimeofday(&finished, NULL);
+  printf("journal entries=%d: %.1fus/change\n", entries,
+         (double)tvsub_us(finished, started) / rounds);
+  /* Compaction */
+  xgettimeofday(&started, NULL);
+  queue_journal_compact(j, head);
+  xgettimeofday(&finished, NULL);
+  printf("compact entries=%d: %"PRId64"us\n", entries,
+         tvsub_us(finished, started));
+  /* Startup */
+  xgettimeofday(&started, NULL);
+  queue_journal_read(queue_journal_new(QPATH), head);
+  xgettimeofday(&finished, NULL);
+  printf("read entries=%d: %"PRId64"us\n", entries,
+         tvsub_us(finished, started));
+  unlink(QPATH);
+  unlink(QPATH ".journal");
+  return 0;
+}
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
@@ -0,0 +1,111 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file libtests/bench-samples.c
+ * @brief Benchmark for sample buffer operations
+ *
+ * Times samples_swap16() and samples_zero() with each implementation the CPU
+ * supports, over packet sizes seen on the RTP paths.  The silence check is
+ * timed against both silent packets (which must be scanned completely) and
+ * ordinary ones.
+ *
+ * Usage: bench-samples [ITERATIONS]
+ */
+#include "common.h"
+
+#include <time.h>
+
+#include "mem.h"
+#include "log.h"
+#include "samples.h"
+#include "timeval.h"
+#include "syscalls.h"
+
+/** @brief Packet sizes in samples
+ *
+ * 722 is a full packet with the default rtp-max-payload and 2048 is the most
+ * that playrtp will accept. */
+static const size_t sizes[] = { 64, 256, 722, 2048 };
+
+/** @brief Something to stop the compiler discarding results */
+static volatile unsigned sink;
+
+int main(int argc, char **argv) {
+  const size_t maxsize = 2048 * 2;
+  uint8_t *audio = xmalloc_noptr(maxsize + 1);
+  uint8_t *silence = xmalloc_noptr(maxsize + 1);
+  uint8_t *out = xmalloc_noptr(maxsize + 1);
+  struct timeval started, finished;
+  long iterations = 200000, n;
+  size_t s, i;
+  int isa;
+
+  mem_init();
+  if(argc > 1) iterations = atol(argv[1]);
+  for(i = 0; i < maxsize; ++i)
+    audio[i] = random() | 1;
+  memset(silence, 0, maxsize + 1);
+  for(isa = SAMPLES_SCALAR; isa <= SAMPLES_AVX2; ++isa) {
+    if((int)samples_set_isa(isa) != isa)
+      continue;
+    for(s = 0; s < sizeof sizes / sizeof *sizes; ++s) {
+      const size_t nsamples = sizes[s];
+      /* Scale down the big ones so each run takes similar time */
+      const long count = iterations * 64 / (long)nsamples;
+      int64_t swap_ns, silent_ns, audio_ns;
+
+      /* Offset by one byte so the buffers are deliberately misaligned */
+      xgettimeofday(&started, NULL);
+      for(n = 0; n < count; ++n)
+        samples_swap16(out + 1, audio + 1, nsamples);
+      xgettimeofday(&finished, NULL);
+      swap_ns = 1000 * tvsub_us(finished, started);
+      xgettimeofday(&started, NULL);
+      for(n = 0; n < count; ++n)
+        sink += samples_zero(silence + 1, 2 * nsamples);
+      xgettimeofday(&finished, NULL);
+      silent_ns = 1000 * tvsub_us(finished, started);
+      xgettimeofday(&started, NULL);
+      for(n = 0; n < count; ++n)
+        sink += samples_zero(audio + 1, 2 * nsamples);
+      xgettimeofday(&finished, NULL);
+      audio_ns = 1000 * tvsub_us(finished, started);
+      printf("%-6s %5zu samples: swap %8.1fns  zero(silent) %8.1fns  zero(audio) %6.1fns\n",
+             samples_isa_name(isa), nsamples,
+             (double)swap_ns / count,
+             (double)silent_ns / count,
+             (double)audio_ns / count);
+    }
+  }
+  /* Check the implementations agree */
+  samples_set_isa(SAMPLES_SCALAR);
+  samples_swap16(silence, audio + 1, maxsize / 2);
+  samples_set_isa(SAMPLES_AVX2);
+  samples_swap16(out, audio + 1, maxsize / 2);
+  if(memcmp(silence, out, maxsize))
+    disorder_fatal(0, "implementations disagree");
+  return 0;
+}
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
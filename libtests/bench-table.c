@@ -0,0 +1,160 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file libtests/bench-table.c
+ * @brief Benchmark for table lookup
+ *
+ * Looks up every server command name, plus a few that aren't commands, first
+ * by binary search and then via a perfect hash, and reports the time per
+ * lookup.
+ *
+ * Usage: bench-table [ROUNDS]
+ */
+#include "common.h"
+
+#include "mem.h"
+#include "table.h"
+#include "timeval.h"
+#include "syscalls.h"
+
+/** @brief The server's command names */
+static const struct {
+  const char *name;
+} commands[] = {
+  { "adduser" },
+  { "adopt" },
+  { "allfiles" },
+  { "confirm" },
+  { "cookie" },
+  { "deluser" },
+  { "dirs" },
+  { "disable" },
+  { "edituser" },
+  { "enable" },
+  { "enabled" },
+  { "exists" },
+  { "files" },
+  { "get" },
+  { "get-global" },
+  { "length" },
+  { "log" },
+  { "make-cookie" },
+  { "memstats" },
+  { "move" },
+  { "moveafter" },
+  { "new" },
+  { "nop" },
+  { "part" },
+  { "pause" },
+  { "play" },
+  { "playafter" },
+  { "playing" },
+  { "playlist-delete" },
+  { "playlist-get" },
+  { "playlist-get-share" },
+  { "playlist-insert" },
+  { "playlist-length" },
+  { "playlist-lock" },
+  { "playlist-move" },
+  { "playlist-remove" },
+  { "playlist-set" },
+  { "playlist-set-share" },
+  { "playlist-unlock" },
+  { "playlists" },
+  { "prefs" },
+  { "queue" },
+  { "random-disable" },
+  { "random-enable" },
+  { "random-enabled" },
+  { "recent" },
+  { "reconfigure" },
+  { "register" },
+  { "reminder" },
+  { "remove" },
+  { "rescan" },
+  { "resolve" },
+  { "resume" },
+  { "revoke" },
+  { "rtp-address" },
+  { "rtp-cancel" },
+  { "rtp-request" },
+  { "schedule-add" },
+  { "schedule-del" },
+  { "schedule-get" },
+  { "schedule-list" },
+  { "scratch" },
+  { "search" },
+  { "set" },
+  { "set-global" },
+  { "shutdown" },
+  { "stats" },
+  { "tags" },
+  { "unset" },
+  { "unset-global" },
+  { "user" },
+  { "userinfo" },
+  { "users" },
+  { "version" },
+  { "volume" },
+};
+
+/** @brief Names to look up */
+static const char *names[sizeof commands / sizeof *commands + 3];
+
+/** @brief Something to stop the compiler discarding results */
+static volatile int sink;
+
+static struct table_hash commands_hash;
+
+int main(int argc, char **argv) {
+  long rounds = 1000000, n, lookups;
+  size_t i, nnames = 0;
+  struct timeval started, finished;
+
+  mem_init();
+  if(argc > 1) rounds = atol(argv[1]);
+  for(i = 0; i < sizeof commands / sizeof *commands; ++i)
+    names[nnames++] = commands[i].name;
+  names[nnames++] = "playlist-frobnicate";
+  names[nnames++] = "xyzzy";
+  names[nnames++] = "";
+  lookups = rounds * (long)nnames;
+  xgettimeofday(&started, NULL);
+  for(n = 0; n < rounds; ++n)
+    for(i = 0; i < nnames; ++i)
+      sink += TABLE_FIND(commands, name, names[i]);
+  xgettimeofday(&finished, NULL);
+  printf("binary search %6.2fns per lookup\n",
+         1000.0 * tvsub_us(finished, started) / lookups);
+  xgettimeofday(&started, NULL);
+  for(n = 0; n < rounds; ++n)
+    for(i = 0; i < nnames; ++i)
+      sink += TABLE_HASH_FIND(commands_hash, commands, name, names[i]);
+  xgettimeofday(&finished, NULL);
+  printf("perfect hash  %6.2fns per lookup\n",
+         1000.0 * tvsub_us(finished, started) / lookups);
+  return 0;
+}
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
@@ -0,0 +1,153 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file libtests/bench-trackname.c
+ * @brief Benchmark for track name calculation
+ *
+ * Computes the display and sort artist, album and title of a synthetic track
+ * list, plus the display and sort transforms, using the default namepart and
+ * transform rules.  This is done first by scanning all the rules on every
+ * call, as trackname_part() and trackname_transform() used to, and then with
+ * the current functions, twice: once with nothing remembered and once with
+ * everything remembered (if the list fits in @ref TRACKNAME_MEMO_SIZE).
+ *
+ * Usage: bench-trackname [TRACKS [PASSES]]
+ */
+#include "common.h"
+
+#include <time.h>
+#include <errno.h>
+#include <fnmatch.h>
+#include <unistd.h>
+
+#include "mem.h"
+#include "log.h"
+#include "configuration.h"
+#include "trackname.h"
+#include "regsub.h"
+#include "printf.h"
+#include "timeval.h"
+#include "syscalls.h"
+
+#define CONFIG "bench-trackname.conf"
+
+static const char *const contexts[] = { "display", "sort" };
+static const char *const parts[] = { "artist", "album", "title" };
+
+/** @brief Something to stop the compiler discarding results */
+static volatile size_t sink;
+
+/* What lib/trackname.c used to do */
+static const char *old_part(const char *track, const char *context,
+                            const char *part) {
+  const char *replaced, *rootless;
+
+  if((rootless = track_rootless(track))) track = rootless;
+  for(int n = 0; n < config->namepart.n; ++n) {
+    if(!strcmp(config->namepart.s[n].part, part)
+       && fnmatch(config->namepart.s[n].context, context, 0) == 0) {
+      if((replaced = regsub(config->namepart.s[n].re,
+                            track,
+                            config->namepart.s[n].replace,
+                            config->namepart.s[n].reflags
+                            |REGSUB_MUST_MATCH
+                            |REGSUB_REPLACE)))
+        return replaced;
+    }
+  }
+  return "";
+}
+
+static const char *old_transform(const char *type, const char *subject,
+                                 const char *context) {
+  const char *replaced;
+  const struct transform *k;
+
+  for(int n = 0; n < config->transform.n; ++n) {
+    k = &config->transform.t[n];
+    if(strcmp(k->type, type))
+      continue;
+    if(fnmatch(k->context, context, 0) != 0)
+      continue;
+    if((replaced = regsub(k->re, subject, k->replace, k->flags)))
+      subject = replaced;
+  }
+  return subject;
+}
+
+/* Compute every name for every track; return names per second */
+static double run(char **tracks, int ntracks, int passes, int old) {
+  struct timeval started, finished;
+  size_t c, p, names = 0;
+
+  xgettimeofday(&started, NULL);
+  for(int pass = 0; pass < passes; ++pass)
+    for(int n = 0; n < ntracks; ++n)
+      for(c = 0; c < sizeof contexts / sizeof *contexts; ++c) {
+        for(p = 0; p < sizeof parts / sizeof *parts; ++p) {
+          sink += strlen(old ? old_part(tracks[n], contexts[c], parts[p])
+                         : trackname_part(tracks[n], contexts[c], parts[p]));
+          ++names;
+        }
+        sink += strlen(old ? old_transform("track", tracks[n], contexts[c])
+                       : trackname_transform("track", tracks[n],
+                                             contexts[c]));
+        ++names;
+      }
+  xgettimeofday(&finished, NULL);
+  return names / (tvsub_us(finished, started) / 1e6);
+}
+
+int main(int argc, char **argv) {
+  int ntracks = 10000, passes = 3, n;
+  char **tracks;
+  FILE *fp;
+
+  mem_init();
+  if(argc > 1) ntracks = atoi(argv[1]);
+  if(argc > 2) passes = atoi(argv[2]);
+  if(!(fp = fopen(CONFIG, "w"))
+     || fprintf(fp, "collection fs UTF-8 /music\n") < 0
+     || fclose(fp) < 0)
+    disorder_fatal(errno, "writing %s", CONFIG);
+  configfile = xstrdup(CONFIG);
+  config_per_user = 0;
+  setenv("DISORDER_PRIVCONFIG", CONFIG ".private", 1);
+  if(config_read(0, NULL))
+    disorder_fatal(0, "cannot read %s", CONFIG);
+  unlink(CONFIG);
+  tracks = xcalloc(ntracks, sizeof *tracks);
+  for(n = 0; n < ntracks; ++n)
+    byte_xasprintf(&tracks[n], "/music/Artist %d/Album %d/%02d:Title %d.ogg",
+                   n / 200, n / 12, n % 12 + 1, n);
+  printf("tracks=%d old:           %9.0f names/s\n", ntracks,
+         run(tracks, ntracks, passes, 1));
+  printf("tracks=%d indexed:       %9.0f names/s\n", ntracks,
+         run(tracks, ntracks, 1, 0));
+  printf("tracks=%d indexed+memo:  %9.0f names/s\n", ntracks,
+         run(tracks, ntracks, passes, 0));
+  return 0;
+}
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
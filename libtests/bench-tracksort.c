@@ -0,0 +1,119 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file libtests/bench-tracksort.c
+ * @brief Benchmark for track sorting
+ *
+ * Sorts a synthetic directory listing twice: once with compare_tracks() as
+ * the comparison function, which casefolds on every comparison, and once with
+ * tracksort_sort(), which builds collation keys first.  The times for the
+ * second include building the keys.  The two orders are checked to agree.
+ *
+ * Usage: bench-tracksort [TRACKS [REPEATS]]
+ */
+#include "common.h"
+
+#include <time.h>
+
+#include "mem.h"
+#include "log.h"
+#include "trackname.h"
+#include "printf.h"
+#include "timeval.h"
+#include "syscalls.h"
+
+/* Words that make up the names, with a mix of case and some non-ASCII */
+static const char *const words[] = {
+  "the", "The", "THE", "love", "Love", "night", "Night", "song",
+  "caf\xC3\xA9", "CAF\xC3\x89", "stra\xC3\x9F" "e", "\xC3\x85ngstr\xC3\xB6m",
+  "blue", "Blue", "river", "River", "a", "A", "one", "two",
+};
+
+#define NWORDS (sizeof words / sizeof *words)
+
+/* Generate a title of a few words */
+static char *make_name(void) {
+  const int nw = 1 + random() % 4;
+  char *s = xstrdup("");
+
+  for(int n = 0; n < nw; ++n)
+    byte_xasprintf(&s, "%s%s%s", s, n ? " " : "", words[random() % NWORDS]);
+  return s;
+}
+
+/* The old way to sort */
+static int compare_old(const void *a, const void *b) {
+  const struct tracksort_data *ea = a, *eb = b;
+
+  return compare_tracks(ea->sort, eb->sort,
+                        ea->display, eb->display,
+                        ea->track, eb->track);
+}
+
+int main(int argc, char **argv) {
+  int ntracks = 20000, repeats = 5, n, r;
+  struct tracksort_data *base, *td, *expected;
+  struct timeval started, finished;
+  int64_t old_us = 0, new_us = 0;
+
+  mem_init();
+  if(argc > 1) ntracks = atoi(argv[1]);
+  if(argc > 2) repeats = atoi(argv[2]);
+  base = xcalloc(ntracks, sizeof *base);
+  td = xcalloc(ntracks, sizeof *td);
+  expected = xcalloc(ntracks, sizeof *expected);
+  for(n = 0; n < ntracks; ++n) {
+    char *display = make_name(), *track;
+
+    /* Strip a leading "the" from the sort key the way the usual
+     * configuration does */
+    byte_xasprintf(&track, "/music/Artist %d/Album/%02d:%s.ogg",
+                   n % 50, n % 20, display);
+    base[n].track = track;
+    base[n].display = display;
+    base[n].sort = strncasecmp(display, "the ", 4) ? display : display + 4;
+  }
+  for(r = 0; r < repeats; ++r) {
+    memcpy(td, base, ntracks * sizeof *td);
+    xgettimeofday(&started, NULL);
+    qsort(td, ntracks, sizeof *td, compare_old);
+    xgettimeofday(&finished, NULL);
+    old_us += tvsub_us(finished, started);
+    memcpy(expected, td, ntracks * sizeof *td);
+    memcpy(td, base, ntracks * sizeof *td);
+    xgettimeofday(&started, NULL);
+    tracksort_sort(ntracks, td);
+    xgettimeofday(&finished, NULL);
+    new_us += tvsub_us(finished, started);
+    for(n = 0; n < ntracks; ++n)
+      if(compare_old(&td[n], &expected[n]))
+        disorder_fatal(0, "orders differ at %d: %s vs %s",
+                       n, td[n].track, expected[n].track);
+  }
+  printf("%d tracks: compare_tracks %8.1fms  collation keys %8.1fms\n",
+         ntracks, old_us / 1000.0 / repeats, new_us / 1000.0 / repeats);
+  return 0;
+}
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
@@ -0,0 +1,137 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+/** @file libtests/bench-words.c
+ * @brief Benchmark for splitting track names into search words
+ *
+ * Splits a synthetic list of track names into words the way a rescan does,
+ * first through UTF-32 as lib/trackdb.c used to for every name and then with
+ * the ASCII fast path, falling back to UTF-32 for names that aren't ASCII.
+ * PERCENT of the names contain non-ASCII characters.
+ *
+ * Usage: bench-words [TRACKS [PERCENT]]
+ */
+#include "common.h"
+
+#include <time.h>
+
+#include "mem.h"
+#include "log.h"
+#include "unicode.h"
+#include "unidata.h"
+#include "printf.h"
+#include "timeval.h"
+#include "syscalls.h"
+
+static const char *const words[] = {
+  "The", "Love", "Night", "Song", "Blue", "River", "Don't", "Stop", "Me",
+  "Now", "Live", "at", "the", "BBC", "Part", "II", "Remastered", "2009",
+  "Mix", "feat.", "DJ", "Rock", "&", "Roll", "(Demo)", "-", "One", "Two",
+};
+
+#define NWORDS (sizeof words / sizeof *words)
+
+static const char *const accented[] = {
+  "Caf\xC3\xA9", "Bj\xC3\xB6rk", "Se\xC3\xB1or", "Stra\xC3\x9F" "e",
+};
+
+#define NACCENTED (sizeof accented / sizeof *accented)
+
+/** @brief Something to stop the compiler discarding results */
+static volatile size_t sink;
+
+static int tailor_underscore(uint32_t c) {
+  return c == '_' ? unicode_Word_Break_Other : -1;
+}
+
+/* What lib/trackdb.c used to do */
+static size_t split_utf32(const char *s) {
+  size_t nw, nt32, i, j, total = 0;
+  uint32_t *t32, **w32;
+
+  if(!(t32 = utf8_to_utf32(s, strlen(s), &nt32)))
+    return 0;
+  if(!(t32 = utf32_casefold_compat(t32, nt32, &nt32)))
+    return 0;
+  for(i = j = 0; i < nt32; ++i)
+    if(!utf32_combining_class(t32[i]))
+      t32[j++] = t32[i];
+  nt32 = j;
+  w32 = utf32_word_split(t32, nt32, &nw, tailor_underscore);
+  for(i = 0; i < nw; ++i)
+    total += strlen(utf32_to_utf8(w32[i], utf32_len(w32[i]), 0));
+  return total;
+}
+
+static size_t split_fast(const char *s) {
+  size_t nw, i, total = 0;
+  char **w;
+
+  if(!(w = utf8_casefold_word_split_ascii(s, strlen(s), &nw,
+                                          tailor_underscore)))
+    return split_utf32(s);
+  for(i = 0; i < nw; ++i)
+    total += strlen(w[i]);
+  return total;
+}
+
+static double run(char **names, int nnames, size_t (*split)(const char *)) {
+  struct timeval started, finished;
+
+  xgettimeofday(&started, NULL);
+  for(int n = 0; n < nnames; ++n)
+    sink += split(names[n]);
+  xgettimeofday(&finished, NULL);
+  return tvsub_us(finished, started) / 1000.0;
+}
+
+int main(int argc, char **argv) {
+  int ntracks = 100000, percent = 5, n, w, nw;
+  char **names;
+  double slow, fast;
+
+  mem_init();
+  if(argc > 1) ntracks = atoi(argv[1]);
+  if(argc > 2) percent = atoi(argv[2]);
+  names = xcalloc(ntracks, sizeof *names);
+  for(n = 0; n < ntracks; ++n) {
+    char *name;
+
+    byte_xasprintf(&name, "Artist_%d/Album %d/%02d", n / 200, n / 12,
+                   n % 12 + 1);
+    nw = 2 + random() % 5;
+    for(w = 0; w < nw; ++w)
+      byte_xasprintf(&name, "%s %s", name,
+                     random() % 100 < percent ? accented[random() % NACCENTED]
+                                              : words[random() % NWORDS]);
+    names[n] = name;
+  }
+  slow = run(names, ntracks, split_utf32);
+  fast = run(names, ntracks, split_fast);
+  printf("tracks=%d non-ASCII=%d%%: UTF-32 %.1fms  ASCII fast path %.1fms"
+         "  (%.1fx)\n", ntracks, percent, slow, fast, slow / fast);
+  return 0;
+}
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2005, 2007, 2008 Richard Kettlewell
+ * Copyright (C) 2005, 2007, 2008, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -17,9 +17,15 @@
  */
 #include "test.h"
 
+static size_t string_size(const void *value) {
+  return strlen(value) + 1;
+}
+
 static void test_cache(void) {
-  const struct cache_type t1 = { 1 }, t2 = { 10 };
+  const struct cache_type t1 = { 1, NULL }, t2 = { 10, NULL };
+  const struct cache_type t3 = { 10, string_size };
   const char v11[] = "spong", v12[] = "wibble", v2[] = "blat";
+  size_t base;
 
   cache_put(&t1, "1_1", v11);
   cache_put(&t1, "1_2", v12);
@@ -43,6 +49,17 @@ static void test_cache(void) {
   cache_clean(0);
   insist(cache_count() == 0);
   insist(cache_get(&t2, "2") == 0); 
+  check_integer(cache_bytes(), 0);
+  /* Memory use includes values when their size is known */
+  cache_put(&t2, "2", v2);
+  base = cache_bytes();
+  insist(base > 0);
+  cache_put(&t3, "2", v11);
+  check_integer(cache_bytes(), base + strlen(v11) + 1);
+  cache_put(&t3, "2", v12);
+  check_integer(cache_bytes(), base + strlen(v12) + 1);
+  cache_clean(&t3);
+  check_integer(cache_bytes(), 0);
 }
 
 TEST(cache);
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2008, 2009 Richard Kettlewell
+ * Copyright (C) 2008, 2009, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -46,6 +46,82 @@ static int callback3(ev_source attribute((unused)) *ev,
   return 1;
 }
 
+/* Writer drain test: write TOTAL bytes a chunk at a time, never buffering
+ * more than HIGH, while reading them back from the other end */
+#define TOTAL (4 * 1024 * 1024)
+#define CHUNK 4096
+#define HIGH 65536
+#define LOW 16384
+
+static size_t produced, consumed, most_buffered;
+static int drains;
+
+static int producer(ev_source attribute((unused)) *ev,
+                    ev_writer *w,
+                    void attribute((unused)) *u) {
+  static char chunk[CHUNK];
+  size_t buffered, allocated;
+
+  ++drains;
+  for(;;) {
+    ev_writer_usage(w, &buffered, &allocated);
+    if(buffered > most_buffered)
+      most_buffered = buffered;
+    if(produced >= TOTAL)
+      return ev_writer_close(w);
+    if(buffered >= HIGH)
+      return ev_writer_drained(w, LOW, producer, 0);
+    sink_write(ev_writer_sink(w), chunk, CHUNK);
+    produced += CHUNK;
+  }
+}
+
+static int consumer(ev_source attribute((unused)) *ev,
+                    ev_reader *reader,
+                    void attribute((unused)) *ptr,
+                    size_t bytes,
+                    int eof,
+                    void attribute((unused)) *u) {
+  consumed += bytes;
+  ev_reader_consume(reader, bytes);
+  return eof;
+}
+
+static int writer_done(ev_source attribute((unused)) *ev,
+                       int errno_value,
+                       void attribute((unused)) *u) {
+  check_integer(errno_value, 0);
+  return 0;
+}
+
+static int reader_failed(ev_source attribute((unused)) *ev,
+                         int errno_value,
+                         void attribute((unused)) *u) {
+  check_integer(errno_value, 0);
+  return 1;
+}
+
+static void test_drained(void) {
+  ev_source *ev;
+  ev_writer *w;
+  int sv[2];
+
+  ev = ev_new();
+  insist(socketpair(PF_UNIX, SOCK_STREAM, 0, sv) == 0);
+  nonblock(sv[0]);
+  nonblock(sv[1]);
+  w = ev_writer_new(ev, sv[0], writer_done, 0, "test writer");
+  insist(w != 0);
+  insist(ev_reader_new(ev, sv[1], consumer, reader_failed, 0,
+                       "test reader") != 0);
+  /* The buffer is empty, so the first call comes straight away */
+  check_integer(ev_writer_drained(w, LOW, producer, 0), 0);
+  check_integer(ev_run(ev), 1);
+  check_integer(consumed, TOTAL);
+  insist(drains > 1);
+  insist(most_buffered < HIGH + CHUNK);
+}
+
 static void test_event(void) {
   struct timeval w;
   ev_source *ev;
@@ -64,6 +140,7 @@ static void test_event(void) {
   check_integer(run1, 1);
   check_integer(run2, 0);
   check_integer(run3, 1);
+  test_drained();
 }
 
 TEST(event);
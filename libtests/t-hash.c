@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2005, 2007, 2008, 2010 Richard Kettlewell
+ * Copyright (C) 2005, 2007, 2008, 2010, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -31,6 +31,41 @@ static int test_hash_callback(const char attribute((unused)) *key,
     return 0;
 }
 
+/* Keys with the same hash code must still be told apart.  hash.c's hash
+ * function is 33*a+b for a two-character key, so adding 1 to the first
+ * character and taking 33 from the second gives the same code.  The keys
+ * below are two groups of three that collide in this way. */
+static void test_hash_collisions(void) {
+  static const char *const keys[] = { "Uz", "VY", "W8", "wz", "xY", "y8" };
+  const size_t nkeys = sizeof keys / sizeof *keys;
+  hash *h = hash_new(sizeof (size_t));
+  size_t i, j, *ip;
+
+  /* Each colliding key is new, and finds its own value */
+  for(i = 0; i < nkeys; ++i) {
+    insist(hash_find(h, keys[i]) == 0);
+    insist(hash_add(h, keys[i], &i, HASH_INSERT) == 0);
+    insist(hash_add(h, keys[i], &i, HASH_INSERT) != 0);
+  }
+  check_integer(hash_count(h), nkeys);
+  for(i = 0; i < nkeys; ++i)
+    insist((ip = hash_find(h, keys[i])) != 0 && *ip == i);
+  /* Replacing one leaves the others alone */
+  j = 100;
+  insist(hash_add(h, "xY", &j, HASH_REPLACE) == 0);
+  insist(hash_add(h, "zz", &j, HASH_REPLACE) != 0);
+  insist((ip = hash_find(h, "wz")) != 0 && *ip == 3);
+  insist((ip = hash_find(h, "xY")) != 0 && *ip == 100);
+  /* Removing one leaves the others in place, whichever order they are in */
+  for(i = nkeys; i-- > 0;) {
+    insist(hash_remove(h, keys[i]) == 0);
+    insist(hash_remove(h, keys[i]) != 0);
+    for(j = 0; j < i; ++j)
+      insist(hash_find(h, keys[j]) != 0);
+  }
+  check_integer(hash_count(h), 0);
+}
+
 static void test_hash(void) {
   hash *h;
   int i, *ip;
@@ -63,6 +98,7 @@ static void test_hash(void) {
   for(i = 0; i < 10000; ++i)
     insist(hash_remove(h, do_printf("%d", i)) == 0);
   check_integer(hash_count(h), 0);
+  test_hash_collisions();
 }
 
 TEST(hash);
@@ -0,0 +1,94 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "test.h"
+#include "hreader.h"
+
+#include <fcntl.h>
+
+#define PATH "t-hreader.data"
+#define SIZE 100000
+
+static void test_mode(const char *data, size_t bufsize, unsigned flags) {
+  struct hreader h[1];
+  char buffer[SIZE];
+  size_t total = 0;
+  int n;
+
+  hreader_defaults(bufsize, flags);
+  insist(hreader_init(PATH, h) == 0);
+  check_integer(hreader_size(h), SIZE);
+  check_integer(h->bufsize, bufsize ? bufsize : HREADER_DEFAULT_BUFSIZE);
+  insist((h->fd >= 0) == !!(flags & HREADER_KEEP_OPEN));
+  /* Sequential reads of an awkward size */
+  while((n = hreader_read(h, buffer + total, 999)) > 0)
+    total += n;
+  check_integer(n, 0);
+  check_integer(total, SIZE);
+  insist(!memcmp(buffer, data, SIZE));
+  insist(hreader_eof(h));
+  /* Reads before the current buffer */
+  check_integer(hreader_pread(h, buffer, 10, 12345), 10);
+  insist(!memcmp(buffer, data + 12345, 10));
+  /* A read straddling the end */
+  check_integer(hreader_pread(h, buffer, 100, SIZE - 50), 50);
+  insist(!memcmp(buffer, data + SIZE - 50, 50));
+  check_integer(hreader_seek(h, -7, SEEK_END), SIZE - 7);
+  check_integer(hreader_read(h, buffer, 100), 7);
+  hreader_close(h);
+  insist(h->fd == -1);
+}
+
+static void test_hreader(void) {
+  static char data[SIZE];
+  struct hreader h[1];
+  char buffer[16];
+  size_t n;
+  int fd;
+
+  for(n = 0; n < SIZE; ++n)
+    data[n] = n * 7 + n / 256;
+  insist((fd = open(PATH, O_WRONLY|O_CREAT|O_TRUNC, 0666)) >= 0);
+  insist(write(fd, data, SIZE) == SIZE);
+  close(fd);
+  test_mode(data, 0, 0);
+  test_mode(data, 0, HREADER_PREFETCH);
+  test_mode(data, 4096, HREADER_KEEP_OPEN);
+  test_mode(data, 1000, HREADER_KEEP_OPEN|HREADER_PREFETCH);
+  test_mode(data, 1 << 20, HREADER_KEEP_OPEN|HREADER_PREFETCH);
+  /* A kept-open file can still be read after it's been removed */
+  hreader_defaults(16, HREADER_KEEP_OPEN);
+  insist(hreader_init(PATH, h) == 0);
+  unlink(PATH);
+  check_integer(hreader_pread(h, buffer, 16, 5000), 16);
+  insist(!memcmp(buffer, data + 5000, 16));
+  hreader_close(h);
+  /* ...but a hands-off one can't */
+  hreader_defaults(0, HREADER_PREFETCH);
+  insist(hreader_init(PATH, h) == -1);
+}
+
+TEST(hreader);
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
@@ -19,7 +19,7 @@
 #include "macros.h"
 
 static void test_macros(void) {
-  const struct mx_node *m;
+  const struct mx_node *m, *cm;
 #define L1 "this is just some\n"
 #define L2 "plain text\n"
   static const char plain[] = L1 L2;
@@ -199,6 +199,25 @@ static void test_macros(void) {
               "yes\n", 0);
   check_macro("include2", "@include{t-macros-2}",
               "wibble\n", 0);
+
+  /* Parsed template files are cached, but changes must be noticed */
+  {
+    char *tmpl, *inc;
+    FILE *fp;
+
+    byte_xasprintf(&tmpl, "t-macros-%lu.tmpl", (unsigned long)getpid());
+    if(!(fp = fopen(tmpl, "w")) || fputs("@if{true}{one}\n", fp) < 0
+       || fclose(fp) < 0)
+      disorder_fatal(errno, "error writing %s", tmpl);
+    byte_xasprintf(&inc, "@include{%s}", tmpl);
+    check_macro("cache1", inc, "one\n", 0);
+    check_macro("cache2", inc, "one\n", 0);
+    if(!(fp = fopen(tmpl, "w")) || fputs("@if{false}{one}{three}\n", fp) < 0
+       || fclose(fp) < 0)
+      disorder_fatal(errno, "error writing %s", tmpl);
+    check_macro("cache3", inc, "three\n", 0);
+    unlink(tmpl);
+  }
   fprintf(stderr, ">>> expect error message about t-macros-nonesuch:\n");
   check_macro("include3", "<@include{t-macros-nonesuch}>",
               "<[[cannot find 't-macros-nonesuch']]>", 0);
@@ -241,6 +260,25 @@ static void test_macros(void) {
               "@n{x}{x}{z}",
               "z", 0);
 
+  /* Compiled templates are reused, so redefinitions must be noticed, and
+   * templates can mention macros before they are defined */
+  cm = mx_parse("macro6", 1, "@p{x}@@@p{y}", NULL);
+  check_macro("macro7", "@define{p}{a}{<@a>}", "", 0);
+  check_integer(mx_expandstr(cm, &s, 0, "macro6"), 0);
+  check_string(s, "<x>@<y>");
+  check_macro("macro8", "@define{p}{a}{[@a]}", "", 0);
+  check_integer(mx_expandstr(cm, &s, 0, "macro6"), 0);
+  check_string(s, "[x]@[y]");
+
+  /* Rewriting must leave the original alone */
+  m = mx_parse("rewrite1", 1, "@a/@q{@a}/@q{c}", NULL);
+  check_integer(mx_expandstr(mx_rewritel(m, "a", "1", (char *)0), &s, 0,
+                             "rewrite1"), 0);
+  check_string(s, "1/1/c");
+  check_integer(mx_expandstr(mx_rewritel(m, "a", "2", (char *)0), &s, 0,
+                             "rewrite1"), 0);
+  check_string(s, "2/2/c");
+  check_string(mx_dump(m), "@a/@q{@a}/@q{c}");
 }
 
 TEST(macros);
@@ -0,0 +1,95 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "test.h"
+
+static int all_zero(const char *p, size_t n) {
+  while(n--)
+    if(*p++)
+      return 0;
+  return 1;
+}
+
+static void test_mem(void) {
+  struct mem_arena *a, *b;
+  struct mem_stats ms;
+  char *first, *p, *q, *r, *big;
+  size_t n;
+
+  a = mem_arena_new();
+  /* Fill most of the first chunk so that a reset leaves it all 0-filled */
+  first = mem_arena_alloc(a, 60000);
+  insist(all_zero(first, 60000));
+  memset(first, 'x', 60000);
+  mem_arena_reset(a);
+  p = mem_arena_alloc(a, 100);
+  insist(p == first);
+  insist(all_zero(p, 100));
+  check_string(mem_arena_strndup(a, "arena", 3), "are");
+  /* Allocations are aligned and distinct */
+  p = mem_arena_alloc(a, 3);
+  q = mem_arena_alloc(a, sizeof (double));
+  insist((uintptr_t)q % sizeof (double) == 0);
+  insist(q > p);
+  insist(mem_arena_alloc(a, 0) != mem_arena_alloc(a, 0));
+  /* The most recent allocation is resized in place */
+  p = mem_arena_strndup(a, "growing", 7);
+  insist(mem_arena_realloc(a, p, 8, 1000) == p);
+  insist(mem_arena_realloc(a, p, 1000, 8) == p);
+  /* Anything else moves, and only its own contents are copied */
+  q = mem_arena_alloc(a, 64);
+  memset(q, 0xA5, 64);
+  r = mem_arena_realloc(a, p, 8, 2000);
+  insist(r != p);
+  check_string(r, "growing");
+  insist(all_zero(r + 8, 2000 - 8));
+  insist(mem_arena_realloc(a, NULL, 0, 10) != NULL);
+  /* Bigger than a chunk */
+  big = mem_arena_alloc(a, 1024 * 1024);
+  insist(all_zero(big, 1024 * 1024));
+  mem_get_stats(&ms);
+  insist(ms.arena_size >= 1024 * 1024);
+  /* Arenas are independent */
+  b = mem_arena_new();
+  p = mem_arena_alloc(b, 10);
+  q = mem_arena_alloc(a, 10);
+  insist(p != q);
+  mem_arena_free(b);
+  /* After a reset, the space is reused and fresh allocations are still
+   * 0-filled */
+  mem_arena_reset(a);
+  mem_get_stats(&ms);
+  n = ms.arena_size;
+  insist(n < 1024 * 1024);
+  p = mem_arena_alloc(a, 100);
+  insist(p == first);
+  insist(all_zero(p, 100));
+  mem_arena_free(a);
+  mem_get_stats(&ms);
+  check_integer(ms.arena_size, 0);
+}
+
+TEST(mem);
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
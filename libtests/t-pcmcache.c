@@ -0,0 +1,155 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "test.h"
+#include "pcm-cache.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <sys/time.h>
+
+#define CACHEDIR "t-pcmcache.dir"
+#define TRACK "t-pcmcache.track"
+
+static const char *const argv1[] = { "disorder-decode" };
+static const char *const argv2[] = { "disorder-decode", "--keep-open" };
+
+/* Write a file of the given size */
+static void make_file(const char *path, size_t size, time_t mtime) {
+  static char data[4096];
+  struct timeval tv[2];
+  int fd;
+
+  insist((fd = open(path, O_WRONLY|O_CREAT|O_TRUNC, 0666)) >= 0);
+  insist(size <= sizeof data);
+  insist(write(fd, data, size) == (ssize_t)size);
+  close(fd);
+  tv[0].tv_sec = tv[1].tv_sec = mtime;
+  tv[0].tv_usec = tv[1].tv_usec = 0;
+  insist(utimes(path, tv) == 0);
+}
+
+/* Add an entry with the given contents via pcm_cache_tee() */
+static int add(const char *key, const char *contents, off_t limit) {
+  struct pcm_cache_writer *w;
+  int in[2], out[2];
+  char buffer[64];
+
+  insist(pipe(in) == 0);
+  insist(pipe(out) == 0);
+  insist(write(in[1], contents, strlen(contents))
+         == (ssize_t)strlen(contents));
+  close(in[1]);
+  insist((w = pcm_cache_create(CACHEDIR, key, limit)) != NULL);
+  check_integer(pcm_cache_tee(in[0], out[1], w), 0);
+  close(in[0]);
+  close(out[1]);
+  /* The copy is passed on whether or not it's cached */
+  memset(buffer, 0, sizeof buffer);
+  check_integer(read(out[0], buffer, sizeof buffer), strlen(contents));
+  check_string(buffer, contents);
+  close(out[0]);
+  return pcm_cache_commit(w);
+}
+
+/* Read an entry back, or return NULL */
+static char *lookup(const char *key) {
+  char buffer[64];
+  ssize_t n;
+  int fd;
+
+  if((fd = pcm_cache_open(CACHEDIR, key)) < 0)
+    return NULL;
+  insist((n = read(fd, buffer, sizeof buffer - 1)) >= 0);
+  buffer[n] = 0;
+  close(fd);
+  return xstrdup(buffer);
+}
+
+/* Backdate an entry's last use */
+static void age(const char *key, time_t when) {
+  struct timeval tv[2];
+  char *path;
+
+  byte_xasprintf(&path, CACHEDIR "/%s", key);
+  tv[0].tv_sec = tv[1].tv_sec = when;
+  tv[0].tv_usec = tv[1].tv_usec = 0;
+  insist(utimes(path, tv) == 0);
+}
+
+static void test_pcmcache(void) {
+  char *k1, *k2;
+  struct stat sb;
+
+  insist(system("rm -rf " CACHEDIR) == 0);
+  /* Keys depend on the file's attributes and the decoder */
+  insist(pcm_cache_key(TRACK ".missing", 1, argv1) == NULL);
+  make_file(TRACK, 100, 1000000);
+  k1 = pcm_cache_key(TRACK, 1, argv1);
+  check_integer(strlen(k1), 40);
+  check_string(pcm_cache_key(TRACK, 1, argv1), k1);
+  insist(strcmp(pcm_cache_key(TRACK, 2, argv2), k1));
+  make_file(TRACK, 100, 1000001);
+  insist(strcmp(k2 = pcm_cache_key(TRACK, 1, argv1), k1));
+  make_file(TRACK, 101, 1000001);
+  insist(strcmp(pcm_cache_key(TRACK, 1, argv1), k2));
+  /* Misses and hits */
+  insist(lookup("a") == NULL);
+  check_integer(add("a", "alpha", 100), 0);
+  check_string(lookup("a"), "alpha");
+  /* Oversized entries are passed on but not kept */
+  check_integer(add("b", "bravo", 4), -1);
+  insist(lookup("b") == NULL);
+  check_integer(add("b", "bravo", 5), 0);
+  check_integer(add("c", "charlie", 100), 0);
+  /* Eviction removes the least recently used */
+  age("a", 2000000);
+  age("b", 1000000);
+  age("c", 3000000);
+  pcm_cache_evict(CACHEDIR, 100);
+  check_string(lookup("b"), "bravo");
+  pcm_cache_evict(CACHEDIR, 12);        /* a+b+c = 17 */
+  insist(lookup("a") == NULL);
+  check_string(lookup("b"), "bravo");
+  check_string(lookup("c"), "charlie");
+  /* Reading an entry counts as using it */
+  age("c", 1000000);
+  check_string(lookup("c"), "charlie");
+  pcm_cache_evict(CACHEDIR, 7);
+  insist(lookup("b") == NULL);
+  check_string(lookup("c"), "charlie");
+  /* Stale partial entries are cleaned up, recent ones left alone */
+  make_file(CACHEDIR "/tmp.x.1", 10, 1000000);
+  make_file(CACHEDIR "/tmp.y.1", 10, time(NULL));
+  pcm_cache_evict(CACHEDIR, 100);
+  insist(stat(CACHEDIR "/tmp.x.1", &sb) < 0);
+  insist(stat(CACHEDIR "/tmp.y.1", &sb) == 0);
+  insist(system("rm -rf " CACHEDIR) == 0);
+  unlink(TRACK);
+}
+
+TEST(pcmcache);
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
@@ -0,0 +1,288 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "test.h"
+
+/* The playlist storage code is built into this test directly, with the few
+ * database functions it uses replaced by an in-memory table below.  That lets
+ * it be checked against a flat list of tracks without setting up a real
+ * database. */
+#include "trackdb-playlists.c"
+
+/* In-memory stand-in for the playlists database ---------------------------- */
+
+/** @brief Records, mapping keys to URL-encoded data */
+static hash *records;
+
+/** @brief Number of records read, written and deleted */
+static int reads, writes, deletes;
+
+DB *trackdb_playlistsdb;
+
+int trackdb_getdata(DB attribute((unused)) *db,
+                    const char *track,
+                    struct kvp **kp,
+                    DB_TXN attribute((unused)) *tid) {
+  char **data;
+
+  ++reads;
+  *kp = 0;
+  if(!(data = hash_find(records, track)))
+    return DB_NOTFOUND;
+  *kp = kvp_urldecode(*data, strlen(*data));
+  return 0;
+}
+
+int trackdb_putdata(DB attribute((unused)) *db,
+                    const char *track,
+                    const struct kvp *k,
+                    DB_TXN attribute((unused)) *tid,
+                    u_int32_t attribute((unused)) flags) {
+  char *data = kvp_urlencode(k, 0);
+
+  ++writes;
+  hash_add(records, track, &data, HASH_INSERT_OR_REPLACE);
+  return 0;
+}
+
+int trackdb_delkey(DB attribute((unused)) *db,
+                   const char *track,
+                   DB_TXN attribute((unused)) *tid) {
+  ++deletes;
+  return hash_remove(records, track) ? DB_NOTFOUND : 0;
+}
+
+DB_TXN *trackdb_begin_transaction(void) {
+  return 0;
+}
+
+void trackdb_abort_transaction(DB_TXN attribute((unused)) *tid) {
+}
+
+void trackdb_commit_transaction(DB_TXN attribute((unused)) *tid) {
+}
+
+void trackdb_abort_to_retry(DB_TXN attribute((unused)) *tid) {
+}
+
+/* Listing playlists needs a cursor; it isn't tested here */
+DBC *trackdb_opencursor(DB attribute((unused)) *db,
+                        DB_TXN attribute((unused)) *tid) {
+  abort();
+}
+
+int trackdb_closecursor(DBC attribute((unused)) *c) {
+  abort();
+}
+
+/* Tests -------------------------------------------------------------------- */
+
+#define NAME "fred.mix"
+#define WHO "fred"
+
+/** @brief What the playlist should contain */
+static struct vector model;
+
+/** @brief Next track number to hand out */
+static int nexttrack;
+
+static char *new_track(void) {
+  char *track;
+
+  byte_xasprintf(&track, "track%d", nexttrack++);
+  return track;
+}
+
+/* Check the stored playlist's tracks against the model */
+static void check_tracks(void) {
+  char **tracks;
+  int ntracks, n;
+
+  check_integer(trackdb_playlist_get(NAME, WHO, &tracks, &ntracks, 0), 0);
+  check_integer(ntracks, model.nvec);
+  for(n = 0; n < ntracks && n < model.nvec; ++n)
+    if(strcmp(tracks[n], model.vec[n])) {
+      fprintf(stderr, "track %d is %s, expected %s\n",
+              n, tracks[n], model.vec[n]);
+      count_error();
+      break;
+    }
+}
+
+/* Check the stored playlist against the model, and check that its chunks are
+ * well formed */
+static void check_playlist(void) {
+  struct playlist pl;
+  int total = 0, n;
+
+  check_tracks();
+  check_integer(playlist_read(NAME, &pl, 0), 0);
+  check_integer(pl.ntracks, model.nvec);
+  for(n = 0; n < pl.chunks.nvec; ++n) {
+    const struct playlist_chunk *c = &pl.chunks.vec[n];
+
+    insist(c->ntracks > 0 && c->ntracks <= PLAYLIST_CHUNK);
+    insist(hash_find(records, playlist_chunk_key(NAME, c->id)) != 0);
+    total += c->ntracks;
+  }
+  check_integer(total, model.nvec);
+  /* No chunk records left behind */
+  check_integer(hash_count(records), 1 + pl.chunks.nvec);
+}
+
+/* Pick a position from 0 to limit inclusive.  Half the time it is at or next
+ * to a chunk boundary, where splits and merges happen. */
+static int pick_position(int limit) {
+  struct playlist pl;
+  int position = 0, n;
+
+  if(rand() % 2) {
+    playlist_read(NAME, &pl, 0);
+    if(pl.chunks.nvec) {
+      n = rand() % pl.chunks.nvec;
+      for(int i = 0; i < n; ++i)
+        position += pl.chunks.vec[i].ntracks;
+      position += rand() % 3 - 1;
+      if(position < 0)
+        position = 0;
+      if(position > limit)
+        position = limit;
+      return position;
+    }
+  }
+  return rand() % (limit + 1);
+}
+
+/* Pick a number of tracks from 0 to limit inclusive, sometimes more than
+ * fits in a chunk */
+static int pick_count(int limit) {
+  const int most = rand() % 8 ? 8 : 2 * PLAYLIST_CHUNK + 1;
+
+  return rand() % ((limit < most ? limit : most) + 1);
+}
+
+static void random_edit(void) {
+  const int ntracks = model.nvec;
+  int position, count, to, e;
+  char **tracks;
+
+  switch(rand() % (ntracks > 1000 ? 2 : 3)) {
+  case 0:                               /* remove */
+    position = pick_position(ntracks);
+    count = pick_count(ntracks - position);
+    check_integer(trackdb_playlist_remove(NAME, WHO, position, count), 0);
+    memmove(model.vec + position, model.vec + position + count,
+            (ntracks - position - count) * sizeof (char *));
+    model.nvec -= count;
+    break;
+  case 1:                               /* move */
+    position = pick_position(ntracks);
+    count = pick_count(ntracks - position);
+    to = pick_position(ntracks - count);
+    check_integer(trackdb_playlist_move(NAME, WHO, position, count, to), 0);
+    tracks = xcalloc(count, sizeof *tracks);
+    memcpy(tracks, model.vec + position, count * sizeof *tracks);
+    memmove(model.vec + position, model.vec + position + count,
+            (ntracks - position - count) * sizeof (char *));
+    memmove(model.vec + to + count, model.vec + to,
+            (ntracks - count - to) * sizeof (char *));
+    memcpy(model.vec + to, tracks, count * sizeof *tracks);
+    break;
+  case 2:                               /* insert */
+    position = pick_position(ntracks);
+    count = pick_count(2 * PLAYLIST_CHUNK + 1);
+    tracks = xcalloc(count, sizeof *tracks);
+    for(int n = 0; n < count; ++n)
+      tracks[n] = new_track();
+    check_integer(trackdb_playlist_insert(NAME, WHO, position, tracks, count),
+                  0);
+    for(int n = 0; n < count; ++n)
+      vector_append(&model, NULL);
+    memmove(model.vec + position + count, model.vec + position,
+            (ntracks - position) * sizeof (char *));
+    memcpy(model.vec + position, tracks, count * sizeof *tracks);
+    break;
+  }
+  /* Out of range edits change nothing */
+  if(rand() % 16 == 0) {
+    position = rand() % (model.nvec + 1);
+    e = trackdb_playlist_remove(NAME, WHO, position,
+                                model.nvec - position + 1);
+    check_integer(e, ERANGE);
+  }
+}
+
+static void test_playlists(void) {
+  struct kvp *k = 0;
+  char b[16], **tracks;
+
+  records = hash_new(sizeof (char *));
+  config = xmalloc(sizeof *config);
+  config->playlist_max = 10000;
+  srand(1);
+  vector_init(&model);
+
+  /* Start from an old-format record, with the tracks in the header */
+  kvp_set(&k, "sharing", "private");
+  kvp_set(&k, "count", "700");
+  for(int n = 0; n < 700; ++n) {
+    snprintf(b, sizeof b, "%d", n);
+    vector_append(&model, new_track());
+    kvp_set(&k, b, model.vec[n]);
+  }
+  trackdb_putdata(trackdb_playlistsdb, NAME, k, 0, 0);
+  check_tracks();
+
+  for(int n = 0; n < 5000; ++n) {
+    random_edit();
+    check_playlist();
+  }
+
+  /* Emptying the playlist leaves just the header */
+  check_integer(trackdb_playlist_remove(NAME, WHO, 0, model.nvec), 0);
+  model.nvec = 0;
+  check_playlist();
+  check_integer(hash_count(records), 1);
+
+  /* An append to a long playlist only touches the last chunk and the
+   * header */
+  tracks = xcalloc(7000, sizeof *tracks);
+  for(int n = 0; n < 7000; ++n) {
+    tracks[n] = new_track();
+    vector_append(&model, tracks[n]);
+  }
+  check_integer(trackdb_playlist_set(NAME, WHO, tracks, 7000, 0), 0);
+  reads = writes = deletes = 0;
+  tracks[0] = new_track();
+  vector_append(&model, tracks[0]);
+  check_integer(trackdb_playlist_insert(NAME, WHO, 7000, tracks, 1), 0);
+  check_integer(reads, 2);
+  check_integer(writes, 2);
+  check_integer(deletes, 0);
+  check_playlist();
+}
+
+TEST(playlists);
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
@@ -0,0 +1,86 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "test.h"
+#include "queue.h"
+
+static struct queue_entry *new_entry(const char *id, const char *track) {
+  struct queue_entry *q = xmalloc(sizeof *q);
+
+  q->id = id;
+  q->track = track;
+  return q;
+}
+
+static void test_queue(void) {
+  struct queue_entry head[1] = { { 0 } }, other[1] = { { 0 } };
+  struct queue_entry *a, *b, *c;
+
+  head->next = head->prev = head;
+  other->next = other->prev = other;
+  /* Entries present before indexing are picked up */
+  queue_insert_entry(head, a = new_entry("a", "/x"));
+  queue_index_list(head);
+  queue_index_list(other);
+  insist(queue_index_find(head, "a") == a);
+  check_integer(queue_index_track(head, "/x"), 1);
+  check_integer(queue_index_length(head), 1);
+  /* Insertion */
+  queue_insert_entry(a, b = new_entry("b", "/y"));
+  queue_insert_entry(head->prev, c = new_entry("c", "/x"));
+  insist(queue_index_find(head, "b") == b);
+  insist(queue_index_find(head, "c") == c);
+  insist(queue_index_find(head, "d") == NULL);
+  check_integer(queue_index_track(head, "/x"), 2);
+  check_integer(queue_index_track(head, "/y"), 1);
+  check_integer(queue_index_track(head, "/z"), 0);
+  check_integer(queue_index_length(head), 3);
+  /* Moving within a list */
+  queue_delete_entry(a);
+  queue_insert_entry(c, a);
+  insist(queue_index_find(head, "a") == a);
+  check_integer(queue_index_track(head, "/x"), 2);
+  check_integer(queue_index_length(head), 3);
+  /* Moving between lists */
+  queue_delete_entry(c);
+  check_integer(queue_index_track(head, "/x"), 1);
+  insist(queue_index_find(head, "c") == NULL);
+  queue_insert_entry(other, c);
+  insist(queue_index_find(other, "c") == c);
+  check_integer(queue_index_track(other, "/x"), 1);
+  check_integer(queue_index_length(other), 1);
+  /* Removing the last entry for a track */
+  queue_delete_entry(a);
+  check_integer(queue_index_track(head, "/x"), 0);
+  check_integer(queue_index_length(head), 1);
+  /* Unindexed lists are left alone */
+  head->index = NULL;
+  head->next = head->prev = head;
+  queue_insert_entry(head, a);
+  insist(a->index == NULL);
+}
+
+TEST(queue);
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
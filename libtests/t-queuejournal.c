@@ -0,0 +1,221 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "test.h"
+#include "queue-journal.h"
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#define QPATH "t-queuejournal.queue"
+#define JPATH QPATH ".journal"
+
+static const char *const submitters[] = { "fred", "jim", "sheila", NULL };
+
+static unsigned nextid;
+
+static struct queue_entry *new_entry(void) {
+  struct queue_entry *q = xmalloc(sizeof *q);
+  char *s;
+
+  byte_xasprintf(&s, "id%u", nextid++);
+  q->id = s;
+  byte_xasprintf(&s, "/music/track %u.ogg", nextid);
+  q->track = s;
+  q->submitter = submitters[nextid % 4];
+  q->when = 1000 + nextid;
+  q->origin = origin_picked;
+  q->state = playing_unplayed;
+  return q;
+}
+
+static struct queue_entry *nth(struct queue_entry *head, int n) {
+  struct queue_entry *q = head->next;
+
+  while(n-- > 0)
+    q = q->next;
+  return q;
+}
+
+static int length(const struct queue_entry *head) {
+  const struct queue_entry *q;
+  int n = 0;
+
+  for(q = head->next; q != head; q = q->next)
+    ++n;
+  return n;
+}
+
+/* Concatenate marshalled entries so lists can be compared.  The expected
+ * field isn't journalled so is left out. */
+static char *flatten(const struct queue_entry *head) {
+  const struct queue_entry *q;
+  struct queue_entry e;
+  struct dynstr d[1];
+
+  dynstr_init(d);
+  for(q = head->next; q != head; q = q->next) {
+    e = *q;
+    e.expected = 0;
+    dynstr_append_string(d, queue_marshall(&e));
+    dynstr_append(d, '\n');
+  }
+  dynstr_terminate(d);
+  return d->vec;
+}
+
+/* Read back what's on disk and check it matches head */
+static void check_replay(const struct queue_entry *head) {
+  struct queue_entry copy[1] = { { 0 } };
+
+  queue_journal_read(queue_journal_new(QPATH), copy);
+  check_string(flatten(copy), flatten(head));
+}
+
+/* Make a random change to the list */
+static void mutate(struct queue_entry *head) {
+  struct queue_entry *q;
+  int n = length(head);
+
+  switch(rand() % 6) {
+  case 0:
+  case 1:                               /* add */
+    queue_insert_entry(n ? nth(head, rand() % (n + 1))->prev : head,
+                       new_entry());
+    break;
+  case 2:                               /* remove */
+    if(n)
+      queue_delete_entry(nth(head, rand() % n));
+    break;
+  case 3:                               /* move */
+    if(n > 1) {
+      q = nth(head, rand() % n);
+      queue_delete_entry(q);
+      queue_insert_entry(nth(head, rand() % n)->prev, q);
+    }
+    break;
+  case 4:                               /* modify in place */
+    if(n) {
+      q = nth(head, rand() % n);
+      q->state = q->state == playing_unplayed ? playing_started
+                                              : playing_unplayed;
+      q->submitter = submitters[rand() % 4];
+    }
+    break;
+  case 5:                               /* transient field only */
+    if(n)
+      nth(head, rand() % n)->expected = rand();
+    break;
+  }
+}
+
+static void test_queuejournal(void) {
+  struct queue_entry head[1], other[1] = { { 0 } };
+  struct queue_journal *j;
+  struct stat sb;
+  int n, fd;
+
+  unlink(QPATH);
+  unlink(JPATH);
+  memset(head, 0, sizeof *head);
+  head->next = head->prev = head;
+  /* No files at all */
+  j = queue_journal_new(QPATH);
+  queue_journal_read(j, head);
+  check_integer(length(head), 0);
+  /* First write produces a snapshot and an empty journal */
+  queue_insert_entry(head, new_entry());
+  queue_journal_write(j, head);
+  check_replay(head);
+  insist(stat(JPATH, &sb) == 0);
+  check_integer(sb.st_size, 5);         /* "#1 1\n" */
+  /* Writing without changing anything appends nothing */
+  head->next->expected = 99;
+  queue_journal_write(j, head);
+  insist(stat(JPATH, &sb) == 0);
+  check_integer(sb.st_size, 5);
+  /* Random changes, checking each one replays correctly */
+  srand(1);
+  for(n = 0; n < 2000; ++n) {
+    mutate(head);
+    if(rand() % 3)
+      mutate(head);
+    queue_journal_write(j, head);
+    queue_journal_sync(j);
+    check_replay(head);
+  }
+  /* Moving one entry of many writes one record */
+  while(length(head) < 100)
+    queue_insert_entry(head->prev, new_entry());
+  queue_journal_compact(j, head);
+  other->next = nth(head, 50);
+  queue_delete_entry(other->next);
+  queue_insert_entry(nth(head, 10), other->next);
+  queue_journal_write(j, head);
+  insist(stat(JPATH, &sb) == 0);
+  check_integer(sb.st_size - 5 - 1,
+                (long)(strlen("+ ") + strlen(nth(head, 10)->id)
+                       + strlen(queue_marshall(nth(head, 11)))));
+  check_replay(head);
+  /* A partial record at the end is ignored */
+  insist((fd = open(JPATH, O_WRONLY|O_APPEND)) >= 0);
+  insist(write(fd, "- id", 4) == 4);
+  close(fd);
+  check_replay(head);
+  /* A reader picks up from there and the next write starts afresh */
+  j = queue_journal_new(QPATH);
+  queue_journal_read(j, other);
+  check_string(flatten(other), flatten(head));
+  queue_delete_entry(other->next);
+  queue_journal_write(j, other);
+  check_replay(other);
+  /* A zero-filled tail stops replay there, and the next write starts
+   * afresh */
+  queue_journal_write(j, other);
+  insist((fd = open(JPATH, O_WRONLY|O_APPEND)) >= 0);
+  insist(write(fd, "\0\0\0\n- ", 6) == 6);
+  insist(write(fd, other->next->id, strlen(other->next->id))
+         == (ssize_t)strlen(other->next->id));
+  insist(write(fd, "\n", 1) == 1);
+  close(fd);
+  check_replay(other);
+  /* So does a record naming an unknown ID */
+  queue_journal_compact(j, other);
+  insist((fd = open(JPATH, O_WRONLY|O_APPEND)) >= 0);
+  insist(write(fd, "+ nosuchid id x\n", 16) == 16);
+  close(fd);
+  check_replay(other);
+  /* A journal from an older generation is ignored */
+  insist((fd = open(JPATH, O_WRONLY|O_TRUNC)) >= 0);
+  insist(write(fd, "#1 1\n- id0\n", 11) == 11);
+  close(fd);
+  check_replay(other);
+  unlink(QPATH);
+  unlink(JPATH);
+}
+
+TEST(queuejournal);
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
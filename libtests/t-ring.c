@@ -0,0 +1,104 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "test.h"
+#include "ring.h"
+
+#include <pthread.h>
+
+/** @struct iring
+ * @brief A ring with @c unsigned elements */
+RING_TYPE(iring, unsigned);
+
+/** @brief Number of elements passed between threads */
+#define NPASSED 1000000
+
+static void *producer(void *arg) {
+  struct iring *r = arg;
+  unsigned n;
+
+  for(n = 0; n < NPASSED; ++n)
+    while(iring_put(r, n))
+      sched_yield();
+  return NULL;
+}
+
+/** @brief Tests for @ref ring.h */
+static void test_ring(void) {
+  struct iring r[1];
+  unsigned n, e;
+  pthread_t t;
+  int ok;
+
+  iring_init(r, 8);
+  check_integer(iring_count(r), 0);
+  insist(iring_get(r, &e) == -1);
+  /* Fill, overflow and drain */
+  for(n = 0; n < 8; ++n)
+    insist(iring_put(r, n) == 0);
+  insist(iring_put(r, 8) == -1);
+  check_integer(iring_count(r), 8);
+  for(n = 0; n < 8; ++n) {
+    insist(iring_get(r, &e) == 0);
+    check_integer(e, n);
+  }
+  insist(iring_get(r, &e) == -1);
+  /* Go round enough times that the positions wrap */
+  for(n = 0; n < 100; ++n) {
+    insist(iring_put(r, n) == 0);
+    insist(iring_put(r, n + 1000) == 0);
+    insist(iring_get(r, &e) == 0);
+    check_integer(e, n);
+    insist(iring_get(r, &e) == 0);
+    check_integer(e, n + 1000);
+  }
+  check_integer(iring_count(r), 0);
+  /* Peeking leaves the element in place until it is dropped */
+  insist(iring_peek(r) == NULL);
+  insist(iring_put(r, 7) == 0);
+  insist(iring_peek(r) != NULL);
+  check_integer(*iring_peek(r), 7);
+  *iring_peek(r) = 9;
+  check_integer(iring_count(r), 1);
+  iring_drop(r);
+  check_integer(iring_count(r), 0);
+  insist(iring_peek(r) == NULL);
+  /* One producer and one consumer */
+  iring_init(r, 64);
+  insist(pthread_create(&t, NULL, producer, r) == 0);
+  ok = 1;
+  for(n = 0; n < NPASSED; ++n) {
+    while(iring_get(r, &e))
+      sched_yield();
+    if(e != n)
+      ok = 0;
+  }
+  insist(pthread_join(t, NULL) == 0);
+  insist(ok);
+  check_integer(iring_count(r), 0);
+}
+
+TEST(ring);
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
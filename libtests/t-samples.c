@@ -0,0 +1,85 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "test.h"
+#include "samples.h"
+
+/** @brief Check one implementation against the obvious answers */
+static void check_isa(enum samples_isa isa) {
+  uint8_t src[600], dst[600], copy[600];
+  size_t offset, n, i;
+
+  if(samples_set_isa(isa) != isa)
+    return;                             /* not supported here */
+  for(i = 0; i < sizeof src; ++i)
+    src[i] = random();
+  /* Every length up to a bit over a few vectors, at every alignment */
+  for(offset = 0; offset < 32; ++offset) {
+    for(n = 0; n < 260; ++n) {
+      memset(dst, 0xAA, sizeof dst);
+      samples_swap16(dst + offset, src + offset, n);
+      for(i = 0; i < n; ++i) {
+        insist(dst[offset + 2 * i] == src[offset + 2 * i + 1]);
+        insist(dst[offset + 2 * i + 1] == src[offset + 2 * i]);
+      }
+      insist(dst[offset + 2 * n] == 0xAA);
+      if(offset)
+        insist(dst[offset - 1] == 0xAA);
+      /* In place */
+      memcpy(copy, src, sizeof src);
+      samples_swap16(copy + offset, copy + offset, n);
+      insist(!memcmp(copy + offset, dst + offset, 2 * n));
+      /* All-zero, and a single nonzero byte at each position */
+      memset(dst, 0, sizeof dst);
+      insist(samples_zero(dst + offset, n) == 1);
+      for(i = 0; i < n; ++i) {
+        dst[offset + i] = 1;
+        insist(samples_zero(dst + offset, n) == 0);
+        dst[offset + i] = 0;
+      }
+      dst[offset + n] = 1;
+      insist(samples_zero(dst + offset, n) == 1);
+    }
+  }
+}
+
+/** @brief Tests for @ref samples.c */
+static void test_samples(void) {
+  const enum samples_isa best = samples_get_isa();
+
+  check_string(samples_isa_name(SAMPLES_SCALAR), "scalar");
+#if __x86_64__
+  /* Every x86-64 CPU has SSE2, so if it can't be selected then the configure
+   * check for HAVE_X86_SIMD has gone wrong */
+  check_integer(best >= SAMPLES_SSE2, 1);
+#endif
+  check_isa(SAMPLES_SCALAR);
+  check_isa(SAMPLES_SSE2);
+  check_isa(SAMPLES_AVX2);
+  check_integer(samples_set_isa(SAMPLES_AVX2), best);
+}
+
+TEST(samples);
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
@@ -0,0 +1,90 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "test.h"
+#include "table.h"
+
+static const struct {
+  const char *name;
+  int value;
+} words[] = {
+  { "adopt", 0 },
+  { "allfiles", 1 },
+  { "dirs", 2 },
+  { "disable", 3 },
+  { "enable", 4 },
+  { "enabled", 5 },
+  { "files", 6 },
+  { "log", 7 },
+  { "new", 8 },
+  { "nop", 9 },
+  { "play", 10 },
+  { "playafter", 11 },
+  { "playing", 12 },
+  { "queue", 13 },
+};
+
+static const char *const missing[] = {
+  "", "a", "adop", "adopted", "enabl", "zzz", "Play", "log ",
+};
+
+static struct table_hash words_hash;
+
+struct entry {
+  char *name;
+};
+
+static void test_table(void) {
+  size_t n;
+  struct entry *big;
+  struct table_hash big_hash;
+
+  for(n = 0; n < sizeof words / sizeof *words; ++n) {
+    check_integer(TABLE_FIND(words, name, words[n].name), words[n].value);
+    check_integer(TABLE_HASH_FIND(words_hash, words, name, words[n].name),
+                  words[n].value);
+  }
+  for(n = 0; n < sizeof missing / sizeof *missing; ++n) {
+    check_integer(TABLE_FIND(words, name, missing[n]), -1);
+    check_integer(TABLE_HASH_FIND(words_hash, words, name, missing[n]), -1);
+  }
+  /* A big table, to exercise growing the slots */
+  big = xcalloc(2000, sizeof *big);
+  for(n = 0; n < 2000; ++n)
+    byte_xasprintf(&big[n].name, "%zu", n * 7919);
+  memset(&big_hash, 0, sizeof big_hash);
+  for(n = 0; n < 2000; ++n)
+    check_integer(table_hash_find(&big_hash, big, offsetof(struct entry, name),
+                                  sizeof *big, 2000, big[n].name), n);
+  check_integer(table_hash_find(&big_hash, big, offsetof(struct entry, name),
+                                sizeof *big, 2000, "1"), -1);
+  /* An empty table */
+  memset(&big_hash, 0, sizeof big_hash);
+  check_integer(table_hash_find(&big_hash, big, offsetof(struct entry, name),
+                                sizeof *big, 0, "0"), -1);
+}
+
+TEST(table);
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
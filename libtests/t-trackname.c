@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2008 Richard Kettlewell
+ * Copyright (C) 2008, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -17,6 +17,9 @@
  */
 #include "test.h"
 #include "trackname.h"
+#include "configuration.h"
+
+#define CONFIG "t-trackname.conf"
 
 #define CHECK_PATH_ORDER(A,B,EXPECTED) do {			\
   const unsigned char a[] = A, b[] = B;				\
@@ -26,6 +29,109 @@
 			  a, (sizeof a) - 1) == -(EXPECTED));	\
 } while(0)
 
+/* Sort key, display string and track for collation key checks.  Includes
+ * case differences, prefixes, non-ASCII and bytes either side of '/'. */
+static const char *const collation_cases[][3] = {
+  { "abc", "abc", "/x/abc" },
+  { "ABC", "abc", "/x/ABC" },
+  { "abc", "ABC", "/x/abc2" },
+  { "ab", "ab", "/x/ab" },
+  { "abcd", "abcd", "/x/abcd" },
+  { "abc", "abc", "/x/abc" },
+  { "abc", "abc", "/x.y" },
+  { "abc", "abc", "/x/y" },
+  { "abc", "abc", "/x-y" },
+  { "abc", "abc", "/x0" },
+  { "abc", "abc", "/x" },
+  { "", "", "/" },
+  { "", "z", "/z" },
+  { "\xC3\xA9t\xC3\xA9", "\xC3\xA9t\xC3\xA9", "/e" },
+  { "\xC3\x89T\xC3\x89", "\xC3\x89t\xC3\xA9", "/E" },
+  { "ete", "ete", "/ete" },
+  { "stra\xC3\x9F" "e", "stra\xC3\x9F" "e", "/s1" },
+  { "strasse", "strasse", "/s2" },
+  { "STRASSE", "Strasse", "/s3" },
+  { "\xFF", "\xFF", "/bad" },
+};
+
+#define NCOLLATION_CASES (sizeof collation_cases / sizeof *collation_cases)
+
+static int sign(int n) {
+  return n < 0 ? -1 : n > 0;
+}
+
+static void test_collation_keys(void) {
+  char *keys[NCOLLATION_CASES];
+  size_t nkeys[NCOLLATION_CASES], a, b;
+
+  for(a = 0; a < NCOLLATION_CASES; ++a)
+    keys[a] = track_collation_key(collation_cases[a][0],
+                                  collation_cases[a][1],
+                                  collation_cases[a][2],
+                                  &nkeys[a]);
+  for(a = 0; a < NCOLLATION_CASES; ++a)
+    for(b = 0; b < NCOLLATION_CASES; ++b) {
+      /* \xFF is not UTF-8 so compare_tracks() can't handle it */
+      if(a == NCOLLATION_CASES - 1 || b == NCOLLATION_CASES - 1)
+        continue;
+      check_integer(sign(compare_collation_keys(keys[a], nkeys[a],
+                                                keys[b], nkeys[b])),
+                    sign(compare_tracks(collation_cases[a][0],
+                                        collation_cases[b][0],
+                                        collation_cases[a][1],
+                                        collation_cases[b][1],
+                                        collation_cases[a][2],
+                                        collation_cases[b][2])));
+    }
+  /* Invalid UTF-8 still gets a key, ordered after everything else here */
+  for(a = 0; a + 1 < NCOLLATION_CASES; ++a)
+    insist(compare_collation_keys(keys[a], nkeys[a],
+                                  keys[NCOLLATION_CASES - 1],
+                                  nkeys[NCOLLATION_CASES - 1]) < 0);
+}
+
+static void test_name_rules(void) {
+  FILE *fp;
+  const char *a, *b, *t;
+  char *track;
+  size_t entries, bytes, entries2, bytes2;
+
+  insist((fp = fopen(CONFIG, "w")) != NULL);
+  fprintf(fp, "collection fs UTF-8 /music\n");
+  insist(fclose(fp) == 0);
+  configfile = xstrdup(CONFIG);
+  config_per_user = 0;
+  setenv("DISORDER_PRIVCONFIG", CONFIG ".private", 1);
+  insist(config_read(0, NULL) == 0);
+  unlink(CONFIG);
+  track = xstrdup("/music/Artist/Album/01:Title.ogg");
+  check_string(trackname_part(track, "display", "artist"), "Artist");
+  check_string(trackname_part(track, "sort", "album"), "Album");
+  check_string(trackname_part(track, "display", "title"), "Title");
+  check_string(trackname_part(track, "sort", "title"), "01:Title");
+  check_string(trackname_part(track, "display", "ext"), ".ogg");
+  check_string(trackname_part(track, "display", "nonesuch"), "");
+  /* Remembered results come back without being recomputed */
+  a = trackname_part(track, "display", "title");
+  b = trackname_part(track, "display", "title");
+  insist(a == b);
+  /* ...but only for the same track */
+  trackname_memo_usage(&entries, &bytes);
+  track[strlen(track) - 5] = 'X';
+  check_string(trackname_part(track, "display", "title"), "TitlX");
+  trackname_memo_usage(&entries2, &bytes2);
+  check_integer(entries2, entries + 1);
+  check_integer(bytes2, bytes + strlen(track) + strlen("TitlX") + 2);
+  check_string(trackname_transform("dir", "/music/The Artist", "sort"),
+               "Artist The");
+  check_string(trackname_transform("dir", "/music/The Artist", "display"),
+               "The Artist");
+  /* A subject no rule applies to is handed back as it was */
+  t = "/music/The Artist";
+  insist(trackname_transform("nonesuch", t, "display") == t);
+  insist(trackname_transform("nonesuch", t, "display") == t);
+}
+
 static void test_trackname(void) {
   CHECK_PATH_ORDER("/a/b", "/aa/", -1);
   CHECK_PATH_ORDER("/a/b", "/a", 1);
@@ -33,6 +139,8 @@ static void test_trackname(void) {
   CHECK_PATH_ORDER("/ab", "/aa", 1);
   CHECK_PATH_ORDER("/aa", "/aa", 0);
   CHECK_PATH_ORDER("/", "/", 0);
+  test_collation_keys();
+  test_name_rules();
 }
 
 TEST(trackname);
@@ -0,0 +1,222 @@
+/*
+ * This file is part of DisOrder.
+ * Copyright (C) 2026 Richard Kettlewell
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "test.h"
+#include "uaudio.h"
+
+#include <pthread.h>
+
+/* Drives the uaudio background threads with a fake backend.  Every call to
+ * the collect and play callbacks waits for the test to allow it, and the
+ * clock only moves when the play thread sleeps, so what the threads see is
+ * the same on every run. */
+
+/* Mono at 1KHz, so a sample is a millisecond */
+#define RATE 1000
+
+/* How much later than asked the fake sleep wakes up */
+#define OVERSLEEP_NS 250000
+
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t cond = PTHREAD_COND_INITIALIZER;
+
+static int collects_allowed, collects_waiting;
+static int plays_allowed, plays_waiting, plays_done;
+static unsigned last_flags;
+static int stopping;
+
+/* Set to have the fake backend record its own pacing sleep */
+static int backend_paces;
+
+/* Samples returned per collect call */
+static size_t collect_size;
+
+static int16_t next_in, next_out;
+static int out_of_order;
+
+static struct timespec fake_time = { 1, 0 };
+
+#define AWAIT(EXPR) do {                        \
+  pthread_mutex_lock(&lock);                    \
+  while(!(EXPR))                                \
+    pthread_cond_wait(&cond, &lock);            \
+  pthread_mutex_unlock(&lock);                  \
+} while(0)
+
+#define ALLOW(COUNTER) do {                     \
+  pthread_mutex_lock(&lock);                    \
+  ++COUNTER;                                    \
+  pthread_cond_broadcast(&cond);                \
+  pthread_mutex_unlock(&lock);                  \
+} while(0)
+
+static size_t collect(void *buffer, size_t max_samples,
+                      void attribute((unused)) *userdata) {
+  int16_t *const samples = buffer;
+  size_t n;
+
+  pthread_mutex_lock(&lock);
+  ++collects_waiting;
+  pthread_cond_broadcast(&cond);
+  while(!collects_allowed && !stopping)
+    pthread_cond_wait(&cond, &lock);
+  if(!stopping)
+    --collects_allowed;
+  --collects_waiting;
+  if(max_samples > collect_size)
+    max_samples = collect_size;
+  for(n = 0; n < max_samples; ++n)
+    samples[n] = ++next_in;
+  pthread_mutex_unlock(&lock);
+  return max_samples;
+}
+
+static size_t play(void *buffer, size_t nsamples, unsigned flags) {
+  const int16_t *const samples = buffer;
+  size_t n;
+
+  pthread_mutex_lock(&lock);
+  ++plays_waiting;
+  pthread_cond_broadcast(&cond);
+  while(!plays_allowed && !stopping)
+    pthread_cond_wait(&cond, &lock);
+  if(!stopping) {
+    --plays_allowed;
+    ++plays_done;
+  }
+  --plays_waiting;
+  last_flags = flags;
+  if(flags & UAUDIO_PLAYING)
+    for(n = 0; n < nsamples; ++n)
+      if(samples[n] != ++next_out)
+        out_of_order = 1;
+  if(backend_paces)
+    uaudio_thread_record_sleep(OVERSLEEP_NS / 1000);
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&lock);
+  return nsamples;
+}
+
+static void fake_now(struct timespec *ts) {
+  *ts = fake_time;
+}
+
+static void fake_sleep(const struct timespec *ts) {
+  fake_time.tv_sec += ts->tv_sec;
+  fake_time.tv_nsec += ts->tv_nsec + OVERSLEEP_NS;
+  while(fake_time.tv_nsec >= 1000000000) {
+    fake_time.tv_nsec -= 1000000000;
+    ++fake_time.tv_sec;
+  }
+}
+
+/* Underruns are noticed while the play thread waits for the collector, where
+ * the fake backend can't see it, so poll for them */
+static void await_underruns(uint32_t n) {
+  struct uaudio_stats s;
+
+  for(;;) {
+    uaudio_thread_stats(&s);
+    if(s.underruns >= n)
+      break;
+    sched_yield();
+  }
+}
+
+static void test_uaudio_thread(void) {
+  struct uaudio_stats s;
+
+  uaudio_set_format(RATE, 1, 16, 1);
+  uaudio_thread_clock(fake_now, fake_sleep);
+  uaudio_thread_start(collect, NULL, play, 10, 30, 0);
+  /* Silence is played until activated */
+  AWAIT(plays_waiting == 1);
+  insist(last_flags == 0);
+  uaudio_thread_activate();
+  ALLOW(plays_allowed);
+  AWAIT(plays_done == 1);
+  insist(last_flags & UAUDIO_PAUSED);
+  /* Small buffers: play starts when all but one are full */
+  collect_size = 10;
+  ALLOW(collects_allowed);
+  ALLOW(collects_allowed);
+  AWAIT(collects_waiting == 1 && !collects_allowed);
+  check_integer(plays_waiting, 0);
+  ALLOW(collects_allowed);
+  AWAIT(plays_waiting == 1);
+  uaudio_thread_stats(&s);
+  check_integer(s.depth[3], 1);         /* 30ms */
+  ALLOW(plays_allowed);
+  AWAIT(plays_done == 2 && plays_waiting == 1);
+  uaudio_thread_stats(&s);
+  check_integer(s.depth[3], 2);         /* 20ms */
+  check_integer(s.underruns, 0);
+  ALLOW(plays_allowed);
+  AWAIT(plays_done == 3 && plays_waiting == 1);
+  uaudio_thread_stats(&s);
+  check_integer(s.depth[2], 1);         /* 10ms */
+  ALLOW(plays_allowed);
+  AWAIT(plays_done == 4);
+  await_underruns(1);
+  /* Larger buffers: play restarts once the watermark is reached */
+  collect_size = 25;
+  ALLOW(collects_allowed);
+  AWAIT(collects_waiting == 1 && !collects_allowed);
+  ALLOW(collects_allowed);
+  AWAIT(plays_waiting == 1);
+  uaudio_thread_stats(&s);
+  check_integer(s.depth[4], 1);         /* 50ms */
+  ALLOW(plays_allowed);
+  AWAIT(plays_done == 5 && plays_waiting == 1);
+  /* A backend that paces itself replaces the play thread's own count */
+  backend_paces = 1;
+  ALLOW(plays_allowed);
+  AWAIT(plays_done == 6);
+  await_underruns(2);
+  uaudio_thread_stats(&s);
+  check_integer(s.depth[0], 0);
+  check_integer(s.depth[1], 0);
+  check_integer(s.depth[2], 1);
+  check_integer(s.depth[3], 3);
+  check_integer(s.depth[4], 1);
+  check_integer(s.underruns, 2);
+  /* 30 samples of silence and 80 of audio against a 62-sample lead: only the
+   * last two buffers had to wait, and the last sleep was counted once */
+  check_integer(s.sleeps, 2);
+  insist(s.late_max_us >= OVERSLEEP_NS / 1000 - 1
+         && s.late_max_us <= OVERSLEEP_NS / 1000);
+  insist(s.late_mean_us >= OVERSLEEP_NS / 1000 - 1
+         && s.late_mean_us <= OVERSLEEP_NS / 1000);
+  check_integer(next_out, 80);
+  insist(!out_of_order);
+  pthread_mutex_lock(&lock);
+  stopping = 1;
+  pthread_cond_broadcast(&cond);
+  pthread_mutex_unlock(&lock);
+  uaudio_thread_stop();
+}
+
+TEST(uaudio_thread);
+
+/*
+Local Variables:
+c-basic-offset:2
+comment-column:40
+fill-column:79
+indent-tabs-mode:nil
+End:
+*/
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2005, 2007-2009, 2011 Richard Kettlewell
+ * Copyright (C) 2005, 2007-2009, 2011, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -97,6 +97,65 @@ static void breaktest(const char *path,
   close_unicode_test(path, fp);
 }
 
+/** @brief Tests for utf8_quick_check_nfc() and utf8_ascii_prefix() */
+static void test_quick_check(void) {
+  uint32_t c, c32[2], *nfc;
+  uint32_t *d;
+  size_t nnfc, n;
+  char *u8, buffer[80];
+  int bad = 0;
+
+  for(c = 0; c < 0x110000; ++c) {
+    if(c >= 0xD800 && c <= 0xDFFF)
+      continue;
+    c32[0] = c;
+    c32[1] = 0;
+    u8 = utf32_to_utf8(c32, 1, 0);
+    if(utf8_quick_check_nfc(u8, strlen(u8))) {
+      /* Unchanged by NFC on its own... */
+      nfc = utf32_compose_canon(c32, 1, &nnfc);
+      if(nnfc != 1 || nfc[0] != c)
+        ++bad;
+      xfree(nfc);
+    } else if(c < 0x80)
+      ++bad;                            /* ASCII always passes */
+    xfree(u8);
+    /* ...and can't be a later part of a canonical decomposition, so can't
+     * compose with what's before it */
+    d = utf32_decompose_canon(c32, 1, &nnfc);
+    for(n = 1; n < nnfc; ++n) {
+      u8 = utf32_to_utf8(d + n, 1, 0);
+      if(utf8_quick_check_nfc(u8, strlen(u8)))
+        ++bad;
+      xfree(u8);
+    }
+    xfree(d);
+    ++tests;
+  }
+  check_integer(bad, 0);
+  /* Hangul jamo that compose with what's before them */
+  insist(!utf8_quick_check_nfc("\xE1\x85\xA1", 3));   /* U+1161 */
+  insist(!utf8_quick_check_nfc("\xE1\x86\xA8", 3));   /* U+11A8 */
+  insist(utf8_quick_check_nfc("\xEA\xB0\x80", 3));    /* U+AC00 */
+  /* Invalid UTF-8 is left to utf8_compose_canon() to reject */
+  insist(!utf8_quick_check_nfc("\xC0\x80", 2));
+  insist(!utf8_quick_check_nfc("abc\xE2\x82", 5));
+  insist(!utf8_quick_check_nfc("\x80", 1));
+  insist(utf8_quick_check_nfc("", 0));
+  insist(utf8_quick_check_nfc("play /music/x.ogg", 17));
+  insist(!utf8_quick_check_nfc("e\xCC\x81", 3));       /* e U+0301 */
+  /* The ASCII prefix is found at every length and position */
+  for(n = 0; n < sizeof buffer; ++n)
+    buffer[n] = 'a' + n % 26;
+  check_integer(utf8_ascii_prefix(buffer, sizeof buffer), sizeof buffer);
+  for(n = 0; n < sizeof buffer; ++n) {
+    buffer[n] = (char)0xC3;
+    check_integer(utf8_ascii_prefix(buffer, sizeof buffer), n);
+    check_integer(utf8_ascii_prefix(buffer, n), n);
+    buffer[n] = 'a';
+  }
+}
+
 /** @brief Tests for @ref lib/unicode.h */
 static void test_unicode(void) {
   FILE *fp;
@@ -153,6 +212,18 @@ static void test_unicode(void) {
       count_error();						\
     }								\
   } while(0)
+    /* The quick check must never claim something changes under NFC */
+    for(cn = 1; cn <= 5; ++cn) {
+      char *u8 = utf32_to_utf8(c[cn], utf32_len(c[cn]), 0);
+
+      ++tests;
+      if(utf8_quick_check_nfc(u8, strlen(u8)) && utf32_cmp(c[cn], NFC_c[cn])) {
+        fprintf(stderr, "NormalizationTest.txt:%d: c%d passes quick check\n",
+                lineno, cn);
+        count_error();
+      }
+      xfree(u8);
+    }
     unt_check(NFD, 3, 1);
     unt_check(NFD, 3, 2);
     unt_check(NFD, 3, 3);
@@ -184,6 +255,7 @@ static void test_unicode(void) {
   breaktest("WordBreakTest.txt", utf32_is_word_boundary);
   insist(utf32_combining_class(0x40000) == 0);
   insist(utf32_combining_class(0xE0000) == 0);
+  test_quick_check();
 }
 
 TEST(unicode);
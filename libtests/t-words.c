@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2005, 2007, 2008 Richard Kettlewell
+ * Copyright (C) 2005, 2007, 2008, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -16,6 +16,11 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "test.h"
+#include "unidata.h"
+
+#ifndef SRCDIR
+# define SRCDIR "."
+#endif
 
 struct {
   const char *in;
@@ -47,6 +52,133 @@ struct {
 };
 #define NWTEST (sizeof wtest / sizeof *wtest)
 
+/* The Word_Break tailoring used for track names */
+static int tailor_underscore(uint32_t c) {
+  return c == '_' ? unicode_Word_Break_Other : -1;
+}
+
+/* Check utf8_casefold_word_split_ascii() against EXPECT, or against the
+ * UTF-32 path if EXPECT is NULL */
+static void check_ascii_split(const char *s, unicode_property_tailor *pt,
+                              char **expect, size_t nexpect) {
+  char **got, *folded;
+  size_t ngot, i;
+
+  if(!expect) {
+    folded = utf8_casefold_compat(s, strlen(s), 0);
+    expect = utf8_word_split(folded, strlen(folded), &nexpect, pt);
+  }
+  got = utf8_casefold_word_split_ascii(s, strlen(s), &ngot, pt);
+  ++tests;
+  if(got && ngot == nexpect) {
+    for(i = 0; i < ngot && !strcmp(got[i], expect[i]); ++i)
+      ;
+    if(i == ngot && !got[i])
+      return;
+  }
+  fprintf(stderr, "ASCII word split of '%s' disagrees\n", s);
+  count_error();
+}
+
+/* Characters with each ASCII Word_Break value, including ones the tailoring
+ * changes */
+static const char ascii_alphabet[] = "aZ0:.',;_ -\r\n\v";
+
+#define NALPHABET (sizeof ascii_alphabet - 1)
+
+/* Every string over ascii_alphabet up to LENGTH characters */
+static void ascii_exhaustive(char *buffer, size_t n, size_t length) {
+  size_t i;
+
+  buffer[n] = 0;
+  check_ascii_split(buffer, 0, 0, 0);
+  check_ascii_split(buffer, tailor_underscore, 0, 0);
+  if(n < length)
+    for(i = 0; i < NALPHABET; ++i) {
+      buffer[n] = ascii_alphabet[i];
+      ascii_exhaustive(buffer, n + 1, length);
+    }
+}
+
+/* The ASCII lines of WordBreakTest.txt, with the words taken from the
+ * boundaries it gives */
+static void ascii_breaktest(void) {
+  FILE *fp;
+  char *l, *lp, line[256], *expect[256], boundary[256];
+  size_t nline, nexpect, start, n, i;
+  unsigned long c;
+  int ascii, isword, w;
+
+  if(!(fp = popen("gzip -dc " SRCDIR "/WordBreakTest.txt.gz", "r")))
+    disorder_fatal(errno, "decompressing WordBreakTest.txt");
+  while(!inputline("WordBreakTest.txt", fp, &l, '\n')) {
+    nline = 0;
+    ascii = 1;
+    for(lp = l; *lp && *lp != '#' && ascii; ) {
+      if(*lp == ' ' || *lp == '\t')
+        ++lp;
+      else if((unsigned char)*lp == 0xC3 && (unsigned char)lp[1] == 0xB7) {
+        boundary[nline] = 1;            /* 00F7 DIVISION SIGN */
+        lp += 2;
+      } else if((unsigned char)*lp == 0xC3 && (unsigned char)lp[1] == 0x97) {
+        boundary[nline] = 0;            /* 00D7 MULTIPLICATION SIGN */
+        lp += 2;
+      } else {
+        c = strtoul(lp, &lp, 16);
+        if(c == 0 || c >= 0x80 || nline >= sizeof line - 1)
+          ascii = 0;
+        else
+          line[nline++] = c;
+      }
+    }
+    xfree(l);
+    if(!ascii || !nline)
+      continue;
+    line[nline] = 0;
+    nexpect = start = 0;
+    for(n = 1; n <= nline; ++n) {
+      if(!boundary[n])
+        continue;
+      isword = 0;
+      for(i = start; i < n; ++i)
+        if(isalnum((unsigned char)line[i]))
+          isword = 1;
+      if(isword) {
+        expect[nexpect] = xstrndup(line + start, n - start);
+        for(i = 0; i < n - start; ++i)
+          expect[nexpect][i] = tolower((unsigned char)expect[nexpect][i]);
+        ++nexpect;
+      }
+      start = n;
+    }
+    expect[nexpect] = 0;
+    check_ascii_split(line, 0, expect, nexpect);
+  }
+  if((w = pclose(fp)))
+    disorder_fatal(0, "decompressing WordBreakTest.txt: %s", wstat(w));
+}
+
+static void test_ascii_words(void) {
+  char buffer[64];
+  size_t n, i, len;
+
+  /* Only ASCII is accepted */
+  insist(utf8_casefold_word_split_ascii("caf\xC3\xA9", 5, 0, 0) == NULL);
+  for(n = 0; n < NWTEST; ++n)
+    check_ascii_split(wtest[n].in, 0, 0, 0);
+  ascii_exhaustive(buffer, 0, 4);
+  srand(1);
+  for(n = 0; n < 20000; ++n) {
+    len = rand() % 40;
+    for(i = 0; i < len; ++i)
+      buffer[i] = 1 + rand() % 127;
+    buffer[len] = 0;
+    check_ascii_split(buffer, 0, 0, 0);
+    check_ascii_split(buffer, tailor_underscore, 0, 0);
+  }
+  ascii_breaktest();
+}
+
 static void test_words(void) {
   size_t t, nexpect, ngot, i;
   int right;
@@ -78,6 +210,7 @@ static void test_words(void) {
     }
     ++tests;
   }
+  test_ascii_words();
 }
 
 TEST(words);
@@ -1,6 +1,6 @@
 #
 # This file is part of DisOrder.
-# Copyright (C) 2005-2008 Richard Kettlewell
+# Copyright (C) 2005-2008, 2026 Richard Kettlewell
 #
 # This program is free software: you can redistribute it and/or modify
 # it under the terms of the GNU General Public License as published by
@@ -24,7 +24,7 @@ complete -r disobedience 2>/dev/null || true
 complete -o default \
          -A file \
          -W "allfiles authorize dirs disable disable-random
-             enable enable-random files get get-volume length log move
+             enable enable-random files get get-volume length log memstats move
              play playing prefs quack queue random-disable
              random-enable recent reconfigure remove rescan scratch
              search set set-volume shutdown stats unset version resolve
@@ -35,7 +35,7 @@ complete -o default \
              adopt
              playlist-del playlist-get playlist-set playlists
              -h --help -H --help-commands --version -V --config -c
-             --length --debug -d" \
+             --length --debug -d --binary -b" \
 	 disorder
 
 complete -o default \
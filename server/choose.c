@@ -69,16 +69,6 @@ static long ntracks;
 static char **required_tags;
 static char **prohibited_tags;
 
-static int queue_contains(const struct queue_entry *head,
-                          const char *track) {
-  const struct queue_entry *q;
-
-  for(q = head->next; q != head; q = q->next)
-    if(!strcmp(q->track, track))
-      return 1;
-  return 0;
-}
-
 /** @brief Compute the weight of a track
  * @param track Track name (UTF-8)
  * @param data Track data
@@ -118,8 +108,8 @@ static unsigned long compute_weight(const char *track,
   }
 
   /* Reject tracks currently in the queue or in the recent list */
-  if(queue_contains(&qhead, track)
-     || queue_contains(&phead, track))
+  if(queue_index_track(&qhead, track)
+     || queue_index_track(&phead, track))
     return 0;
 
   /* We'll need tags for a number of things */
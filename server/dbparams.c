@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2009 Richard Kettlewell
+ * Copyright (C) 2009, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -79,7 +79,7 @@ void dbparams_check(void) {
       return;
     case DB_LOCK_DEADLOCK:
       /* Deadlocked, try again */
-      trackdb_abort_transaction(tid);
+      trackdb_abort_to_retry(tid);
       break;
     default:
       disorder_fatal(0, "error updating database: %s", db_strerror(err));
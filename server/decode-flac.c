@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2007-2011 Richard Kettlewell
+ * Copyright (C) 2007-2011, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -38,29 +38,78 @@ static void flac_error(const FLAC__StreamDecoder attribute((unused)) *decoder,
                  FLAC__StreamDecoderErrorStatusString[status]);
 }
 
+/** @brief Define a function to interleave FLAC samples
+ * @param NAME Function name
+ * @param TYPE Output sample type
+ *
+ * The stereo case is separated out so that the compiler can vectorize it.
+ */
+#define FLAC_CONVERT(NAME, TYPE)                                        \
+  static void NAME(TYPE *out, const FLAC__int32 *const buffer[],        \
+                   size_t channels, size_t blocksize) {                 \
+    size_t n, c;                                                        \
+                                                                        \
+    if(channels == 2) {                                                 \
+      const FLAC__int32 *l = buffer[0], *r = buffer[1];                 \
+      for(n = 0; n < blocksize; ++n) {                                  \
+        out[2 * n] = l[n];                                              \
+        out[2 * n + 1] = r[n];                                          \
+      }                                                                 \
+    } else                                                              \
+      for(n = 0; n < blocksize; ++n)                                    \
+        for(c = 0; c < channels; ++c)                                   \
+          *out++ = buffer[c][n];                                        \
+  }
+
+FLAC_CONVERT(flac_convert_8, int8_t)
+FLAC_CONVERT(flac_convert_16, int16_t)
+FLAC_CONVERT(flac_convert_32, int32_t)
+
 /** @brief Write callback for FLAC decoder */
 static FLAC__StreamDecoderWriteStatus flac_write
     (const FLAC__StreamDecoder attribute((unused)) *decoder,
      const FLAC__Frame *frame,
      const FLAC__int32 *const buffer[],
      void attribute((unused)) *client_data) {
+  const size_t channels = frame->header.channels;
+  const size_t blocksize = frame->header.blocksize;
+  const unsigned bytes = frame->header.bits_per_sample / 8;
   size_t n, c;
 
-  output_header(frame->header.sample_rate,
-                frame->header.channels,
+  output_format(frame->header.sample_rate,
+                channels,
                 frame->header.bits_per_sample,
-                (frame->header.channels * frame->header.blocksize
-                 * frame->header.bits_per_sample) / 8,
-                ENDIAN_BIG);
-  for(n = 0; n < frame->header.blocksize; ++n) {
-    for(c = 0; c < frame->header.channels; ++c) {
-      switch(frame->header.bits_per_sample) {
-      case 8: output_8(buffer[c][n]); break;
-      case 16: output_16(buffer[c][n]); break;
-      case 24: output_24(buffer[c][n]); break;
-      case 32: output_32(buffer[c][n]); break;
+                ENDIAN_NATIVE);
+  switch(bytes) {
+  case 1:
+    flac_convert_8(output_reserve(channels * blocksize), buffer,
+                   channels, blocksize);
+    break;
+  case 2:
+    flac_convert_16(output_reserve(2 * channels * blocksize), buffer,
+                    channels, blocksize);
+    break;
+  case 3: {
+    uint8_t *out = output_reserve(3 * channels * blocksize);
+    for(n = 0; n < blocksize; ++n)
+      for(c = 0; c < channels; ++c) {
+        const uint32_t s = buffer[c][n];
+#if WORDS_BIGENDIAN
+        *out++ = s >> 16;
+        *out++ = s >> 8;
+        *out++ = s;
+#else
+        *out++ = s;
+        *out++ = s >> 8;
+        *out++ = s >> 16;
+#endif
       }
-    }
+    break;
+  }
+  case 4:
+    flac_convert_32(output_reserve(4 * channels * blocksize), buffer,
+                    channels, blocksize);
+    break;
   }
   return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
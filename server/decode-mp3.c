@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2007-2010 Richard Kettlewell
+ * Copyright (C) 2007-2010, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -37,86 +37,95 @@ static inline unsigned long prng(unsigned long state)
   return (state * 0x0019660dL + 0x3c6ef35fL) & 0xffffffffL;
 }
 
-/** @brief Generic linear sample quantize and dither routine
- * Filched from mpg321, which credits it to Robert Leslie */
-static long audio_linear_dither(mad_fixed_t sample,
-				struct audio_dither *dither) {
-  unsigned int scalebits;
-  mad_fixed_t output, mask, rnd;
+/** @brief Quantize and dither one channel to 16 bits
+ * @param out Where to write the first output sample
+ * @param stride Distance between output samples
+ * @param in Input samples
+ * @param n Number of samples
+ * @param dither Dithering state
+ *
+ * Generic linear sample quantize and dither routine, filched from mpg321, which
+ * credits it to Robert Leslie.  It works on a whole channel of a frame at once
+ * and keeps the state in locals.  The error feedback makes each sample depend
+ * on the one before so there is nothing to vectorize here.
+ */
+static void audio_linear_dither(int16_t *out,
+                                size_t stride,
+                                const mad_fixed_t *in,
+                                size_t n,
+                                struct audio_dither *dither) {
   const int bits = 16;
+  const unsigned int scalebits = MAD_F_FRACBITS + 1 - bits;
+  const mad_fixed_t mask = (1L << scalebits) - 1;
+  mad_fixed_t sample, output, rnd;
+  mad_fixed_t error0 = dither->error[0], error1 = dither->error[1],
+    error2 = dither->error[2], random = dither->random;
 
   enum {
     MIN = -MAD_F_ONE,
     MAX =  MAD_F_ONE - 1
   };
 
-  /* noise shape */
-  sample += dither->error[0] - dither->error[1] + dither->error[2];
+  while(n--) {
+    /* noise shape */
+    sample = *in++ + error0 - error1 + error2;
 
-  dither->error[2] = dither->error[1];
-  dither->error[1] = dither->error[0] / 2;
+    error2 = error1;
+    error1 = error0 / 2;
 
-  /* bias */
-  output = sample + (1L << (MAD_F_FRACBITS + 1 - bits - 1));
+    /* bias */
+    output = sample + (1L << (MAD_F_FRACBITS + 1 - bits - 1));
 
-  scalebits = MAD_F_FRACBITS + 1 - bits;
-  mask = (1L << scalebits) - 1;
+    /* dither */
+    rnd = prng(random);
+    output += (rnd & mask) - (random & mask);
 
-  /* dither */
-  rnd  = prng(dither->random);
-  output += (rnd & mask) - (dither->random & mask);
+    random = rnd;
 
-  dither->random = rnd;
+    /* clip */
+    if (output > MAX) {
+      output = MAX;
 
-  /* clip */
-  if (output > MAX) {
-    output = MAX;
-
-    if (sample > MAX)
-      sample = MAX;
-  }
-  else if (output < MIN) {
-    output = MIN;
+      if (sample > MAX)
+        sample = MAX;
+    }
+    else if (output < MIN) {
+      output = MIN;
 
-    if (sample < MIN)
-      sample = MIN;
-  }
+      if (sample < MIN)
+        sample = MIN;
+    }
 
-  /* quantize */
-  output &= ~mask;
+    /* quantize */
+    output &= ~mask;
 
-  /* error feedback */
-  dither->error[0] = sample - output;
+    /* error feedback */
+    error0 = sample - output;
 
-  /* scale */
-  return output >> scalebits;
+    /* scale */
+    *out = output >> scalebits;
+    out += stride;
+  }
+  dither->error[0] = error0;
+  dither->error[1] = error1;
+  dither->error[2] = error2;
+  dither->random = random;
 }
 
 /** @brief MP3 output callback */
 static enum mad_flow mp3_output(void attribute((unused)) *data,
 				struct mad_header const *header,
 				struct mad_pcm *pcm) {
-  size_t n = pcm->length;
-  const mad_fixed_t *l = pcm->samples[0], *r = pcm->samples[1];
-  static struct audio_dither ld[1], rd[1];
-
-  output_header(header->samplerate,
-		pcm->channels,
-		16,
-                2 * pcm->channels * pcm->length,
-                ENDIAN_BIG);
-  switch(pcm->channels) {
-  case 1:
-    while(n--)
-      output_16(audio_linear_dither(*l++, ld));
-    break;
-  case 2:
-    while(n--) {
-      output_16(audio_linear_dither(*l++, ld));
-      output_16(audio_linear_dither(*r++, rd));
-    }
-    break;
-  }
+  static struct audio_dither dither[2];
+  const unsigned channels = pcm->channels;
+  int16_t *out;
+  unsigned c;
+
+  output_format(header->samplerate, channels, 16, ENDIAN_NATIVE);
+  out = output_reserve(sizeof *out * channels * pcm->length);
+  for(c = 0; c < channels; ++c)
+    audio_linear_dither(out + c, channels, pcm->samples[c], pcm->length,
+                        &dither[c]);
   return MAD_FLOW_CONTINUE;
 }
 
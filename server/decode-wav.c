@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2007-2011 Richard Kettlewell
+ * Copyright (C) 2007-2011, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -26,8 +26,7 @@ static int wav_write(struct wavfile attribute((unused)) *f,
                      const char *data,
                      size_t nbytes,
                      void attribute((unused)) *u) {
-  if(fwrite(data, 1, nbytes, outputfp) < nbytes)
-    disorder_fatal(errno, "decoding %s: writing sample data", path);
+  output_bytes(data, nbytes);
   return 0;
 }
 
@@ -38,7 +37,7 @@ void decode_wav(void) {
 
   if((err = wav_init(f, path)))
     disorder_fatal(err, "opening %s", path);
-  output_header(f->rate, f->channels, f->bits, f->datasize, ENDIAN_LITTLE);
+  output_format(f->rate, f->channels, f->bits, ENDIAN_LITTLE);
   if((err = wav_data(f, wav_write, 0)))
     disorder_fatal(err, "error decoding %s", path);
 }
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2007-2010 Richard Kettlewell
+ * Copyright (C) 2007-2010, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -41,23 +41,46 @@ const char *path;
 char input_buffer[INPUT_BUFFER_SIZE];
 int input_count;
 
-/** @brief Write a block header
+/** @brief Current output format */
+static struct stream_header output_current;
+
+/** @brief Pending sample data */
+static char *output_block;
+
+/** @brief Bytes of sample data in @ref output_block */
+static size_t output_used;
+
+/** @brief Size of @ref output_block */
+static size_t output_size;
+
+/** @brief Block size to aim for
+ *
+ * Set by output_format() to @ref DECODE_BLOCK_MS worth of samples.
+ */
+static size_t output_target;
+
+/** @brief Set the output sample format
  * @param rate Sample rate in Hz
  * @param channels Channel count (currently only 1 or 2 supported)
  * @param bits Bits per sample (must be a multiple of 8, no more than 64)
- * @param nbytes Total number of data bytes
  * @param endian @ref ENDIAN_BIG or @ref ENDIAN_LITTLE
  *
  * Checks that the sample format is a supported one (so other calls do not have
- * to) and calls disorder_fatal() on error.
+ * to) and calls disorder_fatal() on error.  If the format has changed then any
+ * pending samples are flushed first.  It is cheap to call this with an
+ * unchanged format, so decoders may call it for every frame.
  */
-void output_header(int rate,
+void output_format(int rate,
                    int channels,
                    int bits,
-                   int nbytes,
                    int endian) {
-  struct stream_header header;
+  size_t frame;
 
+  if(rate == (int)output_current.rate
+     && channels == output_current.channels
+     && bits == output_current.bits
+     && endian == output_current.endian)
+    return;
   if(bits <= 0 || bits % 8 || bits > 64)
     disorder_fatal(0, "decoding %s: unsupported sample size %d bits",
                    path, bits);
@@ -66,13 +89,62 @@ void output_header(int rate,
                    path, channels);
   if(rate <= 0)
     disorder_fatal(0, "decoding %s: nonsensical sample rate %dHz", path, rate);
-  header.rate = rate;
-  header.bits = bits;
-  header.channels = channels;
-  header.endian = endian;
-  header.nbytes = nbytes;
-  if(fwrite(&header, sizeof header, 1, outputfp) < 1)
+  output_flush();
+  output_current.rate = rate;
+  output_current.bits = bits;
+  output_current.channels = channels;
+  output_current.endian = endian;
+  frame = channels * bits / 8;
+  output_target = (size_t)rate * DECODE_BLOCK_MS / 1000 * frame;
+  if(output_target < frame)
+    output_target = frame;
+}
+
+/** @brief Reserve space for sample data
+ * @param nbytes Number of bytes required
+ * @return Pointer to @p nbytes bytes of space
+ *
+ * The caller must fill in all @p nbytes bytes, in the format last set by
+ * output_format(), before calling any other output function.
+ */
+void *output_reserve(size_t nbytes) {
+  void *ptr;
+
+  if(!output_current.rate)
+    disorder_fatal(0, "decoding %s: sample data before format", path);
+  if(output_used >= output_target)
+    output_flush();
+  if(output_used + nbytes > output_size) {
+    output_size = output_target + nbytes;
+    output_block = xrealloc_noptr(output_block, output_size);
+  }
+  ptr = output_block + output_used;
+  output_used += nbytes;
+  return ptr;
+}
+
+/** @brief Append sample data
+ * @param data Sample data
+ * @param nbytes Number of bytes of sample data
+ */
+void output_bytes(const void *data, size_t nbytes) {
+  memcpy(output_reserve(nbytes), data, nbytes);
+}
+
+/** @brief Write out pending sample data
+ *
+ * Writes a single header covering all the pending samples, followed by the
+ * samples themselves.
+ */
+void output_flush(void) {
+  if(!output_used)
+    return;
+  output_current.nbytes = output_used;
+  if(fwrite(&output_current, sizeof output_current, 1, outputfp) < 1)
     disorder_fatal(errno, "decoding %s: writing format header", path);
+  if(fwrite(output_block, 1, output_used, outputfp) < output_used)
+    disorder_fatal(errno, "decoding %s: writing sample data", path);
+  output_used = 0;
 }
 
 /** @brief Lookup table of decoders */
@@ -90,6 +162,9 @@ static const struct decoder decoders[] = {
 
 static const struct option options[] = {
   { "help", no_argument, 0, 'h' },
+  { "buffer-size", required_argument, 0, 'b' },
+  { "keep-open", no_argument, 0, 'k' },
+  { "no-prefetch", no_argument, 0, 'P' },
   { "version", no_argument, 0, 'V' },
   { 0, 0, 0, 0 }
 };
@@ -100,6 +175,9 @@ static void attribute((noreturn)) help(void) {
 	  "  disorder-decode [OPTIONS] PATH\n"
 	  "Options:\n"
 	  "  --help, -h              Display usage message\n"
+	  "  --buffer-size, -b BYTES Input buffer size\n"
+	  "  --keep-open, -k         Keep input file open\n"
+	  "  --no-prefetch, -P       Don't prefetch input\n"
 	  "  --version, -V           Display version number\n"
 	  "\n"
 	  "Audio decoder for DisOrder.  Only intended to be used by speaker\n"
@@ -111,12 +189,21 @@ static void attribute((noreturn)) help(void) {
 int main(int argc, char **argv) {
   int n;
   const char *e;
+  char *end;
+  long bufsize = 0;
+  unsigned flags = HREADER_PREFETCH;
 
   set_progname(argv);
   if(!setlocale(LC_CTYPE, "")) disorder_fatal(errno, "calling setlocale");
-  while((n = getopt_long(argc, argv, "hV", options, 0)) >= 0) {
+  while((n = getopt_long(argc, argv, "hVb:kP", options, 0)) >= 0) {
     switch(n) {
     case 'h': help();
+    case 'b':
+      if(xstrtol(&bufsize, optarg, &end, 0) || *end || bufsize <= 0)
+        disorder_fatal(0, "invalid buffer size '%s'", optarg);
+      break;
+    case 'k': flags |= HREADER_KEEP_OPEN; break;
+    case 'P': flags &= ~HREADER_PREFETCH; break;
     case 'V': version("disorder-decode");
     default: disorder_fatal(0, "invalid option");
     }
@@ -131,6 +218,7 @@ int main(int argc, char **argv) {
   } else
     outputfp = stdout;
   path = argv[optind];
+  hreader_defaults(bufsize, flags);
   for(n = 0;
       decoders[n].pattern
 	&& fnmatch(decoders[n].pattern, path, 0) != 0;
@@ -139,6 +227,7 @@ int main(int argc, char **argv) {
   if(!decoders[n].pattern)
     disorder_fatal(0, "cannot determine file type for %s", path);
   decoders[n].decode();
+  output_flush();
   xfclose(outputfp);
   return 0;
 }
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2007-2010 Richard Kettlewell
+ * Copyright (C) 2007-2010, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -39,41 +39,20 @@ extern char input_buffer[INPUT_BUFFER_SIZE];
 /** @brief Number of bytes read into buffer */
 extern int input_count;
 
-/** @brief Write an 8-bit word */
-static inline void output_8(int n) {
-  if(putc(n, outputfp) < 0)
-    disorder_fatal(errno, "decoding %s: output error", path);
-}
-
-/** @brief Write a 16-bit word in bigendian format */
-static inline void output_16(uint16_t n) {
-  if(putc(n >> 8, outputfp) < 0
-     || putc(n, outputfp) < 0)
-    disorder_fatal(errno, "decoding %s: output error", path);
-}
-
-/** @brief Write a 24-bit word in bigendian format */
-static inline void output_24(uint32_t n) {
-  if(putc(n >> 16, outputfp) < 0
-     || putc(n >> 8, outputfp) < 0
-     || putc(n, outputfp) < 0)
-    disorder_fatal(errno, "decoding %s: output error", path);
-}
-
-/** @brief Write a 32-bit word in bigendian format */
-static inline void output_32(uint32_t n) {
-  if(putc(n >> 24, outputfp) < 0
-     || putc(n >> 16, outputfp) < 0
-     || putc(n >> 8, outputfp) < 0
-     || putc(n, outputfp) < 0)
-    disorder_fatal(errno, "decoding %s: output error", path);
-}
+/** @brief Duration of a block of decoded samples in milliseconds
+ *
+ * Decoded samples are accumulated into blocks of at least this length before
+ * being written out with a single header.
+ */
+#define DECODE_BLOCK_MS 50
 
-void output_header(int rate,
+void output_format(int rate,
                    int channels,
                    int bits,
-                   int nbytes,
                    int endian);
+void *output_reserve(size_t nbytes);
+void output_bytes(const void *data, size_t nbytes);
+void output_flush(void);
 
 void decode_mp3(void);
 void decode_ogg(void);
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2008-2012 Richard Kettlewell
+ * Copyright (C) 2008-2012, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -66,8 +66,10 @@
 #include "logfd.h"
 #include "mem.h"
 #include "mime.h"
+#include "pcm-cache.h"
 #include "printf.h"
 #include "queue.h"
+#include "queue-journal.h"
 #include "random.h"
 #include "rights.h"
 #include "sendmail.h"
@@ -124,13 +126,16 @@ void queue_read(void);
 /* read the queue in.  Calls @fatal@ on error. */
 
 void queue_write(void);
-/* write the queue out.  Calls @fatal@ on error. */
+/* journal changes to the queue.  Calls @fatal@ on error. */
 
 void recent_read(void);
 /* read the recently played list in.  Calls @fatal@ on error. */
 
 void recent_write(void);
-/* write the recently played list out.  Calls @fatal@ on error. */
+/* journal changes to the recently played list.  Calls @fatal@ on error. */
+
+void queue_sync(void);
+/* flush journalled queue and recently played list changes to disk */
 
 struct queue_entry *queue_add(const char *track, const char *submitter,
 			      int where, const char *target,
@@ -213,6 +218,9 @@ void speaker_setup(ev_source *ev);
 void speaker_reload(void);
 /* Tell the speaker process to reload its configuration. */
 
+extern struct speaker_stats speaker_stats;
+/* Latest statistics from the speaker process */
+
 int pause_playing(const char *who);
 /* Pause the current track.  Return 0 on success, -1 on error.  WHO
  * can be 0. */
@@ -243,6 +251,9 @@ int server_stop(ev_source *ev, int fd);
 void rtp_request(const struct sockaddr_storage *sa);
 void rtp_request_cancel(const struct sockaddr_storage *sa);
 
+void memstats_log(void);
+/* Log a summary of memory use */
+
 extern int volume_left, volume_right;	/* last known volume */
 
 extern int wideopen;			/* blindly accept all logins */
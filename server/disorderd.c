@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2004-2012 Richard Kettlewell
+ * Copyright (C) 2004-2012, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -133,6 +133,24 @@ static void periodic_database_gc(ev_source attribute((unused)) *ev_) {
   trackdb_gc();
 }
 
+static void periodic_queue_sync(ev_source attribute((unused)) *ev_) {
+  queue_sync();
+}
+
+static void periodic_memstats(ev_source attribute((unused)) *ev_) {
+  static time_t last;
+  time_t now;
+
+  /* Checked every second so that a new interval takes effect on reload */
+  if(!config->memstats_interval)
+    return;
+  xtime(&now);
+  if(now - last >= config->memstats_interval) {
+    memstats_log();
+    last = now;
+  }
+}
+
 static void periodic_volume_check(ev_source attribute((unused)) *ev_) {
   int l, r;
   char lb[32], rb[32];
@@ -327,6 +345,8 @@ int main(int argc, char **argv) {
   create_periodic(ev, periodic_rescan, 86400, 1/*immediate*/);
   /* Tidy up the database once a minute */
   create_periodic(ev, periodic_database_gc, 60, 0);
+  /* Flush queue journals to disk once a second */
+  create_periodic(ev, periodic_queue_sync, 1, 0);
   /* Check the volume immediately and then once a minute */
   create_periodic(ev, periodic_volume_check, 60, 1);
   /* Check for a playable track once a second */
@@ -335,6 +355,8 @@ int main(int argc, char **argv) {
   create_periodic(ev, periodic_add_random, 2, 1);
   /* Issue a rescan when devices are mounted or unmouted */
   create_periodic(ev, periodic_mount_check, MOUNT_CHECK_INTERVAL, 1);
+  /* Log memory use every memstats_interval seconds */
+  create_periodic(ev, periodic_memstats, 1, 0);
   /* enter the event loop */
   n = ev_run(ev);
   /* if we exit the event loop, something must have gone wrong */
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2004-2012 Richard Kettlewell
+ * Copyright (C) 2004-2012, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -31,6 +31,9 @@ struct queue_entry *playing;
 /** @brief Set when paused */
 int paused;
 
+/** @brief Latest statistics from the speaker process */
+struct speaker_stats speaker_stats;
+
 static void finished(ev_source *ev);
 static int start_child(struct queue_entry *q, 
                        const struct pbgc_params *params,
@@ -38,6 +41,12 @@ static int start_child(struct queue_entry *q,
 static int prepare_child(struct queue_entry *q, 
                          const struct pbgc_params *params,
                          void attribute((unused)) *bgdata);
+static void prepare_decode(struct queue_entry *q,
+                           const struct pbgc_params *params,
+                           int fd);
+static int prepare_cached(struct queue_entry *q,
+                          const struct pbgc_params *params,
+                          int fd);
 static void ensure_next_scratch(ev_source *ev);
 
 /** @brief File descriptor of our end of the socket to the speaker */
@@ -95,11 +104,12 @@ static int speaker_readable(ev_source *ev, int fd,
     D(("SM_PLAYING %s %ld", sm.u.id, sm.data));
     playing->sofar = sm.data;
     break;
+  case SM_STATS:
+    speaker_stats = sm.u.stats;
+    break;
   case SM_ARRIVED: {
     /* track ID is now prepared */
-    struct queue_entry *q;
-    for(q = qhead.next; q != &qhead && strcmp(q->id, sm.u.id); q = q->next)
-      ;
+    struct queue_entry *q = queue_index_find(&qhead, sm.u.id);
     if(q && q->preparing) {
       q->preparing = 0;
       q->prepared = 1;
@@ -457,20 +467,92 @@ static int prepare_child(struct queue_entry *q,
   int n;
   while(waitpid(npid, &n, 0) < 0 && errno == EINTR)
     ;
+  /* Close all the FDs we don't need */
+  xclose(np[0]);
+  if(config->pcm_cache_mbyte)
+    return prepare_cached(q, params, np[1]);
+  /* Start the decoder itself */
+  prepare_decode(q, params, np[1]);
+  return 0;
+}
+
+/** @brief Run the decoder for a raw-format player
+ * @param q Track to decode
+ * @param params Player parameters
+ * @param fd Where the decoder should write
+ *
+ * Usually doesn't return, since the decoder replaces the calling process.
+ */
+static void prepare_decode(struct queue_entry *q,
+                           const struct pbgc_params *params,
+                           int fd) {
   /* Pass the file descriptor to the driver in an environment
    * variable. */
-  char buffer[64];
-  snprintf(buffer, sizeof buffer, "DISORDER_RAW_FD=%d", np[1]);
+  static char buffer[64];
+  snprintf(buffer, sizeof buffer, "DISORDER_RAW_FD=%d", fd);
   if(putenv(buffer) < 0)
     disorder_fatal(errno, "error calling putenv");
-  /* Close all the FDs we don't need */
-  xclose(np[0]);
-  /* Start the decoder itself */
   play_track(q->pl,
              params->argv, params->argc,
              params->rawpath,
              q->track);
-  return 0;
+}
+
+/** @brief Decode a track via the decoded track cache
+ * @param q Track to decode
+ * @param params Player parameters
+ * @param fd Where the decoded track should be written
+ * @return Process exit code
+ *
+ * If the track is in the cache then it is copied from there.  Otherwise the
+ * decoder is run in a subprocess and its output is written both to @p fd and
+ * to a new cache entry, which is kept if the decoder succeeds.
+ */
+static int prepare_cached(struct queue_entry *q,
+                          const struct pbgc_params *params,
+                          int fd) {
+  const off_t limit = (off_t)config->pcm_cache_mbyte << 20;
+  struct pcm_cache_writer *w;
+  char *dir, *key;
+  int cfd, dp[2], err, status;
+  pid_t dpid;
+
+  if(!(key = pcm_cache_key(params->rawpath, params->argc, params->argv))) {
+    prepare_decode(q, params, fd);
+    return 0;
+  }
+  byte_xasprintf(&dir, "%s/pcm-cache", config->home);
+  if((cfd = pcm_cache_open(dir, key)) >= 0) {
+    if((err = pcm_cache_tee(cfd, fd, NULL)))
+      disorder_fatal(err, "error copying cached %s", q->track);
+    return 0;
+  }
+  xpipe(dp);
+  if(!(dpid = xfork())) {
+    xclose(dp[0]);
+    prepare_decode(q, params, dp[1]);
+    _exit(0);
+  }
+  xclose(dp[1]);
+  w = pcm_cache_create(dir, key, limit / PCM_CACHE_ENTRY_FRACTION);
+  if((err = pcm_cache_tee(dp[0], fd, w)))
+    disorder_error(err, "error copying decoded %s", q->track);
+  /* Closing the pipe stops the decoder if we gave up early */
+  xclose(dp[0]);
+  while(waitpid(dpid, &status, 0) < 0 && errno == EINTR)
+    ;
+  if(w) {
+    if(!err && !status && !pcm_cache_commit(w))
+      pcm_cache_evict(dir, limit);
+    else
+      pcm_cache_abandon(w);
+  }
+  if(WIFSIGNALED(status)) {
+    /* Report the decoder's fate as our own */
+    signal(WTERMSIG(status), SIG_DFL);
+    kill(getpid(), WTERMSIG(status));
+  }
+  return err ? 1 : WEXITSTATUS(status);
 }
 
 /** @brief Kill a player
@@ -532,17 +614,11 @@ static void chosen_random_track(ev_source *ev,
  * function has returned.
  */
 void add_random_track(ev_source *ev) {
-  struct queue_entry *q;
-  long qlen = 0;
-
   /* If random play is not enabled then do nothing. */
   if(shutting_down || !random_is_enabled())
     return;
-  /* Count how big the queue is */
-  for(q = qhead.next; q != &qhead; q = q->next)
-    ++qlen;
-  /* If it's smaller than the desired size then add a track */
-  if(qlen < config->queue_pad)
+  /* If the queue is smaller than the desired size then add a track */
+  if(queue_index_length(&qhead) < config->queue_pad)
     trackdb_request_random(ev, chosen_random_track);
 }
 
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2004-2009 Richard Kettlewell
+ * Copyright (C) 2004-2009, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -20,30 +20,11 @@
  */
 #include "disorder-server.h"
 
-static int find_in_list(struct queue_entry *needle,
-			int nqs, struct queue_entry **qs) {
-  int n;
-
-  for(n = 0; n < nqs; ++n)
-    if(qs[n] == needle)
-      return 1;
-  return 0;
-}
-
-static int id_in_use(const char *id) {
-  struct queue_entry *q;
-
-  for(q = qhead.next; q != &qhead; q = q->next)
-    if(!strcmp(id, q->id))
-      return 1;
-  return 0;
-}
-
 static void queue_id(struct queue_entry *q) {
   const char *id;
 
   id = random_id();
-  while(id_in_use(id))
+  while(queue_index_find(&qhead, id))
     id = random_id();
   q->id = id;
 }
@@ -96,10 +77,7 @@ struct queue_entry *queue_add(const char *track, const char *submitter,
       afterme = &qhead;
     else {
       /* Insert after a specific track */
-      afterme = qhead.next;
-      while(afterme != &qhead && strcmp(afterme->id, target))
-        afterme = afterme->next;
-      if(afterme == &qhead)
+      if(!(afterme = queue_index_find(&qhead, target)))
         return NULL;
     }
     queue_insert_entry(afterme, q);
@@ -169,14 +147,19 @@ void queue_moveafter(struct queue_entry *target,
 		     int nqs, struct queue_entry **qs,
 		     const char *who) {
   struct queue_entry *q;
+  hash *moving;
   int n;
 
   /* Normalize */
   if(!target)
     target = &qhead;
-  else
-    while(find_in_list(target, nqs, qs))
+  else {
+    moving = hash_new(1);
+    for(n = 0; n < nqs; ++n)
+      hash_add(moving, qs[n]->id, NULL, HASH_INSERT_OR_REPLACE);
+    while(target != &qhead && hash_find(moving, target->id))
       target = target->prev;
+  }
   /* Do the move */
   for(n = 0; n < nqs; ++n) {
     q = qs[n];
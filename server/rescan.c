@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder 
- * Copyright (C) 2005-2011 Richard Kettlewell
+ * Copyright (C) 2005-2011, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -121,7 +121,8 @@ static void rescan_collection(const struct collection *c) {
     }
     if(config->dbversion > 1) {
       /* We use NFC track names */
-      if(!(track = utf8_compose_canon(track, strlen(track), 0))) {
+      if(!utf8_quick_check_nfc(track, strlen(track))
+         && !(track = utf8_compose_canon(track, strlen(track), 0))) {
         disorder_error(0, "cannot convert track path to NFC: %s", path);
         continue;
       }
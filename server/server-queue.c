@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2004-2009 Richard Kettlewell
+ * Copyright (C) 2004-2009, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -59,107 +59,57 @@ void queue_fix_sofar(struct queue_entry *q) {
   }
 }
 
-static void queue_read_error(const char *msg,
-			     void *u) {
-  disorder_fatal(0, "error parsing queue %s: %s", (const char *)u, msg);
-}
+/** @brief Journal for @ref qhead */
+static struct queue_journal *queue_journal;
+
+/** @brief Journal for @ref phead */
+static struct queue_journal *recent_journal;
 
-static void queue_do_read(struct queue_entry *head, const char *path) {
-  char *buffer;
-  FILE *fp;
+void queue_read(void) {
   struct queue_entry *q;
-  int ver = 0;
+  const char *path = config_get_file("queue");
 
-  if(!(fp = fopen(path, "r"))) {
-    if(errno == ENOENT)
-      return;			/* no queue */
-    disorder_fatal(errno, "error opening %s", path);
-  }
-  head->next = head->prev = head;
-  while(!inputline(path, fp, &buffer, '\n')) {
-    if(buffer[0] == '#') {
-      /* Version indicator */
-      ver = atoi(buffer + 1);
-      continue;
-    }
-    q = xmalloc(sizeof *q);
-    queue_unmarshall(q, buffer, queue_read_error, (void *)path);
-    if(ver < 1) {
-      /* Fix up origin field as best we can; will be wrong in some cases but
-       * hopefully not too horribly so. */
-      q->origin = q->submitter ? origin_picked : origin_random;
-      /* Eliminated obsolete states, since they are assumed elsewhere not to be
-       * set. */
-      switch(q->state) {
-      case playing_isscratch:
-        q->origin = origin_scratch;
-        q->state = playing_unplayed;
-        break;
-      case playing_random:
-        q->state = playing_unplayed;
-        break;
-      default:
-        break;
-      }
-    }
-    if(head == &qhead
-       && (!q->track
-	   || !q->when))
+  queue_journal = queue_journal_new(path);
+  queue_journal_read(queue_journal, &qhead);
+  queue_index_list(&qhead);
+  for(q = qhead.next; q != &qhead; q = q->next)
+    if(!q->track || !q->when)
       disorder_fatal(0, "incomplete queue entry in %s", path);
-    queue_insert_entry(head->prev, q);
-  }
-  if(ferror(fp))
-    disorder_fatal(errno, "error reading %s", path);
-  fclose(fp);
-}
-
-void queue_read(void) {
-  queue_do_read(&qhead, config_get_file("queue"));
 }
 
 void recent_read(void) {
-  struct queue_entry *q;
-
-  queue_do_read(&phead, config_get_file("recent"));
+  recent_journal = queue_journal_new(config_get_file("recent"));
+  queue_journal_read(recent_journal, &phead);
+  queue_index_list(&phead);
   /* reset pcount after loading */
-  pcount = 0;
-  q = phead.next;
-  while(q != &phead) {
-    ++pcount;
-    q = q->next;
-  }
-}
-
-static void queue_do_write(const struct queue_entry *head, const char *path) {
-  char *tmp;
-  FILE *fp;
-  struct queue_entry *q;
-
-  byte_xasprintf(&tmp, "%s.new", path);
-  if(!(fp = fopen(tmp, "w"))) disorder_fatal(errno, "error opening %s", tmp);
-  /* Save version indicator */
-  if(fprintf(fp, "#1\n") < 0)
-    disorder_fatal(errno, "error writing %s", tmp);
-  for(q = head->next; q != head; q = q->next)
-    if(fprintf(fp, "%s\n", queue_marshall(q)) < 0)
-      disorder_fatal(errno, "error writing %s", tmp);
-  if(fclose(fp) < 0) disorder_fatal(errno, "error closing %s", tmp);
-  if(rename(tmp, path) < 0) disorder_fatal(errno, "error replacing %s", path);
+  pcount = queue_index_length(&phead);
 }
 
 void queue_write(void) {
-  queue_do_write(&qhead, config_get_file("queue"));
+  queue_journal_write(queue_journal, &qhead);
 }
 
 void recent_write(void) {
-  queue_do_write(&phead, config_get_file("recent"));
+  queue_journal_write(recent_journal, &phead);
+}
+
+void queue_sync(void) {
+  if(queue_journal)
+    queue_journal_sync(queue_journal);
+  if(recent_journal)
+    queue_journal_sync(recent_journal);
 }
 
 struct queue_entry *queue_find(const char *key) {
-  struct queue_entry *q;
+  struct queue_entry *q, *byid = queue_index_find(&qhead, key);
 
+  /* Only search by track name if it's known to be present */
+  if(!queue_index_track(&qhead, key))
+    return byid;
+  /* If the key matches both an ID and a track, whichever comes first in the
+   * queue wins */
   for(q = qhead.next;
-      q != &qhead && strcmp(q->track, key) && strcmp(q->id, key);
+      q != &qhead && q != byid && strcmp(q->track, key);
       q = q->next)
     ;
   return q != &qhead ? q : 0;
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder.
- * Copyright (C) 2004-2012 Richard Kettlewell
+ * Copyright (C) 2004-2012, 2026 Richard Kettlewell
  *
  * This program is free software: you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
@@ -18,6 +18,8 @@
 
 #include "disorder-server.h"
 #include "basen.h"
+#include "timeval.h"
+#include "frame.h"
 
 #ifndef NONCE_SIZE
 # define NONCE_SIZE 16
@@ -124,6 +126,21 @@ struct conn {
 
   /** @brief RTP destination (if @ref rtp_requested is nonzero) */
   struct sockaddr_storage rtp_destination;
+
+  /** @brief Nonzero if response bodies use binary framing */
+  int binary;
+
+  /** @brief Listing being streamed as a response body, or NULL */
+  struct trackdb_listing *listing;
+
+  /** @brief Rest of a list being streamed as a response body, or NULL */
+  char **streaming;
+
+  /** @brief Arena for @ref streaming, or NULL
+   *
+   * Reset when the body is complete.
+   */
+  struct mem_arena *arena;
 };
 
 /** @brief Linked list of connections */
@@ -139,11 +156,16 @@ static int c_playlist_set_body(struct conn *c,
                                char **body,
                                int nbody,
                                void *u);
+static int c_playlist_insert_body(struct conn *c,
+                                  char **body,
+                                  int nbody,
+                                  void *u);
 static int fetch_body(struct conn *c,
                       body_callback_type body_callback,
                       void *u);
 static int body_line(struct conn *c, char *line);
 static int command(struct conn *c, char *line);
+static void command_report(struct sink *output);
 
 static const char *noyes[] = { "no", "yes" };
 
@@ -163,6 +185,11 @@ static void remove_connection(struct conn *c) {
     ;
   if(*cc)
     *cc = c->next;
+  if(c->arena) {
+    c->streaming = 0;
+    mem_arena_free(c->arena);
+    c->arena = 0;
+  }
 }
 
 /** @brief Called when a connection's writer fails or is shut down
@@ -622,6 +649,100 @@ static int c_user(struct conn *c,
   return 1;
 }
 
+/** @brief Write one item of a response body
+ * @param c Connection
+ * @param s Item
+ * @param len Length of item
+ *
+ * In text mode the item is written as a dot-stuffed line, and must not
+ * contain a newline.  In binary mode it is written as a frame.
+ */
+static void body_item(struct conn *c, const char *s, size_t len) {
+  if(c->binary)
+    frame_write(ev_writer_sink(c->w), s, len);
+  else {
+    if(*s == '.')
+      sink_writec(ev_writer_sink(c->w), '.');
+    sink_write(ev_writer_sink(c->w), s, len);
+    sink_writec(ev_writer_sink(c->w), '\n');
+  }
+}
+
+/** @brief Write one string item of a response body
+ * @param c Connection
+ * @param s Item
+ */
+static void body_string(struct conn *c, const char *s) {
+  body_item(c, s, strlen(s));
+}
+
+/** @brief Write one formatted item of a response body
+ * @param c Connection
+ * @param fmt Format string
+ */
+static void body_printf(struct conn *c, const char *fmt, ...) {
+  va_list ap;
+  char *s;
+  int n;
+
+  va_start(ap, fmt);
+  n = byte_xvasprintf(&s, fmt, ap);
+  va_end(ap);
+  body_item(c, s, n);
+  xfree(s);
+}
+
+/** @brief Write a block of text as response body items
+ * @param c Connection
+ * @param text Newline-separated lines, one item each
+ */
+static void body_text(struct conn *c, const char *text) {
+  const char *nl;
+
+  while(*text) {
+    nl = strchr(text, '\n');
+    if(!nl) {
+      body_string(c, text);
+      break;
+    }
+    body_item(c, text, nl - text);
+    text = nl + 1;
+  }
+}
+
+static void body_queue_field(const char *name, const char *value, void *u) {
+  struct conn *const c = u;
+
+  body_string(c, name);
+  body_string(c, value);
+}
+
+/** @brief Write a queue entry as response body items
+ * @param c Connection
+ * @param q Queue entry
+ *
+ * In text mode this is a single line in queue_marshall() format.  In binary
+ * mode each field name and value is a separate item and an empty item ends
+ * the entry, saving the quoting and splitting.
+ */
+static void body_queue_entry(struct conn *c, const struct queue_entry *q) {
+  if(c->binary) {
+    queue_marshall_fields(q, body_queue_field, c);
+    body_item(c, "", 0);
+  } else
+    body_printf(c, " %s", queue_marshall(q));
+}
+
+/** @brief End a response body
+ * @param c Connection
+ */
+static void body_end(struct conn *c) {
+  if(c->binary)
+    frame_end(ev_writer_sink(c->w));
+  else
+    sink_writes(ev_writer_sink(c->w), ".\n");
+}
+
 static int c_recent(struct conn *c,
 		    char attribute((unused)) **vec,
 		    int attribute((unused)) nvec) {
@@ -629,8 +750,8 @@ static int c_recent(struct conn *c,
 
   sink_writes(ev_writer_sink(c->w), "253 Tracks follow\n");
   for(q = phead.next; q != &phead; q = q->next)
-    sink_printf(ev_writer_sink(c->w), " %s\n", queue_marshall(q));
-  sink_writes(ev_writer_sink(c->w), ".\n");
+    body_queue_entry(c, q);
+  body_end(c);
   return 1;				/* completed */
 }
 
@@ -659,7 +780,7 @@ static int c_queue(struct conn *c,
   for(q = qhead.next; q != &qhead; q = q->next) {
     /* fill in estimated start time */
     q->expected = when;
-    sink_printf(ev_writer_sink(c->w), " %s\n", queue_marshall(q));
+    body_queue_entry(c, q);
     /* update for next track */
     if(when) {
       if((l = trackdb_get(q->track, "_length"))
@@ -669,14 +790,96 @@ static int c_queue(struct conn *c,
 	when = 0;
     }
   }
-  sink_writes(ev_writer_sink(c->w), ".\n");
+  body_end(c);
   return 1;				/* completed */
 }
 
-static int output_list(struct conn *c, char **vec) {
-  while(*vec)
-    sink_printf(ev_writer_sink(c->w), "%s\n", *vec++);
-  sink_writes(ev_writer_sink(c->w), ".\n");
+/** @brief Arena for query results that are written out straight away
+ *
+ * It is reset as soon as the command has been answered.
+ */
+static struct mem_arena *query_arena;
+
+/** @brief Buffered bytes above which a streamed body waits for the client */
+#define STREAM_HIGH_WATER 65536
+
+/** @brief Buffered bytes at which a streamed body carries on */
+#define STREAM_LOW_WATER 16384
+
+/** @brief Items or database keys handled per step of a streamed body */
+#define STREAM_STEP 1024
+
+static int stream_body(struct conn *c);
+
+/** @brief Reader callback while a response body is being streamed
+ *
+ * Further commands wait until the body is finished, so that their responses
+ * don't end up in the middle of it.
+ */
+static int stream_reader_callback(ev_source attribute((unused)) *ev,
+                                  ev_reader *reader,
+                                  void attribute((unused)) *ptr,
+                                  size_t attribute((unused)) bytes,
+                                  int attribute((unused)) eof,
+                                  void attribute((unused)) *u) {
+  return ev_reader_disable(reader);
+}
+
+/** @brief Called when the client has consumed enough of a streamed body */
+static int stream_drained(ev_source attribute((unused)) *ev,
+                          ev_writer attribute((unused)) *w,
+                          void *u) {
+  struct conn *const c = u;
+
+  if(stream_body(c)) {
+    /* Now we can start processing commands again */
+    c->reader = reader_callback;
+    ev_reader_enable(c->r);
+  }
+  return 0;
+}
+
+/** @brief Write as much of a streamed response body as the client can take
+ * @param c Connection
+ * @return 1 if the body is complete, 0 if waiting for the client
+ *
+ * The body comes from @c c->listing or @c c->streaming.  Output stops when
+ * @ref STREAM_HIGH_WATER bytes are buffered and carries on from
+ * stream_drained(), so that only a little of a large listing is held in
+ * memory at once, and the client starts receiving it straight away.
+ *
+ * Each step of @c c->listing reads the database in its own transaction, so a
+ * listing is not a consistent snapshot if the database changes meanwhile.
+ */
+static int stream_body(struct conn *c) {
+  struct vector v[1];
+  size_t buffered, allocated;
+  int n;
+
+  for(;;) {
+    ev_writer_usage(c->w, &buffered, &allocated);
+    if(buffered >= STREAM_HIGH_WATER) {
+      ev_writer_drained(c->w, STREAM_LOW_WATER, stream_drained, c);
+      c->reader = stream_reader_callback;
+      return 0;
+    }
+    if(c->listing) {
+      vector_init(v);
+      if(!trackdb_listing_next(c->listing, v, STREAM_STEP))
+        c->listing = 0;
+      for(n = 0; n < v->nvec; ++n)
+        body_string(c, v->vec[n]);
+    } else if(c->streaming) {
+      for(n = 0; n < STREAM_STEP && *c->streaming; ++n)
+        body_string(c, *c->streaming++);
+      if(!*c->streaming)
+        c->streaming = 0;
+    } else
+      break;
+  }
+  body_end(c);
+  if(c->arena)
+    mem_arena_reset(c->arena);
   return 1;
 }
 
@@ -733,19 +936,22 @@ static int files_dirs(struct conn *c,
     key = 0;
     fvec = 0;
   }
-  if(!fvec) {
-    /* No cache hit (either because a miss, or because we did not look) so do
-     * the lookup */
+  if(key) {
+    /* A cache miss, so do the lookup and put the answer in the cache */
     if(dir && *dir)
       fvec = trackdb_list(dir, 0, what, rec);
     else
       fvec = trackdb_list(0, 0, what, rec);
-  }
-  if(key)
-    /* Put the answer in the cache */
     cache_put(&cache_files_type, key, fvec);
+  }
   sink_writes(ev_writer_sink(c->w), "253 Listing follow\n");
-  return output_list(c, fvec);
+  if(fvec)
+    c->streaming = fvec;
+  else
+    /* The answer isn't going in the cache so there's no need to have all of
+     * it at once; it's read from the database as the client consumes it */
+    c->listing = trackdb_listing_open(dir && *dir ? dir : 0, what, 0);
+  return stream_body(c);
 }
 
 static int c_files(struct conn *c,
@@ -828,9 +1034,8 @@ static int c_prefs(struct conn *c,
   sink_writes(ev_writer_sink(c->w), "253 prefs follow\n");
   for(; k; k = k->next)
     if(k->name[0] != '_')		/* omit internal values */
-      sink_printf(ev_writer_sink(c->w),
-		  " %s %s\n", quoteutf8(k->name), quoteutf8(k->value));
-  sink_writes(ev_writer_sink(c->w), ".\n");
+      body_printf(c, " %s %s", quoteutf8(k->name), quoteutf8(k->value));
+  body_end(c);
   return 1;
 }
 
@@ -849,8 +1054,8 @@ static void search_parse_error(const char *msg, void *u) {
 static int c_search(struct conn *c,
 			  char **vec,
 			  int attribute((unused)) nvec) {
-  char **terms, **results;
-  int nterms, nresults, n;
+  char **terms;
+  int nterms, nresults;
   const char *e = "unknown error";
 
   /* This is a bit of a bodge.  Initially it's there to make the eclient
@@ -859,14 +1064,14 @@ static int c_search(struct conn *c,
    * user-supplied search strings will be the same everywhere. */
   if(!(terms = split(vec[0], &nterms, SPLIT_QUOTES, search_parse_error, &e))) {
     sink_printf(ev_writer_sink(c->w), "550 %s\n", e);
-  } else {
-    results = trackdb_search(terms, nterms, &nresults);
-    sink_printf(ev_writer_sink(c->w), "253 %d matches\n", nresults);
-    for(n = 0; n < nresults; ++n)
-      sink_printf(ev_writer_sink(c->w), "%s\n", results[n]);
-    sink_writes(ev_writer_sink(c->w), ".\n");
+    return 1;
   }
-  return 1;
+  /* The matches are only needed until they have been streamed */
+  if(!c->arena)
+    c->arena = mem_arena_new();
+  c->streaming = trackdb_search(terms, nterms, &nresults, c->arena);
+  sink_printf(ev_writer_sink(c->w), "253 %d matches\n", nresults);
+  return stream_body(c);
 }
 
 static int c_random_enable(struct conn *c,
@@ -896,8 +1101,49 @@ static int c_random_enabled(struct conn *c,
 
 static void got_stats(char *stats, void *u) {
   struct conn *const c = u;
+  const struct speaker_stats *const s = &speaker_stats;
+  struct dynstr depth[1], body[1];
+  char bucket[32];
+  int n;
 
-  sink_printf(ev_writer_sink(c->w), "253 stats\n%s\n.\n", stats);
+  /* Each bucket is labelled with its lower bound in milliseconds */
+  dynstr_init(depth);
+  for(n = 0; n < UAUDIO_DEPTH_BUCKETS; ++n) {
+    snprintf(bucket, sizeof bucket, " %d:%"PRIu32,
+             n ? 2 << n : 0, s->backend.depth[n]);
+    dynstr_append_string(depth, bucket);
+  }
+  dynstr_terminate(depth);
+  dynstr_init(body);
+  sink_printf(sink_dynstr(body), "%s\n"
+              "Speaker stats:\n"
+              "tracks: %"PRIu32"\n"
+              "buffered: %"PRIu32"ms\n"
+              "buffer target: %"PRIu32"ms\n"
+              "buffer pool: %"PRIu32"KB\n"
+              "buffer pool peak: %"PRIu32"KB\n"
+              "underruns: %"PRIu32"\n"
+              "underrun silence: %"PRIu32"ms\n"
+              "track handovers: %"PRIu32"\n"
+              "gapless handovers: %"PRIu32"\n"
+              "last handover gap: %"PRIu32" samples\n"
+              "backend buffer depth (ms):%s\n"
+              "backend underruns: %"PRIu32"\n"
+              "backend wakeups: %"PRIu32"\n"
+              "backend lateness: mean %"PRIu32"us max %"PRIu32"us\n"
+              "\n",
+              stats,
+              s->tracks, s->buffered_ms, s->target_ms,
+              s->pool_kbytes, s->pool_peak_kbytes,
+              s->underruns, s->underrun_ms,
+              s->handovers, s->gapless_handovers, s->last_gap_samples,
+              depth->vec, s->backend.underruns, s->backend.sleeps,
+              s->backend.late_mean_us, s->backend.late_max_us);
+  command_report(sink_dynstr(body));
+  dynstr_terminate(body);
+  sink_writes(ev_writer_sink(c->w), "253 stats\n");
+  body_text(c, body->vec);
+  body_end(c);
   /* Now we can start processing commands again */
   ev_reader_enable(c->r);
 }
@@ -909,6 +1155,134 @@ static int c_stats(struct conn *c,
   return 0;				/* not yet complete */
 }
 
+/** @brief Memory use, as reported by @c memstats and memstats_log() */
+struct memstats {
+  /** @brief Heap and arena statistics */
+  struct mem_stats mem;
+
+  /** @brief Number of entries in the object cache */
+  size_t cache_entries;
+
+  /** @brief Approximate bytes used by the object cache */
+  size_t cache_bytes;
+
+  /** @brief Number of remembered track name results */
+  size_t memo_entries;
+
+  /** @brief Approximate bytes used by remembered track name results */
+  size_t memo_bytes;
+
+  /** @brief Number of connections */
+  int connections;
+
+  /** @brief Number of connections receiving the event log */
+  int log_connections;
+
+  /** @brief Bytes waiting to be written to connections */
+  size_t write_buffered;
+
+  /** @brief Bytes allocated for connection output buffers */
+  size_t write_allocated;
+
+  /** @brief Bytes read from connections but not yet processed */
+  size_t read_buffered;
+
+  /** @brief Bytes allocated for connection input buffers */
+  size_t read_allocated;
+};
+
+/** @brief Gather memory use statistics
+ * @param ms Where to store statistics
+ */
+static void get_memstats(struct memstats *ms) {
+  const struct conn *c;
+  size_t buffered, allocated;
+
+  memset(ms, 0, sizeof *ms);
+  mem_get_stats(&ms->mem);
+  ms->cache_entries = cache_count();
+  ms->cache_bytes = cache_bytes();
+  trackname_memo_usage(&ms->memo_entries, &ms->memo_bytes);
+  for(c = connections; c; c = c->next) {
+    ++ms->connections;
+    if(c->lo)
+      ++ms->log_connections;
+    if(c->w) {
+      ev_writer_usage(c->w, &buffered, &allocated);
+      ms->write_buffered += buffered;
+      ms->write_allocated += allocated;
+    }
+    if(c->r) {
+      ev_reader_usage(c->r, &buffered, &allocated);
+      ms->read_buffered += buffered;
+      ms->read_allocated += allocated;
+    }
+  }
+}
+
+static int c_memstats(struct conn *c,
+		      char attribute((unused)) **vec,
+		      int attribute((unused)) nvec) {
+  const struct speaker_stats *const s = &speaker_stats;
+  struct memstats ms;
+  char *body;
+
+  get_memstats(&ms);
+  byte_xasprintf(&body,
+              "heap: %zu bytes\n"
+              "heap free: %zu bytes\n"
+              "allocated: %zu bytes\n"
+              "collections: %zu\n"
+              "arenas: %zu bytes\n"
+              "cache: %zu entries, %zu bytes\n"
+              "name memo: %zu entries, %zu bytes\n"
+              "connections: %d (%d log)\n"
+              "write buffers: %zu bytes used, %zu bytes allocated\n"
+              "read buffers: %zu bytes used, %zu bytes allocated\n"
+              "speaker tracks: %"PRIu32"\n"
+              "speaker buffered: %"PRIu32"KB\n"
+              "speaker pool: %"PRIu32"KB (peak %"PRIu32"KB)\n",
+              ms.mem.heap_size, ms.mem.free_bytes, ms.mem.allocated,
+              ms.mem.collections, ms.mem.arena_size,
+              ms.cache_entries, ms.cache_bytes,
+              ms.memo_entries, ms.memo_bytes,
+              ms.connections, ms.log_connections,
+              ms.write_buffered, ms.write_allocated,
+              ms.read_buffered, ms.read_allocated,
+              s->tracks, s->buffered_kbytes,
+              s->pool_kbytes, s->pool_peak_kbytes);
+  sink_writes(ev_writer_sink(c->w), "253 memstats\n");
+  body_text(c, body);
+  body_end(c);
+  return 1;
+}
+
+/** @brief Log a summary of memory use
+ *
+ * The allocation figure is the amount allocated since the previous call.
+ */
+void memstats_log(void) {
+  static size_t last_allocated;
+  struct memstats ms;
+
+  get_memstats(&ms);
+  disorder_info("memory: heap %zuKB (%zuKB free), %zuKB allocated,"
+                " %zu collections; cache %zu entries %zuKB;"
+                " name memo %zu entries %zuKB;"
+                " %d connections buffering %zuKB of %zuKB;"
+                " speaker %"PRIu32"KB of %"PRIu32"KB",
+                ms.mem.heap_size / 1024, ms.mem.free_bytes / 1024,
+                (ms.mem.allocated - last_allocated) / 1024,
+                ms.mem.collections,
+                ms.cache_entries, ms.cache_bytes / 1024,
+                ms.memo_entries, ms.memo_bytes / 1024,
+                ms.connections,
+                (ms.write_buffered + ms.read_buffered) / 1024,
+                (ms.write_allocated + ms.read_allocated) / 1024,
+                speaker_stats.buffered_kbytes, speaker_stats.pool_kbytes);
+  last_allocated = ms.mem.allocated;
+}
+
 static int c_volume(struct conn *c,
 		    char **vec,
 		    int nvec) {
@@ -1144,12 +1518,9 @@ static int list_response(struct conn *c,
                          const char *reply,
                          char **list) {
   sink_printf(ev_writer_sink(c->w), "253 %s\n", reply);
-  while(*list) {
-    sink_printf(ev_writer_sink(c->w), "%s%s\n",
-		**list == '.' ? "." : "", *list);
-    ++list;
-  }
-  sink_writes(ev_writer_sink(c->w), ".\n");
+  while(*list)
+    body_string(c, *list++);
+  body_end(c);
   return 1;				/* completed */
 }
 
@@ -1194,6 +1565,14 @@ static int c_get_global(struct conn *c,
   return 1;
 }
 
+static int c_binary(struct conn *c,
+		    char attribute((unused)) **vec,
+		    int attribute((unused)) nvec) {
+  sink_writes(ev_writer_sink(c->w), "250 binary framing enabled\n");
+  c->binary = 1;
+  return 1;
+}
+
 static int c_nop(struct conn *c,
 		 char attribute((unused)) **vec,
 		 int attribute((unused)) nvec) {
@@ -1213,14 +1592,14 @@ static int c_new(struct conn *c,
     max = INT_MAX;
   if(max <= 0 || max > config->new_max)
     max = config->new_max;
-  tracks = trackdb_new(0, max);
+  if(!query_arena)
+    query_arena = mem_arena_new();
+  tracks = trackdb_new(0, max, query_arena);
   sink_printf(ev_writer_sink(c->w), "253 New track list follows\n");
-  while(*tracks) {
-    sink_printf(ev_writer_sink(c->w), "%s%s\n",
-		**tracks == '.' ? "." : "", *tracks);
-    ++tracks;
-  }
-  sink_writes(ev_writer_sink(c->w), ".\n");
+  while(*tracks)
+    body_string(c, *tracks++);
+  body_end(c);
+  mem_arena_reset(query_arena);
   return 1;				/* completed */
 
 }
@@ -1647,8 +2026,8 @@ static int c_schedule_list(struct conn *c,
   char **ids = schedule_list(0);
   sink_writes(ev_writer_sink(c->w), "253 ID list follows\n");
   while(*ids)
-    sink_printf(ev_writer_sink(c->w), "%s\n", *ids++);
-  sink_writes(ev_writer_sink(c->w), ".\n");
+    body_string(c, *ids++);
+  body_end(c);
   return 1;				/* completed */
 }
 
@@ -1665,9 +2044,8 @@ static int c_schedule_get(struct conn *c,
    * them. */
   sink_writes(ev_writer_sink(c->w), "253 Event information follows\n");
   for(k = actiondata; k; k = k->next)
-    sink_printf(ev_writer_sink(c->w), " %s %s\n",
-		quoteutf8(k->name),  quoteutf8(k->value));
-  sink_writes(ev_writer_sink(c->w), ".\n");
+    body_printf(c, " %s %s", quoteutf8(k->name), quoteutf8(k->value));
+  body_end(c);
   return 1;				/* completed */
 }
 
@@ -1779,6 +2157,9 @@ static int playlist_response(struct conn *c,
   case ENOENT:
     sink_writes(ev_writer_sink(c->w), "555 No such playlist\n");
     break;
+  case ERANGE:
+    sink_writes(ev_writer_sink(c->w), "550 Invalid playlist position\n");
+    break;
   default:
     sink_writes(ev_writer_sink(c->w), "550 Error accessing playlist\n");
     break;
@@ -1786,6 +2167,20 @@ static int playlist_response(struct conn *c,
   return 1;
 }
 
+/** @brief Check that a connection holds the lock on a playlist
+ * @param c Connection
+ * @param playlist Playlist name
+ * @return Nonzero if it does; otherwise an error has been sent
+ */
+static int playlist_locked(struct conn *c, const char *playlist) {
+  if(!c->locked_playlist
+     || strcmp(playlist, c->locked_playlist)) {
+    sink_writes(ev_writer_sink(c->w), "550 Playlist is not locked\n");
+    return 0;
+  }
+  return 1;
+}
+
 static int c_playlist_get(struct conn *c,
 			  char **vec,
 			  int attribute((unused)) nvec) {
@@ -1811,11 +2206,8 @@ static int c_playlist_set_body(struct conn *c,
   const char *playlist = u;
   int err;
 
-  if(!c->locked_playlist
-     || strcmp(playlist, c->locked_playlist)) {
-    sink_writes(ev_writer_sink(c->w), "550 Playlist is not locked\n");
+  if(!playlist_locked(c, playlist))
     return 1;
-  }
   if(!(err = trackdb_playlist_set(playlist, c->who,
                                   body, nbody, 0))) {
     sink_printf(ev_writer_sink(c->w), "250 OK\n");
@@ -1824,6 +2216,95 @@ static int c_playlist_set_body(struct conn *c,
     return playlist_response(c, err);
 }
 
+/** @brief Parse a playlist position or count
+ * @param c Connection
+ * @param s String to parse
+ * @param np Where to store the result
+ * @return 0 on success, -1 if @p s is invalid and an error has been sent
+ */
+static int playlist_position(struct conn *c, const char *s, int *np) {
+  long n;
+  char *e;
+
+  if(xstrtol(&n, s, &e, 10) || e == s || *e || n < 0 || n > INT_MAX) {
+    sink_writes(ev_writer_sink(c->w), "550 invalid position\n");
+    return -1;
+  }
+  *np = n;
+  return 0;
+}
+
+static int c_playlist_insert(struct conn *c,
+                             char **vec,
+                             int attribute((unused)) nvec) {
+  return fetch_body(c, c_playlist_insert_body, vec);
+}
+
+static int c_playlist_insert_body(struct conn *c,
+                                  char **body,
+                                  int nbody,
+                                  void *u) {
+  char **vec = u;
+  int err, position;
+
+  if(!playlist_locked(c, vec[0])
+     || playlist_position(c, vec[1], &position))
+    return 1;
+  if(!(err = trackdb_playlist_insert(vec[0], c->who, position,
+                                     body, nbody))) {
+    sink_printf(ev_writer_sink(c->w), "250 OK\n");
+    return 1;
+  } else
+    return playlist_response(c, err);
+}
+
+static int c_playlist_remove(struct conn *c,
+                             char **vec,
+                             int attribute((unused)) nvec) {
+  int err, position, count;
+
+  if(!playlist_locked(c, vec[0]))
+    return 1;
+  if(playlist_position(c, vec[1], &position)
+     || playlist_position(c, vec[2], &count))
+    return 1;
+  if(!(err = trackdb_playlist_remove(vec[0], c->who, position, count))) {
+    sink_printf(ev_writer_sink(c->w), "250 OK\n");
+    return 1;
+  } else
+    return playlist_response(c, err);
+}
+
+static int c_playlist_move(struct conn *c,
+                           char **vec,
+                           int attribute((unused)) nvec) {
+  int err, from, count, to;
+
+  if(!playlist_locked(c, vec[0]))
+    return 1;
+  if(playlist_position(c, vec[1], &from)
+     || playlist_position(c, vec[2], &count)
+     || playlist_position(c, vec[3], &to))
+    return 1;
+  if(!(err = trackdb_playlist_move(vec[0], c->who, from, count, to))) {
+    sink_printf(ev_writer_sink(c->w), "250 OK\n");
+    return 1;
+  } else
+    return playlist_response(c, err);
+}
+
+static int c_playlist_length(struct conn *c,
+                             char **vec,
+                             int attribute((unused)) nvec) {
+  int ntracks, err;
+
+  if(!(err = trackdb_playlist_get(vec[0], c->who, 0, &ntracks, 0))) {
+    sink_printf(ev_writer_sink(c->w), "252 %d\n", ntracks);
+    return 1;
+  } else
+    return playlist_response(c, err);
+}
+
 static int c_playlist_get_share(struct conn *c,
                                 char **vec,
                                 int attribute((unused)) nvec) {
@@ -1935,6 +2416,7 @@ static const struct server_command {
   { "adduser",        2, 3,       c_adduser,        RIGHT_ADMIN },
   { "adopt",          1, 1,       c_adopt,          RIGHT_PLAY },
   { "allfiles",       0, 2,       c_allfiles,       RIGHT_READ },
+  { "binary",         0, 0,       c_binary,         0 },
   { "confirm",        1, 1,       c_confirm,        0 },
   { "cookie",         1, 1,       c_cookie,         0 },
   { "deluser",        1, 1,       c_deluser,        RIGHT_ADMIN },
@@ -1950,6 +2432,7 @@ static const struct server_command {
   { "length",         1, 1,       c_length,         RIGHT_READ },
   { "log",            0, 0,       c_log,            RIGHT_READ },
   { "make-cookie",    0, 0,       c_make_cookie,    RIGHT_READ },
+  { "memstats",       0, 0,       c_memstats,       RIGHT_ADMIN },
   { "move",           2, 2,       c_move,           RIGHT_MOVE__MASK },
   { "moveafter",      1, INT_MAX, c_moveafter,      RIGHT_MOVE__MASK },
   { "new",            0, 1,       c_new,            RIGHT_READ },
@@ -1962,7 +2445,11 @@ static const struct server_command {
   { "playlist-delete",    1, 1,   c_playlist_delete,    RIGHT_PLAY },
   { "playlist-get",       1, 1,   c_playlist_get,       RIGHT_READ },
   { "playlist-get-share", 1, 1,   c_playlist_get_share, RIGHT_READ },
+  { "playlist-insert",    2, 2,   c_playlist_insert,    RIGHT_PLAY },
+  { "playlist-length",    1, 1,   c_playlist_length,    RIGHT_READ },
   { "playlist-lock",      1, 1,   c_playlist_lock,      RIGHT_PLAY },
+  { "playlist-move",      4, 4,   c_playlist_move,      RIGHT_PLAY },
+  { "playlist-remove",    3, 3,   c_playlist_remove,    RIGHT_PLAY },
   { "playlist-set",       1, 1,   c_playlist_set,       RIGHT_PLAY },
   { "playlist-set-share", 2, 2,   c_playlist_set_share, RIGHT_PLAY },
   { "playlist-unlock",    0, 0,   c_playlist_unlock,    RIGHT_PLAY },
@@ -2049,6 +2536,104 @@ static void command_error(const char *msg, void *u) {
   sink_printf(ev_writer_sink(c->w), "500 parse error: %s\n", msg);
 }
 
+/** @brief Number of entries in @ref commands */
+#define NCOMMANDS (int)(sizeof commands / sizeof *commands)
+
+/** @brief Number of latency buckets kept for each command
+ *
+ * Bucket 0 counts commands that took under 16us.  Bucket @c n > 0 counts
+ * those that took at least 8<<n microseconds, and under twice that except in
+ * the last bucket, which starts at about a second.
+ */
+#define LATENCY_BUCKETS 18
+
+/** @brief Statistics for one command */
+struct command_stats {
+  /** @brief Number of times the command has been handled */
+  unsigned long count;
+
+  /** @brief Number of database transactions it retried */
+  unsigned long retries;
+
+  /** @brief Total time spent handling it, in microseconds */
+  uint64_t total_us;
+
+  /** @brief Longest time spent handling it, in microseconds */
+  uint64_t max_us;
+
+  /** @brief Latency histogram */
+  unsigned long latency[LATENCY_BUCKETS];
+};
+
+/** @brief Perfect hash for looking up @ref commands */
+static struct table_hash command_hash;
+
+/** @brief Statistics for each entry in @ref commands */
+static struct command_stats command_stats[NCOMMANDS];
+
+/** @brief Record how long a command took
+ * @param c Connection
+ * @param n Index into @ref commands
+ * @param started When the command started
+ * @param retries Number of database transactions retried
+ *
+ * Only the time until the command function returned is counted.  Commands
+ * that complete later, such as @c stats, are not timed beyond that.
+ */
+static void command_timed(const struct conn *c,
+                          int n,
+                          const struct timeval *started,
+                          unsigned long retries) {
+  struct command_stats *const cs = &command_stats[n];
+  struct timeval now;
+  uint64_t us;
+  int bucket;
+
+  xgettimeofday(&now, NULL);
+  us = tvsub_us(now, *started);
+  ++cs->count;
+  cs->retries += retries;
+  cs->total_us += us;
+  if(us > cs->max_us)
+    cs->max_us = us;
+  for(bucket = 0;
+      bucket + 1 < LATENCY_BUCKETS && us >= (uint64_t)16 << bucket;
+      ++bucket)
+    ;
+  ++cs->latency[bucket];
+  if(config->slow_command_ms && us >= (uint64_t)config->slow_command_ms * 1000)
+    disorder_info("S%x %s took %"PRIu64"ms with %lu retries",
+                  c->tag, commands[n].name, us / 1000, retries);
+}
+
+/** @brief Report command statistics
+ * @param output Where to write the report
+ *
+ * One line is written for each command that has been used.
+ */
+static void command_report(struct sink *output) {
+  const struct command_stats *cs;
+  int n, bucket;
+
+  sink_printf(output, "Command stats:\n"
+              "transaction retries: %lu\n", trackdb_retries);
+  for(n = 0; n < NCOMMANDS; ++n) {
+    cs = &command_stats[n];
+    if(!cs->count)
+      continue;
+    sink_printf(output, "%s: %lu calls, mean %"PRIu64"us, max %"PRIu64"us,"
+                " %lu retries;",
+                commands[n].name, cs->count, cs->total_us / cs->count,
+                cs->max_us, cs->retries);
+    /* Each bucket is labelled with its lower bound in microseconds */
+    for(bucket = 0; bucket < LATENCY_BUCKETS; ++bucket)
+      if(cs->latency[bucket])
+        sink_printf(output, " %d:%lu",
+                    bucket ? 8 << bucket : 0, cs->latency[bucket]);
+    sink_writes(output, "\n");
+  }
+}
+
 /** @brief @ref line_reader_type callback for commands
  * @param c Connection
  * @param line Line
@@ -2058,11 +2643,15 @@ static void command_error(const char *msg, void *u) {
  */
 static int command(struct conn *c, char *line) {
   char **vec;
-  int nvec, n;
+  int nvec, n, rc;
+  struct timeval started;
+  unsigned long retries;
 
   D(("server command %s", line));
-  /* We force everything into NFC as early as possible */
-  if(!(line = utf8_compose_canon(line, strlen(line), 0))) {
+  /* We force everything into NFC as early as possible.  Nearly every line
+   * already is, and the quick check saves decoding and copying it. */
+  if(!utf8_quick_check_nfc(line, strlen(line))
+     && !(line = utf8_compose_canon(line, strlen(line), 0))) {
     sink_writes(ev_writer_sink(c->w), "500 cannot normalize command\n");
     return 1;
   }
@@ -2074,7 +2663,7 @@ static int command(struct conn *c, char *line) {
     sink_writes(ev_writer_sink(c->w), "500 do what?\n");
     return 1;
   }
-  if((n = TABLE_FIND(commands, name, vec[0])) < 0)
+  if((n = TABLE_HASH_FIND(command_hash, commands, name, vec[0])) < 0)
     sink_writes(ev_writer_sink(c->w), "500 unknown command\n");
   else {
     if(commands[n].rights
@@ -2095,7 +2684,11 @@ static int command(struct conn *c, char *line) {
       sink_writes(ev_writer_sink(c->w), "500 too many arguments\n");
       return 1;
     }
-    return commands[n].fn(c, vec, nvec);
+    retries = trackdb_retries;
+    xgettimeofday(&started, NULL);
+    rc = commands[n].fn(c, vec, nvec);
+    command_timed(c, n, &started, trackdb_retries - retries);
+    return rc;
   }
   return 1;			/* completed */
 }
@@ -1,6 +1,6 @@
 /*
  * This file is part of DisOrder
- * Copyright (C) 2005-2013 Richard Kettlewell
+ * Copyright (C) 2005-2013, 2026 Richard Kettlewell
  * Portions (C) 2007 Mark Wooding
  *
  * This program is free software: you can redistribute it and/or modify
@@ -25,15 +25,22 @@
  * process that is about to become disorder-normalize) and plays them in the
  * right order.
  *
- * @b Model.  mainloop() implements a select loop awaiting commands from the
+ * @b Model.  mainloop() implements an event loop awaiting commands from the
  * main server, new connections to the speaker socket, and audio data on those
  * connections.  Each connection starts with a queue ID (with a 32-bit
  * native-endian length word), allowing it to be referred to in commands from
- * the server.
+ * the server.  File descriptors are registered with epoll (or, where that is
+ * not available, a persistent poll() array) when they are opened, and a
+ * track's connection is only watched while its buffer has room.
  *
- * Data read on connections is buffered, up to a limit (currently 1Mbyte per
- * track).  No attempt is made here to limit the number of tracks, it is
- * assumed that the main server won't start outrageously many decoders.
+ * Data read on connections is buffered in chunks taken from a shared pool.
+ * A track becomes playable once it has @c speaker_low_water_ms of audio
+ * buffered (or reaches EOF), and tracks other than the playing one are not
+ * buffered any further than that.  The playing track is buffered up to its
+ * own target, which doubles whenever it runs out of data and is halved again
+ * when its decoder keeps well ahead.  The pool is limited to @c
+ * speaker_buffer_mbyte, except that the playing and pending tracks may always
+ * allocate, so that they cannot be starved by tracks that are merely prepared.
  *
  * Audio is supplied from this buffer to the uaudio play callback.  Playback is
  * enabled when a track is to be played and disabled when its last bytes
@@ -41,10 +48,21 @@
  * obvious way.  If the callback finds itself required to play when there is no
  * playing track it returns dead air.
  *
+ * @b Threads.  The callback runs on the backend's audio thread and must never
+ * wait for the main loop, so there is no lock between them.  Each track's
+ * chunks pass to the callback through a single-producer single-consumer ring
+ * (see @ref ring.h) and the main loop returns them to the pool once the
+ * callback has dropped them.  Other state they share is accessed atomically,
+ * and a track the main loop has withdrawn is only destroyed once the callback
+ * cannot still be using it.
+ *
  * To implement gapless playback, the server is notified that a track has
  * finished slightly early.  @ref SM_PLAY is therefore allowed to arrive while
  * the previous track is still playing provided an early @ref SM_FINISHED has
- * been sent for it.
+ * been sent for it.  If the new track has enough data buffered by the time
+ * the previous one runs out, the callback switches to it directly, filling
+ * the rest of the same buffer from it; otherwise the main loop switches
+ * tracks and the gap is measured and reported.
  *
  * @b Encodings.  The encodings supported depend entirely on the uaudio backend
  * chosen.  See @ref uaudio.h, etc.
@@ -67,7 +85,6 @@
  * So (for instance) a 16-bit stereo frame is 4 bytes and consists of a pair of
  * 2-byte samples.
  */
-
 #include "common.h"
 
 #include <getopt.h>
@@ -75,15 +92,15 @@
 #include <syslog.h>
 #include <unistd.h>
 #include <errno.h>
-#include <sys/select.h>
 #include <sys/wait.h>
 #include <time.h>
 #include <fcntl.h>
 #include <poll.h>
 #include <sys/un.h>
 #include <sys/stat.h>
-#include <pthread.h>
-#include <sys/resource.h>
+#if HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
 #include <gcrypt.h>
 
 #include "configuration.h"
@@ -91,14 +108,93 @@
 #include "log.h"
 #include "defs.h"
 #include "mem.h"
+#include "ring.h"
 #include "speaker-protocol.h"
 #include "user.h"
 #include "printf.h"
 #include "version.h"
 #include "uaudio.h"
 
-/** @brief Maximum number of FDs to poll for */
-#define NFDS 1024
+/** @brief Maximum number of ready file descriptors handled per iteration */
+#define NEVENTS 64
+
+/** @brief Size of a buffer chunk */
+#define CHUNK_SIZE 65536
+
+/** @brief Number of free chunks kept for reuse rather than freed */
+#define SPARE_CHUNKS 16
+
+/** @brief Limit on the playing track's buffer target
+ *
+ * Expressed as a multiple of the low-water mark.
+ */
+#define MAX_TARGET 16
+
+/** @brief Seconds between adjustments of the playing track's buffer target */
+#define ADAPT_INTERVAL 10
+
+/** @brief Longest gap between tracks that counts as a handover, in seconds */
+#define MAX_GAP 10
+
+/** @brief A chunk of buffered sample data
+ *
+ * Once a chunk has been put on a track's ring, speaker_fill() only ever
+ * appends to it (updating @ref end) and speaker_callback() only ever consumes
+ * from it (updating @ref start).  Frames may straddle chunks.
+ */
+struct chunk {
+  /** @brief Next chunk in the track's list, or on the free list */
+  struct chunk *next;
+
+  /** @brief Offset of first unplayed byte */
+  size_t start;
+
+  /** @brief Offset after last byte read */
+  size_t end;
+
+  /** @brief Sample data */
+  char data[CHUNK_SIZE];
+};
+
+/** @struct chunk_ring
+ * @brief Chunks passed from the main loop to speaker_callback() */
+RING_TYPE(chunk_ring, struct chunk *);
+
+/** @brief Free chunks
+ *
+ * Only the main loop allocates and frees chunks.
+ */
+static struct chunk *free_chunks;
+
+/** @brief Number of chunks on @ref free_chunks */
+static size_t nfree_chunks;
+
+/** @brief Number of chunks allocated, including free ones */
+static size_t nchunks;
+
+/** @brief Statistics reported to the server
+ *
+ * The underrun and handover fields are updated by speaker_callback(); the
+ * main loop reads them atomically.  The rest belong to the main loop.
+ */
+static struct speaker_stats stats;
+
+/** @brief When the last track ran out, if we are waiting for the next one
+ *
+ * Used to measure the gap between tracks when there is one.  Zero when not
+ * waiting.  Only used by speaker_callback().
+ */
+static struct timespec gap_started;
+
+/** @brief Value of @ref pauses when @ref gap_started was set */
+static unsigned gap_pauses;
+
+/** @brief Number of times the server has paused playback
+ *
+ * A pause between tracks is not a gap, so speaker_callback() uses this to
+ * discard the measurement.
+ */
+static unsigned pauses;
 
 /** @brief Number of bytes before end of track to send SM_FINISHED
  *
@@ -110,6 +206,10 @@ static size_t early_finish;
  *
  * Known tracks are kept in a linked list.  Usually there will be at most two
  * of these but rearranging the queue can cause there to be more.
+ *
+ * Sample data passes from the main loop to speaker_callback() through @ref
+ * chunks.  Fields described as shared are accessed atomically; the rest
+ * belong to the main loop.
  */
 struct track {
   /** @brief Next track */
@@ -121,26 +221,77 @@ struct track {
   /** @brief Track ID */
   char id[24];
 
-  /** @brief Start position of data in buffer */
-  size_t start;
+  /** @brief Chunks available to speaker_callback() */
+  struct chunk_ring chunks;
+
+  /** @brief Chunks put on @ref chunks and not yet reclaimed, oldest first
+   *
+   * Chunks that speaker_callback() has dropped from @ref chunks are returned
+   * to the pool by reclaim().
+   */
+  struct chunk *first;
+
+  /** @brief Last chunk on @ref first's list
+   *
+   * New data is appended to this chunk until it is full.
+   */
+  struct chunk *last;
+
+  /** @brief Number of chunks on @ref first's list */
+  size_t nlisted;
+
+  /** @brief Total bytes made available to speaker_callback() (shared) */
+  size_t pushed;
+
+  /** @brief Total bytes consumed by speaker_callback() (shared) */
+  size_t consumed;
+
+  /** @brief Buffer target in bytes while playing
+   *
+   * 0 until the track starts playing.
+   */
+  size_t target;
+
+  /** @brief Lowest buffer level seen since the target was last adjusted */
+  size_t min_used;
+
+  /** @brief Number of times the track has run out of data (shared) */
+  unsigned underruns;
 
-  /** @brief Number of bytes of data in buffer */
-  size_t used;
+  /** @brief Value of @ref underruns last acted on */
+  unsigned seen_underruns;
 
-  /** @brief Set @c fd is at EOF */
+  /** @brief Set when the track has run out of data before EOF
+   *
+   * Only used by speaker_callback().
+   */
+  int starved;
+
+  /** @brief Set when the track is finished with (shared)
+   *
+   * The main loop destroys such tracks.
+   */
+  int retired;
+
+  /** @brief Set @c fd is at EOF (shared) */
   int eof;
 
-  /** @brief Total number of samples played */
+  /** @brief Total number of samples played (shared) */
   unsigned long long played;
 
-  /** @brief Slot in @ref fds */
-  int slot;
+  /** @brief Set when @c fd is being watched for input */
+  int watching;
+
+  /** @brief Set when @c fd is readable */
+  int ready;
+
+  /** @brief Value of @ref callbacks when the track was buried */
+  unsigned long epoch;
 
-  /** @brief Set when playable
+  /** @brief Set when playable (shared)
    *
-   * A track becomes playable whenever it fills its buffer or reaches EOF; it
-   * stops being playable when it entirely empties its buffer.  Tracks start
-   * out life not playable.
+   * A track becomes playable when it has buffered @c speaker_low_water_ms of
+   * audio or reaches EOF.  Tracks start out life not playable.
    */
   int playable;
 
@@ -151,43 +302,32 @@ struct track {
    * track cannot be paused or cancelled.
    */
   int finished;
-  
-  /** @brief Input buffer
-   *
-   * 1Mbyte is enough for nearly 6s of 44100Hz 16-bit stereo
-   */
-  char buffer[1048576];
 };
 
-/** @brief Lock protecting data structures
- *
- * This lock protects values shared between the main thread and the callback.
- *
- * It is held 'all' the time by the main thread, the exceptions being when
- * called activate/deactivate callbacks and when calling (potentially) slow
- * system calls (in particular poll(), where in fact the main thread will spend
- * most of its time blocked).
- *
- * The callback holds it when it's running.
- */
-static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
-
 /** @brief Linked list of all prepared tracks
  *
  * This includes @ref playing and @ref pending_playing.
  */
 static struct track *tracks;
 
-/** @brief Playing track, or NULL
+/** @brief Tracks waiting to be destroyed
+ *
+ * See bury().
+ */
+static struct track *doomed;
+
+/** @brief Playing track, or NULL (shared)
  *
  * This means the track the speaker process intends to play.  It does not
  * reflect any other state (e.g. activation of uaudio backend).
  *
- * This track remains on @ref track.
+ * This track remains on @ref track.  The main loop sets it to a track it has
+ * taken from @ref pending_playing, or to NULL; speaker_callback() may
+ * switch it directly to the pending track.  See switch_track().
  */
 static struct track *playing;
 
-/** @brief Pending playing track, or NULL
+/** @brief Pending playing track, or NULL (shared)
  *
  * This means the track the server wants the speaker to play.
  *
@@ -195,15 +335,25 @@ static struct track *playing;
  */
 static struct track *pending_playing;
 
-/** @brief Array of file descriptors for poll() */
-static struct pollfd fds[NFDS];
+/** @brief Set while speaker_callback() is running (shared) */
+static int in_callback;
 
-/** @brief Next free slot in @ref fds
- *
- * This is used when filling in the @ref fds array each iteration through the
- * event loop.
- */
-static int fdno;
+/** @brief Number of times speaker_callback() has returned (shared) */
+static unsigned long callbacks;
+
+#if HAVE_SYS_EPOLL_H
+/** @brief epoll instance for the main loop */
+static int epfd;
+#else
+/** @brief File descriptors being watched, for poll() */
+static struct pollfd *fds;
+
+/** @brief Number of entries in use in @ref fds */
+static size_t nfds;
+
+/** @brief Number of entries allocated in @ref fds */
+static size_t fds_size;
+#endif
 
 /** @brief Listen socket */
 static int listenfd;
@@ -211,13 +361,13 @@ static int listenfd;
 /** @brief Timestamp of last potential report to server */
 static time_t last_report;
 
-/** @brief Set when paused */
+/** @brief Set when paused (shared) */
 static int paused;
 
 /** @brief Set when back end activated */
 static int activated;
 
-/** @brief Signal pipe back into the poll() loop */
+/** @brief Signal pipe back into the main loop */
 static int sigpipe[2];
 
 /** @brief Selected backend */
@@ -251,6 +401,213 @@ static void attribute((noreturn)) help(void) {
   exit(0);
 }
 
+/** @brief Return the number of bytes in one frame */
+static inline size_t frame_size(void) {
+  return uaudio_sample_size * uaudio_channels;
+}
+
+/** @brief Convert a byte count to milliseconds of audio */
+static uint32_t bytes_to_ms(size_t bytes) {
+  return (unsigned long long)bytes * 1000 / (frame_size() * uaudio_rate);
+}
+
+/** @brief Return the low-water mark in bytes
+ *
+ * This is @c speaker_low_water_ms rounded to a whole number of frames.
+ */
+static size_t low_water(void) {
+  size_t bytes = (unsigned long long)config->speaker_low_water_ms
+    * uaudio_rate / 1000 * frame_size();
+
+  return bytes ? bytes : frame_size();
+}
+
+/** @brief Return the playing track */
+static inline struct track *get_playing(void) {
+  return __atomic_load_n(&playing, __ATOMIC_SEQ_CST);
+}
+
+/** @brief Return the pending playing track */
+static inline struct track *get_pending(void) {
+  return __atomic_load_n(&pending_playing, __ATOMIC_SEQ_CST);
+}
+
+/** @brief Return the number of bytes buffered for track @p t
+ *
+ * Safe to call from either thread.
+ */
+static inline size_t used(struct track *t) {
+  return __atomic_load_n(&t->pushed, __ATOMIC_ACQUIRE)
+    - __atomic_load_n(&t->consumed, __ATOMIC_ACQUIRE);
+}
+
+/** @brief Return nonzero if track @p t has no more data to play
+ *
+ * Safe to call from either thread.
+ */
+static inline int drained(struct track *t) {
+  return __atomic_load_n(&t->eof, __ATOMIC_ACQUIRE) && !used(t);
+}
+
+/** @brief Return the number of bytes track @p t may buffer */
+static size_t buffer_limit(const struct track *t) {
+  return t == get_playing() && t->target ? t->target : low_water();
+}
+
+/** @brief Return nonzero if track @p t may allocate beyond the pool limit */
+static int priority(const struct track *t) {
+  return t == get_playing() || t == get_pending();
+}
+
+/** @brief Return nonzero if a chunk is available for track @p t */
+static int chunk_available(const struct track *t) {
+  return free_chunks
+    || priority(t)
+    || (nchunks + 1) * sizeof (struct chunk)
+         <= (size_t)config->speaker_buffer_mbyte << 20;
+}
+
+/** @brief Get a chunk for track @p t
+ * @return Empty chunk or NULL if the pool is exhausted
+ */
+static struct chunk *chunk_get(const struct track *t) {
+  struct chunk *c;
+
+  if(free_chunks) {
+    c = free_chunks;
+    free_chunks = c->next;
+    --nfree_chunks;
+  } else if(chunk_available(t)) {
+    c = xmalloc_noptr(sizeof *c);
+    ++nchunks;
+    if(nchunks * sizeof *c / 1024 > stats.pool_peak_kbytes)
+      stats.pool_peak_kbytes = nchunks * sizeof *c / 1024;
+  } else
+    return NULL;
+  c->next = NULL;
+  c->start = c->end = 0;
+  return c;
+}
+
+/** @brief Return a chunk to the pool */
+static void chunk_put(struct chunk *c) {
+  if(nfree_chunks < SPARE_CHUNKS) {
+    c->next = free_chunks;
+    free_chunks = c;
+    ++nfree_chunks;
+  } else {
+    free(c);
+    --nchunks;
+  }
+}
+
+/** @brief Return chunks that speaker_callback() has finished with to the pool
+ * @param t Track
+ *
+ * Chunks are consumed in order, so those no longer on the ring are the oldest
+ * ones on the track's list.
+ */
+static void reclaim(struct track *t) {
+  struct chunk *c;
+
+  while(t->nlisted > chunk_ring_count(&t->chunks)) {
+    c = t->first;
+    if(!(t->first = c->next))
+      t->last = NULL;
+    --t->nlisted;
+    chunk_put(c);
+  }
+}
+
+/** @brief Return nonzero if we want to read data for track @p t */
+static int wants_data(struct track *t) {
+  return t->fd >= 0
+    && !t->eof
+    && used(t) < buffer_limit(t)
+    && ((t->last && t->last->end < CHUNK_SIZE)
+        || (chunk_ring_count(&t->chunks) <= t->chunks.mask
+            && chunk_available(t)));
+}
+
+/** @brief Start watching @p fd for input */
+static void watch(int fd) {
+#if HAVE_SYS_EPOLL_H
+  struct epoll_event ev;
+
+  memset(&ev, 0, sizeof ev);
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if(epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+    disorder_fatal(errno, "error calling epoll_ctl");
+#else
+  if(nfds == fds_size) {
+    fds_size = fds_size ? 2 * fds_size : 16;
+    fds = xrealloc(fds, fds_size * sizeof *fds);
+  }
+  fds[nfds].fd = fd;
+  fds[nfds].events = POLLIN;
+  ++nfds;
+#endif
+}
+
+/** @brief Stop watching @p fd */
+static void unwatch(int fd) {
+#if HAVE_SYS_EPOLL_H
+  if(epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL) < 0)
+    disorder_fatal(errno, "error calling epoll_ctl");
+#else
+  size_t n;
+
+  for(n = 0; n < nfds && fds[n].fd != fd; ++n)
+    ;
+  if(n < nfds)
+    fds[n] = fds[--nfds];
+#endif
+}
+
+/** @brief Wait for watched file descriptors to become readable
+ * @param ready Where to store up to @ref NEVENTS readable file descriptors
+ * @param timeout Timeout in milliseconds
+ * @return Number of readable file descriptors, or -1 on error
+ *
+ * Hangups and errors count as readable.
+ */
+static int wait_input(int *ready, int timeout) {
+#if HAVE_SYS_EPOLL_H
+  struct epoll_event events[NEVENTS];
+  int n, i;
+
+  if((n = epoll_wait(epfd, events, NEVENTS, timeout)) < 0)
+    return -1;
+  for(i = 0; i < n; ++i)
+    ready[i] = events[i].data.fd;
+  return n;
+#else
+  size_t i;
+  int n;
+
+  if(poll(fds, nfds, timeout) < 0)
+    return -1;
+  for(i = 0, n = 0; i < nfds && n < NEVENTS; ++i)
+    if(fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+      ready[n++] = fds[i].fd;
+  return n;
+#endif
+}
+
+/** @brief Watch or stop watching track @p t according to its buffer state */
+static void update_watch(struct track *t) {
+  const int want = wants_data(t);
+
+  if(want != t->watching) {
+    if(want)
+      watch(t->fd);
+    else
+      unwatch(t->fd);
+    t->watching = want;
+  }
+}
+
 /** @brief Find track @p id, maybe creating it if not found
  * @param id Track ID to find
  * @param create If nonzero, create track structure of @p id if not found
@@ -258,6 +615,7 @@ static void attribute((noreturn)) help(void) {
  */
 static struct track *findtrack(const char *id, int create) {
   struct track *t;
+  size_t size = 1;
 
   D(("findtrack %s %d", id, create));
   for(t = tracks; t && strcmp(id, t->id); t = t->next)
@@ -267,11 +625,28 @@ static struct track *findtrack(const char *id, int create) {
     t->next = tracks;
     strcpy(t->id, id);
     t->fd = -1;
+    /* Enough ring slots for the largest buffer target, allowing for partly
+     * used chunks at either end */
+    while(size < MAX_TARGET * low_water() / CHUNK_SIZE + 2)
+      size *= 2;
+    chunk_ring_init(&t->chunks, size);
     tracks = t;
   }
   return t;
 }
 
+/** @brief Find the track reading from @p fd
+ * @param fd File descriptor
+ * @return Pointer to track structure or NULL
+ */
+static struct track *findfd(int fd) {
+  struct track *t;
+
+  for(t = tracks; t && t->fd != fd; t = t->next)
+    ;
+  return t;
+}
+
 /** @brief Remove track @p id (but do not destroy it)
  * @param id Track ID to remove
  * @return Track structure or NULL if not found
@@ -291,12 +666,81 @@ static struct track *removetrack(const char *id) {
  * @param t Track structure
  */
 static void destroy(struct track *t) {
+  struct chunk *c;
+
   D(("destroy %s", t->id));
-  if(t->fd != -1)
-    xclose(t->fd);
+  while((c = t->first)) {
+    t->first = c->next;
+    chunk_put(c);
+  }
+  free(t->chunks.vec);
   free(t);
 }
 
+/** @brief Return nonzero if speaker_callback() cannot be using buried track
+ * @p t */
+static int unreachable(const struct track *t) {
+  return !__atomic_load_n(&in_callback, __ATOMIC_SEQ_CST)
+    || __atomic_load_n(&callbacks, __ATOMIC_SEQ_CST) != t->epoch;
+}
+
+/** @brief Dispose of a track
+ * @param t Track, already removed from @ref tracks
+ *
+ * The track must no longer be @ref playing or @ref pending_playing.  If
+ * speaker_callback() is running it may still be using it, so destruction is
+ * deferred until it has returned.
+ */
+static void bury(struct track *t) {
+  if(t->fd != -1) {
+    if(t->watching)
+      unwatch(t->fd);
+    xclose(t->fd);
+    t->fd = -1;
+  }
+  t->epoch = __atomic_load_n(&callbacks, __ATOMIC_SEQ_CST);
+  if(unreachable(t))
+    destroy(t);
+  else {
+    t->next = doomed;
+    doomed = t;
+  }
+}
+
+/** @brief Destroy buried tracks that speaker_callback() has finished with */
+static void cremate(void) {
+  struct track *t, **tt;
+
+  for(tt = &doomed; (t = *tt);) {
+    if(unreachable(t)) {
+      *tt = t->next;
+      destroy(t);
+    } else
+      tt = &t->next;
+  }
+}
+
+/** @brief Stop playing track @p t
+ * @param t Track to withdraw
+ * @return Nonzero if @p t was playing or pending
+ *
+ * speaker_callback() may switch from the playing track to the pending one at
+ * any moment; see switch_track() for why this covers that case.
+ */
+static int unpublish(struct track *t) {
+  struct track *expected = t;
+  int rc = 0;
+
+  if(__atomic_compare_exchange_n(&pending_playing, &expected, NULL, 0,
+                                 __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+    rc = 1;
+  expected = t;
+  if(__atomic_compare_exchange_n(&playing, &expected, NULL, 0,
+                                 __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+    rc = 1;
+  return rc;
+}
+
 /** @brief Read data into a sample buffer
  * @param t Pointer to track
  * @return 0 on success, -1 on EOF
@@ -308,55 +752,96 @@ static void destroy(struct track *t) {
  * Errors count as EOF.
  */
 static int speaker_fill(struct track *t) {
-  size_t where, left;
-  int n, rc;
+  struct chunk *c;
+  size_t partial, level = used(t);
+  int n, rc, fresh = 0;
 
   D(("fill %s: eof=%d used=%zu",
-     t->id, t->eof, t->used));
+     t->id, t->eof, level));
   if(t->eof)
     return -1;
-  if(t->used < sizeof t->buffer) {
-    /* there is room left in the buffer */
-    where = (t->start + t->used) % sizeof t->buffer;
-    /* Get as much data as we can */
-    if(where >= t->start)
-      left = (sizeof t->buffer) - where;
+  if(level >= buffer_limit(t))
+    return 0;
+  if(t->target && level < t->min_used)
+    t->min_used = level;
+  reclaim(t);
+  if(!(c = t->last) || c->end == CHUNK_SIZE) {
+    /* We need a new chunk */
+    if(chunk_ring_count(&t->chunks) > t->chunks.mask
+       || !(c = chunk_get(t)))
+      return 0;
+    fresh = 1;
+  }
+  /* Get as much data as we can.  speaker_callback() may be consuming from
+   * this chunk meanwhile but it never reads beyond c->end. */
+  do {
+    n = read(t->fd, c->data + c->end, CHUNK_SIZE - c->end);
+  } while(n < 0 && errno == EINTR);
+  if(n < 0 && errno == EAGAIN) {
+    /* EAGAIN means more later */
+    if(fresh)
+      chunk_put(c);
+    rc = 0;
+  } else if(n <= 0) {
+    /* n=0 means EOF.  n<0 means some error occurred.  We log the error but
+     * otherwise treat it as identical to EOF. */
+    if(n < 0)
+      disorder_error(errno, "error reading sample stream for %s", t->id);
     else
-      left = t->start - where;
-    pthread_mutex_unlock(&lock);
-    do {
-      n = read(t->fd, t->buffer + where, left);
-    } while(n < 0 && errno == EINTR);
-    pthread_mutex_lock(&lock);
-    if(n < 0 && errno == EAGAIN) {
-      /* EAGAIN means more later */
-      rc = 0;
-    } else if(n <= 0) {
-      /* n=0 means EOF.  n<0 means some error occurred.  We log the error but
-       * otherwise treat it as identical to EOF. */
-      if(n < 0)
-        disorder_error(errno, "error reading sample stream for %s", t->id);
+      D(("fill %s: eof detected", t->id));
+    if(fresh)
+      chunk_put(c);
+    /* Discard any partial frame at the end; it could never be played.
+     * speaker_callback() only consumes whole frames so it can't have started
+     * on it. */
+    if((partial = t->pushed % frame_size()))
+      __atomic_store_n(&t->pushed, t->pushed - partial, __ATOMIC_RELEASE);
+    __atomic_store_n(&t->eof, 1, __ATOMIC_RELEASE);
+    /* A track always becomes playable at EOF; we're not going to see any
+     * more data. */
+    __atomic_store_n(&t->playable, 1, __ATOMIC_RELEASE);
+    rc = -1;
+  } else {
+    if(fresh) {
+      c->end = n;
+      if(t->last)
+        t->last->next = c;
       else
-        D(("fill %s: eof detected", t->id));
-      t->eof = 1;
-      /* A track always becomes playable at EOF; we're not going to see any
-       * more data. */
-      t->playable = 1;
-      rc = -1;
-    } else {
-      t->used += n;
-      /* A track becomes playable when it (first) fills its buffer.  For
-       * 44.1KHz 16-bit stereo this is ~6s of audio data.  The latency will
-       * depend how long that takes to decode (hopefuly not very!) */
-      if(t->used == sizeof t->buffer)
-        t->playable = 1;
-      rc = 0;
-    }
-  } else
+        t->first = c;
+      t->last = c;
+      ++t->nlisted;
+      chunk_ring_put(&t->chunks, c);
+    } else
+      __atomic_store_n(&c->end, c->end + n, __ATOMIC_RELEASE);
+    __atomic_store_n(&t->pushed, t->pushed + n, __ATOMIC_RELEASE);
+    /* A track becomes playable when it has enough data buffered.  The latency
+     * will depend how long that takes to decode (hopefuly not very!) */
+    if(used(t) >= low_water())
+      __atomic_store_n(&t->playable, 1, __ATOMIC_RELEASE);
     rc = 0;
+  }
   return rc;
 }
 
+/** @brief Adjust the playing track's buffer target
+ *
+ * Called every @ref ADAPT_INTERVAL seconds.  If the buffer never dropped below
+ * half its target over the interval then the decoder is keeping well ahead
+ * and the target is halved, down to twice the low-water mark.  Growth happens
+ * in mainloop() when speaker_callback() reports that the track ran out of
+ * data.
+ */
+static void adapt(void) {
+  struct track *const p = get_playing();
+
+  if(!p || !p->target)
+    return;
+  if(p->min_used >= p->target / 2
+     && p->target / 2 >= 2 * low_water())
+    p->target /= 2;
+  p->min_used = used(p);
+}
+
 /** @brief Return nonzero if we want to play some audio
  *
  * We want to play audio if there is a current track; and it is not paused; and
@@ -370,41 +855,169 @@ static int speaker_fill(struct track *t) {
  * its start.
  */
 static int playable(void) {
-  return playing
-         && (!paused || playing->finished)
-         && playing->playable;
+  struct track *const p = get_playing();
+
+  return p
+         && (!paused || p->finished)
+         && p->playable;
 }
 
 /** @brief Notify the server what we're up to */
 static void report(void) {
   struct speaker_message sm;
+  struct track *const p = get_playing();
 
-  if(playing) {
+  if(p) {
     /* Had better not send a report for a track that the server thinks has
      * finished, that would be confusing. */
-    if(playing->finished)
+    if(p->finished)
       return;
     memset(&sm, 0, sizeof sm);
     sm.type = paused ? SM_PAUSED : SM_PLAYING;
-    strcpy(sm.u.id, playing->id);
-    sm.data = playing->played / (uaudio_rate * uaudio_channels);
+    strcpy(sm.u.id, p->id);
+    sm.data = __atomic_load_n(&p->played, __ATOMIC_RELAXED)
+      / (uaudio_rate * uaudio_channels);
     speaker_send(1, &sm);
     xtime(&last_report);
   }
 }
 
-/** @brief Add a file descriptor to the set to poll() for
- * @param fd File descriptor
- * @param events Events to wait for e.g. @c POLLIN
- * @return Slot number
- */
-static int addfd(int fd, int events) {
-  if(fdno < NFDS) {
-    fds[fdno].fd = fd;
-    fds[fdno].events = events;
-    return fdno++;
-  } else
+/** @brief Send statistics to the server */
+static void report_stats(void) {
+  struct speaker_message sm;
+  struct track *t, *const p = get_playing();
+  size_t buffered = 0;
+
+  memset(&sm, 0, sizeof sm);
+  sm.type = SM_STATS;
+  for(t = tracks; t; t = t->next) {
+    ++sm.u.stats.tracks;
+    buffered += used(t);
+  }
+  sm.u.stats.buffered_kbytes = buffered / 1024;
+  if(p) {
+    sm.u.stats.buffered_ms = bytes_to_ms(used(p));
+    sm.u.stats.target_ms = bytes_to_ms(buffer_limit(p));
+  }
+  sm.u.stats.pool_kbytes = nchunks * sizeof (struct chunk) / 1024;
+  sm.u.stats.pool_peak_kbytes = stats.pool_peak_kbytes;
+  sm.u.stats.underruns = __atomic_load_n(&stats.underruns, __ATOMIC_RELAXED);
+  sm.u.stats.underrun_ms = __atomic_load_n(&stats.underrun_ms,
+                                           __ATOMIC_RELAXED);
+  sm.u.stats.handovers = __atomic_load_n(&stats.handovers, __ATOMIC_RELAXED);
+  sm.u.stats.gapless_handovers = __atomic_load_n(&stats.gapless_handovers,
+                                                 __ATOMIC_RELAXED);
+  sm.u.stats.last_gap_samples = __atomic_load_n(&stats.last_gap_samples,
+                                                __ATOMIC_RELAXED);
+  if(backend->stats)
+    backend->stats(&sm.u.stats.backend);
+  speaker_send(1, &sm);
+}
+
+/** @brief Take data from a track
+ * @param t Track to take data from
+ * @param buffer Where to put sample data
+ * @param max_bytes Maximum number of bytes to take
+ * @return Number of bytes taken (always a whole number of frames)
+ *
+ * Called from speaker_callback().
+ */
+static size_t take(struct track *t, char *buffer, size_t max_bytes) {
+  size_t avail, want, bytes, end, done = 0;
+  struct chunk *c;
+
+  /* Only supply whole frames */
+  avail = used(t);
+  want = avail - avail % frame_size();
+  if(want > max_bytes)
+    want = max_bytes;
+  while(done < want) {
+    c = *chunk_ring_peek(&t->chunks);
+    end = __atomic_load_n(&c->end, __ATOMIC_ACQUIRE);
+    bytes = end - c->start;
+    if(bytes > want - done)
+      bytes = want - done;
+    memcpy(buffer + done, c->data + c->start, bytes);
+    c->start += bytes;
+    done += bytes;
+    /* Hand used-up chunks back, unless speaker_fill() might yet append to
+     * them */
+    if(c->start == end
+       && (end == CHUNK_SIZE || chunk_ring_count(&t->chunks) > 1))
+      chunk_ring_drop(&t->chunks);
+  }
+  if(done) {
+    t->starved = 0;
+    __atomic_store_n(&t->consumed, t->consumed + done, __ATOMIC_RELEASE);
+    __atomic_store_n(&t->played, t->played + done / uaudio_sample_size,
+                     __ATOMIC_RELAXED);
+  }
+  return done;
+}
+
+/** @brief Wake up the main loop */
+static void wake(void) {
+  int ignored = write(sigpipe[1], "", 1);
+  (void) ignored;
+}
+
+/** @brief Return nonzero if we are measuring a gap between tracks */
+static int in_gap(void) {
+  return gap_started.tv_sec || gap_started.tv_nsec;
+}
+
+/** @brief Record a handover to a new track
+ *
+ * Called from speaker_callback() when it first supplies data from a track
+ * that followed on from another.
+ */
+static void handover(void) {
+  struct timespec now;
+  double gap;
+
+  if(in_gap()) {
+    xgettime(CLOCK_MONOTONIC, &now);
+    gap = (now.tv_sec - gap_started.tv_sec)
+      + (now.tv_nsec - gap_started.tv_nsec) / 1e9;
+    gap_started.tv_sec = gap_started.tv_nsec = 0;
+    /* A pause between tracks is not a gap; and much longer than this and it's
+     * not a handover, the queue just ran dry */
+    if(gap_pauses != __atomic_load_n(&pauses, __ATOMIC_RELAXED)
+       || gap >= MAX_GAP)
+      return;
+    __atomic_store_n(&stats.last_gap_samples, gap * uaudio_rate,
+                     __ATOMIC_RELAXED);
+  } else {
+    __atomic_store_n(&stats.last_gap_samples, 0, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&stats.gapless_handovers, 1, __ATOMIC_RELAXED);
+  }
+  __atomic_add_fetch(&stats.handovers, 1, __ATOMIC_RELAXED);
+}
+
+/** @brief Switch from playing track @p t to pending track @p next
+ * @return 0 on success, -1 if the main loop withdrew either track
+ *
+ * Called from speaker_callback().  @ref playing is switched before @ref
+ * pending_playing is cleared, so a track is never in neither.  If the main
+ * loop withdraws @p next in the meantime (see unpublish()) then whichever
+ * thread gets there second clears @ref playing.
+ */
+static int switch_track(struct track *t, struct track *next) {
+  struct track *expected = t;
+
+  if(!__atomic_compare_exchange_n(&playing, &expected, next, 0,
+                                  __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+    return -1;
+  __atomic_store_n(&t->retired, 1, __ATOMIC_SEQ_CST);
+  expected = next;
+  if(!__atomic_compare_exchange_n(&pending_playing, &expected, NULL, 0,
+                                  __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+    expected = next;
+    __atomic_compare_exchange_n(&playing, &expected, NULL, 0,
+                                __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
     return -1;
+  }
+  return 0;
 }
 
 /** @brief Callback to return some sampled data
@@ -414,119 +1027,128 @@ static int addfd(int fd, int events) {
  * @return Number of samples written
  *
  * See uaudio_callback().
+ *
+ * This runs on the audio thread and never blocks: it takes no locks, makes no
+ * potentially slow system calls, and allocates and frees nothing.  Tracks
+ * may be withdrawn by the main loop while it runs, but are not destroyed
+ * until it returns; see bury().
  */
 static size_t speaker_callback(void *buffer,
                                size_t max_samples,
                                void attribute((unused)) *userdata) {
   size_t max_bytes = max_samples * uaudio_sample_size;
-  size_t provided_samples = 0;
+  size_t provided_samples = 0, done = 0;
+  struct track *t, *next;
 
   /* Be sure to keep the amount of data in a buffer a whole number of frames:
    * otherwise the playing threads can become stuck. */
-  max_bytes -= max_bytes % (uaudio_sample_size * uaudio_channels);
+  max_bytes -= max_bytes % frame_size();
 
-  pthread_mutex_lock(&lock);
+  __atomic_store_n(&in_callback, 1, __ATOMIC_SEQ_CST);
   /* TODO perhaps we should immediately go silent if we've been asked to pause
    * or cancel the playing track (maybe block in the cancel case and see what
    * else turns up?) */
-  if(playing) {
-    if(playing->used > 0) {
-      size_t bytes;
-      /* Compute size of largest contiguous chunk.  We get called as often as
-       * necessary so there's no need for cleverness here. */
-      if(playing->start + playing->used > sizeof playing->buffer)
-        bytes = sizeof playing->buffer - playing->start;
-      else
-        bytes = playing->used;
-      /* Limit to what we were asked for */
-      if(bytes > max_bytes)
-        bytes = max_bytes;
-      /* And truncate to a whole number of frames. */
-      bytes -= bytes % (uaudio_sample_size * uaudio_channels);
-      /* Provide it */
-      memcpy(buffer, playing->buffer + playing->start, bytes);
-      playing->start += bytes;
-      playing->used -= bytes;
-      /* Wrap around to start of buffer */
-      if(playing->start == sizeof playing->buffer)
-        playing->start = 0;
+  if((t = get_playing())) {
+    /* The main loop switched tracks after a gap */
+    if(!t->played && used(t) && in_gap())
+      handover();
+    done = take(t, buffer, max_bytes);
+    /* If the track has run out and the next one is ready, switch to it
+     * immediately.  The server must already have been sent SM_FINISHED for the
+     * outgoing track, or it wouldn't have sent SM_PLAY for the next one. */
+    while(drained(t)
+          && (next = get_pending())
+          && __atomic_load_n(&next->playable, __ATOMIC_ACQUIRE)
+          && !__atomic_load_n(&paused, __ATOMIC_RELAXED)
+          && !switch_track(t, next)) {
+      t = next;
+      handover();
+      done += take(t, (char *)buffer + done, max_bytes - done);
+      wake();
+    }
+    if(drained(t)) {
       /* See if we've reached the end of the track; if so make sure the event
        * loop wakes up. */
-      if(playing->used == 0 && playing->eof) {
-        int ignored = write(sigpipe[1], "", 1);
-        (void) ignored;
+      if(done)
+        wake();
+      /* If we've run out of data, the next track is late */
+      if(done < max_bytes && !in_gap()) {
+        xgettime(CLOCK_MONOTONIC, &gap_started);
+        gap_pauses = __atomic_load_n(&pauses, __ATOMIC_RELAXED);
       }
-      provided_samples = bytes / uaudio_sample_size;
-      playing->played += provided_samples;
     }
+    provided_samples = done / uaudio_sample_size;
   }
   /* If we couldn't provide anything at all, play dead air */
   /* TODO maybe it would be better to block, in some cases? */
   if(!provided_samples) {
     memset(buffer, 0, max_bytes);
     provided_samples = max_samples;
-    if(playing)
-      disorder_info("%zu samples silence, playing->used=%zu",
-                    provided_samples, playing->used);
-    else
-      disorder_info("%zu samples silence, playing=NULL", provided_samples);
+    if(t
+       && __atomic_load_n(&t->playable, __ATOMIC_ACQUIRE)
+       && !__atomic_load_n(&t->eof, __ATOMIC_ACQUIRE)) {
+      /* The decoder has fallen behind.  Count the underrun; the main loop
+       * will buffer further ahead from now on. */
+      if(!t->starved) {
+        t->starved = 1;
+        __atomic_add_fetch(&t->underruns, 1, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&stats.underruns, 1, __ATOMIC_RELAXED);
+        wake();
+      }
+      __atomic_add_fetch(&stats.underrun_ms, bytes_to_ms(max_bytes),
+                         __ATOMIC_RELAXED);
+    }
   }
-  pthread_mutex_unlock(&lock);
+  __atomic_add_fetch(&callbacks, 1, __ATOMIC_SEQ_CST);
+  __atomic_store_n(&in_callback, 0, __ATOMIC_SEQ_CST);
   return provided_samples;
 }
 
 /** @brief Main event loop */
 static void mainloop(void) {
-  struct track *t;
+  struct track *t, *p, *next;
   struct speaker_message sm;
-  int n, fd, stdin_slot, timeout, listen_slot, sigpipe_slot;
+  int n, i, fd, ready[NEVENTS];
+  int command_ready, listen_ready;
+  unsigned underruns;
+  time_t now, last_stats = 0, last_adapt = 0;
 
-  pthread_mutex_lock(&lock);
+  /* Always ready for commands from the main server and for inbound
+   * connections, and allow the wait to be interrupted by
+   * speaker_callback() */
+  watch(0);
+  watch(listenfd);
+  watch(sigpipe[0]);
   /* Keep going while our parent process is alive */
   while(getppid() != 1) {
     int force_report = 0;
 
-    fdno = 0;
-    /* By default we will wait up to half a second before thinking about
-     * current state. */
-    timeout = 500;
-    /* Always ready for commands from the main server. */
-    stdin_slot = addfd(0, POLLIN);
-    /* Also always ready for inbound connections */
-    listen_slot = addfd(listenfd, POLLIN);
-    /* Try to read sample data for the currently playing track if there is
-     * buffer space. */
-    if(playing
-       && playing->fd >= 0
-       && !playing->eof
-       && playing->used < (sizeof playing->buffer))
-      playing->slot = addfd(playing->fd, POLLIN);
-    else if(playing)
-      playing->slot = -1;
-    /* Allow the poll() to be interrupted at the end of a track */
-    sigpipe_slot = addfd(sigpipe[0], POLLIN);
-    /* If any other tracks don't have a full buffer, try to read sample data
-     * from them.  We do this last of all, so that if we run out of slots,
-     * nothing important can't be monitored. */
-    for(t = tracks; t; t = t->next)
-      if(t != playing) {
-        if(t->fd >= 0
-           && !t->eof
-           && t->used < sizeof t->buffer) {
-          t->slot = addfd(t->fd,  POLLIN | POLLHUP);
-        } else
-          t->slot = -1;
-      }
-    /* Wait for something interesting to happen */
-    pthread_mutex_unlock(&lock);
-    n = poll(fds, fdno, timeout);
-    pthread_mutex_lock(&lock);
+    /* Wait for something interesting to happen, or up to half a second before
+     * thinking about current state.  Track file descriptors are only watched
+     * while their buffers have space; see update_watch(). */
+    n = wait_input(ready, 500);
     if(n < 0) {
       if(errno == EINTR) continue;
-      disorder_fatal(errno, "error calling poll");
+      disorder_fatal(errno, "error waiting for input");
+    }
+    command_ready = listen_ready = 0;
+    for(i = 0; i < n; ++i) {
+      if(ready[i] == 0)
+        command_ready = 1;
+      else if(ready[i] == listenfd)
+        listen_ready = 1;
+      else if(ready[i] == sigpipe[0]) {
+        /* Drain the signal pipe.  We don't care about its contents, merely
+         * that it interrupted the wait. */
+        char buffer[64];
+        int ignored; (void)ignored;
+
+        ignored = read(sigpipe[0], buffer, sizeof buffer);
+      } else if((t = findfd(ready[i])))
+        t->ready = 1;
     }
     /* Perhaps a connection has arrived */
-    if(fds[listen_slot].revents & POLLIN) {
+    if(listen_ready) {
       struct sockaddr_un addr;
       socklen_t addrlen = sizeof addr;
       uint32_t l;
@@ -570,10 +1192,10 @@ static void mainloop(void) {
         disorder_error(errno, "accept");
     }
     /* Perhaps we have a command to process */
-    if(fds[stdin_slot].revents & POLLIN) {
+    if(command_ready) {
       /* There might (in theory) be several commands queued up, but in general
        * this won't be the case, so we don't bother looping around to pick them
-       * all up. */ 
+       * all up. */
       n = speaker_recv(0, &sm);
       if(n > 0)
         /* As a rule we don't send success replies to most commands - we just
@@ -583,14 +1205,14 @@ static void mainloop(void) {
 	case SM_PLAY:
           /* SM_PLAY is only allowed if the server reasonably believes that
            * nothing is playing */
-          if(playing) {
+          if((p = get_playing())) {
             /* If finished isn't set then the server can't believe that this
              * track has finished */
-            if(!playing->finished)
+            if(!p->finished)
               disorder_fatal(0, "got SM_PLAY but already playing something");
             /* If pending_playing is set then the server must believe that that
              * is playing */
-            if(pending_playing)
+            if(get_pending())
               disorder_fatal(0, "got SM_PLAY but have a pending playing track");
           }
 	  t = findtrack(sm.u.id, 1);
@@ -606,34 +1228,32 @@ static void mainloop(void) {
            * just sit around sending silence until the decoder connects and
            * starts sending some sample data.  But is is annoying and ought to
            * be fixed. */
-          pending_playing = t;
+          __atomic_store_n(&pending_playing, t, __ATOMIC_SEQ_CST);
           /* If nothing is currently playing then we'll switch to the pending
            * track below so there's no point distinguishing the situations
            * here. */
 	  break;
 	case SM_PAUSE:
           D(("SM_PAUSE"));
-	  paused = 1;
+          __atomic_store_n(&paused, 1, __ATOMIC_RELAXED);
+          /* A pause between tracks is not a gap */
+          __atomic_add_fetch(&pauses, 1, __ATOMIC_RELAXED);
           force_report = 1;
           break;
 	case SM_RESUME:
           D(("SM_RESUME"));
-          paused = 0;
+          __atomic_store_n(&paused, 0, __ATOMIC_RELAXED);
           force_report = 1;
 	  break;
 	case SM_CANCEL:
           D(("SM_CANCEL %s", sm.u.id));
 	  t = removetrack(sm.u.id);
 	  if(t) {
-	    if(t == playing || t == pending_playing) {
+	    if(unpublish(t)) {
               /* Scratching the track that the server believes is playing,
                * which might either be the actual playing track or a pending
                * playing track */
               sm.type = SM_FINISHED;
-              if(t == playing)
-                playing = 0;
-              else
-                pending_playing = 0;
             } else {
               /* Could be scratching the playing track before it's quite got
                * going, or could be just removing a track from the queue.  We
@@ -644,7 +1264,7 @@ static void mainloop(void) {
               sm.type = SM_STILLBORN;
             }
             strcpy(sm.u.id, t->id);
-	    destroy(t);
+	    bury(t);
 	  } else {
             /* Probably scratching the playing track well before it's got
              * going, but could indicate a bug, so we log this as an error. */
@@ -675,68 +1295,97 @@ static void mainloop(void) {
     }
     /* Read in any buffered data */
     for(t = tracks; t; t = t->next)
-      if(t->fd != -1
-         && t->slot != -1
-         && (fds[t->slot].revents & (POLLIN | POLLHUP)))
-         speaker_fill(t);
-    /* Drain the signal pipe.  We don't care about its contents, merely that it
-     * interrupted poll(). */
-    if(fds[sigpipe_slot].revents & POLLIN) {
-      char buffer[64];
-      int ignored; (void)ignored;
-
-      ignored = read(sigpipe[0], buffer, sizeof buffer);
-    }
+      if(t->ready) {
+        t->ready = 0;
+        speaker_fill(t);
+      }
     /* Send SM_FINISHED when we're near the end of the track.
      *
      * This is how we implement gapless play; we hope that the SM_PLAY from the
      * server arrives before the remaining bytes of the track play out.
      */
-    if(playing
-       && playing->eof
-       && !playing->finished
-       && playing->used <= early_finish) {
+    if((p = get_playing())
+       && p->eof
+       && !p->finished
+       && used(p) <= early_finish) {
       memset(&sm, 0, sizeof sm);
       sm.type = SM_FINISHED;
-      strcpy(sm.u.id, playing->id);
+      strcpy(sm.u.id, p->id);
       speaker_send(1, &sm);
-      playing->finished = 1;
+      p->finished = 1;
     }
-    /* When the track is actually finished, deconfigure it */
-    if(playing && playing->eof && !playing->used) {
-      if(!playing->finished) {
+    /* When the track is actually finished, deconfigure it.  If
+     * speaker_callback() has already switched to the next track then it has
+     * retired this one itself. */
+    if((p = get_playing()) && drained(p)) {
+      if(!p->finished) {
         /* should never happen but we'd like to know if it does */
         disorder_fatal(0, "track finish state inconsistent");
       }
-      removetrack(playing->id);
-      destroy(playing);
-      playing = 0;
+      if(__atomic_compare_exchange_n(&playing, &p, NULL, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+        p->retired = 1;
+    }
+    /* Destroy tracks that have finished, including any that the callback
+     * switched away from */
+    for(t = tracks; t; t = next) {
+      next = t->next;
+      if(__atomic_load_n(&t->retired, __ATOMIC_SEQ_CST)
+         && t != get_playing()) {
+        removetrack(t->id);
+        bury(t);
+        force_report = 1;
+      }
     }
+    cremate();
     /* Act on the pending SM_PLAY */
-    if(!playing && pending_playing) {
-      playing = pending_playing;
-      pending_playing = 0;
+    if(!get_playing() && (p = get_pending())
+       && __atomic_compare_exchange_n(&pending_playing, &p, NULL, 0,
+                                      __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+      __atomic_store_n(&playing, p, __ATOMIC_SEQ_CST);
       force_report = 1;
     }
+    if((p = get_playing())) {
+      /* A newly playing track, however it started, gets an initial target */
+      if(!p->target) {
+        p->target = 2 * low_water();
+        p->min_used = used(p);
+      }
+      /* If it has run out of data, buffer further ahead from now on */
+      underruns = __atomic_load_n(&p->underruns, __ATOMIC_ACQUIRE);
+      if(underruns != p->seen_underruns) {
+        p->seen_underruns = underruns;
+        if(p->target < MAX_TARGET * low_water())
+          p->target *= 2;
+      }
+    }
     /* Impose any state change required by the above */
     if(playable()) {
       if(!activated) {
         activated = 1;
-        pthread_mutex_unlock(&lock);
         backend->activate();
-        pthread_mutex_lock(&lock);
       }
     } else {
       if(activated) {
         activated = 0;
-        pthread_mutex_unlock(&lock);
         backend->deactivate();
-        pthread_mutex_lock(&lock);
       }
     }
+    /* Watch the tracks that have room for more data */
+    for(t = tracks; t; t = t->next)
+      update_watch(t);
     /* If we've not reported our state for a second do so now. */
-    if(force_report || xtime(0) > last_report)
+    now = xtime(0);
+    if(force_report || now > last_report)
       report();
+    if(now > last_stats) {
+      report_stats();
+      last_stats = now;
+    }
+    if(now >= last_adapt + ADAPT_INTERVAL) {
+      adapt();
+      last_adapt = now;
+    }
   }
 }
 
@@ -747,7 +1396,6 @@ int main(int argc, char **argv) {
   struct speaker_message sm;
   const char *d;
   char *dir;
-  struct rlimit rl[1];
 
   set_progname(argv);
   if(!setlocale(LC_CTYPE, "")) disorder_fatal(errno, "error calling setlocale");
@@ -780,26 +1428,21 @@ int main(int argc, char **argv) {
   /* make sure we're not root, whatever the config says */
   if(getuid() == 0 || geteuid() == 0)
     disorder_fatal(0, "do not run as root");
-  /* Make sure we can't have more than NFDS files open (it would bust our
-   * poll() array) */
-  if(getrlimit(RLIMIT_NOFILE, rl) < 0)
-    disorder_fatal(errno, "getrlimit RLIMIT_NOFILE");
-  if(rl->rlim_cur > NFDS) {
-    rl->rlim_cur = NFDS;
-    if(setrlimit(RLIMIT_NOFILE, rl) < 0)
-      disorder_fatal(errno, "setrlimit to reduce RLIMIT_NOFILE to %lu",
-            (unsigned long)rl->rlim_cur);
-    disorder_info("set RLIM_NOFILE to %lu", (unsigned long)rl->rlim_cur);
-  } else
-    disorder_info("RLIM_NOFILE is %lu", (unsigned long)rl->rlim_cur);
   /* gcrypt initialization */
   if(!gcry_check_version(NULL))
     disorder_fatal(0, "gcry_check_version failed");
   gcry_control(GCRYCTL_INIT_SECMEM, 0);
   gcry_control (GCRYCTL_INITIALIZATION_FINISHED, 0);
-  /* create a pipe between the backend callback and the poll() loop */
+  /* create a pipe between the backend callback and the main loop.  Neither
+   * end blocks: the callback must never wait for the main loop. */
   xpipe(sigpipe);
   nonblock(sigpipe[0]);
+  nonblock(sigpipe[1]);
+#if HAVE_SYS_EPOLL_H
+  if((epfd = epoll_create(NEVENTS)) < 0)
+    disorder_fatal(errno, "error calling epoll_create");
+  cloexec(epfd);
+#endif
   /* set up audio backend */
   uaudio_set_format(config->sample_format.rate,
                     config->sample_format.channels,
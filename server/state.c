@@ -50,6 +50,7 @@ const struct uaudio *api;
 void quit(ev_source *ev) {
   disorder_info("shutting down...");
   quitting(ev);
+  queue_sync();
   trackdb_close();
   trackdb_deinit(ev);
   /* Shutdown subprocesses.
@@ -0,0 +1,68 @@
+#! /usr/bin/env python
+#
+# This file is part of DisOrder.
+# Copyright (C) 2026 Richard Kettlewell
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+import dtest,disorder
+
+def strip_expected(q):
+    # the expected start time is recomputed every time the queue is listed
+    for e in q:
+        e.pop('expected', None)
+    return q
+
+def test():
+    """Check that binary framing gives the same answers as text framing"""
+    dtest.start_daemon()
+    dtest.create_user()
+    dtest.rescan()
+    t = disorder.client()
+    b = disorder.client(binary=True)
+    t.disable()
+    t.random_disable()
+    print " checking listings"
+    assert b.allfiles(dtest.tracks) == t.allfiles(dtest.tracks), "allfiles"
+    assert b.directories(dtest.tracks) == t.directories(dtest.tracks), "dirs"
+    assert b.search(["first"]) == t.search(["first"]), "search"
+    assert len(b.search(["first"])) > 0, "search found something"
+    assert b.tags() == t.tags(), "tags"
+    assert b.users() == t.users(), "users"
+    assert b.binary, "binary framing was negotiated"
+    assert not t.binary, "text client stays in text mode"
+    print " checking preferences"
+    track = "%s/Joe Bloggs/First Album/02:Second track.ogg" % dtest.tracks
+    t.set(track, "odd", "a \"quoted\"\nvalue")
+    assert b.prefs(track) == t.prefs(track), "prefs"
+    print " checking the queue"
+    for e in t.queue():
+        t.remove(e['id'])
+    t.play(track)
+    t.play(track)
+    q = strip_expected(b.queue())
+    assert len(q) == 2, "queue length"
+    assert q == strip_expected(t.queue()), "queue"
+    assert q[0]['track'] == track, "queue track"
+    assert b.recent() == t.recent(), "recent"
+    print " checking free-text bodies"
+    assert len(b.memstats()) == len(t.memstats()), "memstats"
+    print " checking disorder(1) --binary"
+    args = ["disorder", "--config", disorder._configfile,
+            "--no-per-user-config"]
+    assert (dtest.command(args + ["--binary", "allfiles", dtest.tracks])
+            == dtest.command(args + ["allfiles", dtest.tracks])), "disorder(1)"
+
+if __name__ == '__main__':
+    dtest.run()
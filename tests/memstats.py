@@ -0,0 +1,37 @@
+#! /usr/bin/env python
+#
+# This file is part of DisOrder.
+# Copyright (C) 2026 Richard Kettlewell
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+import dtest,disorder,re
+
+def test():
+    """Check that memstats reports cached listings"""
+    dtest.start_daemon()
+    dtest.create_user()
+    dtest.rescan()
+    c = disorder.client()
+    print " caching a listing"
+    c.files("%s/Joe Bloggs/First Album" % dtest.tracks, "first")
+    print " getting memory stats"
+    m = c.memstats()
+    n = [int(r.group(1)) for r in [re.match("cache: (\d+) entries", l)
+                                   for l in m] if r]
+    assert len(n) == 1, "checking for cache line"
+    assert n[0] > 0, "checking cache entries"
+
+if __name__ == '__main__':
+    dtest.run()
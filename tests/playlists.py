@@ -1,7 +1,7 @@
 #! /usr/bin/env python
 #
 # This file is part of DisOrder.
-# Copyright (C) 2008 Richard Kettlewell
+# Copyright (C) 2008, 2026 Richard Kettlewell
 #
 # This program is free software; you can redistribute it and/or modify
 # it under the terms of the GNU General Public License as published by
@@ -62,6 +62,56 @@ def test():
     l = c.playlist_get("wibble")
     assert l == ["three", "two", "one"], "checking modified playlist contents"
     #
+    print " editing shared playlist in place"
+    c.playlist_lock("wibble")
+    c.playlist_insert("wibble", 3, ["four", "five"])
+    c.playlist_insert("wibble", 0, ["zero"])
+    assert c.playlist_get("wibble") == ["zero", "three", "two", "one",
+                                        "four", "five"], "checking insert"
+    c.playlist_move("wibble", 1, 3, 2)
+    assert c.playlist_get("wibble") == ["zero", "four", "three", "two",
+                                        "one", "five"], "checking move"
+    c.playlist_remove("wibble", 0, 2)
+    assert c.playlist_get("wibble") == ["three", "two", "one",
+                                        "five"], "checking remove"
+    assert c.playlist_length("wibble") == 4, "checking length"
+    try:
+        c.playlist_remove("wibble", 3, 2)
+        print "*** should not be able to remove past the end ***"
+        assert False
+    except disorder.operationError:
+        pass                            # good
+    for bad in ["foo", "1x", "-1", ""]:
+        try:
+            c.playlist_remove("wibble", bad, 1)
+            print "*** should not accept position %s ***" % repr(bad)
+            assert False
+        except disorder.operationError:
+            pass                        # good
+    try:
+        c.playlist_insert("wibble", "foo", ["six"])
+        print "*** should not accept an invalid insert position ***"
+        assert False
+    except disorder.operationError:
+        pass                            # good
+    assert c.playlist_length("wibble") == 4, "checking nothing changed"
+    c.playlist_remove("wibble", 3, 1)
+    c.playlist_unlock()
+    #
+    print " editing a long playlist"
+    c.playlist_lock("wibble")
+    big = ["track%d" % n for n in range(2000)]
+    c.playlist_insert("wibble", 0, big)
+    big = big + ["three", "two", "one"]
+    for n in range(0, 1000, 7):
+        c.playlist_move("wibble", n, 1, 1990 - n)
+        big.insert(1990 - n, big.pop(n))
+    c.playlist_remove("wibble", 100, 600)
+    del big[100:700]
+    assert c.playlist_get("wibble") == big, "checking long playlist"
+    c.playlist_set("wibble", ["three", "two", "one"])
+    c.playlist_unlock()
+    #
     print " creating a private playlist"
     c.playlist_lock("fred.spong")
     c.playlist_set("fred.spong", ["a", "b", "c"])
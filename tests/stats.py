@@ -0,0 +1,36 @@
+#! /usr/bin/env python
+#
+# This file is part of DisOrder.
+# Copyright (C) 2026 Richard Kettlewell
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+#
+import dtest,disorder
+
+def test():
+    """Check that server statistics include command timings"""
+    dtest.start_daemon()
+    dtest.create_user()
+    c = disorder.client()
+    c.version()
+    c.version()
+    print " getting server stats"
+    s = c.stats()
+    assert "Command stats:" in s, "checking for command stats"
+    v = [l for l in s if l.startswith("version: ")]
+    assert len(v) == 1, "checking version command was timed"
+    assert int(v[0].split()[1]) >= 2, "checking call count"
+
+if __name__ == '__main__':
+    dtest.run()